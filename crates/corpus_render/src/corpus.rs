@@ -0,0 +1,163 @@
+//! コーパスの項目。
+
+use std::{
+    path::{Component, Path},
+    time::SystemTime,
+};
+
+use anyhow::{bail, ensure};
+use serde::{Deserialize, Serialize};
+use voicevox_core::{AudioQueryModel, OutputFormat, StyleId, Synthesizer, TtsOptions};
+
+/// コーパスのJSONLの一行。
+///
+/// `text`と`audio_query`のどちらか一方を指定する。
+#[derive(Deserialize)]
+#[serde(deny_unknown_fields)]
+pub(crate) struct Entry {
+    /// アーカイブの中でのファイル名(拡張子を除く)。指定しなければ行番号を使う。
+    pub(crate) id: Option<String>,
+    /// 読み上げる文章。
+    text: Option<String>,
+    /// `text`の代わりに合成するAudioQuery。
+    audio_query: Option<AudioQueryModel>,
+    /// 話者のスタイルID。
+    style_id: u32,
+    /// `text`をAquesTalk風記法として解釈する。
+    #[serde(default)]
+    kana: bool,
+    #[serde(default = "default_enable_interrogative_upspeak")]
+    enable_interrogative_upspeak: bool,
+    /// 出力の形式。指定しなければコマンドラインで指定したものを使う。
+    output_format: Option<OutputFormat>,
+}
+
+fn default_enable_interrogative_upspeak() -> bool {
+    true
+}
+
+/// 項目を合成した結果。
+pub(crate) struct Rendered {
+    /// アーカイブの中でのファイル名。
+    pub(crate) name: String,
+    pub(crate) data: Vec<u8>,
+    /// 音声の長さ(秒)。
+    pub(crate) duration: f64,
+}
+
+impl Entry {
+    /// 項目を合成する。
+    ///
+    /// `line`はコーパスの中での行番号(1始まり)で、`id`が無いときのファイル名に使う。
+    pub(crate) async fn render(
+        self,
+        synthesizer: &Synthesizer,
+        line: u64,
+        default_format: OutputFormat,
+    ) -> anyhow::Result<Rendered> {
+        let output_format = self.output_format.unwrap_or(default_format);
+        let name = match &self.id {
+            Some(id) => {
+                ensure!(is_safe_name(id), "`id` must be a relative path: {id:?}");
+                format!("{id}.{}", extension(output_format))
+            }
+            None => format!("{line:08}.{}", extension(output_format)),
+        };
+        let style_id = StyleId::new(self.style_id);
+
+        let options = &TtsOptions {
+            kana: self.kana,
+            enable_interrogative_upspeak: self.enable_interrogative_upspeak,
+            ..Default::default()
+        };
+        let waveform = match (self.text, self.audio_query) {
+            (Some(text), None) => synthesizer.tts_waveform(&text, style_id, options).await?,
+            (None, Some(audio_query)) => {
+                synthesizer
+                    .synthesis_waveform(&audio_query, style_id, &options.into())
+                    .await?
+            }
+            _ => bail!("exactly one of `text` and `audio_query` must be specified"),
+        };
+
+        Ok(Rendered {
+            name,
+            data: waveform.encode(output_format),
+            duration: waveform.num_frames() as f64 / f64::from(waveform.sampling_rate()),
+        })
+    }
+}
+
+/// コーパスのファイルの長さと更新日時。
+///
+/// 再開するときに、コーパスが書き換えられていないかを確かめるのに使う。大きなコーパスを再開の
+/// たびに読み通さないよう、内容のハッシュは取らない。
+#[derive(Clone, Copy, Default, PartialEq, Eq, Debug, Deserialize, Serialize)]
+pub(crate) struct Fingerprint {
+    len: u64,
+    /// 更新日時(UNIX時間、ナノ秒)。
+    modified: u64,
+}
+
+impl Fingerprint {
+    #[cfg(test)]
+    pub(crate) const fn new(len: u64, modified: u64) -> Self {
+        Self { len, modified }
+    }
+
+    pub(crate) fn of(path: &Path) -> anyhow::Result<Self> {
+        let metadata = fs_err::metadata(path)?;
+        let modified = metadata
+            .modified()?
+            .duration_since(SystemTime::UNIX_EPOCH)
+            .unwrap_or_default();
+        Ok(Self {
+            len: metadata.len(),
+            modified: modified.as_nanos() as u64,
+        })
+    }
+}
+
+/// 展開したときにアーカイブの外を指さないか。
+fn is_safe_name(id: &str) -> bool {
+    !id.is_empty()
+        && Path::new(id)
+            .components()
+            .all(|component| matches!(component, Component::Normal(_)))
+}
+
+fn extension(output_format: OutputFormat) -> &'static str {
+    match output_format {
+        OutputFormat::Wav => "wav",
+        OutputFormat::Flac => "flac",
+        OutputFormat::MuLaw => "ulaw",
+        OutputFormat::ALaw => "alaw",
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn fingerprint_changes_when_corpus_is_edited() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("corpus.jsonl");
+        fs_err::write(&path, "{}\n").unwrap();
+        let fingerprint = Fingerprint::of(&path).unwrap();
+        assert_eq!(fingerprint, Fingerprint::of(&path).unwrap());
+
+        fs_err::write(&path, "{}\n{}\n").unwrap();
+        assert_ne!(fingerprint, Fingerprint::of(&path).unwrap());
+    }
+
+    #[test]
+    fn is_safe_name_works() {
+        assert!(is_safe_name("0001"));
+        assert!(is_safe_name("speaker/0001"));
+        assert!(!is_safe_name(""));
+        assert!(!is_safe_name("/etc/passwd"));
+        assert!(!is_safe_name("../0001"));
+        assert!(!is_safe_name("a/../../0001"));
+    }
+}
@@ -0,0 +1,375 @@
+//! コーパスをまとめて音声にする。
+//!
+//! JSONLのコーパスの各行を、行の順番でシャードに振り分ける(`n`番目の行はシャード
+//! `n % シャード数`)。シャードごとに`Synthesizer`を一つずつ作り、別々のスレッドで並列に合成する。
+//! 推論セッションもシャードごとに持つため、シャードどうしが推論を待ち合うことはないが、推論モデル
+//! はシャードの数だけメモリに載る。
+//!
+//! 出力はシャードごとのtarアーカイブにまとめ、進捗をチェックポイントとして残す。同じコーパス・
+//! 出力先・シャード数で再び実行すると、チェックポイントの続きから再開する。コーパスは長さと更新
+//! 日時で見分け、書き換えられていれば再開しない。
+//!
+//! ```console
+//! $ cargo run --release -p corpus_render -- corpus.jsonl -o out --open-jtalk-dict-dir dict
+//! ```
+//!
+//! コーパスの一行は次のような形になる。`audio_query`を`text`の代わりに指定することもできる。
+//!
+//! ```json
+//! {"id": "0001", "text": "こんにちは", "style_id": 0, "output_format": "flac"}
+//! ```
+
+mod corpus;
+mod shard;
+
+use std::{
+    io::{self, BufRead as _, BufReader},
+    path::{Path, PathBuf},
+    sync::{
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        mpsc, Arc,
+    },
+    thread,
+    time::{Duration, Instant},
+};
+
+use anyhow::{anyhow, Context as _};
+use clap::{Parser as _, ValueEnum};
+use tokio::runtime::{Handle, Runtime};
+use tracing::{error, info};
+use voicevox_core::{
+    AccelerationMode, InitializeOptions, OpenJtalk, OutputFormat, Synthesizer, VoiceModel,
+};
+
+use crate::{
+    corpus::{Entry, Fingerprint},
+    shard::ShardWriter,
+};
+
+/// シャードごとに、まだ処理していない行をいくつまで溜めるか。
+const QUEUE_LEN: usize = 256;
+const READ_BUFFER_SIZE: usize = 1024 * 1024;
+const MIB: usize = 1024 * 1024;
+
+#[derive(clap::Parser)]
+struct Args {
+    /// コーパスのJSONL
+    corpus: PathBuf,
+
+    /// 出力先のディレクトリ
+    #[arg(short, long)]
+    output: PathBuf,
+
+    /// Open JTalkの辞書のディレクトリ
+    #[arg(long)]
+    open_jtalk_dict_dir: PathBuf,
+
+    /// 読み込むVVMファイル。指定しなければ、モデルディレクトリにあるものをすべて読み込む
+    #[arg(long)]
+    vvm: Vec<PathBuf>,
+
+    /// シャードの数。指定しなければ、論理コア数を`--threads`で割った数
+    #[arg(long)]
+    shards: Option<usize>,
+
+    /// シャードごとの推論のスレッド数
+    #[arg(long, default_value_t = 1)]
+    threads: u16,
+
+    /// ハードウェアアクセラレーションモード
+    #[arg(value_enum, long, default_value_t = Device::Cpu)]
+    device: Device,
+
+    /// 項目で指定されていないときの出力の形式
+    #[arg(value_enum, long, default_value_t = Format::Wav)]
+    format: Format,
+
+    /// アーカイブを分ける大きさ(MiB)
+    #[arg(long, default_value_t = 1024)]
+    archive_size_mib: u64,
+
+    /// アーカイブへの書き込みのバッファの大きさ(MiB)
+    #[arg(long, default_value_t = 8)]
+    write_buffer_mib: usize,
+
+    /// チェックポイントを更新する間隔(項目数)
+    #[arg(long, default_value_t = 256)]
+    checkpoint_interval: u64,
+
+    /// 進捗を表示する間隔(秒)
+    #[arg(long, default_value_t = 10, value_parser = clap::value_parser!(u64).range(1..))]
+    report_interval: u64,
+}
+
+#[derive(ValueEnum, Clone, Copy)]
+enum Device {
+    Cpu,
+    Gpu,
+}
+
+#[derive(ValueEnum, Clone, Copy)]
+enum Format {
+    Wav,
+    Flac,
+    Mulaw,
+    Alaw,
+}
+
+impl From<Format> for OutputFormat {
+    fn from(format: Format) -> Self {
+        match format {
+            Format::Wav => Self::Wav,
+            Format::Flac => Self::Flac,
+            Format::Mulaw => Self::MuLaw,
+            Format::Alaw => Self::ALaw,
+        }
+    }
+}
+
+/// 全シャードの、この実行での処理の合計。
+#[derive(Default)]
+struct Progress {
+    rendered: AtomicU64,
+    failed: AtomicU64,
+    /// 合成した音声の長さ(マイクロ秒)。
+    audio_micros: AtomicU64,
+    /// アーカイブに書いたバイト数。
+    bytes: AtomicU64,
+}
+
+impl Progress {
+    fn report(&self, elapsed: Duration, cores: usize) {
+        let rendered = self.rendered.load(Ordering::Relaxed);
+        let failed = self.failed.load(Ordering::Relaxed);
+        let audio = self.audio_micros.load(Ordering::Relaxed) as f64 / 1e6;
+        let bytes = self.bytes.load(Ordering::Relaxed) as f64;
+        let secs = elapsed.as_secs_f64();
+        // 実時間比(RTF)は、全体のものとコアあたりのものを出す
+        let rtf = secs / audio;
+        info!(
+            "{rendered} rendered, {failed} failed in {secs:.0}s: {:.1} items/s, {:.1} MiB/s, \
+             {audio:.0}s of audio, RTF {rtf:.4} ({:.4} per core)",
+            rendered as f64 / secs,
+            bytes / secs / (1024. * 1024.),
+            rtf * cores as f64,
+        );
+    }
+}
+
+fn main() -> anyhow::Result<()> {
+    setup_logger();
+
+    let args = Args::parse();
+    let threads = args.threads.max(1);
+    let shards = args.shards.unwrap_or_else(|| {
+        let cpus = thread::available_parallelism().map_or(1, |n| n.get());
+        (cpus / usize::from(threads)).max(1)
+    });
+    let cores = shards * usize::from(threads);
+    let corpus = Fingerprint::of(&args.corpus)
+        .with_context(|| format!("could not read {}", args.corpus.display()))?;
+    fs_err::create_dir_all(&args.output)?;
+
+    let runtime = Runtime::new()?;
+    let models = runtime.block_on(load_models(&args.vvm))?;
+    info!(
+        "loaded {} model(s), rendering with {shards} shard(s)",
+        models.len()
+    );
+
+    let progress = Progress::default();
+    let complete = AtomicBool::new(false);
+    let finished = AtomicBool::new(false);
+    let start = Instant::now();
+
+    let (dispatched, results) = thread::scope(|s| {
+        let reporter = s.spawn(|| {
+            while !finished.load(Ordering::Acquire) {
+                thread::park_timeout(Duration::from_secs(args.report_interval));
+                if !finished.load(Ordering::Acquire) {
+                    progress.report(start.elapsed(), cores);
+                }
+            }
+        });
+
+        let (senders, handles): (Vec<_>, Vec<_>) = (0..shards)
+            .map(|shard| {
+                let (tx, rx) = mpsc::sync_channel(QUEUE_LEN);
+                let worker = Worker {
+                    shard,
+                    shards,
+                    corpus,
+                    args: &args,
+                    threads,
+                    models: &models,
+                    progress: &progress,
+                    complete: &complete,
+                };
+                let runtime = runtime.handle();
+                (tx, s.spawn(move || worker.run(rx, runtime)))
+            })
+            .unzip();
+
+        let dispatched = dispatch(&args.corpus, &senders);
+        complete.store(dispatched.is_ok(), Ordering::Release);
+        drop(senders);
+
+        let results = handles
+            .into_iter()
+            .map(|handle| handle.join().unwrap())
+            .collect::<Vec<_>>();
+        finished.store(true, Ordering::Release);
+        reporter.thread().unpark();
+        (dispatched, results)
+    });
+
+    progress.report(start.elapsed(), cores);
+    dispatched.with_context(|| format!("could not read {}", args.corpus.display()))?;
+    let mut failed_shards = 0;
+    for (shard, result) in results.into_iter().enumerate() {
+        if let Err(err) = result {
+            error!("shard {shard} failed: {err:#}");
+            failed_shards += 1;
+        }
+    }
+    if failed_shards > 0 {
+        return Err(anyhow!(
+            "{failed_shards} shard(s) failed. run again with the same arguments to resume"
+        ));
+    }
+    Ok(())
+}
+
+/// コーパスを読み、行の順番でシャードに振り分ける。空行は数えない。
+fn dispatch(corpus: &Path, senders: &[mpsc::SyncSender<(u64, String)>]) -> anyhow::Result<()> {
+    let corpus = BufReader::with_capacity(READ_BUFFER_SIZE, fs_err::File::open(corpus)?);
+    let mut index = 0;
+    for (i, line) in corpus.lines().enumerate() {
+        let line = line?;
+        if line.trim().is_empty() {
+            continue;
+        }
+        // 送れないのはそのシャードが失敗して終わったときで、理由はシャードの側で報告する。ほかの
+        // シャードには振り分け続ける
+        let _ = senders[index % senders.len()].send((i as u64 + 1, line));
+        index += 1;
+    }
+    Ok(())
+}
+
+async fn load_models(vvms: &[PathBuf]) -> anyhow::Result<Vec<VoiceModel>> {
+    if vvms.is_empty() {
+        return Ok(VoiceModel::get_all_models().await?);
+    }
+    let mut models = Vec::with_capacity(vvms.len());
+    for vvm in vvms {
+        models.push(VoiceModel::from_path(vvm).await?);
+    }
+    Ok(models)
+}
+
+/// 一つのシャードを処理する。
+struct Worker<'a> {
+    shard: usize,
+    shards: usize,
+    corpus: Fingerprint,
+    args: &'a Args,
+    threads: u16,
+    models: &'a [VoiceModel],
+    progress: &'a Progress,
+    /// コーパスをすべて振り分け終えたか。
+    complete: &'a AtomicBool,
+}
+
+impl Worker<'_> {
+    fn run(self, lines: mpsc::Receiver<(u64, String)>, runtime: &Handle) -> anyhow::Result<()> {
+        let args = self.args;
+        let mut writer = ShardWriter::open(
+            &args.output,
+            self.shard,
+            self.shards,
+            self.corpus,
+            args.archive_size_mib * MIB as u64,
+            args.write_buffer_mib * MIB,
+        )?;
+        if writer.checkpoint().finished {
+            lines.iter().for_each(drop);
+            return Ok(());
+        }
+        let synthesizer = runtime.block_on(self.synthesizer())?;
+        let format = args.format.into();
+
+        // 前回までに処理した項目は飛ばす
+        let skip = writer.checkpoint().done as usize;
+        for (line, json) in lines.iter().skip(skip) {
+            let entry = serde_json::from_str::<Entry>(&json);
+            let id = entry.as_ref().ok().and_then(|entry| entry.id.clone());
+            let rendered = match entry {
+                Ok(entry) => runtime.block_on(entry.render(&synthesizer, line, format)),
+                Err(err) => Err(err.into()),
+            };
+
+            match rendered {
+                Ok(rendered) => {
+                    writer.append(&rendered.name, &rendered.data)?;
+                    let progress = self.progress;
+                    progress.rendered.fetch_add(1, Ordering::Relaxed);
+                    progress
+                        .audio_micros
+                        .fetch_add((rendered.duration * 1e6) as u64, Ordering::Relaxed);
+                    progress
+                        .bytes
+                        .fetch_add(rendered.data.len() as u64, Ordering::Relaxed);
+                }
+                Err(err) => {
+                    writer.fail(line, id.as_deref(), &format!("{err:#}"))?;
+                    self.progress.failed.fetch_add(1, Ordering::Relaxed);
+                }
+            }
+            if writer.pending() >= args.checkpoint_interval {
+                writer.commit()?;
+            }
+        }
+
+        // コーパスを最後まで読めなかった場合は、続きがあるものとして終わりにしない
+        if self.complete.load(Ordering::Acquire) {
+            writer.finish()?;
+        } else {
+            writer.commit()?;
+        }
+        Ok(())
+    }
+
+    async fn synthesizer(&self) -> anyhow::Result<Synthesizer> {
+        // Open JTalkは一度に一つの解析しかできないため、シャードごとに持つ
+        let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(
+            &self.args.open_jtalk_dict_dir,
+        )?);
+        let synthesizer = Synthesizer::new_with_initialize(
+            open_jtalk,
+            &InitializeOptions {
+                acceleration_mode: match self.args.device {
+                    Device::Cpu => AccelerationMode::Cpu,
+                    Device::Gpu => AccelerationMode::Gpu,
+                },
+                cpu_num_threads: self.threads,
+                // 推論セッションを他のシャードと共有すると、推論がシャードをまたいで一つずつになる
+                share_sessions: false,
+                ..Default::default()
+            },
+        )
+        .await?;
+        for model in self.models {
+            synthesizer.load_voice_model(model).await?;
+        }
+        Ok(synthesizer)
+    }
+}
+
+fn setup_logger() {
+    tracing_subscriber::fmt()
+        .with_env_filter(format!("error,{}=info", env!("CARGO_CRATE_NAME")))
+        .with_writer(io::stderr)
+        .with_target(false)
+        .init();
+}
@@ -0,0 +1,337 @@
+//! シャードごとの出力。
+//!
+//! 一つのシャードは、一定の大きさごとに分けたtarアーカイブ(`shard-0003-0000.tar`、
+//! `shard-0003-0001.tar`、...)と、失敗した項目の一覧(`shard-0003.errors.jsonl`)、進捗の
+//! チェックポイント(`shard-0003.checkpoint.json`)からなる。
+//!
+//! アーカイブは大きなバッファを通して先頭から順に書く。チェックポイントはアーカイブと失敗した項目の
+//! 一覧を同期した後にだけ更新するため、チェックポイントに書かれた長さまでは必ず書き終わっている。
+//! 再開するときは、その長さより後ろの中途半端な部分を切り捨ててから続きを書く。
+
+use std::{
+    io::{self, BufWriter, Seek as _, SeekFrom, Write},
+    path::{Path, PathBuf},
+};
+
+use anyhow::{ensure, Context as _};
+use fs_err::{File, OpenOptions};
+use serde::{Deserialize, Serialize};
+
+use crate::corpus::Fingerprint;
+
+/// シャードの進捗。
+#[derive(Default, PartialEq, Debug, Deserialize, Serialize)]
+pub(crate) struct Checkpoint {
+    /// シャードの総数。再開するときに一致しなければならない。
+    shards: usize,
+    /// コーパス。再開するときに一致しなければならない。
+    corpus: Fingerprint,
+    /// 処理し終えた、このシャードの項目の数。失敗したものも含む。
+    pub(crate) done: u64,
+    /// 書いている途中のアーカイブの番号。
+    part: u32,
+    /// 書いている途中のアーカイブのうち、書き終わっている長さ。
+    part_len: u64,
+    /// 失敗した項目の一覧のうち、書き終わっている長さ。
+    errors_len: u64,
+    /// すべての項目を処理し終えたか。
+    pub(crate) finished: bool,
+}
+
+/// シャードの出力先。
+pub(crate) struct ShardWriter {
+    dir: PathBuf,
+    shard: usize,
+    /// アーカイブを分ける大きさ。
+    part_size: u64,
+    buffer_size: usize,
+    checkpoint: Checkpoint,
+    /// 書いている途中のアーカイブ。分ける間だけ`None`になる。
+    archive: Option<tar::Builder<CountingWriter>>,
+    errors: CountingWriter,
+    /// 直近のチェックポイントの後に処理した項目の数。
+    pending: u64,
+}
+
+impl ShardWriter {
+    /// シャードの出力を開く。チェックポイントがあれば、その続きから書く。
+    pub(crate) fn open(
+        dir: &Path,
+        shard: usize,
+        shards: usize,
+        corpus: Fingerprint,
+        part_size: u64,
+        buffer_size: usize,
+    ) -> anyhow::Result<Self> {
+        let checkpoint_path = checkpoint_path(dir, shard);
+        let checkpoint = if checkpoint_path.exists() {
+            let checkpoint = serde_json::from_slice::<Checkpoint>(&fs_err::read(&checkpoint_path)?)
+                .with_context(|| format!("could not parse {}", checkpoint_path.display()))?;
+            ensure!(
+                checkpoint.shards == shards,
+                "{} was written with {} shards, but {shards} shards are specified",
+                checkpoint_path.display(),
+                checkpoint.shards,
+            );
+            // 行の振り分けはコーパスの内容で決まるため、書き換えられたコーパスの続きを書くと
+            // アーカイブの中身が食い違う
+            ensure!(
+                checkpoint.corpus == corpus,
+                "{} was written for a different version of the corpus. remove the output to \
+                 start over",
+                checkpoint_path.display(),
+            );
+            checkpoint
+        } else {
+            Checkpoint {
+                shards,
+                corpus,
+                ..Default::default()
+            }
+        };
+
+        let archive = CountingWriter::open(
+            &part_path(dir, shard, checkpoint.part),
+            checkpoint.part_len,
+            buffer_size,
+        )?;
+        let errors = CountingWriter::open(
+            &dir.join(format!("shard-{shard:04}.errors.jsonl")),
+            checkpoint.errors_len,
+            buffer_size.min(DEFAULT_BUFFER_SIZE),
+        )?;
+
+        Ok(Self {
+            dir: dir.to_owned(),
+            shard,
+            part_size,
+            buffer_size,
+            checkpoint,
+            archive: Some(tar::Builder::new(archive)),
+            errors,
+            pending: 0,
+        })
+    }
+
+    pub(crate) fn checkpoint(&self) -> &Checkpoint {
+        &self.checkpoint
+    }
+
+    /// 直近のチェックポイントの後に処理した項目の数。
+    pub(crate) fn pending(&self) -> u64 {
+        self.pending
+    }
+
+    /// 項目の出力を`name`としてアーカイブに加える。
+    pub(crate) fn append(&mut self, name: &str, data: &[u8]) -> anyhow::Result<()> {
+        let mut header = tar::Header::new_gnu();
+        header.set_size(data.len() as _);
+        header.set_mode(0o644);
+        let archive = self.archive.as_mut().unwrap();
+        archive.append_data(&mut header, name, data)?;
+        self.pending += 1;
+
+        if archive.get_ref().len >= self.part_size {
+            self.next_part()?;
+        }
+        Ok(())
+    }
+
+    /// 失敗した項目を記録する。
+    pub(crate) fn fail(&mut self, line: u64, id: Option<&str>, error: &str) -> anyhow::Result<()> {
+        serde_json::to_writer(
+            &mut self.errors,
+            &serde_json::json!({ "line": line, "id": id, "error": error }),
+        )?;
+        self.errors.write_all(b"\n")?;
+        self.pending += 1;
+        Ok(())
+    }
+
+    /// ここまでの出力を同期し、チェックポイントを更新する。
+    pub(crate) fn commit(&mut self) -> anyhow::Result<()> {
+        let archive = self.archive.as_mut().unwrap().get_mut();
+        archive.sync()?;
+        self.errors.sync()?;
+        self.checkpoint.part_len = archive.len;
+        self.checkpoint.errors_len = self.errors.len;
+        self.checkpoint.done += self.pending;
+        self.pending = 0;
+        self.write_checkpoint()
+    }
+
+    /// アーカイブを閉じ、すべての項目を処理し終えたことを記録する。
+    pub(crate) fn finish(mut self) -> anyhow::Result<Checkpoint> {
+        let mut archive = self.archive.take().unwrap().into_inner()?;
+        archive.sync()?;
+        self.errors.sync()?;
+        self.checkpoint.part_len = archive.len;
+        self.checkpoint.errors_len = self.errors.len;
+        self.checkpoint.done += self.pending;
+        self.checkpoint.finished = true;
+        self.write_checkpoint()?;
+        Ok(self.checkpoint)
+    }
+
+    /// 書いている途中のアーカイブを閉じ、次のアーカイブに移る。
+    fn next_part(&mut self) -> anyhow::Result<()> {
+        let mut archive = self.archive.take().unwrap().into_inner()?;
+        archive.sync()?;
+        let part = self.checkpoint.part + 1;
+        let archive =
+            CountingWriter::open(&part_path(&self.dir, self.shard, part), 0, self.buffer_size)?;
+        self.archive = Some(tar::Builder::new(archive));
+
+        // 閉じたアーカイブに入れた項目は、次のアーカイブに移った時点で処理し終えたものとする
+        self.checkpoint.part = part;
+        self.checkpoint.part_len = 0;
+        self.errors.sync()?;
+        self.checkpoint.errors_len = self.errors.len;
+        self.checkpoint.done += self.pending;
+        self.pending = 0;
+        self.write_checkpoint()
+    }
+
+    /// チェックポイントを、書きかけのものが残らないよう一時ファイルからの置き換えで書く。
+    fn write_checkpoint(&self) -> anyhow::Result<()> {
+        let path = checkpoint_path(&self.dir, self.shard);
+        let tmp = path.with_extension("json.tmp");
+        let mut file = File::create(&tmp)?;
+        file.write_all(&serde_json::to_vec(&self.checkpoint)?)?;
+        file.sync_data()?;
+        fs_err::rename(tmp, path)?;
+        Ok(())
+    }
+}
+
+const DEFAULT_BUFFER_SIZE: usize = 64 * 1024;
+
+fn checkpoint_path(dir: &Path, shard: usize) -> PathBuf {
+    dir.join(format!("shard-{shard:04}.checkpoint.json"))
+}
+
+fn part_path(dir: &Path, shard: usize, part: u32) -> PathBuf {
+    dir.join(format!("shard-{shard:04}-{part:04}.tar"))
+}
+
+/// 書いた長さを数える、バッファ付きのファイル。
+struct CountingWriter {
+    file: BufWriter<File>,
+    len: u64,
+}
+
+impl CountingWriter {
+    /// `path`を開き、`len`より後ろを切り捨てて、その続きから書く。
+    fn open(path: &Path, len: u64, buffer_size: usize) -> io::Result<Self> {
+        let mut file = OpenOptions::new()
+            .create(true)
+            .write(true)
+            .truncate(false)
+            .open(path)?;
+        file.set_len(len)?;
+        file.seek(SeekFrom::Start(len))?;
+        Ok(Self {
+            file: BufWriter::with_capacity(buffer_size, file),
+            len,
+        })
+    }
+
+    fn sync(&mut self) -> io::Result<()> {
+        self.file.flush()?;
+        self.file.get_ref().sync_data()
+    }
+}
+
+impl Write for CountingWriter {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let n = self.file.write(buf)?;
+        self.len += n as u64;
+        Ok(n)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.file.flush()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::io::Read as _;
+
+    use super::*;
+
+    const CORPUS: Fingerprint = Fingerprint::new(100, 0);
+
+    fn read_archive(path: &Path) -> Vec<(String, Vec<u8>)> {
+        let mut archive = tar::Archive::new(File::open(path).unwrap());
+        archive
+            .entries()
+            .unwrap()
+            .map(|entry| {
+                let mut entry = entry.unwrap();
+                let name = entry.path().unwrap().to_str().unwrap().to_owned();
+                let mut data = vec![];
+                entry.read_to_end(&mut data).unwrap();
+                (name, data)
+            })
+            .collect()
+    }
+
+    #[test]
+    fn resume_discards_uncommitted_entries() {
+        let dir = tempfile::tempdir().unwrap();
+
+        let mut writer = ShardWriter::open(dir.path(), 0, 2, CORPUS, u64::MAX, 1024).unwrap();
+        writer.append("a.wav", b"aaa").unwrap();
+        writer.fail(2, Some("b"), "error").unwrap();
+        writer.commit().unwrap();
+        writer.append("c.wav", b"ccc").unwrap();
+        writer.fail(4, Some("d"), "error").unwrap();
+        // 中断したものとして、チェックポイントを更新せずに終える
+        let CountingWriter { file, .. } = writer.archive.take().unwrap().into_inner().unwrap();
+        drop(file);
+        drop(writer);
+
+        let mut writer = ShardWriter::open(dir.path(), 0, 2, CORPUS, u64::MAX, 1024).unwrap();
+        assert_eq!(2, writer.checkpoint().done);
+        writer.append("c.wav", b"ccc2").unwrap();
+        let checkpoint = writer.finish().unwrap();
+        assert_eq!(3, checkpoint.done);
+        assert!(checkpoint.finished);
+
+        assert_eq!(
+            vec![
+                ("a.wav".to_owned(), b"aaa".to_vec()),
+                ("c.wav".to_owned(), b"ccc2".to_vec()),
+            ],
+            read_archive(&dir.path().join("shard-0000-0000.tar")),
+        );
+        let errors = fs_err::read_to_string(dir.path().join("shard-0000.errors.jsonl")).unwrap();
+        assert_eq!(1, errors.lines().count());
+        assert!(ShardWriter::open(dir.path(), 0, 3, CORPUS, u64::MAX, 1024).is_err());
+        let edited = Fingerprint::new(101, 0);
+        assert!(ShardWriter::open(dir.path(), 0, 2, edited, u64::MAX, 1024).is_err());
+    }
+
+    #[test]
+    fn archives_are_split_by_size() {
+        let dir = tempfile::tempdir().unwrap();
+
+        let mut writer = ShardWriter::open(dir.path(), 1, 2, CORPUS, 4096, 1024).unwrap();
+        for i in 0..10 {
+            writer.append(&format!("{i}.wav"), &[i; 1000]).unwrap();
+        }
+        let checkpoint = writer.finish().unwrap();
+        assert_eq!(10, checkpoint.done);
+
+        let entries = (0..=checkpoint.part)
+            .flat_map(|part| read_archive(&part_path(dir.path(), 1, part)))
+            .collect::<Vec<_>>();
+        assert!(checkpoint.part > 0);
+        assert_eq!(10, entries.len());
+        for (i, (name, data)) in entries.into_iter().enumerate() {
+            assert_eq!(format!("{i}.wav"), name);
+            assert_eq!(vec![i as u8; 1000], data);
+        }
+    }
+}
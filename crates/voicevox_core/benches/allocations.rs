@@ -0,0 +1,133 @@
+//! 音声合成の各処理段階での、ヒープ確保の回数とバイト数を計測する。
+//!
+//! グローバルアロケータを差し替えて数えるため、Rust側での確保のみが対象となる(ONNX Runtime内部での
+//! 確保は含まれない)。推論を伴うものはサンプルのVVM(`model/sample.vvm`)で計測する。
+
+use std::{
+    alloc::{GlobalAlloc, Layout, System},
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Arc,
+    },
+};
+
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Builder;
+use voicevox_core::{
+    AccelerationMode, InitializeOptions, OpenJtalk, StyleId, SynthesisOptions, Synthesizer,
+    TtsOptions, VoiceModel, __internal::expand_frames,
+};
+
+#[global_allocator]
+static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+static ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+struct CountingAllocator;
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(layout.size(), Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(new_size, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+const TEXTS: &[(&str, &str)] = &[
+    ("short", "こんにちは"),
+    (
+        "medium",
+        "この音声は、ボイスボックスを使用して、出力されています。",
+    ),
+    (
+        "long",
+        "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。\
+         何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。",
+    ),
+];
+const STYLE_ID: u32 = 302;
+
+fn main() -> anyhow::Result<()> {
+    // 他のスレッドでの確保を数えないよう、現在のスレッドのみで動かす
+    let runtime = Builder::new_current_thread().enable_all().build()?;
+    let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR)?);
+
+    runtime.block_on(async {
+        let model = VoiceModel::from_path(concat!(
+            env!("CARGO_MANIFEST_DIR"),
+            "/../../model/sample.vvm",
+        ))
+        .await?;
+        let synthesizer = Synthesizer::new_with_initialize(
+            open_jtalk,
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                ..Default::default()
+            },
+        )
+        .await?;
+        synthesizer.load_voice_model(&model).await?;
+        let style_id = StyleId::new(STYLE_ID);
+
+        println!("| stage | text | allocations | bytes |");
+        println!("|-------|------|-------------|-------|");
+        for &(name, text) in TEXTS {
+            let audio_query = synthesizer
+                .audio_query(text, style_id, &Default::default())
+                .await?;
+            let accent_phrases = audio_query.accent_phrases();
+
+            let (allocations, bytes) =
+                count(synthesizer.audio_query(text, style_id, &Default::default())).await;
+            println!("| audio_query | {name} | {allocations} | {bytes} |");
+
+            let (allocations, bytes) =
+                count(synthesizer.replace_mora_data(accent_phrases, style_id)).await;
+            println!("| replace_mora_data | {name} | {allocations} | {bytes} |");
+
+            let (allocations, bytes) =
+                count(synthesizer.replace_phoneme_length(accent_phrases, style_id)).await;
+            println!("| replace_phoneme_length | {name} | {allocations} | {bytes} |");
+
+            let (allocations, bytes) =
+                count(synthesizer.replace_mora_pitch(accent_phrases, style_id)).await;
+            println!("| replace_mora_pitch | {name} | {allocations} | {bytes} |");
+
+            let (allocations, bytes) = count(async { expand_frames(&audio_query, true) }).await;
+            println!("| expand_frames | {name} | {allocations} | {bytes} |");
+
+            let (allocations, bytes) = count(synthesizer.synthesis(
+                &audio_query,
+                style_id,
+                &SynthesisOptions::from(&TtsOptions::default()),
+            ))
+            .await;
+            println!("| synthesis | {name} | {allocations} | {bytes} |");
+        }
+        anyhow::Ok(())
+    })
+}
+
+/// `future`を完了させるまでの確保の回数とバイト数を返す。
+async fn count<T>(future: impl std::future::Future<Output = T>) -> (usize, usize) {
+    ALLOCATIONS.store(0, Ordering::Relaxed);
+    ALLOCATED_BYTES.store(0, Ordering::Relaxed);
+    let output = future.await;
+    let counts = (
+        ALLOCATIONS.load(Ordering::Relaxed),
+        ALLOCATED_BYTES.load(Ordering::Relaxed),
+    );
+    drop(output);
+    counts
+}
@@ -0,0 +1,178 @@
+//! 長さの異なる音声合成を長時間続け、メモリの使用量(RSS)と所要時間のばらつきを計測する。
+//!
+//! 音声波形の生成の入力の長さを揃えない場合(`VV_DECODE_LENGTH_BUCKETS=`)と揃える場合とで、それぞれ
+//! 別のプロセスで同じ順番の要求を処理し、結果を並べる。揃える長さは`VV_DECODE_LENGTH_BUCKETS`で
+//! 指定でき、指定しなければ既定の長さを使う。それぞれの計測の時間は`VV_BENCH_SOAK_SECS`(秒)で
+//! 指定できる。
+//!
+//! 要求ごとに文と話速を変え、音声波形の生成の入力の長さを毎回異なるものにする。RSSはLinuxでのみ
+//! 計測する。
+
+use std::{
+    env, fs,
+    process::Command,
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Runtime;
+use voicevox_core::{
+    AccelerationMode, AudioQueryModel, InitializeOptions, OpenJtalk, StyleId, SynthesisOptions,
+    Synthesizer, TtsOptions, VoiceModel,
+};
+
+const TEXTS: &[&str] = &[
+    "こんにちは",
+    "この音声は、ボイスボックスを使用して、出力されています。",
+    "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。",
+];
+const STYLE_ID: u32 = 302;
+const BUCKETS_ENV_NAME: &str = "VV_DECODE_LENGTH_BUCKETS";
+const SECS_ENV_NAME: &str = "VV_BENCH_SOAK_SECS";
+/// 計測を行う子プロセスであることを示す環境変数。
+const CHILD_ENV_NAME: &str = "VV_BENCH_SOAK_CHILD";
+const DEFAULT_SECS: u64 = 300;
+
+fn main() {
+    if env::var_os(CHILD_ENV_NAME).is_some() {
+        let runtime = Runtime::new().unwrap();
+        println!("{}", runtime.block_on(soak()));
+        return;
+    }
+
+    let buckets = env::var(BUCKETS_ENV_NAME).ok();
+    let configs = [
+        ("none", Some("")),
+        (buckets.as_deref().unwrap_or("default"), buckets.as_deref()),
+    ];
+
+    let header = "| buckets | requests | RSS after warm-up (MiB) | RSS at end (MiB) | p50 (ms) \
+                  | p99 (ms) | max (ms) | stddev (ms) |";
+    println!("{header}");
+    println!("{}", header.replace(|c| c != '|', "-"));
+    for (label, buckets) in configs {
+        let mut command = Command::new(env::current_exe().unwrap());
+        command.env(CHILD_ENV_NAME, "1");
+        match buckets {
+            Some(buckets) => command.env(BUCKETS_ENV_NAME, buckets),
+            None => command.env_remove(BUCKETS_ENV_NAME),
+        };
+        let output = command.output().unwrap();
+        assert!(output.status.success(), "{output:?}");
+        let row = String::from_utf8(output.stdout).unwrap();
+        println!("| {label} | {} |", row.trim());
+    }
+}
+
+/// 要求を処理し続け、結果を表の一行として返す。
+async fn soak() -> String {
+    let secs = env::var(SECS_ENV_NAME).map_or(DEFAULT_SECS, |secs| secs.parse().unwrap());
+    let duration = Duration::from_secs(secs);
+
+    let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap());
+    let model = VoiceModel::from_path(concat!(
+        env!("CARGO_MANIFEST_DIR"),
+        "/../../model/sample.vvm",
+    ))
+    .await
+    .unwrap();
+    let synthesizer = Synthesizer::new_with_initialize(
+        open_jtalk,
+        &InitializeOptions {
+            acceleration_mode: AccelerationMode::Cpu,
+            ..Default::default()
+        },
+    )
+    .await
+    .unwrap();
+    synthesizer.load_voice_model(&model).await.unwrap();
+    let style_id = StyleId::new(STYLE_ID);
+
+    let mut audio_queries = vec![];
+    for text in TEXTS {
+        audio_queries.push(
+            synthesizer
+                .audio_query(text, style_id, &Default::default())
+                .await
+                .unwrap(),
+        );
+    }
+    let options = &SynthesisOptions::from(&TtsOptions::default());
+
+    // どちらの計測でも同じ順番の要求になるよう、線形合同法で文と話速を選ぶ
+    let mut state = 1u64;
+    let mut latencies = vec![];
+    let mut rss_after_warm_up = None;
+    let start = Instant::now();
+    while start.elapsed() < duration {
+        state = state
+            .wrapping_mul(6364136223846793005)
+            .wrapping_add(1442695040888963407);
+        let r = (state >> 33) as usize;
+        let audio_query = &audio_queries[r % audio_queries.len()];
+        let speed_scale = 0.7 + (r / audio_queries.len() % 61) as f32 * 0.01;
+        let audio_query = with_speed_scale(audio_query, speed_scale);
+
+        let request_start = Instant::now();
+        synthesizer
+            .synthesis(&audio_query, style_id, options)
+            .await
+            .unwrap();
+        latencies.push(request_start.elapsed());
+
+        // 最初の4分の1をウォームアップとする
+        if rss_after_warm_up.is_none() && start.elapsed() >= duration / 4 {
+            rss_after_warm_up = Some(rss());
+        }
+    }
+    let rss_at_end = rss();
+
+    latencies.sort_unstable();
+    let n = latencies.len();
+    let millis = |latency: Duration| latency.as_secs_f64() * 1e3;
+    let mean = latencies.iter().copied().map(millis).sum::<f64>() / n as f64;
+    let stddev = (latencies
+        .iter()
+        .map(|&latency| (millis(latency) - mean).powi(2))
+        .sum::<f64>()
+        / n as f64)
+        .sqrt();
+    format!(
+        "{n} | {} | {} | {:.1} | {:.1} | {:.1} | {stddev:.1}",
+        format_mib(rss_after_warm_up.flatten()),
+        format_mib(rss_at_end),
+        millis(latencies[n / 2]),
+        millis(latencies[(n * 99 / 100).min(n - 1)]),
+        millis(latencies[n - 1]),
+    )
+}
+
+fn with_speed_scale(audio_query: &AudioQueryModel, speed_scale: f32) -> AudioQueryModel {
+    AudioQueryModel::new(
+        audio_query.accent_phrases().clone(),
+        speed_scale,
+        *audio_query.pitch_scale(),
+        *audio_query.intonation_scale(),
+        *audio_query.volume_scale(),
+        *audio_query.pre_phoneme_length(),
+        *audio_query.post_phoneme_length(),
+        *audio_query.output_sampling_rate(),
+        *audio_query.output_stereo(),
+        None,
+    )
+}
+
+/// 現在のRSS(バイト)。Linux以外では`None`。
+fn rss() -> Option<u64> {
+    let status = fs::read_to_string("/proc/self/status").ok()?;
+    let line = status.lines().find(|line| line.starts_with("VmRSS:"))?;
+    let kib = line.split_whitespace().nth(1)?.parse::<u64>().ok()?;
+    Some(kib * 1024)
+}
+
+fn format_mib(bytes: Option<u64>) -> String {
+    bytes.map_or("-".to_owned(), |bytes| {
+        format!("{:.1}", bytes as f64 / (1024. * 1024.))
+    })
+}
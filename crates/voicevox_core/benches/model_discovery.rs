@@ -0,0 +1,46 @@
+//! モデルディレクトリにあるVVMファイルの列挙(`VoiceModel::get_all_models`)の速度を、メタデータの
+//! インデックス(`VV_MODELS_INDEX_PATH`)の有無で比較する。
+//!
+//! サンプルのVVM(`model/sample.vvm`)を複製したディレクトリで計測する。
+
+use std::{env, fs};
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use tempfile::TempDir;
+use tokio::runtime::Runtime;
+use voicevox_core::VoiceModel;
+
+const SAMPLE_VVM: &str = concat!(env!("CARGO_MANIFEST_DIR"), "/../../model/sample.vvm");
+const VVM_COUNTS: &[usize] = &[16, 64];
+
+fn model_discovery(c: &mut Criterion) {
+    let runtime = Runtime::new().unwrap();
+    let mut group = c.benchmark_group("model_discovery");
+
+    for &vvm_count in VVM_COUNTS {
+        let dir = TempDir::new().unwrap();
+        for i in 0..vvm_count {
+            fs::copy(SAMPLE_VVM, dir.path().join(format!("{i}.vvm"))).unwrap();
+        }
+        let index_path = dir.path().join("index.json");
+        env::set_var("VV_MODELS_ROOT_DIR", dir.path());
+
+        env::remove_var("VV_MODELS_INDEX_PATH");
+        group.bench_function(BenchmarkId::new("without_index", vvm_count), |b| {
+            b.to_async(&runtime)
+                .iter(|| async { VoiceModel::get_all_models().await.unwrap() });
+        });
+
+        env::set_var("VV_MODELS_INDEX_PATH", &index_path);
+        // 一度目の列挙でインデックスが作られる
+        runtime.block_on(VoiceModel::get_all_models()).unwrap();
+        group.bench_function(BenchmarkId::new("with_index", vvm_count), |b| {
+            b.to_async(&runtime)
+                .iter(|| async { VoiceModel::get_all_models().await.unwrap() });
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, model_discovery);
+criterion_main!(benches);
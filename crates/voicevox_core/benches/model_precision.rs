@@ -0,0 +1,137 @@
+//! モデルの精度([`ModelPrecision`])ごとの、音声波形の生成の速度と精度を比較する。
+//!
+//! 同じAudioQueryから[`ModelPrecision::Fp32`]で生成した波形を基準とし、SN比と最大誤差を出す。
+//! 速度は実時間比(RTF, 生成にかかった時間 / 音声の長さ)で出す。
+//!
+//! 対象のVVMは`VV_BENCH_VVM`で指定できる。精度違いのモデルは`cargo xtask quantize-vvm`で追加できる。
+//! VVMに該当する精度のモデルが無い場合、その精度の結果は[`ModelPrecision::Fp32`]と同じになる。
+
+use std::{
+    env,
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Runtime;
+use voicevox_core::{
+    AccelerationMode, AudioQueryModel, InitializeOptions, ModelPrecision, OpenJtalk, StyleId,
+    SynthesisOptions, Synthesizer, TtsOptions, VoiceModel,
+};
+
+const TEXTS: &[&str] = &[
+    "この音声は、ボイスボックスを使用して、出力されています。",
+    "こんにちは、今日はいい天気ですね。",
+];
+const STYLE_ID: u32 = 302;
+const ITERATIONS: u32 = 5;
+const WAV_HEADER_LEN: usize = 44;
+
+fn main() {
+    let runtime = Runtime::new().unwrap();
+    runtime.block_on(run());
+}
+
+async fn run() {
+    let vvm_path = env::var("VV_BENCH_VVM").unwrap_or_else(|_| {
+        concat!(env!("CARGO_MANIFEST_DIR"), "/../../model/sample.vvm").to_owned()
+    });
+    let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap());
+    let model = VoiceModel::from_path(&vvm_path).await.unwrap();
+    let style_id = StyleId::new(STYLE_ID);
+
+    let mut audio_queries = vec![];
+    let mut baseline = None;
+
+    println!("| precision | RTF | SNR (dB) | max abs error |");
+    println!("|-----------|-----|----------|---------------|");
+
+    for precision in [
+        ModelPrecision::Fp32,
+        ModelPrecision::Fp16,
+        ModelPrecision::Int8,
+    ] {
+        let synthesizer = Synthesizer::new_with_initialize(
+            open_jtalk.clone(),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                model_precision: precision,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        synthesizer.load_voice_model(&model).await.unwrap();
+
+        // 音素長と音高による差が混ざらないよう、AudioQueryはFp32のものを使い回す
+        if audio_queries.is_empty() {
+            for text in TEXTS {
+                audio_queries.push(
+                    synthesizer
+                        .audio_query(text, style_id, &Default::default())
+                        .await
+                        .unwrap(),
+                );
+            }
+        }
+
+        let mut elapsed = Duration::ZERO;
+        let mut waves = vec![];
+        for audio_query in &audio_queries {
+            // ウォームアップ
+            let wave = synthesize(&synthesizer, audio_query, style_id).await;
+            let start = Instant::now();
+            for _ in 0..ITERATIONS {
+                synthesize(&synthesizer, audio_query, style_id).await;
+            }
+            elapsed += start.elapsed() / ITERATIONS;
+            waves.push(wave);
+        }
+
+        let audio_duration = audio_queries
+            .iter()
+            .zip(&waves)
+            .map(|(q, w)| w.len() as f64 / f64::from(*q.output_sampling_rate()))
+            .sum::<f64>();
+        let rtf = elapsed.as_secs_f64() / audio_duration;
+
+        let baseline = baseline.get_or_insert_with(|| waves.clone());
+        let (snr, max_abs_error) = compare(baseline, &waves);
+
+        println!("| {precision:?} | {rtf:.4} | {snr:.2} | {max_abs_error} |");
+    }
+}
+
+async fn synthesize(
+    synthesizer: &Synthesizer,
+    audio_query: &AudioQueryModel,
+    style_id: StyleId,
+) -> Vec<i16> {
+    let wav = synthesizer
+        .synthesis(
+            audio_query,
+            style_id,
+            &SynthesisOptions::from(&TtsOptions::default()),
+        )
+        .await
+        .unwrap();
+    wav[WAV_HEADER_LEN..]
+        .chunks_exact(2)
+        .map(|b| i16::from_le_bytes([b[0], b[1]]))
+        .collect()
+}
+
+/// SN比(dB)と最大誤差を求める。
+fn compare(expected: &[Vec<i16>], actual: &[Vec<i16>]) -> (f64, i32) {
+    let (mut signal, mut noise, mut max_abs_error) = (0., 0., 0);
+    for (expected, actual) in expected.iter().zip(actual) {
+        assert_eq!(expected.len(), actual.len());
+        for (&e, &a) in expected.iter().zip(actual) {
+            let error = i32::from(a) - i32::from(e);
+            signal += f64::from(e).powi(2);
+            noise += f64::from(error).powi(2);
+            max_abs_error = max_abs_error.max(error.abs());
+        }
+    }
+    (10. * (signal / noise).log10(), max_abs_error)
+}
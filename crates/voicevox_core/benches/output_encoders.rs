@@ -0,0 +1,108 @@
+//! 出力形式([`OutputFormat`])ごとの、音声の大きさとエンコードの速度をWAVと比較する。
+//!
+//! サンプルのVVM(`model/sample.vvm`)で合成した音声波形を、全体を一度に、あるいは文ごとに
+//! [`Encoder`]へ渡してエンコードする。大きさは計測の前に表として出す。スループットはWAVにしたときの
+//! バイト数あたりで出す。
+
+use std::sync::Arc;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Runtime;
+use voicevox_core::{
+    AccelerationMode, Encoder, InitializeOptions, OpenJtalk, OutputFormat, StyleId, Synthesizer,
+    VoiceModel, Waveform,
+};
+
+const TEXTS: &[&str] = &[
+    "吾輩は猫である。",
+    "名前はまだ無い。",
+    "どこで生れたかとんと見当がつかぬ。",
+    "何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。",
+];
+const STYLE_ID: u32 = 302;
+const FORMATS: &[OutputFormat] = &[
+    OutputFormat::Wav,
+    OutputFormat::Flac,
+    OutputFormat::MuLaw,
+    OutputFormat::ALaw,
+];
+
+fn synthesize() -> Vec<Waveform> {
+    let runtime = Runtime::new().unwrap();
+    runtime.block_on(async {
+        let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap());
+        let model = VoiceModel::from_path(concat!(
+            env!("CARGO_MANIFEST_DIR"),
+            "/../../model/sample.vvm",
+        ))
+        .await
+        .unwrap();
+        let synthesizer = Synthesizer::new_with_initialize(
+            open_jtalk,
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        synthesizer.load_voice_model(&model).await.unwrap();
+
+        let mut waveforms = vec![];
+        for text in TEXTS {
+            let waveform = synthesizer
+                .tts_waveform(text, StyleId::new(STYLE_ID), &Default::default())
+                .await
+                .unwrap();
+            waveforms.push(waveform);
+        }
+        waveforms
+    })
+}
+
+fn encode_streaming(waveforms: &[Waveform], format: OutputFormat) -> Vec<u8> {
+    let mut encoder = Encoder::new(format);
+    let mut out = vec![];
+    for waveform in waveforms {
+        encoder.write(waveform, &mut out);
+    }
+    encoder.finish(&mut out);
+    out
+}
+
+fn output_encoders(c: &mut Criterion) {
+    let waveforms = synthesize();
+    let wav_len = encode_streaming(&waveforms, OutputFormat::Wav).len();
+
+    println!("| format | bytes | ratio to WAV |");
+    println!("|--------|-------|--------------|");
+    for &format in FORMATS {
+        let len = encode_streaming(&waveforms, format).len();
+        let ratio = len as f64 / wav_len as f64;
+        println!("| {format:?} | {len} | {ratio:.3} |");
+    }
+
+    let mut group = c.benchmark_group("output_encoders");
+    group.throughput(Throughput::Bytes(wav_len as u64));
+    for &format in FORMATS {
+        let name = format!("{format:?}");
+        group.bench_with_input(BenchmarkId::new("whole", &name), &format, |b, &format| {
+            b.iter(|| {
+                waveforms
+                    .iter()
+                    .map(|waveform| waveform.encode(format).len())
+                    .sum::<usize>()
+            })
+        });
+        group.bench_with_input(
+            BenchmarkId::new("streaming", &name),
+            &format,
+            |b, &format| b.iter(|| encode_streaming(&waveforms, format)),
+        );
+    }
+    group.finish();
+}
+
+criterion_group!(benches, output_encoders);
+criterion_main!(benches);
@@ -0,0 +1,357 @@
+//! 音声合成の各処理段階と、`tts`全体の速度を計測する。
+//!
+//! 推論を伴わない処理段階は`voicevox_core::__internal`経由で単体で計測する。推論を伴うものと
+//! `tts`はサンプルのVVM(`model/sample.vvm`)で計測する。
+//!
+//! 前回の結果との比較は`cargo xtask bench-compare`で行える。
+
+use std::sync::{
+    atomic::{AtomicBool, Ordering},
+    Arc,
+};
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use futures::future::try_join_all;
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Runtime;
+use voicevox_core::{
+    AccelerationMode, AudioQueryModel, InitializeOptions, OpenJtalk, Priority, StyleId,
+    Synthesizer, TtsOptions, VoiceModel,
+    __internal::{
+        create_kana, expand_frames, parse_kana, to_wav, Metrics, Phoneme, Request, Utterance,
+    },
+};
+
+const TEXTS: &[(&str, &str)] = &[
+    ("short", "こんにちは"),
+    (
+        "medium",
+        "この音声は、ボイスボックスを使用して、出力されています。",
+    ),
+    (
+        "long",
+        "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。\
+         何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。",
+    ),
+];
+const STYLE_ID: u32 = 302;
+const CONCURRENCIES: &[usize] = &[1, 2, 4, 8];
+const MULTI_STYLE_IDS: &[u32] = &[0, 1, 302, 303];
+const BACKGROUND_TASKS: usize = 2;
+
+struct Fixture {
+    runtime: Runtime,
+    open_jtalk: Arc<OpenJtalk>,
+    synthesizer: Arc<Synthesizer>,
+    audio_queries: Vec<(&'static str, AudioQueryModel)>,
+}
+
+impl Fixture {
+    fn new() -> Self {
+        let runtime = Runtime::new().unwrap();
+        let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap());
+        let (synthesizer, audio_queries) = runtime.block_on(async {
+            let model = VoiceModel::from_path(concat!(
+                env!("CARGO_MANIFEST_DIR"),
+                "/../../model/sample.vvm",
+            ))
+            .await
+            .unwrap();
+            let synthesizer = Synthesizer::new_with_initialize(
+                open_jtalk.clone(),
+                &InitializeOptions {
+                    acceleration_mode: AccelerationMode::Cpu,
+                    ..Default::default()
+                },
+            )
+            .await
+            .unwrap();
+            synthesizer.load_voice_model(&model).await.unwrap();
+
+            let mut audio_queries = vec![];
+            for &(name, text) in TEXTS {
+                let audio_query = synthesizer
+                    .audio_query(text, StyleId::new(STYLE_ID), &Default::default())
+                    .await
+                    .unwrap();
+                audio_queries.push((name, audio_query));
+            }
+            (Arc::new(synthesizer), audio_queries)
+        });
+        Self {
+            runtime,
+            open_jtalk,
+            synthesizer,
+            audio_queries,
+        }
+    }
+}
+
+fn text_analysis(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("text_analysis");
+    let metrics = Metrics::default();
+
+    for &(name, text) in TEXTS {
+        let labels = fixture.open_jtalk.extract_fullcontext(text).unwrap();
+        group.bench_with_input(
+            BenchmarkId::new("phoneme_from_label", name),
+            &labels,
+            |b, labels| {
+                b.iter(|| {
+                    labels
+                        .iter()
+                        .map(|label| Phoneme::from_label(label.clone()).unwrap())
+                        .collect::<Vec<_>>()
+                });
+            },
+        );
+        group.bench_with_input(
+            BenchmarkId::new("extract_full_context_label", name),
+            text,
+            |b, text| {
+                b.iter(|| {
+                    Utterance::extract_full_context_label(
+                        &fixture.open_jtalk,
+                        text,
+                        &metrics,
+                        &Request::default(),
+                    )
+                    .unwrap()
+                });
+            },
+        );
+    }
+    group.finish();
+}
+
+fn kana(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("kana");
+    for (name, audio_query) in &fixture.audio_queries {
+        let kana = create_kana(audio_query.accent_phrases());
+        group.bench_with_input(BenchmarkId::new("parse_kana", name), &kana, |b, kana| {
+            b.iter(|| parse_kana(kana).unwrap());
+        });
+        group.bench_with_input(
+            BenchmarkId::new("create_kana", name),
+            audio_query.accent_phrases(),
+            |b, accent_phrases| {
+                b.iter(|| create_kana(accent_phrases));
+            },
+        );
+    }
+    group.finish();
+}
+
+fn synthesis_stages(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("synthesis_stages");
+    for (name, audio_query) in &fixture.audio_queries {
+        group.bench_with_input(
+            BenchmarkId::new("replace_mora_data", name),
+            audio_query.accent_phrases(),
+            |b, accent_phrases| {
+                b.to_async(&fixture.runtime).iter(|| async {
+                    fixture
+                        .synthesizer
+                        .replace_mora_data(accent_phrases, StyleId::new(STYLE_ID))
+                        .await
+                        .unwrap()
+                });
+            },
+        );
+        group.bench_with_input(
+            BenchmarkId::new("expand_frames", name),
+            audio_query,
+            |b, audio_query| {
+                b.iter(|| expand_frames(audio_query, true));
+            },
+        );
+
+        // 推論を含めないよう、音声波形は適当なもので代用する
+        let (f0, _) = expand_frames(audio_query, true);
+        let wave = (0..f0.len() * 256)
+            .map(|i| (i as f32 * 0.05).sin() * 0.5)
+            .collect::<Vec<_>>();
+        group.bench_with_input(BenchmarkId::new("to_wav", name), &wave, |b, wave| {
+            b.iter(|| to_wav(wave, audio_query));
+        });
+    }
+    group.finish();
+}
+
+/// 長い台本の一部のアクセント句だけを編集したときの、全体の推論しなおしと差分での推論しなおしの比較
+fn incremental(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("incremental");
+    let (_, text) = TEXTS[2];
+    let script = text.repeat(5);
+    let accent_phrases = fixture
+        .runtime
+        .block_on(fixture.synthesizer.create_accent_phrases(
+            &script,
+            StyleId::new(STYLE_ID),
+            &Default::default(),
+        ))
+        .unwrap();
+    let changed = [accent_phrases.len() / 2];
+
+    group.bench_function("replace_mora_data", |b| {
+        b.to_async(&fixture.runtime).iter(|| async {
+            fixture
+                .synthesizer
+                .replace_mora_data(&accent_phrases, StyleId::new(STYLE_ID))
+                .await
+                .unwrap()
+        });
+    });
+    group.bench_function("replace_mora_data_incrementally", |b| {
+        b.to_async(&fixture.runtime).iter(|| async {
+            fixture
+                .synthesizer
+                .replace_mora_data_incrementally(&accent_phrases, &changed, StyleId::new(STYLE_ID))
+                .await
+                .unwrap()
+        });
+    });
+    group.finish();
+}
+
+fn tts(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("tts");
+    for &(name, text) in TEXTS {
+        group.bench_with_input(BenchmarkId::new("single", name), text, |b, text| {
+            b.to_async(&fixture.runtime).iter(|| async {
+                fixture
+                    .synthesizer
+                    .tts(text, StyleId::new(STYLE_ID), &TtsOptions::default())
+                    .await
+                    .unwrap()
+            });
+        });
+    }
+    group.finish();
+
+    // 複数の`tts`を同時に走らせたときのスループット
+    let mut group = c.benchmark_group("tts_throughput");
+    let (_, text) = TEXTS[1];
+    for &concurrency in CONCURRENCIES {
+        group.throughput(Throughput::Elements(concurrency as _));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(concurrency),
+            &concurrency,
+            |b, &concurrency| {
+                b.to_async(&fixture.runtime).iter(|| {
+                    try_join_all((0..concurrency).map(|_| {
+                        let synthesizer = fixture.synthesizer.clone();
+                        tokio::spawn(async move {
+                            synthesizer
+                                .tts(text, StyleId::new(STYLE_ID), &TtsOptions::default())
+                                .await
+                                .unwrap()
+                        })
+                    }))
+                });
+            },
+        );
+    }
+    group.finish();
+}
+
+/// 同じテキストを複数の声で合成するときの、`tts_multi_style`と声ごとに独立した`tts`の比較
+fn multi_style(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("multi_style");
+    let (_, text) = TEXTS[1];
+    let style_ids = MULTI_STYLE_IDS
+        .iter()
+        .map(|&style_id| StyleId::new(style_id))
+        .collect::<Vec<_>>();
+    group.throughput(Throughput::Elements(style_ids.len() as _));
+
+    group.bench_function("independent_tts", |b| {
+        b.to_async(&fixture.runtime).iter(|| {
+            try_join_all(style_ids.iter().map(|&style_id| {
+                let synthesizer = fixture.synthesizer.clone();
+                tokio::spawn(async move {
+                    synthesizer
+                        .tts(text, style_id, &TtsOptions::default())
+                        .await
+                        .unwrap()
+                })
+            }))
+        });
+    });
+    group.bench_function("tts_multi_style", |b| {
+        b.to_async(&fixture.runtime).iter(|| async {
+            fixture
+                .synthesizer
+                .tts_multi_style(text, &style_ids, &TtsOptions::default())
+                .await
+                .unwrap()
+        });
+    });
+    group.finish();
+}
+
+/// 長い文章の`tts`がバッチ処理として流れ続けている中での、短い文章の`tts`の優先度ごとの所要時間
+fn priority(c: &mut Criterion, fixture: &Fixture) {
+    let mut group = c.benchmark_group("priority");
+    let (_, short) = TEXTS[0];
+    let (_, long) = TEXTS[2];
+
+    let stop = Arc::new(AtomicBool::new(false));
+    let background = (0..BACKGROUND_TASKS)
+        .map(|_| {
+            let synthesizer = fixture.synthesizer.clone();
+            let stop = stop.clone();
+            fixture.runtime.spawn(async move {
+                let options = TtsOptions {
+                    priority: Priority::Batch,
+                    ..Default::default()
+                };
+                while !stop.load(Ordering::Relaxed) {
+                    synthesizer
+                        .tts(long, StyleId::new(STYLE_ID), &options)
+                        .await
+                        .unwrap();
+                }
+            })
+        })
+        .collect::<Vec<_>>();
+
+    for priority in [Priority::Batch, Priority::Interactive] {
+        let name: &str = priority.into();
+        let options = TtsOptions {
+            priority,
+            ..Default::default()
+        };
+        group.bench_function(name, |b| {
+            b.to_async(&fixture.runtime).iter(|| async {
+                fixture
+                    .synthesizer
+                    .tts(short, StyleId::new(STYLE_ID), &options)
+                    .await
+                    .unwrap()
+            });
+        });
+    }
+    group.finish();
+
+    stop.store(true, Ordering::Relaxed);
+    fixture.runtime.block_on(try_join_all(background)).unwrap();
+}
+
+fn pipeline(c: &mut Criterion) {
+    let fixture = Fixture::new();
+    text_analysis(c, &fixture);
+    kana(c, &fixture);
+    synthesis_stages(c, &fixture);
+    incremental(c, &fixture);
+    tts(c, &fixture);
+    multi_style(c, &fixture);
+    priority(c, &fixture);
+}
+
+criterion_group! {
+    name = benches;
+    config = Criterion::default().sample_size(20);
+    targets = pipeline
+}
+criterion_main!(benches);
@@ -0,0 +1,109 @@
+//! プロンプトのテンプレート([`PromptTemplate`])のスロットに値を入れて読み上げた場合と、同じ文を
+//! `tts`で読み上げた場合とで、1リクエストあたりのCPU時間を比較する。
+//!
+//! 推論セッションのスレッド数を1にして逐次に処理させ、経過時間をCPU時間とみなす。
+//!
+//! [`PromptTemplate`]: voicevox_core::PromptTemplate
+
+use std::{
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Runtime;
+use voicevox_core::{
+    AccelerationMode, InitializeOptions, OpenJtalk, SessionThreadOptions, StyleId, Synthesizer,
+    TtsOptions, VoiceModel,
+};
+
+const TEMPLATE: &str = "{名前}様、{日付}のご予約を承りました。ご来店を、心よりお待ちしております。";
+const VALUES: &[&[(&str, &str)]] = &[
+    &[("名前", "山田"), ("日付", "三月五日")],
+    &[("名前", "佐藤"), ("日付", "十二月二十四日")],
+    &[("名前", "ボイスボックス"), ("日付", "明日")],
+];
+const STYLE_ID: u32 = 302;
+const ITERATIONS: u32 = 5;
+
+fn main() {
+    let runtime = Runtime::new().unwrap();
+    runtime.block_on(run());
+}
+
+async fn run() {
+    let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap());
+    let model = VoiceModel::from_path(concat!(
+        env!("CARGO_MANIFEST_DIR"),
+        "/../../model/sample.vvm",
+    ))
+    .await
+    .unwrap();
+    let single_thread = SessionThreadOptions {
+        intra_op_num_threads: 1,
+        inter_op_num_threads: 1,
+    };
+    let synthesizer = Synthesizer::new_with_initialize(
+        open_jtalk,
+        &InitializeOptions {
+            acceleration_mode: AccelerationMode::Cpu,
+            light_session_threads: single_thread,
+            heavy_session_threads: single_thread,
+            ..Default::default()
+        },
+    )
+    .await
+    .unwrap();
+    synthesizer.load_voice_model(&model).await.unwrap();
+    let style_id = StyleId::new(STYLE_ID);
+
+    let start = Instant::now();
+    let template = synthesizer
+        .create_prompt_template(TEMPLATE, style_id, &Default::default())
+        .await
+        .unwrap();
+    println!("create_prompt_template: {:?}", start.elapsed());
+
+    println!("| values | tts | render_prompt_template | ratio |");
+    println!("|--------|-----|------------------------|-------|");
+
+    let (synthesizer, template) = (&synthesizer, &template);
+    let options = &TtsOptions::default();
+    for &values in VALUES {
+        let text = &fill(values);
+
+        let tts = measure(|| async move {
+            synthesizer.tts(text, style_id, options).await.unwrap();
+        })
+        .await;
+        let render = measure(|| async move {
+            synthesizer
+                .render_prompt_template(template, values, options)
+                .await
+                .unwrap();
+        })
+        .await;
+
+        let ratio = render.as_secs_f64() / tts.as_secs_f64();
+        println!("| {values:?} | {tts:?} | {render:?} | {ratio:.3} |");
+    }
+}
+
+/// テンプレートのスロットに値を入れた文を作る。
+fn fill(values: &[(&str, &str)]) -> String {
+    values
+        .iter()
+        .fold(TEMPLATE.to_owned(), |text, (name, value)| {
+            text.replace(&format!("{{{name}}}"), value)
+        })
+}
+
+/// ウォームアップの後、1回あたりの所要時間を測る。
+async fn measure<F: std::future::Future<Output = ()>>(mut f: impl FnMut() -> F) -> Duration {
+    f().await;
+    let start = Instant::now();
+    for _ in 0..ITERATIONS {
+        f().await;
+    }
+    start.elapsed() / ITERATIONS
+}
@@ -0,0 +1,100 @@
+//! 推論セッションのスレッド数の組み合わせごとに、音声合成のスループットを計測する。
+//!
+//! 単発の`tts`と、複数の`tts`を同時に走らせた場合の両方を計測する。後者ではスレッドを
+//! 過剰に確保した設定(oversubscription)との差が出やすい。
+
+use std::{sync::Arc, thread};
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use futures::future::try_join_all;
+use test_util::OPEN_JTALK_DIC_DIR;
+use tokio::runtime::Runtime;
+use voicevox_core::{
+    AccelerationMode, InitializeOptions, OpenJtalk, SessionThreadOptions, StyleId, Synthesizer,
+    TtsOptions, VoiceModel,
+};
+
+const TEXT: &str = "この音声は、ボイスボックスを使用して、出力されています。";
+const STYLE_ID: u32 = 302;
+const CONCURRENCY: usize = 4;
+
+fn session_threads(c: &mut Criterion) {
+    let runtime = Runtime::new().unwrap();
+    let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap());
+    let model = runtime
+        .block_on(VoiceModel::from_path(concat!(
+            env!("CARGO_MANIFEST_DIR"),
+            "/../../model/sample.vvm",
+        )))
+        .unwrap();
+
+    let num_cpus = thread::available_parallelism().map_or(1, |n| n.get() as u16);
+
+    // (軽いモデルのintra-op, 重いモデルのintra-op, inter-op)
+    let configs = [
+        (0, 0, 0),
+        (1, 1, 1),
+        (1, num_cpus, 1),
+        (1, num_cpus / 2, 1),
+        (2, num_cpus / 2, 1),
+    ];
+
+    let mut group = c.benchmark_group("session_threads");
+    for (light, heavy, inter) in configs {
+        let synthesizer = runtime.block_on(async {
+            let synthesizer = Synthesizer::new_with_initialize(
+                open_jtalk.clone(),
+                &InitializeOptions {
+                    acceleration_mode: AccelerationMode::Cpu,
+                    light_session_threads: SessionThreadOptions {
+                        intra_op_num_threads: light,
+                        inter_op_num_threads: inter,
+                    },
+                    heavy_session_threads: SessionThreadOptions {
+                        intra_op_num_threads: heavy,
+                        inter_op_num_threads: inter,
+                    },
+                    ..Default::default()
+                },
+            )
+            .await
+            .unwrap();
+            synthesizer.load_voice_model(&model).await.unwrap();
+            Arc::new(synthesizer)
+        });
+        let param = format!("light={light},heavy={heavy},inter={inter}");
+
+        group.bench_with_input(BenchmarkId::new("tts", &param), &synthesizer, |b, s| {
+            b.to_async(&runtime).iter(|| async {
+                s.tts(TEXT, StyleId::new(STYLE_ID), &TtsOptions::default())
+                    .await
+                    .unwrap()
+            });
+        });
+
+        group.bench_with_input(
+            BenchmarkId::new(format!("tts_x{CONCURRENCY}"), &param),
+            &synthesizer,
+            |b, s| {
+                b.to_async(&runtime).iter(|| {
+                    try_join_all((0..CONCURRENCY).map(|_| {
+                        let s = s.clone();
+                        tokio::spawn(async move {
+                            s.tts(TEXT, StyleId::new(STYLE_ID), &TtsOptions::default())
+                                .await
+                                .unwrap()
+                        })
+                    }))
+                });
+            },
+        );
+    }
+    group.finish();
+}
+
+criterion_group! {
+    name = benches;
+    config = Criterion::default().sample_size(10);
+    targets = session_threads
+}
+criterion_main!(benches);
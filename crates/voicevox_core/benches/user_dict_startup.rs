@@ -0,0 +1,88 @@
+//! 大きなユーザー辞書を使う場合の起動時間を、毎回コンパイルする場合と、書き出しておいた
+//! コンパイル済みの辞書を使う場合とで比較する。
+//!
+//! どちらもユーザー辞書のファイルの読み込みから、Open JTalkに設定するまでを測る。コンパイル済みの
+//! 辞書を探すときに求めるシステム辞書の指紋は、それだけでも測る。単語の数は
+//! `VV_BENCH_USER_DICT_WORDS`で指定でき、既定では50,000語とする。
+
+use std::{env, path::Path, time::Instant};
+
+use test_util::OPEN_JTALK_DIC_DIR;
+use voicevox_core::{
+    OpenJtalk, UserDict, UserDictWord, UserDictWordType, __internal::open_jtalk_dict_fingerprint,
+};
+
+const WORDS_ENV_NAME: &str = "VV_BENCH_USER_DICT_WORDS";
+const DEFAULT_WORDS: usize = 50_000;
+const KATAKANA: &[char] = &['ア', 'イ', 'ウ', 'エ', 'オ', 'カ', 'キ', 'ク', 'ケ', 'コ'];
+
+fn main() {
+    let words = env::var(WORDS_ENV_NAME).map_or(DEFAULT_WORDS, |words| words.parse().unwrap());
+    let dir = tempfile::tempdir().unwrap();
+    let store_path = dir.path().join("user_dict.json");
+    let store_path = store_path.to_str().unwrap();
+    let compiled_dir = dir.path().join("compiled");
+
+    let mut user_dict = UserDict::new();
+    for i in 0..words {
+        user_dict.add_word(word(i)).unwrap();
+    }
+    user_dict.save(store_path).unwrap();
+
+    println!("{words} words");
+    println!("| startup | time |");
+    println!("|---------|------|");
+
+    let start = Instant::now();
+    let open_jtalk = OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap();
+    open_jtalk.use_user_dict(&load(store_path)).unwrap();
+    println!("| use_user_dict | {:?} |", start.elapsed());
+
+    let start = Instant::now();
+    open_jtalk
+        .export_compiled_user_dict(&user_dict, &compiled_dir)
+        .unwrap();
+    println!(
+        "| export_compiled_user_dict (once) | {:?} |",
+        start.elapsed()
+    );
+
+    let start = Instant::now();
+    open_jtalk_dict_fingerprint(Path::new(OPEN_JTALK_DIC_DIR)).unwrap();
+    println!("| dict fingerprint | {:?} |", start.elapsed());
+
+    // 指紋を求めるところも含む
+    let start = Instant::now();
+    let open_jtalk = OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap();
+    assert!(open_jtalk
+        .use_compiled_user_dict(&load(store_path), &compiled_dir)
+        .unwrap());
+    println!("| use_compiled_user_dict | {:?} |", start.elapsed());
+}
+
+fn load(store_path: &str) -> UserDict {
+    let mut user_dict = UserDict::new();
+    user_dict.load(store_path).unwrap();
+    user_dict
+}
+
+/// `i`番目の単語。表記と読みを`i`から作り、すべて異なるものにする。
+fn word(i: usize) -> UserDictWord {
+    let mut pronunciation = String::new();
+    let mut n = i;
+    loop {
+        pronunciation.push(KATAKANA[n % KATAKANA.len()]);
+        n /= KATAKANA.len();
+        if n == 0 {
+            break;
+        }
+    }
+    UserDictWord::new(
+        &format!("単語{i}"),
+        pronunciation,
+        0,
+        UserDictWordType::ProperNoun,
+        5,
+    )
+    .unwrap()
+}
@@ -0,0 +1,40 @@
+//! ベンチマークから内部の処理を呼ぶためのモジュール。
+//!
+//! 互換性は保証しない。
+
+pub use crate::{
+    engine::{create_kana, parse_kana, Phoneme, Utterance},
+    metrics::Metrics,
+    scheduler::Request,
+};
+
+use std::path::Path;
+
+use crate::{engine::SynthesisEngine, AudioQueryModel};
+
+/// [`Synthesizer::synthesis`]のうち、音声波形の生成に渡すフレーム単位の特徴量を作る部分。
+///
+/// 戻り値はf0と、フラットにした音素のone-hotベクトル。
+///
+/// [`Synthesizer::synthesis`]: crate::Synthesizer::synthesis
+pub fn expand_frames(
+    query: &AudioQueryModel,
+    enable_interrogative_upspeak: bool,
+) -> (Vec<f32>, Vec<f32>) {
+    SynthesisEngine::expand_frames(query, enable_interrogative_upspeak)
+}
+
+/// [`Synthesizer::synthesis`]のうち、音声波形をWAVにする部分。
+///
+/// [`Synthesizer::synthesis`]: crate::Synthesizer::synthesis
+pub fn to_wav(wave: &[f32], query: &AudioQueryModel) -> Vec<u8> {
+    SynthesisEngine::to_wav(wave, query)
+}
+
+/// [`OpenJtalk::use_compiled_user_dict`]などがコンパイル済みの辞書を探すときに求める、システム
+/// 辞書の指紋。
+///
+/// [`OpenJtalk::use_compiled_user_dict`]: crate::OpenJtalk::use_compiled_user_dict
+pub fn open_jtalk_dict_fingerprint(dict_dir: &Path) -> std::io::Result<[u8; 32]> {
+    crate::engine::dict_fingerprint(dict_dir)
+}
@@ -1,5 +1,3 @@
-use derive_getters::Getters;
-use derive_new::new;
 use once_cell::sync::Lazy;
 use std::collections::HashMap;
 
@@ -52,53 +50,53 @@ const PHONEME_LIST: &[&str] = &[
     "z",
 ];
 
-static PHONEME_MAP: Lazy<HashMap<&str, i64>> = Lazy::new(|| {
+static PHONEME_MAP: Lazy<HashMap<&str, PhonemeId>> = Lazy::new(|| {
     let mut m = HashMap::new();
     for (i, s) in PHONEME_LIST.iter().enumerate() {
-        m.insert(*s, i as i64);
+        m.insert(*s, PhonemeId(i as u8));
     }
     m
 });
 
-#[derive(Debug, Clone, PartialEq, new, Default, Getters)]
-pub struct OjtPhoneme {
-    phoneme: String,
-    #[allow(dead_code)]
-    start: f32,
-    #[allow(dead_code)]
-    end: f32,
-}
+/// 音素。
+///
+/// [`PHONEME_LIST`]におけるインデックスとして持ち、文字列としては持たない。このインデックスはその
+/// まま推論に渡す音素IDとなる。
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub struct PhonemeId(u8);
+
+impl PhonemeId {
+    /// 音素の種類の数。
+    pub const NUM: usize = PHONEME_LIST.len();
+
+    /// 無音(`pau`)。
+    pub const PAU: Self = Self(0);
+
+    /// 音素の文字列から作る。未知の音素であれば`None`。
+    pub fn new(phoneme: &str) -> Option<Self> {
+        PHONEME_MAP.get(phoneme).copied()
+    }
 
-impl OjtPhoneme {
-    pub fn num_phoneme() -> usize {
-        PHONEME_MAP.len()
+    pub fn as_str(self) -> &'static str {
+        PHONEME_LIST[self.0 as usize]
     }
 
-    pub fn space_phoneme() -> String {
-        "pau".into()
+    /// 推論に渡す音素ID。
+    pub fn raw(self) -> i64 {
+        self.0.into()
     }
 
-    pub fn phoneme_id(&self) -> i64 {
-        if self.phoneme.is_empty() {
-            -1
-        } else {
-            *PHONEME_MAP.get(&self.phoneme.as_str()).unwrap()
-        }
+    /// モーラの核(母音・撥音・促音・無音)となる音素かどうか。
+    pub fn is_mora_phoneme(self) -> bool {
+        matches!(
+            self.as_str(),
+            "a" | "i" | "u" | "e" | "o" | "N" | "A" | "I" | "U" | "E" | "O" | "cl" | "pau",
+        )
     }
 
-    pub fn convert(phonemes: &[OjtPhoneme]) -> Vec<OjtPhoneme> {
-        let mut phonemes = phonemes.to_owned();
-        if let Some(first_phoneme) = phonemes.first_mut() {
-            if first_phoneme.phoneme.contains("sil") {
-                first_phoneme.phoneme = OjtPhoneme::space_phoneme();
-            }
-        }
-        if let Some(last_phoneme) = phonemes.last_mut() {
-            if last_phoneme.phoneme.contains("sil") {
-                last_phoneme.phoneme = OjtPhoneme::space_phoneme();
-            }
-        }
-        phonemes
+    /// 無声のモーラとなる音素かどうか。
+    pub fn is_unvoiced_mora_phoneme(self) -> bool {
+        matches!(self.as_str(), "A" | "I" | "U" | "E" | "O" | "cl" | "pau")
     }
 }
 
@@ -109,20 +107,15 @@ mod tests {
 
     use crate::*;
 
-    const STR_HELLO_HIHO: &str = "sil k o N n i ch i w a pau h i h o d e s U sil";
+    const STR_HELLO_HIHO: &str = "pau k o N n i ch i w a pau h i h o d e s U pau";
 
-    fn base_hello_hiho() -> Vec<OjtPhoneme> {
+    fn hello_hiho() -> Vec<PhonemeId> {
         STR_HELLO_HIHO
             .split_whitespace()
-            .enumerate()
-            .map(|(i, s)| OjtPhoneme::new(s.into(), i as f32, (i + 1) as f32))
+            .map(|s| PhonemeId::new(s).unwrap())
             .collect()
     }
 
-    fn ojt_hello_hiho() -> Vec<OjtPhoneme> {
-        OjtPhoneme::convert(&base_hello_hiho())
-    }
-
     #[rstest]
     #[case(1, "A")]
     #[case(14, "e")]
@@ -135,45 +128,58 @@ mod tests {
 
     #[rstest]
     fn test_num_phoneme_works() {
-        assert_eq!(OjtPhoneme::num_phoneme(), 45);
+        assert_eq!(PhonemeId::NUM, 45);
+    }
+
+    #[rstest]
+    fn test_pau_works() {
+        assert_eq!(PhonemeId::PAU.as_str(), "pau");
+        assert_eq!(PhonemeId::new("pau"), Some(PhonemeId::PAU));
     }
 
     #[rstest]
-    fn test_space_phoneme_works() {
-        assert_eq!(OjtPhoneme::space_phoneme(), "pau");
+    #[case("sil")]
+    #[case("")]
+    #[case("ka")]
+    fn test_unknown_phoneme_is_none(#[case] phoneme: &str) {
+        assert_eq!(PhonemeId::new(phoneme), None);
     }
 
     #[rstest]
-    #[case(ojt_hello_hiho(), "pau k o N n i ch i w a pau h i h o d e s U pau")]
-    fn test_convert_works(#[case] ojt_phonemes: Vec<OjtPhoneme>, #[case] expected: &str) {
-        let ojt_str_hello_hiho: String = ojt_phonemes
+    fn test_as_str_roundtrips() {
+        let str_hello_hiho = hello_hiho()
             .iter()
-            .map(|phoneme| phoneme.phoneme().clone())
+            .map(|phoneme| phoneme.as_str())
             .collect::<Vec<_>>()
             .join(" ");
-        assert_eq!(ojt_str_hello_hiho, expected);
+        assert_eq!(str_hello_hiho, STR_HELLO_HIHO);
     }
 
     #[rstest]
-    #[case(ojt_hello_hiho(), 9, OjtPhoneme::new("a".into(), 9., 10.), true)]
-    #[case(ojt_hello_hiho(), 9, OjtPhoneme::new("k".into(), 9., 10.), false)]
-    #[case(ojt_hello_hiho(), 9, OjtPhoneme::new("a".into(), 10., 11.), false)]
-    fn test_ojt_phoneme_equality(
-        #[case] ojt_phonemes: Vec<OjtPhoneme>,
-        #[case] index: usize,
-        #[case] phoneme: OjtPhoneme,
-        #[case] is_equal: bool,
-    ) {
-        assert_eq!(ojt_phonemes[index] == phoneme, is_equal);
+    #[case(hello_hiho(), &[0, 23, 30, 4, 28, 21, 10, 21, 42, 7, 0, 19, 21, 19, 30, 12, 14, 35, 6, 0])]
+    fn test_phoneme_id_works(#[case] phonemes: Vec<PhonemeId>, #[case] expected_ids: &[i64]) {
+        let ids = phonemes
+            .iter()
+            .map(|phoneme| phoneme.raw())
+            .collect::<Vec<_>>();
+        assert_eq!(ids, expected_ids);
     }
 
     #[rstest]
-    #[case(ojt_hello_hiho(), &[0, 23, 30, 4, 28, 21, 10, 21, 42, 7, 0, 19, 21, 19, 30, 12, 14, 35, 6, 0])]
-    fn test_phoneme_id_works(#[case] ojt_phonemes: Vec<OjtPhoneme>, #[case] expected_ids: &[i64]) {
-        let ojt_ids = ojt_phonemes
-            .iter()
-            .map(|phoneme| phoneme.phoneme_id())
-            .collect::<Vec<_>>();
-        assert_eq!(ojt_ids, expected_ids);
+    #[case("a", true, false)]
+    #[case("N", true, false)]
+    #[case("U", true, true)]
+    #[case("cl", true, true)]
+    #[case("pau", true, true)]
+    #[case("k", false, false)]
+    #[case("ch", false, false)]
+    fn test_mora_phoneme_classification(
+        #[case] phoneme: &str,
+        #[case] is_mora_phoneme: bool,
+        #[case] is_unvoiced: bool,
+    ) {
+        let phoneme = PhonemeId::new(phoneme).unwrap();
+        assert_eq!(phoneme.is_mora_phoneme(), is_mora_phoneme);
+        assert_eq!(phoneme.is_unvoiced_mora_phoneme(), is_unvoiced);
     }
 }
@@ -1,6 +1,7 @@
 use std::collections::HashMap;
 
 use super::*;
+use crate::scheduler::Request;
 use once_cell::sync::Lazy;
 use regex::Regex;
 
@@ -308,8 +309,14 @@ impl Utterance {
     pub fn extract_full_context_label(
         open_jtalk: &open_jtalk::OpenJtalk,
         text: impl AsRef<str>,
+        metrics: &Metrics,
+        request: &Request,
     ) -> Result<Self> {
-        let labels = open_jtalk.extract_fullcontext(text)?;
+        let labels = {
+            let _timer = metrics.start(Stage::OpenJtalkAnalysis, request);
+            open_jtalk.extract_fullcontext_with_metrics(text, metrics, request)?
+        };
+        let _timer = metrics.start(Stage::LabelParse, request);
         Self::from_phonemes(
             labels
                 .into_iter()
@@ -12,5 +12,6 @@ pub use self::acoustic_feature_extractor::*;
 pub use self::full_context_label::*;
 pub use self::kana_parser::*;
 pub use self::model::*;
+pub(crate) use self::open_jtalk::dict_fingerprint;
 pub use self::open_jtalk::OpenJtalk;
 pub use self::synthesis_engine::*;
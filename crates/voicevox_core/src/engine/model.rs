@@ -35,7 +35,26 @@ pub struct AccentPhraseModel {
     is_interrogative: bool,
 }
 
+impl MoraModel {
+    pub(super) fn set_consonant_length(&mut self, consonant_length: Option<f32>) {
+        self.consonant_length = consonant_length;
+    }
+
+    pub(super) fn set_vowel_length(&mut self, vowel_length: f32) {
+        self.vowel_length = vowel_length;
+    }
+
+    pub(super) fn set_pitch(&mut self, pitch: f32) {
+        self.pitch = pitch;
+    }
+}
+
 impl AccentPhraseModel {
+    /// モーラと、後ろの無音のモーラを順に可変で辿る。
+    pub(super) fn moras_with_pause_mut(&mut self) -> impl Iterator<Item = &mut MoraModel> {
+        self.moras.iter_mut().chain(&mut self.pause_mora)
+    }
+
     pub(super) fn set_pause_mora(&mut self, pause_mora: Option<MoraModel>) {
         self.pause_mora = pause_mora;
     }
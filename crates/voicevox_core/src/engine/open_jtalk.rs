@@ -1,13 +1,16 @@
+use once_cell::sync::OnceCell;
+use sha2::{Digest as _, Sha256};
 use std::io::Write;
 use std::{
     path::{Path, PathBuf},
     sync::Mutex,
+    time::SystemTime,
 };
 use tempfile::NamedTempFile;
 
 use ::open_jtalk::*;
 
-use crate::{Error, UserDict};
+use crate::{scheduler::Request, Error, LockedResource, Metrics, UserDict};
 
 #[derive(thiserror::Error, Debug)]
 pub enum OpenJtalkError {
@@ -27,6 +30,8 @@ pub type Result<T> = std::result::Result<T, OpenJtalkError>;
 pub struct OpenJtalk {
     resources: Mutex<Resources>,
     dict_dir: Option<PathBuf>,
+    /// システム辞書の指紋。コンパイル済みのユーザー辞書を探すときに、必要になった時点で求める。
+    dict_fingerprint: OnceCell<[u8; 32]>,
 }
 
 struct Resources {
@@ -47,6 +52,7 @@ impl OpenJtalk {
                 jpcommon: ManagedResource::initialize(),
             }),
             dict_dir: None,
+            dict_fingerprint: OnceCell::new(),
         }
     }
     pub fn new_with_initialize(
@@ -63,20 +69,99 @@ impl OpenJtalk {
     ///
     /// この関数を呼び出した後にユーザー辞書を変更した場合は、再度この関数を呼ぶ必要がある。
     pub fn use_user_dict(&self, user_dict: &UserDict) -> crate::result::Result<()> {
-        let dict_dir = self
-            .dict_dir
+        let dict_dir = self.dict_dir()?;
+
+        let temp_dict = NamedTempFile::new().map_err(|e| Error::UseUserDict(e.to_string()))?;
+        let temp_dict_path = temp_dict.into_temp_path();
+        Self::compile_user_dict(dict_dir, user_dict, &temp_dict_path)?;
+
+        self.load_user_dict(dict_dir, &temp_dict_path)
+    }
+
+    /// ユーザー辞書をコンパイルしたものを、ディレクトリ`dir`に書き出す。
+    ///
+    /// 書き出したものは[`use_compiled_user_dict`]でコンパイルし直さずに設定できる。コンパイル済み
+    /// の辞書は、ユーザー辞書の内容・システム辞書・このライブラリのバージョンから求めた指紋を
+    /// ファイル名として置かれる。同じディレクトリに複数の辞書を書き出してもよい。
+    ///
+    /// [`use_compiled_user_dict`]: Self::use_compiled_user_dict
+    pub fn export_compiled_user_dict(
+        &self,
+        user_dict: &UserDict,
+        dir: impl AsRef<Path>,
+    ) -> crate::result::Result<()> {
+        let dict_dir = self.dict_dir()?;
+        let dir = dir.as_ref();
+        let path = dir.join(self.compiled_user_dict_file_name(dict_dir, user_dict)?);
+
+        // 同時に読み込まれても書きかけのものが使われないよう、一時ファイルに書いてから置き換える
+        fs_err::create_dir_all(dir).map_err(|e| Error::UseUserDict(e.to_string()))?;
+        let temp_dict =
+            NamedTempFile::new_in(dir).map_err(|e| Error::UseUserDict(e.to_string()))?;
+        let temp_dict_path = temp_dict.into_temp_path();
+        Self::compile_user_dict(dict_dir, user_dict, &temp_dict_path)?;
+        if fs_err::metadata(&temp_dict_path).map_or(true, |metadata| metadata.len() == 0) {
+            return Err(Error::UseUserDict(
+                "辞書のコンパイルに失敗しました".to_string(),
+            ));
+        }
+        temp_dict_path
+            .persist(path)
+            .map_err(|e| Error::UseUserDict(e.to_string()))?;
+        Ok(())
+    }
+
+    /// [`export_compiled_user_dict`]で`dir`に書き出された辞書のうち、`user_dict`と今のシステム辞書
+    /// から作られたものをユーザー辞書として設定する。
+    ///
+    /// コンパイル済みの辞書は、コンパイルし直さずにメモリにマップして使われる。該当するものが無い
+    /// 場合は何もせずに`false`を返すため、[`use_user_dict`]か[`export_compiled_user_dict`]に
+    /// フォールバックすること。
+    ///
+    /// [`export_compiled_user_dict`]: Self::export_compiled_user_dict
+    /// [`use_user_dict`]: Self::use_user_dict
+    pub fn use_compiled_user_dict(
+        &self,
+        user_dict: &UserDict,
+        dir: impl AsRef<Path>,
+    ) -> crate::result::Result<bool> {
+        let dict_dir = self.dict_dir()?;
+        let path = dir
+            .as_ref()
+            .join(self.compiled_user_dict_file_name(dict_dir, user_dict)?);
+        if !path.exists() {
+            return Ok(false);
+        }
+        self.load_user_dict(dict_dir, &path)?;
+        Ok(true)
+    }
+
+    fn dict_dir(&self) -> crate::result::Result<&str> {
+        self.dict_dir
             .as_ref()
             .and_then(|dict_dir| dict_dir.to_str())
-            .ok_or(Error::NotLoadedOpenjtalkDict)?;
+            .ok_or(Error::NotLoadedOpenjtalkDict)
+    }
 
+    /// ユーザー辞書をコンパイルし、`path`に書き出す。
+    fn compile_user_dict(
+        dict_dir: &str,
+        user_dict: &UserDict,
+        path: &Path,
+    ) -> crate::result::Result<()> {
         // ユーザー辞書用のcsvを作成
         let mut temp_csv = NamedTempFile::new().map_err(|e| Error::UseUserDict(e.to_string()))?;
         temp_csv
             .write_all(user_dict.to_mecab_format().as_bytes())
             .map_err(|e| Error::UseUserDict(e.to_string()))?;
         let temp_csv_path = temp_csv.into_temp_path();
-        let temp_dict = NamedTempFile::new().map_err(|e| Error::UseUserDict(e.to_string()))?;
-        let temp_dict_path = temp_dict.into_temp_path();
+
+        // 書き出し先は呼び出し側が指定したディレクトリのため、UTF-8とは限らない
+        fn to_str(path: &Path) -> crate::result::Result<&str> {
+            path.to_str().ok_or_else(|| {
+                Error::UseUserDict(format!("UTF-8ではないパスです: {}", path.display()))
+            })
+        }
 
         // Mecabでユーザー辞書をコンパイル
         // TODO: エラー（SEGV）が出るパターンを把握し、それをRust側で防ぐ。
@@ -85,18 +170,22 @@ impl OpenJtalk {
             "-d",
             dict_dir,
             "-u",
-            temp_dict_path.to_str().unwrap(),
+            to_str(path)?,
             "-f",
             "utf-8",
             "-t",
             "utf-8",
-            temp_csv_path.to_str().unwrap(),
+            to_str(&temp_csv_path)?,
             "-q",
         ]);
+        Ok(())
+    }
 
+    /// コンパイル済みのユーザー辞書`path`を読み込む。
+    fn load_user_dict(&self, dict_dir: &str, path: &Path) -> crate::result::Result<()> {
         let Resources { mecab, .. } = &mut *self.resources.lock().unwrap();
 
-        let result = mecab.load_with_userdic(Path::new(dict_dir), Some(Path::new(&temp_dict_path)));
+        let result = mecab.load_with_userdic(Path::new(dict_dir), Some(path));
 
         if !result {
             return Err(Error::UseUserDict(
@@ -107,12 +196,54 @@ impl OpenJtalk {
         Ok(())
     }
 
+    /// `user_dict`をコンパイルしたものを置くファイル名。
+    fn compiled_user_dict_file_name(
+        &self,
+        dict_dir: &str,
+        user_dict: &UserDict,
+    ) -> crate::result::Result<String> {
+        let dict_fingerprint = self
+            .dict_fingerprint
+            .get_or_try_init(|| dict_fingerprint(Path::new(dict_dir)))
+            .map_err(|e| Error::UseUserDict(e.to_string()))?;
+
+        let file_name = Sha256::new()
+            .chain_update(env!("CARGO_PKG_VERSION"))
+            .chain_update([0])
+            .chain_update(dict_fingerprint)
+            .chain_update(user_dict.to_mecab_format())
+            .finalize();
+        Ok(format!("{file_name:x}.dic"))
+    }
+
     pub fn extract_fullcontext(&self, text: impl AsRef<str>) -> Result<Vec<String>> {
+        Self::extract_fullcontext_locked(&mut self.resources.lock().unwrap(), text)
+    }
+
+    /// [`extract_fullcontext`]と同じだが、ロック待ちを`metrics`と`request`のトレースに記録する。
+    ///
+    /// [`extract_fullcontext`]: Self::extract_fullcontext
+    pub(crate) fn extract_fullcontext_with_metrics(
+        &self,
+        text: impl AsRef<str>,
+        metrics: &Metrics,
+        request: &Request,
+    ) -> Result<Vec<String>> {
+        Self::extract_fullcontext_locked(
+            &mut metrics.lock(LockedResource::OpenJtalk, &self.resources, request),
+            text,
+        )
+    }
+
+    fn extract_fullcontext_locked(
+        resources: &mut Resources,
+        text: impl AsRef<str>,
+    ) -> Result<Vec<String>> {
         let Resources {
             mecab,
             njd,
             jpcommon,
-        } = &mut *self.resources.lock().unwrap();
+        } = resources;
 
         jpcommon.refresh();
         njd.refresh();
@@ -179,6 +310,36 @@ impl OpenJtalk {
     }
 }
 
+/// システム辞書のディレクトリにあるファイルの、名前・長さ・更新日時のSHA-256から求めた指紋。
+///
+/// システム辞書は100MB程度あり、起動のたびに中身を読むとコンパイル済みの辞書を使う意味が薄れる
+/// ため、中身は読まない。
+pub(crate) fn dict_fingerprint(dict_dir: &Path) -> std::io::Result<[u8; 32]> {
+    let mut paths = fs_err::read_dir(dict_dir)?
+        .map(|entry| Ok(entry?.path()))
+        .collect::<std::io::Result<Vec<_>>>()?;
+    paths.sort();
+
+    let mut hasher = Sha256::new();
+    for path in &paths {
+        let metadata = fs_err::metadata(path)?;
+        if !metadata.is_file() {
+            continue;
+        }
+        let modified = metadata
+            .modified()?
+            .duration_since(SystemTime::UNIX_EPOCH)
+            .unwrap_or_default();
+        // 名前とその後ろの境目が曖昧にならないよう、名前の後にNULを挟む
+        let file_name = path.file_name().unwrap_or_default().to_string_lossy();
+        hasher.update(file_name.as_bytes());
+        hasher.update([0]);
+        hasher.update(metadata.len().to_le_bytes());
+        hasher.update(modified.as_nanos().to_le_bytes());
+    }
+    Ok(hasher.finalize().into())
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -294,4 +455,72 @@ mod tests {
             assert_debug_fmt_eq!(expected, result);
         }
     }
+
+    #[rstest]
+    fn compiled_user_dict_works() {
+        const TEXT: &str = "this_word_should_not_exist_in_default_dictionary";
+
+        let open_jtalk = OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap();
+        let dir = tempfile::tempdir().unwrap();
+        let word = |surface: &str| {
+            UserDictWord::new(
+                surface,
+                "アイウエオ".to_owned(),
+                0,
+                UserDictWordType::ProperNoun,
+                10,
+            )
+            .unwrap()
+        };
+        let mut user_dict = UserDict::new();
+        user_dict.add_word(word(TEXT)).unwrap();
+        let without_dict = open_jtalk.extract_fullcontext(TEXT).unwrap();
+
+        assert!(!open_jtalk
+            .use_compiled_user_dict(&user_dict, dir.path())
+            .unwrap());
+        open_jtalk
+            .export_compiled_user_dict(&user_dict, dir.path())
+            .unwrap();
+        assert!(open_jtalk
+            .use_compiled_user_dict(&user_dict, dir.path())
+            .unwrap());
+        let with_compiled_dict = open_jtalk.extract_fullcontext(TEXT).unwrap();
+        assert_ne!(without_dict, with_compiled_dict);
+
+        open_jtalk.use_user_dict(&user_dict).unwrap();
+        assert_eq!(
+            with_compiled_dict,
+            open_jtalk.extract_fullcontext(TEXT).unwrap(),
+        );
+
+        // 内容が変わったユーザー辞書には使わない
+        user_dict.add_word(word("another_word")).unwrap();
+        assert!(!open_jtalk
+            .use_compiled_user_dict(&user_dict, dir.path())
+            .unwrap());
+    }
+
+    #[cfg(unix)]
+    #[rstest]
+    fn export_compiled_user_dict_rejects_non_utf8_dir() {
+        use std::{ffi::OsStr, os::unix::ffi::OsStrExt as _};
+
+        let open_jtalk = OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap();
+        let dir = tempfile::tempdir().unwrap();
+        let dir = dir.path().join(OsStr::from_bytes(b"\xff"));
+        let result = open_jtalk.export_compiled_user_dict(&UserDict::new(), dir);
+        assert!(matches!(result, Err(Error::UseUserDict(_))), "{result:?}");
+    }
+
+    #[rstest]
+    fn dict_fingerprint_changes_when_dict_is_replaced() {
+        let dir = tempfile::tempdir().unwrap();
+        fs_err::write(dir.path().join("sys.dic"), "a").unwrap();
+        let fingerprint = dict_fingerprint(dir.path()).unwrap();
+        assert_eq!(fingerprint, dict_fingerprint(dir.path()).unwrap());
+
+        fs_err::write(dir.path().join("sys.dic"), "ab").unwrap();
+        assert_ne!(fingerprint, dict_fingerprint(dir.path()).unwrap());
+    }
 }
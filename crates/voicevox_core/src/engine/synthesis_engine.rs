@@ -1,18 +1,26 @@
 use derive_new::new;
-use std::io::{Cursor, Write};
+use std::collections::BTreeSet;
+use std::ops::Range;
+use std::slice;
 use std::sync::Arc;
 
 use super::full_context_label::Utterance;
 use super::open_jtalk::OpenJtalk;
 use super::*;
 use crate::numerics::F32Ext as _;
+use crate::scheduler::Request;
 use crate::InferenceCore;
 
-const UNVOICED_MORA_PHONEME_LIST: &[&str] = &["A", "I", "U", "E", "O", "cl", "pau"];
+/// 差分で推論しなおす際に、変更されたアクセント句の前後それぞれに少なくとも含める文脈のアクセント句
+/// の数。
+const INCREMENTAL_CONTEXT_ACCENT_PHRASES: usize = 3;
 
-const MORA_PHONEME_LIST: &[&str] = &[
-    "a", "i", "u", "e", "o", "N", "A", "I", "U", "E", "O", "cl", "pau",
-];
+/// 差分で推論しなおす対象。
+#[derive(Clone, Copy)]
+enum IncrementalTarget {
+    MoraData,
+    MoraPitch,
+}
 
 #[derive(new)]
 pub struct SynthesisEngine {
@@ -30,20 +38,31 @@ impl SynthesisEngine {
         &self.inference_core
     }
 
-    pub fn inference_core_mut(&mut self) -> &mut InferenceCore {
-        &mut self.inference_core
-    }
-
     pub async fn create_accent_phrases(
         &self,
         text: &str,
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<AccentPhraseModel>> {
+        let accent_phrases = self.analyze_text(text, request)?;
+        self.replace_mora_data(accent_phrases, style_id, request)
+            .await
+    }
+
+    /// テキストを解析し、音素長と音高が未設定(0)のアクセント句を作る。
+    ///
+    /// 声によらないため、複数の声で推論する場合には一度だけ行えばよい。
+    pub fn analyze_text(&self, text: &str, request: &Request) -> Result<Vec<AccentPhraseModel>> {
         if text.is_empty() {
             return Ok(Vec::new());
         }
 
-        let utterance = Utterance::extract_full_context_label(&self.open_jtalk, text)?;
+        let utterance = Utterance::extract_full_context_label(
+            &self.open_jtalk,
+            text,
+            self.inference_core.metrics(),
+            request,
+        )?;
 
         let accent_phrases: Vec<AccentPhraseModel> = utterance
             .breath_groups()
@@ -59,9 +78,8 @@ impl SynthesisEngine {
                                 let mora_text = mora
                                     .phonemes()
                                     .iter()
-                                    .map(|phoneme| phoneme.phoneme().to_string())
-                                    .collect::<Vec<_>>()
-                                    .join("");
+                                    .map(|phoneme| phoneme.phoneme())
+                                    .collect::<String>();
 
                                 let (consonant, consonant_length) =
                                     if let Some(consonant) = mora.consonant() {
@@ -108,94 +126,70 @@ impl SynthesisEngine {
                 accum_vec
             });
 
-        self.replace_mora_data(&accent_phrases, style_id).await
+        Ok(accent_phrases)
     }
 
+    /// `accent_phrases`の音素長と音高を推論し、その場で書き換えて返す。
     pub async fn replace_mora_data(
         &self,
-        accent_phrases: &[AccentPhraseModel],
+        accent_phrases: Vec<AccentPhraseModel>,
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<AccentPhraseModel>> {
         let accent_phrases = self
-            .replace_phoneme_length(accent_phrases, style_id)
+            .replace_phoneme_length(accent_phrases, style_id, request)
             .await?;
-        self.replace_mora_pitch(&accent_phrases, style_id).await
+        self.replace_mora_pitch(accent_phrases, style_id, request)
+            .await
     }
 
+    /// `accent_phrases`の音素長を推論し、その場で書き換えて返す。
     pub async fn replace_phoneme_length(
         &self,
-        accent_phrases: &[AccentPhraseModel],
+        mut accent_phrases: Vec<AccentPhraseModel>,
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<AccentPhraseModel>> {
-        let (_, phoneme_data_list) = SynthesisEngine::initial_process(accent_phrases);
+        let phoneme_list = SynthesisEngine::initial_process(&accent_phrases);
 
-        let (_, _, vowel_indexes_data) = split_mora(&phoneme_data_list);
+        let (_, _, vowel_indexes) = split_mora(&phoneme_list);
 
-        let phoneme_list_s: Vec<i64> = phoneme_data_list
-            .iter()
-            .map(|phoneme_data| phoneme_data.phoneme_id())
-            .collect();
+        let phoneme_list_s: Vec<i64> = phoneme_list.iter().map(|phoneme| phoneme.raw()).collect();
         let phoneme_length = self
             .inference_core()
-            .predict_duration(&phoneme_list_s, style_id)
+            .predict_duration(&phoneme_list_s, style_id, request)
             .await?;
 
-        let mut index = 0;
-        let new_accent_phrases = accent_phrases
-            .iter()
-            .map(|accent_phrase| {
-                AccentPhraseModel::new(
-                    accent_phrase
-                        .moras()
-                        .iter()
-                        .map(|mora| {
-                            let new_mora = MoraModel::new(
-                                mora.text().clone(),
-                                mora.consonant().clone(),
-                                mora.consonant().as_ref().map(|_| {
-                                    phoneme_length[vowel_indexes_data[index + 1] as usize - 1]
-                                }),
-                                mora.vowel().clone(),
-                                phoneme_length[vowel_indexes_data[index + 1] as usize],
-                                *mora.pitch(),
-                            );
-                            index += 1;
-                            new_mora
-                        })
-                        .collect(),
-                    *accent_phrase.accent(),
-                    accent_phrase.pause_mora().as_ref().map(|pause_mora| {
-                        let new_pause_mora = MoraModel::new(
-                            pause_mora.text().clone(),
-                            pause_mora.consonant().clone(),
-                            *pause_mora.consonant_length(),
-                            pause_mora.vowel().clone(),
-                            phoneme_length[vowel_indexes_data[index + 1] as usize],
-                            *pause_mora.pitch(),
-                        );
-                        index += 1;
-                        new_pause_mora
-                    }),
-                    *accent_phrase.is_interrogative(),
-                )
-            })
-            .collect();
+        let moras = accent_phrases
+            .iter_mut()
+            .flat_map(AccentPhraseModel::moras_with_pause_mut);
+        for (mora, &vowel_index) in moras.zip(&vowel_indexes[1..]) {
+            let vowel_index = vowel_index as usize;
+            let consonant_length = mora
+                .consonant()
+                .as_ref()
+                .map(|_| phoneme_length[vowel_index - 1]);
+            mora.set_consonant_length(consonant_length);
+            mora.set_vowel_length(phoneme_length[vowel_index]);
+        }
 
-        Ok(new_accent_phrases)
+        Ok(accent_phrases)
     }
 
+    /// `accent_phrases`の音高を推論し、その場で書き換えて返す。
     pub async fn replace_mora_pitch(
         &self,
-        accent_phrases: &[AccentPhraseModel],
+        mut accent_phrases: Vec<AccentPhraseModel>,
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<AccentPhraseModel>> {
-        let (_, phoneme_data_list) = SynthesisEngine::initial_process(accent_phrases);
+        let phoneme_list = SynthesisEngine::initial_process(&accent_phrases);
 
         let mut base_start_accent_list = vec![0];
         let mut base_end_accent_list = vec![0];
         let mut base_start_accent_phrase_list = vec![0];
         let mut base_end_accent_phrase_list = vec![0];
-        for accent_phrase in accent_phrases {
+        for accent_phrase in &accent_phrases {
             let mut accent = usize::from(*accent_phrase.accent() != 1);
             SynthesisEngine::create_one_accent_list(
                 &mut base_start_accent_list,
@@ -225,17 +219,13 @@ impl SynthesisEngine {
         base_start_accent_phrase_list.push(0);
         base_end_accent_phrase_list.push(0);
 
-        let (consonant_phoneme_data_list, vowel_phoneme_data_list, vowel_indexes) =
-            split_mora(&phoneme_data_list);
+        let (consonant_phonemes, vowel_phonemes, vowel_indexes) = split_mora(&phoneme_list);
 
-        let consonant_phoneme_list: Vec<i64> = consonant_phoneme_data_list
+        let consonant_phoneme_list: Vec<i64> = consonant_phonemes
             .iter()
-            .map(|phoneme_data| phoneme_data.phoneme_id())
-            .collect();
-        let vowel_phoneme_list: Vec<i64> = vowel_phoneme_data_list
-            .iter()
-            .map(|phoneme_data| phoneme_data.phoneme_id())
+            .map(|consonant| consonant.map_or(-1, PhonemeId::raw))
             .collect();
+        let vowel_phoneme_list: Vec<i64> = vowel_phonemes.iter().map(|vowel| vowel.raw()).collect();
 
         let mut start_accent_list = Vec::with_capacity(vowel_indexes.len());
         let mut end_accent_list = Vec::with_capacity(vowel_indexes.len());
@@ -260,58 +250,100 @@ impl SynthesisEngine {
                 &start_accent_phrase_list,
                 &end_accent_phrase_list,
                 style_id,
+                request,
             )
             .await?;
 
-        for i in 0..vowel_phoneme_data_list.len() {
-            if UNVOICED_MORA_PHONEME_LIST
-                .iter()
-                .any(|phoneme| *phoneme == vowel_phoneme_data_list[i].phoneme())
-            {
-                f0_list[i] = 0.;
+        for (f0, vowel) in f0_list.iter_mut().zip(&vowel_phonemes) {
+            if vowel.is_unvoiced_mora_phoneme() {
+                *f0 = 0.;
             }
         }
 
-        let mut index = 0;
-        let new_accent_phrases = accent_phrases
+        let moras = accent_phrases
+            .iter_mut()
+            .flat_map(AccentPhraseModel::moras_with_pause_mut);
+        for (mora, &f0) in moras.zip(&f0_list[1..]) {
+            mora.set_pitch(f0);
+        }
+
+        Ok(accent_phrases)
+    }
+
+    /// `accent_phrases`のうち`changed`で示すものの音素長と音高を、前後の文脈のみから推論しなおす。
+    pub async fn replace_mora_data_incrementally(
+        &self,
+        accent_phrases: Vec<AccentPhraseModel>,
+        changed: &[usize],
+        style_id: StyleId,
+        request: &Request,
+    ) -> Result<Vec<AccentPhraseModel>> {
+        self.replace_incrementally(
+            accent_phrases,
+            changed,
+            style_id,
+            IncrementalTarget::MoraData,
+            request,
+        )
+        .await
+    }
+
+    /// `accent_phrases`のうち`changed`で示すものの音高を、前後の文脈のみから推論しなおす。
+    pub async fn replace_mora_pitch_incrementally(
+        &self,
+        accent_phrases: Vec<AccentPhraseModel>,
+        changed: &[usize],
+        style_id: StyleId,
+        request: &Request,
+    ) -> Result<Vec<AccentPhraseModel>> {
+        self.replace_incrementally(
+            accent_phrases,
+            changed,
+            style_id,
+            IncrementalTarget::MoraPitch,
+            request,
+        )
+        .await
+    }
+
+    async fn replace_incrementally(
+        &self,
+        mut accent_phrases: Vec<AccentPhraseModel>,
+        changed: &[usize],
+        style_id: StyleId,
+        target: IncrementalTarget,
+        request: &Request,
+    ) -> Result<Vec<AccentPhraseModel>> {
+        let changed = changed
             .iter()
-            .map(|accent_phrase| {
-                AccentPhraseModel::new(
-                    accent_phrase
-                        .moras()
-                        .iter()
-                        .map(|mora| {
-                            let new_mora = MoraModel::new(
-                                mora.text().clone(),
-                                mora.consonant().clone(),
-                                *mora.consonant_length(),
-                                mora.vowel().clone(),
-                                *mora.vowel_length(),
-                                f0_list[index + 1],
-                            );
-                            index += 1;
-                            new_mora
-                        })
-                        .collect(),
-                    *accent_phrase.accent(),
-                    accent_phrase.pause_mora().as_ref().map(|pause_mora| {
-                        let new_pause_mora = MoraModel::new(
-                            pause_mora.text().clone(),
-                            pause_mora.consonant().clone(),
-                            *pause_mora.consonant_length(),
-                            pause_mora.vowel().clone(),
-                            *pause_mora.vowel_length(),
-                            f0_list[index + 1],
-                        );
-                        index += 1;
-                        new_pause_mora
-                    }),
-                    *accent_phrase.is_interrogative(),
-                )
-            })
-            .collect();
+            .copied()
+            .filter(|&i| i < accent_phrases.len())
+            .collect::<BTreeSet<_>>();
 
-        Ok(new_accent_phrases)
+        let has_pause = accent_phrases
+            .iter()
+            .map(|accent_phrase| accent_phrase.pause_mora().is_some())
+            .collect::<Vec<_>>();
+
+        for window in context_windows(&changed, &has_pause) {
+            let context = accent_phrases[window.clone()].to_vec();
+            let context = match target {
+                IncrementalTarget::MoraData => {
+                    self.replace_mora_data(context, style_id, request).await?
+                }
+                IncrementalTarget::MoraPitch => {
+                    self.replace_mora_pitch(context, style_id, request).await?
+                }
+            };
+            // 文脈として含めただけのアクセント句は書き換えない
+            for (i, accent_phrase) in window.zip(context) {
+                if changed.contains(&i) {
+                    accent_phrases[i] = accent_phrase;
+                }
+            }
+        }
+
+        Ok(accent_phrases)
     }
 
     pub async fn synthesis(
@@ -319,20 +351,42 @@ impl SynthesisEngine {
         query: &AudioQueryModel,
         style_id: StyleId,
         enable_interrogative_upspeak: bool,
+        request: &Request,
     ) -> Result<Vec<f32>> {
+        request.ensure_not_canceled()?;
+        let (f0, flatten_phoneme) = {
+            let _timer = self
+                .inference_core
+                .metrics()
+                .start(Stage::FrameExpansion, request);
+            Self::expand_frames(query, enable_interrogative_upspeak)
+        };
+
+        self.inference_core()
+            .decode(
+                f0.len(),
+                PhonemeId::NUM,
+                &f0,
+                &flatten_phoneme,
+                style_id,
+                request,
+            )
+            .await
+    }
+
+    /// AudioQueryから、音声波形の生成に渡すフレーム単位のf0と音素(one-hot)を作る。
+    pub fn expand_frames(
+        query: &AudioQueryModel,
+        enable_interrogative_upspeak: bool,
+    ) -> (Vec<f32>, Vec<f32>) {
         let speed_scale = *query.speed_scale();
         let pitch_scale = *query.pitch_scale();
         let intonation_scale = *query.intonation_scale();
         let pre_phoneme_length = *query.pre_phoneme_length();
         let post_phoneme_length = *query.post_phoneme_length();
 
-        let accent_phrases = if enable_interrogative_upspeak {
-            adjust_interrogative_accent_phrases(query.accent_phrases().as_slice())
-        } else {
-            query.accent_phrases().clone()
-        };
-
-        let (flatten_moras, phoneme_data_list) = SynthesisEngine::initial_process(&accent_phrases);
+        let flatten_moras = to_flatten_moras(query.accent_phrases(), enable_interrogative_upspeak);
+        let phoneme_list = to_phoneme_list(&flatten_moras);
 
         let mut phoneme_length_list = vec![pre_phoneme_length];
         let mut f0_list = vec![0.];
@@ -341,11 +395,13 @@ impl SynthesisEngine {
             let mut sum_of_f0_bigger_than_zero = 0.;
             let mut count_of_f0_bigger_than_zero = 0;
 
-            for mora in flatten_moras {
-                let consonant_length = *mora.consonant_length();
-                let vowel_length = *mora.vowel_length();
-                let pitch = *mora.pitch();
-
+            for CompactMora {
+                consonant_length,
+                vowel_length,
+                pitch,
+                ..
+            } in flatten_moras
+            {
                 if let Some(consonant_length) = consonant_length {
                     phoneme_length_list.push(consonant_length);
                 }
@@ -376,28 +432,24 @@ impl SynthesisEngine {
             }
         }
 
-        let (_, _, vowel_indexes) = split_mora(&phoneme_data_list);
+        let (_, _, vowel_indexes) = split_mora(&phoneme_list);
 
-        let mut phoneme: Vec<Vec<f32>> = Vec::new();
+        // 音素のone-hotベクトルは、フレームごとに確保せずフラットなまま並べる
+        let mut flatten_phoneme: Vec<f32> = Vec::new();
         let mut f0: Vec<f32> = Vec::new();
         {
-            const RATE: f32 = 24000. / 256.;
             let mut sum_of_phoneme_length = 0;
             let mut count_of_f0 = 0;
             let mut vowel_indexes_index = 0;
 
             for (i, phoneme_length) in phoneme_length_list.iter().enumerate() {
-                // VOICEVOX ENGINEと挙動を合わせるため、四捨五入ではなく偶数丸めをする
-                //
-                // https://github.com/VOICEVOX/voicevox_engine/issues/552
-                let phoneme_length = ((*phoneme_length * RATE).round_ties_even_() / speed_scale)
-                    .round_ties_even_() as usize;
-                let phoneme_id = phoneme_data_list[i].phoneme_id();
+                let phoneme_length = to_frames(*phoneme_length, speed_scale);
+                let phoneme_id = phoneme_list[i].raw() as usize;
 
                 for _ in 0..phoneme_length {
-                    let mut phonemes_vec = vec![0.; OjtPhoneme::num_phoneme()];
-                    phonemes_vec[phoneme_id as usize] = 1.;
-                    phoneme.push(phonemes_vec)
+                    let start = flatten_phoneme.len();
+                    flatten_phoneme.resize(start + PhonemeId::NUM, 0.);
+                    flatten_phoneme[start + phoneme_id] = 1.;
                 }
                 sum_of_phoneme_length += phoneme_length;
 
@@ -412,18 +464,88 @@ impl SynthesisEngine {
             }
         }
 
-        // 2次元のvectorを1次元に変換し、アドレスを連続させる
-        let flatten_phoneme = phoneme.into_iter().flatten().collect::<Vec<_>>();
+        (f0, flatten_phoneme)
+    }
 
-        self.inference_core()
-            .decode(
-                f0.len(),
-                OjtPhoneme::num_phoneme(),
-                &f0,
-                &flatten_phoneme,
-                style_id,
-            )
-            .await
+    /// [`Self::expand_frames`]が作るフレームのうち、各アクセント句が始まる位置を返す。
+    ///
+    /// 最後の二つの要素は、最後のアクセント句が終わる位置と、後ろの無音も含めた全体のフレーム数で
+    /// ある。
+    pub fn accent_phrase_frames(
+        query: &AudioQueryModel,
+        enable_interrogative_upspeak: bool,
+    ) -> Vec<usize> {
+        let speed_scale = *query.speed_scale();
+        let mut frames = Vec::with_capacity(query.accent_phrases().len() + 2);
+        let mut frame = to_frames(*query.pre_phoneme_length(), speed_scale);
+        frames.push(frame);
+        for accent_phrase in query.accent_phrases() {
+            let moras =
+                to_flatten_moras(slice::from_ref(accent_phrase), enable_interrogative_upspeak);
+            for mora in moras {
+                frame += mora
+                    .consonant_length
+                    .map_or(0, |length| to_frames(length, speed_scale));
+                frame += to_frames(mora.vowel_length, speed_scale);
+            }
+            frames.push(frame);
+        }
+        frames.push(frame + to_frames(*query.post_phoneme_length(), speed_scale));
+        frames
+    }
+
+    /// [`Self::expand_frames`]が作るフレームのうち`windows`のそれぞれの範囲だけから、音声波形を
+    /// 生成する。
+    ///
+    /// 前後の無音を足さないため、範囲の両端の数フレームは、文全体から生成したものとは一致しない。
+    pub async fn synthesis_windows(
+        &self,
+        query: &AudioQueryModel,
+        style_id: StyleId,
+        enable_interrogative_upspeak: bool,
+        windows: &[Range<usize>],
+        request: &Request,
+    ) -> Result<Vec<Vec<f32>>> {
+        request.ensure_not_canceled()?;
+        let (f0, flatten_phoneme) = {
+            let _timer = self
+                .inference_core
+                .metrics()
+                .start(Stage::FrameExpansion, request);
+            Self::expand_frames(query, enable_interrogative_upspeak)
+        };
+
+        let mut waves = Vec::with_capacity(windows.len());
+        for window in windows {
+            let window = window.start.min(f0.len())..window.end.min(f0.len());
+            let wave = self
+                .inference_core()
+                .decode_window(
+                    window.len(),
+                    PhonemeId::NUM,
+                    &f0[window.clone()],
+                    &flatten_phoneme[window.start * PhonemeId::NUM..window.end * PhonemeId::NUM],
+                    style_id,
+                    request,
+                )
+                .await?;
+            waves.push(wave);
+        }
+        Ok(waves)
+    }
+
+    pub async fn synthesis_waveform(
+        &self,
+        query: &AudioQueryModel,
+        style_id: StyleId,
+        enable_interrogative_upspeak: bool,
+        request: &Request,
+    ) -> Result<Waveform> {
+        let wave = self
+            .synthesis(query, style_id, enable_interrogative_upspeak, request)
+            .await?;
+        request.ensure_not_canceled()?;
+        Ok(Waveform::new(wave, query))
     }
 
     pub async fn synthesis_wave_format(
@@ -431,74 +553,30 @@ impl SynthesisEngine {
         query: &AudioQueryModel,
         style_id: StyleId,
         enable_interrogative_upspeak: bool,
+        output_format: OutputFormat,
+        request: &Request,
     ) -> Result<Vec<u8>> {
-        let wave = self
-            .synthesis(query, style_id, enable_interrogative_upspeak)
+        let waveform = self
+            .synthesis_waveform(query, style_id, enable_interrogative_upspeak, request)
             .await?;
-        let volume_scale = *query.volume_scale();
-        let output_stereo = *query.output_stereo();
-        let output_sampling_rate = *query.output_sampling_rate();
-
-        // TODO: 44.1kHzなどの対応
-
-        let num_channels: u16 = if output_stereo { 2 } else { 1 };
-        let bit_depth: u16 = 16;
-        let repeat_count: u32 =
-            (output_sampling_rate / Self::DEFAULT_SAMPLING_RATE) * num_channels as u32;
-        let block_size: u16 = bit_depth * num_channels / 8;
-
-        let bytes_size = wave.len() as u32 * repeat_count * 2;
-        let wave_size = bytes_size + 44;
-
-        let buf: Vec<u8> = Vec::with_capacity(wave_size as usize);
-        let mut cur = Cursor::new(buf);
-
-        cur.write_all("RIFF".as_bytes()).unwrap();
-        cur.write_all(&(wave_size - 8).to_le_bytes()).unwrap();
-        cur.write_all("WAVEfmt ".as_bytes()).unwrap();
-        cur.write_all(&16_u32.to_le_bytes()).unwrap(); // fmt header length
-        cur.write_all(&1_u16.to_le_bytes()).unwrap(); //linear PCM
-        cur.write_all(&num_channels.to_le_bytes()).unwrap();
-        cur.write_all(&output_sampling_rate.to_le_bytes()).unwrap();
-
-        let block_rate = output_sampling_rate * block_size as u32;
-
-        cur.write_all(&block_rate.to_le_bytes()).unwrap();
-        cur.write_all(&block_size.to_le_bytes()).unwrap();
-        cur.write_all(&bit_depth.to_le_bytes()).unwrap();
-        cur.write_all("data".as_bytes()).unwrap();
-        cur.write_all(&bytes_size.to_le_bytes()).unwrap();
-
-        for value in wave {
-            let v = (value * volume_scale).clamp(-1., 1.);
-            let data = (v * 0x7fff as f32) as i16;
-            for _ in 0..repeat_count {
-                cur.write_all(&data.to_le_bytes()).unwrap();
-            }
-        }
+        let _timer = self
+            .inference_core
+            .metrics()
+            .start(Stage::WavEncode, request);
+        Ok(waveform.encode(output_format))
+    }
 
-        Ok(cur.into_inner())
+    /// 音声波形を、AudioQueryの音量・チャンネル数・サンプリングレートに従ってWAVにする。
+    pub fn to_wav(wave: &[f32], query: &AudioQueryModel) -> Vec<u8> {
+        crate::waveform::to_wav(wave, query)
     }
 
     pub fn is_openjtalk_dict_loaded(&self) -> bool {
         self.open_jtalk.dict_loaded()
     }
 
-    fn initial_process(accent_phrases: &[AccentPhraseModel]) -> (Vec<MoraModel>, Vec<OjtPhoneme>) {
-        let flatten_moras = to_flatten_moras(accent_phrases);
-
-        let mut phoneme_strings = vec!["pau".to_string()];
-        for mora in flatten_moras.iter() {
-            if let Some(consonant) = mora.consonant() {
-                phoneme_strings.push(consonant.clone())
-            }
-            phoneme_strings.push(mora.vowel().clone());
-        }
-        phoneme_strings.push("pau".to_string());
-
-        let phoneme_data_list = to_phoneme_data_list(&phoneme_strings);
-
-        (flatten_moras, phoneme_data_list)
+    fn initial_process(accent_phrases: &[AccentPhraseModel]) -> Vec<PhonemeId> {
+        to_phoneme_list(&to_flatten_moras(accent_phrases, false))
     }
 
     fn create_one_accent_list(
@@ -524,57 +602,111 @@ impl SynthesisEngine {
     }
 }
 
-pub fn to_flatten_moras(accent_phrases: &[AccentPhraseModel]) -> Vec<MoraModel> {
-    let mut flatten_moras = Vec::new();
+/// パイプライン内部で扱うモーラ。
+///
+/// 音素を[`PhonemeId`]として持つため`Copy`であり、文字列の複製を伴わずに扱える。[`MoraModel`]
+/// との変換はAPIの境界でのみ行う。
+#[derive(Clone, Copy, Debug)]
+struct CompactMora {
+    consonant: Option<PhonemeId>,
+    consonant_length: Option<f32>,
+    vowel: PhonemeId,
+    vowel_length: f32,
+    pitch: f32,
+}
+
+impl CompactMora {
+    fn from_model(mora: &MoraModel) -> Self {
+        Self {
+            consonant: mora.consonant().as_deref().map(to_phoneme_id),
+            consonant_length: *mora.consonant_length(),
+            vowel: to_phoneme_id(mora.vowel()),
+            vowel_length: *mora.vowel_length(),
+            pitch: *mora.pitch(),
+        }
+    }
+}
+
+/// 音素の長さ(秒)を、話速を反映したフレーム数にする。
+fn to_frames(phoneme_length: f32, speed_scale: f32) -> usize {
+    const RATE: f32 = 24000. / 256.;
+    // VOICEVOX ENGINEと挙動を合わせるため、四捨五入ではなく偶数丸めをする
+    //
+    // https://github.com/VOICEVOX/voicevox_engine/issues/552
+    ((phoneme_length * RATE).round_ties_even_() / speed_scale).round_ties_even_() as usize
+}
+
+fn to_phoneme_id(phoneme: &str) -> PhonemeId {
+    PhonemeId::new(phoneme).unwrap_or_else(|| panic!("unknown phoneme: {phoneme:?}"))
+}
+
+/// アクセント句を、後ろの無音も含めたモーラの列にする。
+///
+/// `enable_interrogative_upspeak`であれば、疑問系のアクセント句の末尾に音高を上げたモーラを足す。
+fn to_flatten_moras(
+    accent_phrases: &[AccentPhraseModel],
+    enable_interrogative_upspeak: bool,
+) -> Vec<CompactMora> {
+    let mut flatten_moras = Vec::with_capacity(
+        accent_phrases
+            .iter()
+            .map(|accent_phrase| accent_phrase.moras().len() + 2)
+            .sum(),
+    );
 
     for accent_phrase in accent_phrases {
         let moras = accent_phrase.moras();
-        for mora in moras {
-            flatten_moras.push(mora.clone());
-        }
-        if let Some(pause_mora) = accent_phrase.pause_mora() {
-            flatten_moras.push(pause_mora.clone());
+        flatten_moras.extend(moras.iter().map(CompactMora::from_model));
+        if enable_interrogative_upspeak && *accent_phrase.is_interrogative() && !moras.is_empty() {
+            let last_mora = *flatten_moras.last().unwrap();
+            if last_mora.pitch != 0.0 {
+                flatten_moras.push(make_interrogative_mora(last_mora));
+            }
         }
+        flatten_moras.extend(
+            accent_phrase
+                .pause_mora()
+                .as_ref()
+                .map(CompactMora::from_model),
+        );
     }
 
     flatten_moras
 }
 
-pub fn to_phoneme_data_list<T: AsRef<str>>(phoneme_str_list: &[T]) -> Vec<OjtPhoneme> {
-    OjtPhoneme::convert(
-        phoneme_str_list
-            .iter()
-            .enumerate()
-            .map(|(i, s)| OjtPhoneme::new(s.as_ref().to_string(), i as f32, i as f32 + 1.))
-            .collect::<Vec<OjtPhoneme>>()
-            .as_slice(),
-    )
+/// モーラの列を、前後に無音を付けた音素の列にする。
+fn to_phoneme_list(flatten_moras: &[CompactMora]) -> Vec<PhonemeId> {
+    let mut phoneme_list = Vec::with_capacity(flatten_moras.len() * 2 + 2);
+    phoneme_list.push(PhonemeId::PAU);
+    for mora in flatten_moras {
+        phoneme_list.extend(mora.consonant);
+        phoneme_list.push(mora.vowel);
+    }
+    phoneme_list.push(PhonemeId::PAU);
+    phoneme_list
 }
 
-pub fn split_mora(phoneme_list: &[OjtPhoneme]) -> (Vec<OjtPhoneme>, Vec<OjtPhoneme>, Vec<i64>) {
+fn split_mora(phoneme_list: &[PhonemeId]) -> (Vec<Option<PhonemeId>>, Vec<PhonemeId>, Vec<i64>) {
     let mut vowel_indexes = Vec::new();
     for (i, phoneme) in phoneme_list.iter().enumerate() {
-        if MORA_PHONEME_LIST
-            .iter()
-            .any(|mora_phoneme| *mora_phoneme == phoneme.phoneme())
-        {
+        if phoneme.is_mora_phoneme() {
             vowel_indexes.push(i as i64);
         }
     }
 
     let vowel_phoneme_list = vowel_indexes
         .iter()
-        .map(|vowel_index| phoneme_list[*vowel_index as usize].clone())
+        .map(|vowel_index| phoneme_list[*vowel_index as usize])
         .collect();
 
-    let mut consonant_phoneme_list = vec![OjtPhoneme::default()];
+    let mut consonant_phoneme_list = vec![None];
     for i in 0..(vowel_indexes.len() - 1) {
         let prev = vowel_indexes[i];
         let next = vowel_indexes[i + 1];
         if next - prev == 1 {
-            consonant_phoneme_list.push(OjtPhoneme::default());
+            consonant_phoneme_list.push(None);
         } else {
-            consonant_phoneme_list.push(phoneme_list[next as usize - 1].clone());
+            consonant_phoneme_list.push(Some(phoneme_list[next as usize - 1]));
         }
     }
 
@@ -596,53 +728,45 @@ fn mora_to_text(mora: impl AsRef<str>) -> String {
     mora_list::mora2text(&mora).to_string()
 }
 
-fn adjust_interrogative_accent_phrases(
-    accent_phrases: &[AccentPhraseModel],
-) -> Vec<AccentPhraseModel> {
-    accent_phrases
-        .iter()
-        .map(|accent_phrase| {
-            AccentPhraseModel::new(
-                adjust_interrogative_moras(accent_phrase),
-                *accent_phrase.accent(),
-                accent_phrase.pause_mora().clone(),
-                *accent_phrase.is_interrogative(),
-            )
-        })
-        .collect()
-}
-
-fn adjust_interrogative_moras(accent_phrase: &AccentPhraseModel) -> Vec<MoraModel> {
-    let moras = accent_phrase.moras();
-    if *accent_phrase.is_interrogative() && !moras.is_empty() {
-        let last_mora = moras.last().unwrap();
-        let last_mora_pitch = *last_mora.pitch();
-        if last_mora_pitch != 0.0 {
-            let mut new_moras: Vec<MoraModel> = Vec::with_capacity(moras.len() + 1);
-            new_moras.extend_from_slice(moras.as_slice());
-            let interrogative_mora = make_interrogative_mora(last_mora);
-            new_moras.push(interrogative_mora);
-            return new_moras;
+/// 変更されたアクセント句それぞれに前後の文脈を足し、両端を無音の位置まで広げた範囲を、重なるものや
+/// 隣接するものはまとめて返す。`has_pause`はアクセント句ごとの、後ろに無音があるかどうか。
+///
+/// 範囲だけを推論する際には、その前後が文頭と文末の無音として扱われる。両端を句読点による無音に
+/// 揃えることで、端の音素の特徴を文章全体で推論する場合と同じにする。
+fn context_windows(changed: &BTreeSet<usize>, has_pause: &[bool]) -> Vec<Range<usize>> {
+    let len = has_pause.len();
+    let mut windows: Vec<Range<usize>> = vec![];
+    for &i in changed {
+        let mut start = i.saturating_sub(INCREMENTAL_CONTEXT_ACCENT_PHRASES);
+        while start > 0 && !has_pause[start - 1] {
+            start -= 1;
+        }
+        let mut end = (i + INCREMENTAL_CONTEXT_ACCENT_PHRASES + 1).min(len);
+        while end < len && !has_pause[end - 1] {
+            end += 1;
+        }
+        match windows.last_mut() {
+            Some(last) if start <= last.end => last.end = end,
+            _ => windows.push(start..end),
         }
     }
-    moras.clone()
+    windows
 }
 
-fn make_interrogative_mora(last_mora: &MoraModel) -> MoraModel {
+fn make_interrogative_mora(last_mora: CompactMora) -> CompactMora {
     const FIX_VOWEL_LENGTH: f32 = 0.15;
     const ADJUST_PITCH: f32 = 0.3;
     const MAX_PITCH: f32 = 6.5;
 
-    let pitch = (*last_mora.pitch() + ADJUST_PITCH).min(MAX_PITCH);
+    let pitch = (last_mora.pitch + ADJUST_PITCH).min(MAX_PITCH);
 
-    MoraModel::new(
-        mora_to_text(last_mora.vowel()),
-        None,
-        None,
-        last_mora.vowel().clone(),
-        FIX_VOWEL_LENGTH,
+    CompactMora {
+        consonant: None,
+        consonant_length: None,
+        vowel: last_mora.vowel,
+        vowel_length: FIX_VOWEL_LENGTH,
         pitch,
-    )
+    }
 }
 
 #[cfg(test)]
@@ -653,12 +777,44 @@ mod tests {
 
     use crate::*;
 
+    #[rstest]
+    #[case(&[], &[], 10, &[])]
+    #[case(&[0], &[], 10, &[0..10])]
+    #[case(&[0], &[3], 10, &[0..4])]
+    #[case(&[0], &[5], 10, &[0..6])]
+    #[case(&[5], &[1, 8], 10, &[2..9])]
+    #[case(&[5], &[0, 3, 8], 10, &[1..9])]
+    #[case(&[9], &[4], 10, &[5..10])]
+    #[case(&[1, 4], &[7, 12], 20, &[0..8])]
+    #[case(&[1, 8], &[4], 20, &[0..20])]
+    #[case(&[1, 16], &[4, 9, 14], 20, &[0..5, 10..20])]
+    #[case(&[0], &[], 2, &[0..2])]
+    fn context_windows_works(
+        #[case] changed: &[usize],
+        #[case] pauses: &[usize],
+        #[case] len: usize,
+        #[case] expected: &[Range<usize>],
+    ) {
+        let changed = changed.iter().copied().collect();
+        let has_pause = (0..len).map(|i| pauses.contains(&i)).collect::<Vec<_>>();
+        assert_eq!(expected, context_windows(&changed, &has_pause));
+    }
+
     #[rstest]
     #[tokio::test]
     async fn is_openjtalk_dict_loaded_works() {
-        let core = InferenceCore::new_with_initialize(false, 0, false)
-            .await
-            .unwrap();
+        let core = InferenceCore::new_with_initialize(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+            false,
+            false,
+            None,
+            false,
+        )
+        .await
+        .unwrap();
         let synthesis_engine = SynthesisEngine::new(
             core,
             OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR)
@@ -672,9 +828,18 @@ mod tests {
     #[rstest]
     #[tokio::test]
     async fn create_accent_phrases_works() {
-        let core = InferenceCore::new_with_initialize(false, 0, true)
-            .await
-            .unwrap();
+        let core = InferenceCore::new_with_initialize(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+            true,
+            false,
+            None,
+            false,
+        )
+        .await
+        .unwrap();
         let synthesis_engine = SynthesisEngine::new(
             core,
             OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR)
@@ -683,7 +848,11 @@ mod tests {
         );
 
         let accent_phrases = synthesis_engine
-            .create_accent_phrases("同じ、文章、です。完全に、同一です。", StyleId::new(1))
+            .create_accent_phrases(
+                "同じ、文章、です。完全に、同一です。",
+                StyleId::new(1),
+                &Request::default(),
+            )
             .await
             .unwrap();
         assert_eq!(accent_phrases.len(), 5);
@@ -725,4 +894,59 @@ mod tests {
             );
         }
     }
+
+    #[rstest]
+    #[case(1., true)]
+    #[case(1.3, true)]
+    #[case(0.7, false)]
+    #[tokio::test]
+    async fn accent_phrase_frames_works(
+        #[case] speed_scale: f32,
+        #[case] enable_interrogative_upspeak: bool,
+    ) {
+        let core = InferenceCore::new_with_initialize(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+            true,
+            false,
+            None,
+            false,
+        )
+        .await
+        .unwrap();
+        let synthesis_engine = SynthesisEngine::new(
+            core,
+            OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR)
+                .unwrap()
+                .into(),
+        );
+
+        let accent_phrases = synthesis_engine
+            .create_accent_phrases("同じ、文章、ですか？", StyleId::new(1), &Request::default())
+            .await
+            .unwrap();
+        let query = AudioQueryModel::new(
+            accent_phrases,
+            speed_scale,
+            0.,
+            1.,
+            1.,
+            0.1,
+            0.1,
+            SynthesisEngine::DEFAULT_SAMPLING_RATE,
+            false,
+            None,
+        );
+
+        let frames = SynthesisEngine::accent_phrase_frames(&query, enable_interrogative_upspeak);
+        let (f0, _) = SynthesisEngine::expand_frames(&query, enable_interrogative_upspeak);
+        assert_eq!(query.accent_phrases().len() + 2, frames.len());
+        assert!(frames.windows(2).all(|w| w[0] < w[1]), "{frames:?}");
+        assert_eq!(f0.len(), *frames.last().unwrap());
+        // 無音のフレームのf0は0になる
+        assert_eq!(0., f0[frames[0] - 1]);
+        assert_eq!(0., f0[frames[frames.len() - 2]]);
+    }
 }
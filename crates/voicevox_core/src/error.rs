@@ -80,6 +80,15 @@ pub enum Error {
     #[error("{}", base_error_message(VOICEVOX_RESULT_INFERENCE_ERROR))]
     InferenceFailed,
 
+    #[error("{}", base_error_message(VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR))]
+    DeadlineExceeded,
+
+    #[error("{}", base_error_message(VOICEVOX_RESULT_CANCELED_ERROR))]
+    Canceled,
+
+    #[error("{}", base_error_message(VOICEVOX_RESULT_TIMED_OUT_ERROR))]
+    TimedOut,
+
     #[error(
         "{},{0}",
         base_error_message(VOICEVOX_RESULT_EXTRACT_FULL_CONTEXT_LABEL_ERROR)
@@ -109,6 +118,12 @@ pub enum Error {
         base_error_message(VOICEVOX_RESULT_INVALID_USER_DICT_WORD_ERROR)
     )]
     InvalidWord(InvalidWordError),
+
+    #[error(
+        "{}: {0}",
+        base_error_message(VOICEVOX_RESULT_INVALID_PROMPT_TEMPLATE_ERROR)
+    )]
+    InvalidPromptTemplate(String),
 }
 
 fn base_error_message(result_code: VoicevoxResultCode) -> &'static str {
@@ -1,5 +1,6 @@
 use self::status::*;
 use super::*;
+use crate::scheduler::Request;
 use onnxruntime::{
     ndarray,
     session::{AnyArray, NdArray},
@@ -14,15 +15,34 @@ pub struct InferenceCore {
 impl InferenceCore {
     pub(crate) async fn new_with_initialize(
         use_gpu: bool,
-        cpu_num_threads: u16,
+        light_session_threads: SessionThreadOptions,
+        heavy_session_threads: SessionThreadOptions,
+        model_precision: ModelPrecision,
         load_all_models: bool,
+        auto_load_models: bool,
+        model_memory_budget: Option<u64>,
+        share_sessions: bool,
     ) -> Result<Self> {
         if !use_gpu || Self::can_support_gpu_feature()? {
-            let mut status = Status::new(use_gpu, cpu_num_threads);
+            let mut status = Status::new(
+                use_gpu,
+                light_session_threads,
+                heavy_session_threads,
+                model_precision,
+            );
+            if share_sessions {
+                status.enable_session_sharing();
+            }
 
-            if load_all_models {
-                for model in &VoiceModel::get_all_models().await? {
-                    status.load_model(model).await?;
+            if load_all_models || auto_load_models {
+                let models = VoiceModel::get_all_models().await?;
+                if load_all_models {
+                    for model in &models {
+                        status.load_model(model).await?;
+                    }
+                }
+                if auto_load_models {
+                    status.enable_auto_load(models, model_memory_budget);
                 }
             }
             Ok(Self { status })
@@ -43,14 +63,14 @@ impl InferenceCore {
         }
     }
 
-    pub async fn load_model(&mut self, model: &VoiceModel) -> Result<()> {
+    pub async fn load_model(&self, model: &VoiceModel) -> Result<()> {
         self.status.load_model(model).await
     }
 
-    pub fn unload_model(&mut self, voice_model_id: &VoiceModelId) -> Result<()> {
+    pub fn unload_model(&self, voice_model_id: &VoiceModelId) -> Result<()> {
         self.status.unload_model(voice_model_id)
     }
-    pub fn metas(&self) -> &VoiceModelMeta {
+    pub fn metas(&self) -> VoiceModelMeta {
         self.status.metas()
     }
 
@@ -58,6 +78,10 @@ impl InferenceCore {
         self.status.is_loaded_model(model_id)
     }
 
+    pub(crate) fn metrics(&self) -> &Metrics {
+        self.status.metrics()
+    }
+
     pub fn is_model_loaded_by_style_id(&self, style_id: StyleId) -> bool {
         self.status.is_loaded_model_by_style_id(style_id)
     }
@@ -66,16 +90,11 @@ impl InferenceCore {
         &self,
         phoneme_vector: &[i64],
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<f32>> {
-        if !self.status.validate_speaker_id(style_id) {
-            return Err(Error::InvalidStyleId { style_id });
-        }
-
-        let (model_id, model_inner_id) = self
-            .status
-            .id_relations
-            .get(&style_id)
-            .ok_or(Error::InvalidStyleId { style_id })?;
+        // 音声モデルの自動での読み込みは、処理段階の所要時間に含めない
+        let (session, model_inner_id) = self.status.predict_duration_session(style_id).await?;
+        let _timer = self.status.metrics().start(Stage::PredictDuration, request);
 
         let mut phoneme_vector_array = NdArray::new(ndarray::arr1(phoneme_vector));
         let mut speaker_id_array = NdArray::new(ndarray::arr1(&[model_inner_id.raw_id() as i64]));
@@ -83,9 +102,9 @@ impl InferenceCore {
         let input_tensors: Vec<&mut dyn AnyArray> =
             vec![&mut phoneme_vector_array, &mut speaker_id_array];
 
-        let mut output = self
-            .status
-            .predict_duration_session_run(model_id, input_tensors)?;
+        let mut output =
+            self.status
+                .predict_duration_session_run(&session, input_tensors, request)?;
 
         for output_item in output.iter_mut() {
             if *output_item < PHONEME_LENGTH_MINIMAL {
@@ -107,16 +126,14 @@ impl InferenceCore {
         start_accent_phrase_vector: &[i64],
         end_accent_phrase_vector: &[i64],
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<f32>> {
-        if !self.status.validate_speaker_id(style_id) {
-            return Err(Error::InvalidStyleId { style_id });
-        }
-
-        let (model_id, model_inner_id) = self
+        // 音声モデルの自動での読み込みは、処理段階の所要時間に含めない
+        let (session, model_inner_id) = self.status.predict_intonation_session(style_id).await?;
+        let _timer = self
             .status
-            .id_relations
-            .get(&style_id)
-            .ok_or(Error::InvalidStyleId { style_id })?;
+            .metrics()
+            .start(Stage::PredictIntonation, request);
 
         let mut length_array = NdArray::new(ndarray::arr0(length as i64));
         let mut vowel_phoneme_vector_array = NdArray::new(ndarray::arr1(vowel_phoneme_vector));
@@ -142,7 +159,7 @@ impl InferenceCore {
         ];
 
         self.status
-            .predict_intonation_session_run(model_id, input_tensors)
+            .predict_intonation_session_run(&session, input_tensors, request)
     }
 
     pub async fn decode(
@@ -152,31 +169,78 @@ impl InferenceCore {
         f0: &[f32],
         phoneme_vector: &[f32],
         style_id: StyleId,
+        request: &Request,
     ) -> Result<Vec<f32>> {
-        if !self.status.validate_speaker_id(style_id) {
-            return Err(Error::InvalidStyleId { style_id });
-        }
-
-        let (model_id, model_inner_id) = self
-            .status
-            .id_relations
-            .get(&style_id)
-            .ok_or(Error::InvalidStyleId { style_id })?;
-
         // 音が途切れてしまうのを避けるworkaround処理が入っている
         // TODO: 改善したらここのpadding処理を取り除く
         const PADDING_SIZE: f64 = 0.4;
         const DEFAULT_SAMPLING_RATE: f64 = 24000.0;
         let padding_size = ((PADDING_SIZE * DEFAULT_SAMPLING_RATE) / 256.0).round() as usize;
-        let start_and_end_padding_size = 2 * padding_size;
-        let length_with_padding = length + start_and_end_padding_size;
-        let f0_with_padding = Self::make_f0_with_padding(f0, length_with_padding, padding_size);
+        self.decode_with_padding(
+            length,
+            phoneme_size,
+            f0,
+            phoneme_vector,
+            style_id,
+            padding_size,
+            request,
+        )
+        .await
+    }
+
+    /// 文の一部のフレームだけから音声波形を生成する。
+    ///
+    /// 前後に無音を足さないため、`f0`と`phoneme_vector`の両端には、生成した音声波形のうち捨てる
+    /// ことになる文脈のフレームを含めておくこと。
+    pub async fn decode_window(
+        &self,
+        length: usize,
+        phoneme_size: usize,
+        f0: &[f32],
+        phoneme_vector: &[f32],
+        style_id: StyleId,
+        request: &Request,
+    ) -> Result<Vec<f32>> {
+        self.decode_with_padding(
+            length,
+            phoneme_size,
+            f0,
+            phoneme_vector,
+            style_id,
+            0,
+            request,
+        )
+        .await
+    }
+
+    #[allow(clippy::too_many_arguments)]
+    async fn decode_with_padding(
+        &self,
+        length: usize,
+        phoneme_size: usize,
+        f0: &[f32],
+        phoneme_vector: &[f32],
+        style_id: StyleId,
+        padding_size: usize,
+        request: &Request,
+    ) -> Result<Vec<f32>> {
+        // 音声モデルの自動での読み込みは、処理段階の所要時間に含めない
+        let (session, model_inner_id) = self.status.decode_session(style_id).await?;
+        let _timer = self.status.metrics().start(Stage::Decode, request);
+
+        // 入力の形が限られた種類になるよう、後ろに無音を足して長さを揃える。足した分は出力から
+        // 切り落とす
+        let length_with_padding = self.status.decode_length(length + 2 * padding_size);
+        let end_padding_size = length_with_padding - length - padding_size;
+        let f0_with_padding =
+            Self::make_f0_with_padding(f0, length_with_padding, padding_size, end_padding_size);
 
         let phoneme_with_padding = Self::make_phoneme_with_padding(
             phoneme_vector,
             phoneme_size,
             length_with_padding,
             padding_size,
+            end_padding_size,
         );
 
         let mut f0_array = NdArray::new(
@@ -195,22 +259,22 @@ impl InferenceCore {
             vec![&mut f0_array, &mut phoneme_array, &mut speaker_id_array];
 
         self.status
-            .decode_session_run(model_id, input_tensors)
-            .map(|output| Self::trim_padding_from_output(output, padding_size))
+            .decode_session_run(&session, input_tensors, request)
+            .map(|output| Self::trim_padding_from_output(output, padding_size, end_padding_size))
     }
 
     fn make_f0_with_padding(
         f0_slice: &[f32],
         length_with_padding: usize,
-        padding_size: usize,
+        start_padding_size: usize,
+        end_padding_size: usize,
     ) -> Vec<f32> {
         // 音が途切れてしまうのを避けるworkaround処理
         // 改善したらこの関数を削除する
         let mut f0_with_padding = Vec::with_capacity(length_with_padding);
-        let padding = vec![0.0; padding_size];
-        f0_with_padding.extend_from_slice(&padding);
+        f0_with_padding.resize(start_padding_size, 0.0);
         f0_with_padding.extend_from_slice(f0_slice);
-        f0_with_padding.extend_from_slice(&padding);
+        f0_with_padding.resize(f0_with_padding.len() + end_padding_size, 0.0);
         f0_with_padding
     }
 
@@ -218,32 +282,59 @@ impl InferenceCore {
         phoneme_slice: &[f32],
         phoneme_size: usize,
         length_with_padding: usize,
-        padding_size: usize,
+        start_padding_size: usize,
+        end_padding_size: usize,
     ) -> Vec<f32> {
         // 音が途切れてしまうのを避けるworkaround処理
         // 改善したらこの関数を削除する
         let mut padding_phoneme = vec![0.0; phoneme_size];
         padding_phoneme[0] = 1.0;
-        let padding_phoneme_len = padding_phoneme.len();
-        let padding_phonemes: Vec<f32> = padding_phoneme
-            .into_iter()
-            .cycle()
-            .take(padding_phoneme_len * padding_size)
-            .collect();
+        let padding_phonemes = |padding_size| {
+            padding_phoneme
+                .iter()
+                .copied()
+                .cycle()
+                .take(phoneme_size * padding_size)
+        };
         let mut phoneme_with_padding = Vec::with_capacity(phoneme_size * length_with_padding);
-        phoneme_with_padding.extend_from_slice(&padding_phonemes);
+        phoneme_with_padding.extend(padding_phonemes(start_padding_size));
         phoneme_with_padding.extend_from_slice(phoneme_slice);
-        phoneme_with_padding.extend_from_slice(&padding_phonemes);
+        phoneme_with_padding.extend(padding_phonemes(end_padding_size));
 
         phoneme_with_padding
     }
 
-    fn trim_padding_from_output(mut output: Vec<f32>, padding_f0_size: usize) -> Vec<f32> {
+    fn trim_padding_from_output(
+        mut output: Vec<f32>,
+        start_padding_f0_size: usize,
+        end_padding_f0_size: usize,
+    ) -> Vec<f32> {
         // 音が途切れてしまうのを避けるworkaround処理
         // 改善したらこの関数を削除する
-        let padding_sampling_size = padding_f0_size * 256;
+        let end = output.len() - end_padding_f0_size * 256;
+        output.truncate(end);
+        output.drain(..start_padding_f0_size * 256);
         output
-            .drain(padding_sampling_size..output.len() - padding_sampling_size)
-            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+
+    #[test]
+    fn padding_works() {
+        let f0 = InferenceCore::make_f0_with_padding(&[1., 2.], 5, 1, 2);
+        assert_eq!(vec![0., 1., 2., 0., 0.], f0);
+
+        let phoneme = InferenceCore::make_phoneme_with_padding(&[0., 1., 0., 1.], 2, 5, 1, 2);
+        assert_eq!(vec![1., 0., 0., 1., 0., 1., 1., 0., 1., 0.], phoneme);
+
+        let output = (0..5 * 256).map(|i| (i / 256) as f32).collect();
+        let output = InferenceCore::trim_padding_from_output(output, 1, 2);
+        assert_eq!(2 * 256, output.len());
+        assert_eq!(1., output[0]);
+        assert_eq!(2., output[output.len() - 1]);
     }
 }
@@ -2,6 +2,9 @@
 
 #![deny(unsafe_code)]
 
+/// cbindgen:ignore
+#[doc(hidden)]
+pub mod __internal;
 mod devices;
 /// cbindgen:ignore
 mod engine;
@@ -10,16 +13,22 @@ mod inference_core;
 mod macros;
 mod manifest;
 mod metas;
+mod metrics;
 mod numerics;
+mod prompt_template;
 mod result;
 pub mod result_code;
+mod scheduler;
 mod status;
+mod trace;
 mod user_dict;
 mod version;
 mod voice_model;
 mod voice_synthesizer;
+mod waveform;
 
 use self::inference_core::*;
+use self::metrics::Metrics;
 
 #[cfg(test)]
 mod test_util;
@@ -30,13 +39,19 @@ use self::test_util::*;
 pub use self::engine::{AccentPhraseModel, AudioQueryModel, OpenJtalk};
 pub use self::error::*;
 pub use self::metas::*;
+pub use self::metrics::{
+    GaugeSnapshot, HistogramSnapshot, LockedResource, Stage, SynthesizerStats,
+};
+pub use self::prompt_template::PromptTemplate;
 pub use self::result::*;
+pub use self::scheduler::CancellationToken;
 pub use self::voice_model::*;
 pub use devices::*;
 pub use manifest::*;
 pub use user_dict::*;
 pub use version::*;
 pub use voice_synthesizer::*;
+pub use waveform::{Encoder, OutputFormat, SampleFormat, Waveform};
 
 use derive_getters::*;
 use derive_new::new;
@@ -2,12 +2,13 @@ use std::{collections::BTreeMap, fmt::Display};
 
 use derive_getters::Getters;
 use derive_new::new;
-use serde::{Deserialize, Serialize};
+use serde::{de::IntoDeserializer as _, Deserialize, Deserializer, Serialize};
+use tracing::warn;
 
 use super::*;
 
 pub type RawManifestVersion = String;
-#[derive(Deserialize, Clone, Debug, PartialEq, new)]
+#[derive(Deserialize, Serialize, Clone, Debug, PartialEq, new)]
 pub struct ManifestVersion(RawManifestVersion);
 
 impl ManifestVersion {
@@ -40,7 +41,7 @@ impl Display for ModelInnerId {
     }
 }
 
-#[derive(Deserialize, Getters, Clone)]
+#[derive(Deserialize, Serialize, Getters, Clone)]
 pub struct Manifest {
     manifest_version: ManifestVersion,
     metas_filename: String,
@@ -49,4 +50,145 @@ pub struct Manifest {
     predict_intonation_filename: String,
     #[serde(default)]
     style_id_to_model_inner_id: BTreeMap<StyleId, ModelInnerId>,
+    /// [`ModelPrecision::Fp32`]以外の精度のモデルのファイル名。
+    #[serde(default, deserialize_with = "deserialize_model_variants")]
+    model_variants: BTreeMap<ModelPrecision, ModelVariantFilenames>,
+}
+
+/// ある精度のモデルのファイル名。
+///
+/// 指定されていないモデルには[`ModelPrecision::Fp32`]のものが使われる。
+#[derive(Deserialize, Serialize, Getters, Clone)]
+pub struct ModelVariantFilenames {
+    #[serde(default)]
+    decode_filename: Option<String>,
+    #[serde(default)]
+    predict_duration_filename: Option<String>,
+    #[serde(default)]
+    predict_intonation_filename: Option<String>,
+}
+
+/// `model_variants`を読む。知らない精度のものは、新しいVVMを古いVOICEVOX COREでも読めるよう、
+/// 警告を出して読み飛ばす。
+fn deserialize_model_variants<'de, D>(
+    deserializer: D,
+) -> std::result::Result<BTreeMap<ModelPrecision, ModelVariantFilenames>, D::Error>
+where
+    D: Deserializer<'de>,
+{
+    let variants = BTreeMap::<String, ModelVariantFilenames>::deserialize(deserializer)?;
+    Ok(variants
+        .into_iter()
+        .filter_map(|(precision, filenames)| {
+            let parsed: std::result::Result<_, serde::de::value::Error> =
+                ModelPrecision::deserialize(precision.as_str().into_deserializer());
+            match parsed {
+                Ok(precision) => Some((precision, filenames)),
+                Err(_) => {
+                    warn!("`model_variants`の不明な精度`{precision}`を無視します");
+                    None
+                }
+            }
+        })
+        .collect())
+}
+
+impl Manifest {
+    pub(crate) fn decode_filename_for(&self, precision: ModelPrecision) -> &str {
+        self.variant_filename(precision, ModelVariantFilenames::decode_filename)
+            .unwrap_or(&self.decode_filename)
+    }
+
+    pub(crate) fn predict_duration_filename_for(&self, precision: ModelPrecision) -> &str {
+        self.variant_filename(precision, ModelVariantFilenames::predict_duration_filename)
+            .unwrap_or(&self.predict_duration_filename)
+    }
+
+    pub(crate) fn predict_intonation_filename_for(&self, precision: ModelPrecision) -> &str {
+        self.variant_filename(
+            precision,
+            ModelVariantFilenames::predict_intonation_filename,
+        )
+        .unwrap_or(&self.predict_intonation_filename)
+    }
+
+    fn variant_filename<'a>(
+        &'a self,
+        precision: ModelPrecision,
+        filename: impl FnOnce(&'a ModelVariantFilenames) -> &'a Option<String>,
+    ) -> Option<&'a str> {
+        filename(self.model_variants.get(&precision)?).as_deref()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use serde_json::json;
+
+    #[rstest]
+    #[case(ModelPrecision::Fp32, ("decode.onnx", "predict_duration.onnx"))]
+    #[case(ModelPrecision::Fp16, ("decode.fp16.onnx", "predict_duration.onnx"))]
+    #[case(
+        ModelPrecision::Int8,
+        ("decode.int8.onnx", "predict_duration.int8.onnx")
+    )]
+    fn manifest_filename_for_works(
+        #[case] precision: ModelPrecision,
+        #[case] (decode_filename, predict_duration_filename): (&str, &str),
+    ) {
+        let manifest = serde_json::from_value::<Manifest>(json!({
+            "manifest_version": "0.0.0",
+            "metas_filename": "metas.json",
+            "decode_filename": "decode.onnx",
+            "predict_duration_filename": "predict_duration.onnx",
+            "predict_intonation_filename": "predict_intonation.onnx",
+            "model_variants": {
+                "fp16": { "decode_filename": "decode.fp16.onnx" },
+                "int8": {
+                    "decode_filename": "decode.int8.onnx",
+                    "predict_duration_filename": "predict_duration.int8.onnx",
+                },
+            },
+        }))
+        .unwrap();
+        assert_eq!(decode_filename, manifest.decode_filename_for(precision));
+        assert_eq!(
+            predict_duration_filename,
+            manifest.predict_duration_filename_for(precision),
+        );
+        assert_eq!(
+            "predict_intonation.onnx",
+            manifest.predict_intonation_filename_for(precision),
+        );
+    }
+
+    #[rstest]
+    fn manifest_ignores_unknown_model_variants() {
+        let manifest = serde_json::from_value::<Manifest>(json!({
+            "manifest_version": "0.0.0",
+            "metas_filename": "metas.json",
+            "decode_filename": "decode.onnx",
+            "predict_duration_filename": "predict_duration.onnx",
+            "predict_intonation_filename": "predict_intonation.onnx",
+            "model_variants": {
+                "fp16": { "decode_filename": "decode.fp16.onnx" },
+                "bf16": { "decode_filename": "decode.bf16.onnx" },
+            },
+        }))
+        .unwrap();
+        assert_eq!(
+            vec![ModelPrecision::Fp16],
+            manifest
+                .model_variants()
+                .keys()
+                .copied()
+                .collect::<Vec<_>>(),
+        );
+        assert_eq!(
+            "decode.fp16.onnx",
+            manifest.decode_filename_for(ModelPrecision::Fp16),
+        );
+    }
 }
@@ -0,0 +1,727 @@
+//! 処理段階ごとの所要時間などの計測。
+
+use std::{
+    collections::BTreeMap,
+    fmt::Write as _,
+    sync::{
+        atomic::{AtomicI64, AtomicU64, Ordering},
+        Mutex, MutexGuard,
+    },
+    time::{Duration, Instant},
+};
+
+use serde::Serialize;
+use strum::{EnumCount, EnumIter, IntoEnumIterator as _, IntoStaticStr};
+
+use crate::{
+    scheduler::{PriorityMutex, PriorityMutexGuard, Request},
+    trace::RequestTrace,
+    Error, Priority, Result,
+};
+
+/// ヒストグラムのバケットの上限(秒)。
+const BUCKET_BOUNDS: [f64; 14] = [
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1., 2.5, 5., 10.,
+];
+
+/// 音声合成の処理段階。
+#[derive(
+    Clone,
+    Copy,
+    PartialEq,
+    Eq,
+    PartialOrd,
+    Ord,
+    Debug,
+    Serialize,
+    EnumCount,
+    EnumIter,
+    IntoStaticStr,
+)]
+#[serde(rename_all = "snake_case")]
+#[strum(serialize_all = "snake_case")]
+pub enum Stage {
+    /// Open JTalkによるテキスト解析。
+    OpenJtalkAnalysis,
+    /// フルコンテキストラベルの解析。
+    LabelParse,
+    /// 音素長の推論。
+    PredictDuration,
+    /// 音高の推論。
+    PredictIntonation,
+    /// 音素長に沿った、フレーム単位の特徴量の展開。
+    FrameExpansion,
+    /// 音声波形の生成。
+    Decode,
+    /// WAVなど、出力の形式への変換。
+    WavEncode,
+}
+
+/// 排他制御されているリソース。
+#[derive(
+    Clone,
+    Copy,
+    PartialEq,
+    Eq,
+    PartialOrd,
+    Ord,
+    Debug,
+    Serialize,
+    EnumCount,
+    EnumIter,
+    IntoStaticStr,
+)]
+#[serde(rename_all = "snake_case")]
+#[strum(serialize_all = "snake_case")]
+pub enum LockedResource {
+    /// Open JTalk。
+    OpenJtalk,
+    /// 音素長の推論セッション。
+    PredictDurationSession,
+    /// 音高の推論セッション。
+    PredictIntonationSession,
+    /// 音声波形の生成セッション。
+    DecodeSession,
+}
+
+/// ヒストグラムのスナップショット。
+#[derive(Clone, PartialEq, Debug, Serialize)]
+pub struct HistogramSnapshot {
+    /// バケットの上限(秒)と、その値以下だった観測の数(累積)の組。
+    pub buckets: Vec<(f64, u64)>,
+    /// 観測の数。
+    pub count: u64,
+    /// 観測値の合計(秒)。
+    pub sum_seconds: f64,
+}
+
+/// ゲージのスナップショット。
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Serialize)]
+pub struct GaugeSnapshot {
+    /// 現在の値。
+    pub current: i64,
+    /// これまでの最大値。
+    pub max: i64,
+}
+
+/// [`Synthesizer::stats`]が返す計測値。
+///
+/// 処理段階の所要時間にはロック待ちの時間も含まれる。ロック待ちの時間は別途`lock_waits`として得られる。
+///
+/// [`Synthesizer::stats`]: crate::Synthesizer::stats
+#[derive(Clone, PartialEq, Debug, Serialize)]
+pub struct SynthesizerStats {
+    /// 処理段階ごとの所要時間。
+    pub stages: BTreeMap<Stage, HistogramSnapshot>,
+    /// リソースごとのロック待ちの時間。
+    pub lock_waits: BTreeMap<LockedResource, HistogramSnapshot>,
+    /// リソースごとの、ロック待ちをしている処理の数。
+    pub queue_depths: BTreeMap<LockedResource, GaugeSnapshot>,
+    /// 優先度ごとの、推論セッションの順番待ちの時間。
+    pub queue_waits: BTreeMap<Priority, HistogramSnapshot>,
+    /// 優先度ごとの、推論セッションの順番待ちをしている処理の数。
+    pub priority_queue_depths: BTreeMap<Priority, GaugeSnapshot>,
+    /// 優先度ごとの、期限に間に合わないために失敗した推論の数。
+    pub deadline_rejections: BTreeMap<Priority, u64>,
+    /// 音声モデルの読み込みにかかった時間。
+    pub model_loads: HistogramSnapshot,
+    /// メモリの上限のために読み込みを解除された音声モデルの数。
+    pub model_evictions: u64,
+    /// 読み込まれている推論モデルのバイト数。
+    pub resident_model_bytes: GaugeSnapshot,
+    /// [`resident_model_bytes`]のうち、他の[`Synthesizer`]と推論セッションを共有しているもの。
+    ///
+    /// [`resident_model_bytes`]: Self::resident_model_bytes
+    /// [`Synthesizer`]: crate::Synthesizer
+    pub shared_model_bytes: GaugeSnapshot,
+}
+
+impl SynthesizerStats {
+    /// 別の[`Synthesizer`]の計測値を足し合わせる。
+    ///
+    /// ゲージの最大値はそれぞれの最大値の和とする。同時に最大になったとは限らないため、実際の
+    /// 最大値以上の値になる。
+    ///
+    /// [`Synthesizer`]: crate::Synthesizer
+    pub fn merge(&mut self, other: &Self) {
+        merge_maps(&mut self.stages, &other.stages, HistogramSnapshot::merge);
+        merge_maps(
+            &mut self.lock_waits,
+            &other.lock_waits,
+            HistogramSnapshot::merge,
+        );
+        merge_maps(
+            &mut self.queue_depths,
+            &other.queue_depths,
+            GaugeSnapshot::merge,
+        );
+        merge_maps(
+            &mut self.queue_waits,
+            &other.queue_waits,
+            HistogramSnapshot::merge,
+        );
+        merge_maps(
+            &mut self.priority_queue_depths,
+            &other.priority_queue_depths,
+            GaugeSnapshot::merge,
+        );
+        merge_maps(
+            &mut self.deadline_rejections,
+            &other.deadline_rejections,
+            |this, other| *this += other,
+        );
+        self.model_loads.merge(&other.model_loads);
+        self.model_evictions += other.model_evictions;
+        self.resident_model_bytes.merge(&other.resident_model_bytes);
+        self.shared_model_bytes.merge(&other.shared_model_bytes);
+
+        fn merge_maps<K: Ord + Clone, V: Clone>(
+            this: &mut BTreeMap<K, V>,
+            other: &BTreeMap<K, V>,
+            merge: impl Fn(&mut V, &V),
+        ) {
+            for (key, value) in other {
+                match this.get_mut(key) {
+                    Some(this) => merge(this, value),
+                    None => {
+                        this.insert(key.clone(), value.clone());
+                    }
+                }
+            }
+        }
+    }
+
+    /// Prometheusのテキスト形式で出力する。
+    pub fn to_prometheus_text(&self) -> String {
+        let mut text = String::new();
+
+        write_histograms(
+            &mut text,
+            "voicevox_stage_duration_seconds",
+            "Time spent in each stage of synthesis.",
+            "stage",
+            &self.stages,
+        );
+        write_histograms(
+            &mut text,
+            "voicevox_lock_wait_seconds",
+            "Time spent waiting for a lock.",
+            "resource",
+            &self.lock_waits,
+        );
+        write_histograms(
+            &mut text,
+            "voicevox_queue_wait_seconds",
+            "Time spent waiting for an inference session, by priority.",
+            "priority",
+            &self.queue_waits,
+        );
+
+        for (name, help, max) in [
+            (
+                "voicevox_lock_queue_depth",
+                "Number of tasks waiting for a lock.",
+                false,
+            ),
+            (
+                "voicevox_lock_queue_depth_max",
+                "Maximum number of tasks that have waited for a lock at the same time.",
+                true,
+            ),
+        ] {
+            writeln!(text, "# HELP {name} {help}").unwrap();
+            writeln!(text, "# TYPE {name} gauge").unwrap();
+            for (&resource, gauge) in &self.queue_depths {
+                let resource: &str = resource.into();
+                let value = if max { gauge.max } else { gauge.current };
+                writeln!(text, "{name}{{resource=\"{resource}\"}} {value}").unwrap();
+            }
+        }
+
+        for (name, help, max) in [
+            (
+                "voicevox_priority_queue_depth",
+                "Number of tasks waiting for an inference session, by priority.",
+                false,
+            ),
+            (
+                "voicevox_priority_queue_depth_max",
+                "Peak number of tasks waiting for an inference session, by priority.",
+                true,
+            ),
+        ] {
+            writeln!(text, "# HELP {name} {help}").unwrap();
+            writeln!(text, "# TYPE {name} gauge").unwrap();
+            for (&priority, gauge) in &self.priority_queue_depths {
+                let priority: &str = priority.into();
+                let value = if max { gauge.max } else { gauge.current };
+                writeln!(text, "{name}{{priority=\"{priority}\"}} {value}").unwrap();
+            }
+        }
+
+        let name = "voicevox_deadline_rejections_total";
+        writeln!(
+            text,
+            "# HELP {name} Number of inferences rejected because they could not meet the deadline.",
+        )
+        .unwrap();
+        writeln!(text, "# TYPE {name} counter").unwrap();
+        for (&priority, count) in &self.deadline_rejections {
+            let priority: &str = priority.into();
+            writeln!(text, "{name}{{priority=\"{priority}\"}} {count}").unwrap();
+        }
+
+        let name = "voicevox_model_load_seconds";
+        writeln!(text, "# HELP {name} Time spent loading a voice model.").unwrap();
+        writeln!(text, "# TYPE {name} histogram").unwrap();
+        write_histogram(&mut text, name, "", &self.model_loads);
+
+        let name = "voicevox_model_evictions_total";
+        writeln!(
+            text,
+            "# HELP {name} Number of voice models unloaded to stay within the memory budget.",
+        )
+        .unwrap();
+        writeln!(text, "# TYPE {name} counter").unwrap();
+        writeln!(text, "{name} {}", self.model_evictions).unwrap();
+
+        for (name, help, value) in [
+            (
+                "voicevox_resident_model_bytes",
+                "Size of the loaded inference models in bytes.",
+                self.resident_model_bytes.current,
+            ),
+            (
+                "voicevox_resident_model_bytes_max",
+                "Peak size of the loaded inference models in bytes.",
+                self.resident_model_bytes.max,
+            ),
+            (
+                "voicevox_shared_model_bytes",
+                "Size of the loaded inference models whose sessions are shared with other synthesizers.",
+                self.shared_model_bytes.current,
+            ),
+        ] {
+            writeln!(text, "# HELP {name} {help}").unwrap();
+            writeln!(text, "# TYPE {name} gauge").unwrap();
+            writeln!(text, "{name} {value}").unwrap();
+        }
+        return text;
+
+        fn write_histograms<K: Copy + Into<&'static str>>(
+            text: &mut String,
+            name: &str,
+            help: &str,
+            label: &str,
+            histograms: &BTreeMap<K, HistogramSnapshot>,
+        ) {
+            writeln!(text, "# HELP {name} {help}").unwrap();
+            writeln!(text, "# TYPE {name} histogram").unwrap();
+            for (&key, histogram) in histograms {
+                let key: &str = key.into();
+                write_histogram(text, name, &format!("{label}=\"{key}\","), histogram);
+            }
+        }
+
+        /// `labels`は空か、`,`で終わるラベルの並び。
+        fn write_histogram(
+            text: &mut String,
+            name: &str,
+            labels: &str,
+            histogram: &HistogramSnapshot,
+        ) {
+            for &(le, count) in &histogram.buckets {
+                writeln!(text, "{name}_bucket{{{labels}le=\"{le}\"}} {count}").unwrap();
+            }
+            let HistogramSnapshot {
+                count, sum_seconds, ..
+            } = histogram;
+            writeln!(text, "{name}_bucket{{{labels}le=\"+Inf\"}} {count}").unwrap();
+            let labels = match labels.trim_end_matches(',') {
+                "" => "".to_owned(),
+                labels => format!("{{{labels}}}"),
+            };
+            writeln!(text, "{name}_sum{labels} {sum_seconds}").unwrap();
+            writeln!(text, "{name}_count{labels} {count}").unwrap();
+        }
+    }
+}
+
+impl HistogramSnapshot {
+    /// バケットの上限はどれも[`BUCKET_BOUNDS`]のため、同じ位置のバケットどうしを足す。
+    fn merge(&mut self, other: &Self) {
+        for ((_, count), (_, other)) in self.buckets.iter_mut().zip(&other.buckets) {
+            *count += other;
+        }
+        self.count += other.count;
+        self.sum_seconds += other.sum_seconds;
+    }
+}
+
+impl GaugeSnapshot {
+    fn merge(&mut self, other: &Self) {
+        self.current += other.current;
+        self.max += other.max;
+    }
+}
+
+/// 計測値の集計先。
+#[derive(Default)]
+pub struct Metrics {
+    stages: [Histogram; Stage::COUNT],
+    lock_waits: [Histogram; LockedResource::COUNT],
+    queue_depths: [Gauge; LockedResource::COUNT],
+    queue_waits: [Histogram; Priority::COUNT],
+    priority_queue_depths: [Gauge; Priority::COUNT],
+    deadline_rejections: [AtomicU64; Priority::COUNT],
+    model_loads: Histogram,
+    model_evictions: AtomicU64,
+    resident_model_bytes: Gauge,
+    shared_model_bytes: Gauge,
+    /// 処理段階の開始時に呼ばれる関数。処理の途中で起きることをテストで再現するために使う。
+    #[cfg(test)]
+    stage_hook: Mutex<Option<Box<dyn Fn(Stage) + Send + Sync>>>,
+}
+
+impl Metrics {
+    /// `stage`の計測を開始する。戻り値がdropされた時点までが計測される。
+    ///
+    /// `request`が記録の対象であれば、その区間をトレースにも記録する。
+    pub(crate) fn start<'a>(&'a self, stage: Stage, request: &'a Request) -> StageTimer<'a> {
+        #[cfg(test)]
+        if let Some(hook) = &*self.stage_hook.lock().unwrap() {
+            hook(stage);
+        }
+        StageTimer {
+            histogram: &self.stages[stage as usize],
+            trace: request.trace().map(|trace| (trace, stage.into())),
+            start: Instant::now(),
+        }
+    }
+
+    #[cfg(test)]
+    pub(crate) fn set_stage_hook(&self, hook: impl Fn(Stage) + Send + Sync + 'static) {
+        *self.stage_hook.lock().unwrap() = Some(Box::new(hook));
+    }
+
+    /// ロック待ちの時間と、ロック待ちをしている処理の数を計測しながら`mutex`をロックする。
+    pub(crate) fn lock<'a, T>(
+        &self,
+        resource: LockedResource,
+        mutex: &'a Mutex<T>,
+        request: &Request,
+    ) -> MutexGuard<'a, T> {
+        let queue_depth = &self.queue_depths[resource as usize];
+        queue_depth.increment();
+        let start = Instant::now();
+        let guard = mutex.lock().unwrap();
+        self.lock_waits[resource as usize].observe(start.elapsed());
+        queue_depth.decrement();
+        trace_lock_wait(request, resource, start);
+        guard
+    }
+
+    /// [`lock`]の計測に加えて、優先度ごとの順番待ちの時間と処理の数を計測しながら`mutex`を
+    /// `request`の順番でロックする。
+    ///
+    /// [`lock`]: Self::lock
+    pub(crate) fn lock_prioritized<'a, T>(
+        &self,
+        resource: LockedResource,
+        mutex: &'a PriorityMutex<T>,
+        request: &Request,
+    ) -> Result<PriorityMutexGuard<'a, T>> {
+        let priority = request.priority as usize;
+        let queue_depths = [
+            &self.queue_depths[resource as usize],
+            &self.priority_queue_depths[priority],
+        ];
+        queue_depths.iter().for_each(|gauge| gauge.increment());
+        let start = Instant::now();
+        let guard = mutex.lock(request);
+        let wait = start.elapsed();
+        queue_depths.iter().for_each(|gauge| gauge.decrement());
+
+        trace_lock_wait(request, resource, start);
+
+        match &guard {
+            Ok(_) => {
+                self.lock_waits[resource as usize].observe(wait);
+                self.queue_waits[priority].observe(wait);
+            }
+            Err(Error::DeadlineExceeded) => {
+                self.deadline_rejections[priority].fetch_add(1, Ordering::Relaxed);
+            }
+            Err(_) => {}
+        }
+        guard
+    }
+
+    /// 音声モデルの読み込みを記録する。`shared_bytes`は`bytes`のうち、既存の推論セッションを
+    /// 共有したもの。
+    pub(crate) fn record_model_load(&self, duration: Duration, bytes: u64, shared_bytes: u64) {
+        self.model_loads.observe(duration);
+        self.resident_model_bytes.add(bytes as i64);
+        self.shared_model_bytes.add(shared_bytes as i64);
+    }
+
+    /// 音声モデルの読み込みの解除を記録する。
+    pub(crate) fn record_model_unload(&self, bytes: u64, shared_bytes: u64, evicted: bool) {
+        self.resident_model_bytes.add(-(bytes as i64));
+        self.shared_model_bytes.add(-(shared_bytes as i64));
+        if evicted {
+            self.model_evictions.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    pub(crate) fn snapshot(&self) -> SynthesizerStats {
+        SynthesizerStats {
+            stages: Stage::iter()
+                .map(|stage| (stage, self.stages[stage as usize].snapshot()))
+                .collect(),
+            lock_waits: LockedResource::iter()
+                .map(|resource| (resource, self.lock_waits[resource as usize].snapshot()))
+                .collect(),
+            queue_depths: LockedResource::iter()
+                .map(|resource| (resource, self.queue_depths[resource as usize].snapshot()))
+                .collect(),
+            queue_waits: Priority::iter()
+                .map(|priority| (priority, self.queue_waits[priority as usize].snapshot()))
+                .collect(),
+            priority_queue_depths: Priority::iter()
+                .map(|priority| {
+                    let gauge = &self.priority_queue_depths[priority as usize];
+                    (priority, gauge.snapshot())
+                })
+                .collect(),
+            deadline_rejections: Priority::iter()
+                .map(|priority| {
+                    let count = &self.deadline_rejections[priority as usize];
+                    (priority, count.load(Ordering::Relaxed))
+                })
+                .collect(),
+            model_loads: self.model_loads.snapshot(),
+            model_evictions: self.model_evictions.load(Ordering::Relaxed),
+            resident_model_bytes: self.resident_model_bytes.snapshot(),
+            shared_model_bytes: self.shared_model_bytes.snapshot(),
+        }
+    }
+}
+
+/// ロック待ちの区間を、`request`が記録の対象であればトレースに記録する。
+fn trace_lock_wait(request: &Request, resource: LockedResource, start: Instant) {
+    if let Some(trace) = request.trace() {
+        trace.record("lock_wait", resource.into(), start);
+    }
+}
+
+pub(crate) struct StageTimer<'a> {
+    histogram: &'a Histogram,
+    trace: Option<(&'a RequestTrace, &'static str)>,
+    start: Instant,
+}
+
+impl Drop for StageTimer<'_> {
+    fn drop(&mut self) {
+        self.histogram.observe(self.start.elapsed());
+        if let Some((trace, stage)) = self.trace {
+            trace.record("stage", stage, self.start);
+        }
+    }
+}
+
+#[derive(Default)]
+struct Histogram {
+    buckets: [AtomicU64; BUCKET_BOUNDS.len()],
+    count: AtomicU64,
+    sum_nanos: AtomicU64,
+}
+
+impl Histogram {
+    fn observe(&self, duration: Duration) {
+        let secs = duration.as_secs_f64();
+        if let Some(i) = BUCKET_BOUNDS.iter().position(|&bound| secs <= bound) {
+            self.buckets[i].fetch_add(1, Ordering::Relaxed);
+        }
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum_nanos
+            .fetch_add(duration.as_nanos() as u64, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> HistogramSnapshot {
+        let mut cumulative = 0;
+        let buckets = BUCKET_BOUNDS
+            .iter()
+            .zip(&self.buckets)
+            .map(|(&bound, count)| {
+                cumulative += count.load(Ordering::Relaxed);
+                (bound, cumulative)
+            })
+            .collect();
+        HistogramSnapshot {
+            buckets,
+            count: self.count.load(Ordering::Relaxed),
+            sum_seconds: Duration::from_nanos(self.sum_nanos.load(Ordering::Relaxed)).as_secs_f64(),
+        }
+    }
+}
+
+#[derive(Default)]
+struct Gauge {
+    current: AtomicI64,
+    max: AtomicI64,
+}
+
+impl Gauge {
+    fn increment(&self) {
+        self.add(1);
+    }
+
+    fn decrement(&self) {
+        self.add(-1);
+    }
+
+    fn add(&self, delta: i64) {
+        let current = self.current.fetch_add(delta, Ordering::Relaxed) + delta;
+        self.max.fetch_max(current, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> GaugeSnapshot {
+        GaugeSnapshot {
+            current: self.current.load(Ordering::Relaxed),
+            max: self.max.load(Ordering::Relaxed),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+
+    #[rstest]
+    fn histogram_snapshot_is_cumulative() {
+        let histogram = Histogram::default();
+        for millis in [0, 3, 3, 700, 20_000] {
+            histogram.observe(Duration::from_millis(millis));
+        }
+        let snapshot = histogram.snapshot();
+        assert_eq!(5, snapshot.count);
+        assert!((snapshot.sum_seconds - 20.706).abs() < 1e-9);
+        assert_eq!((0.0005, 1), snapshot.buckets[0]);
+        assert_eq!((0.005, 3), snapshot.buckets[3]);
+        assert_eq!((1., 4), snapshot.buckets[10]);
+        assert_eq!((10., 4), *snapshot.buckets.last().unwrap());
+    }
+
+    #[rstest]
+    fn lock_records_wait_and_queue_depth() {
+        let metrics = Metrics::default();
+        let mutex = Mutex::new(());
+        drop(metrics.lock(LockedResource::DecodeSession, &mutex, &Request::default()));
+        drop(metrics.lock(LockedResource::DecodeSession, &mutex, &Request::default()));
+
+        let stats = metrics.snapshot();
+        assert_eq!(2, stats.lock_waits[&LockedResource::DecodeSession].count);
+        assert_eq!(0, stats.lock_waits[&LockedResource::OpenJtalk].count);
+        assert_eq!(
+            GaugeSnapshot { current: 0, max: 1 },
+            stats.queue_depths[&LockedResource::DecodeSession],
+        );
+    }
+
+    #[rstest]
+    fn to_prometheus_text_works() {
+        let metrics = Metrics::default();
+        drop(metrics.start(Stage::Decode, &Request::default()));
+        let text = metrics.snapshot().to_prometheus_text();
+
+        assert!(text.contains("# TYPE voicevox_stage_duration_seconds histogram\n"));
+        assert!(text
+            .contains("voicevox_stage_duration_seconds_bucket{stage=\"decode\",le=\"+Inf\"} 1\n"));
+        assert!(text.contains("voicevox_stage_duration_seconds_count{stage=\"wav_encode\"} 0\n"));
+        assert!(text.contains("voicevox_lock_queue_depth{resource=\"open_jtalk\"} 0\n"));
+        assert!(text.contains("voicevox_priority_queue_depth{priority=\"interactive\"} 0\n"));
+        assert!(text.contains("voicevox_deadline_rejections_total{priority=\"batch\"} 0\n"));
+        assert!(text.contains("voicevox_model_load_seconds_bucket{le=\"+Inf\"} 0\n"));
+        assert!(text.contains("voicevox_model_load_seconds_count 0\n"));
+        assert!(text.contains("voicevox_resident_model_bytes 0\n"));
+        assert!(text.contains("voicevox_shared_model_bytes 0\n"));
+    }
+
+    #[rstest]
+    fn record_model_load_and_unload_works() {
+        let metrics = Metrics::default();
+        metrics.record_model_load(Duration::from_millis(300), 100, 0);
+        metrics.record_model_load(Duration::from_millis(200), 50, 50);
+        metrics.record_model_unload(100, 0, true);
+        metrics.record_model_unload(50, 50, false);
+
+        let stats = metrics.snapshot();
+        assert_eq!(2, stats.model_loads.count);
+        assert_eq!(1, stats.model_evictions);
+        assert_eq!(
+            GaugeSnapshot {
+                current: 0,
+                max: 150
+            },
+            stats.resident_model_bytes,
+        );
+        assert_eq!(
+            GaugeSnapshot {
+                current: 0,
+                max: 50
+            },
+            stats.shared_model_bytes,
+        );
+    }
+
+    #[rstest]
+    fn merge_adds_up_stats() {
+        let (metrics1, metrics2) = (Metrics::default(), Metrics::default());
+        drop(metrics1.start(Stage::Decode, &Request::default()));
+        drop(metrics2.start(Stage::Decode, &Request::default()));
+        metrics1.record_model_load(Duration::from_millis(300), 100, 0);
+        metrics2.record_model_load(Duration::from_millis(300), 100, 0);
+
+        let mut stats = metrics1.snapshot();
+        stats.merge(&metrics2.snapshot());
+        let decode = &stats.stages[&Stage::Decode];
+        assert_eq!(2, decode.count);
+        assert_eq!(2, decode.buckets.last().unwrap().1);
+        assert_eq!(0, stats.stages[&Stage::WavEncode].count);
+        assert_eq!(2, stats.model_loads.count);
+        assert_eq!(
+            GaugeSnapshot {
+                current: 200,
+                max: 200
+            },
+            stats.resident_model_bytes,
+        );
+    }
+
+    #[rstest]
+    fn lock_prioritized_records_wait_and_rejection() {
+        let metrics = Metrics::default();
+        let mutex = PriorityMutex::new(());
+        let guard = metrics
+            .lock_prioritized(LockedResource::DecodeSession, &mutex, &Request::default())
+            .unwrap();
+        let request = Request::new(Priority::Interactive, Some(Duration::ZERO));
+        assert!(metrics
+            .lock_prioritized(LockedResource::DecodeSession, &mutex, &request)
+            .is_err());
+        drop(guard);
+
+        let stats = metrics.snapshot();
+        assert_eq!(1, stats.lock_waits[&LockedResource::DecodeSession].count);
+        assert_eq!(1, stats.queue_waits[&Priority::Normal].count);
+        assert_eq!(0, stats.queue_waits[&Priority::Interactive].count);
+        assert_eq!(1, stats.deadline_rejections[&Priority::Interactive]);
+        assert_eq!(
+            GaugeSnapshot { current: 0, max: 1 },
+            stats.priority_queue_depths[&Priority::Interactive],
+        );
+    }
+}
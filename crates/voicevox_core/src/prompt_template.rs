@@ -0,0 +1,392 @@
+//! 定型文の一部だけを差し替えて読み上げるための、プロンプトのテンプレート。
+//!
+//! テンプレート全体の音声をあらかじめ生成しておき、読み上げのたびには、差し替える部分(スロット)と
+//! その前後の文脈のフレームだけを生成しなおして、元の音声に継ぎ合わせる。
+
+use std::ops::Range;
+
+use super::*;
+
+/// 音声波形の1フレームあたりのサンプル数。
+const FRAME_LEN: usize = 256;
+/// スロットの前後に含めて生成しなおす、文脈のフレーム数。
+const CONTEXT_FRAMES: usize = 24;
+/// 生成しなおした部分の両端のうち、文全体から生成したものと一致しないため使わないフレーム数。
+const MARGIN_FRAMES: usize = 8;
+/// 元の音声から生成しなおした音声へと切り替えるクロスフェードのフレーム数。
+const FADE_FRAMES: usize = 8;
+
+/// テンプレートの区切り。
+#[derive(Clone, PartialEq, Debug)]
+pub(crate) enum Segment {
+    /// 読み上げのたびに変わらない部分。
+    Text(String),
+    /// 読み上げのたびに値を入れる部分。値はスロットの名前で指定する。
+    Slot(String),
+}
+
+impl Segment {
+    /// テンプレートを作るときに読ませるテキスト。スロットには、スロットの名前を仮に読ませる。
+    pub(crate) fn text(&self) -> &str {
+        match self {
+            Self::Text(text) | Self::Slot(text) => text,
+        }
+    }
+}
+
+/// 定型文の一部だけを差し替えて読み上げるための、プロンプトのテンプレート。
+///
+/// [`Synthesizer::create_prompt_template`]で作り、[`Synthesizer::render_prompt_template`]で
+/// 読み上げる。
+///
+/// [`Synthesizer::create_prompt_template`]: crate::Synthesizer::create_prompt_template
+/// [`Synthesizer::render_prompt_template`]: crate::Synthesizer::render_prompt_template
+#[derive(Clone)]
+pub struct PromptTemplate {
+    style_id: StyleId,
+    enable_interrogative_upspeak: bool,
+    segments: Vec<Segment>,
+    /// `segments`のそれぞれにあたる、`query`のアクセント句の範囲。
+    ranges: Vec<Range<usize>>,
+    query: AudioQueryModel,
+    /// `query`の各アクセント句が始まるフレームと、最後のアクセント句が終わるフレーム、全体の
+    /// フレーム数。
+    frames: Vec<usize>,
+    /// `query`から生成した音声波形。
+    wave: Vec<f32>,
+}
+
+impl PromptTemplate {
+    pub(crate) fn new(
+        style_id: StyleId,
+        enable_interrogative_upspeak: bool,
+        segments: Vec<Segment>,
+        ranges: Vec<Range<usize>>,
+        query: AudioQueryModel,
+        frames: Vec<usize>,
+        wave: Vec<f32>,
+    ) -> Self {
+        Self {
+            style_id,
+            enable_interrogative_upspeak,
+            segments,
+            ranges,
+            query,
+            frames,
+            wave,
+        }
+    }
+
+    /// テンプレートを作ったときのスタイルID。
+    pub fn style_id(&self) -> StyleId {
+        self.style_id
+    }
+
+    /// テンプレートを作ったときの、疑問文の語尾を上げるかどうか。
+    pub fn enable_interrogative_upspeak(&self) -> bool {
+        self.enable_interrogative_upspeak
+    }
+
+    /// スロットの名前を、テンプレートに現れる順に返す。
+    pub fn slot_names(&self) -> impl Iterator<Item = &str> {
+        self.segments.iter().filter_map(|segment| match segment {
+            Segment::Slot(name) => Some(&**name),
+            Segment::Text(_) => None,
+        })
+    }
+
+    /// スロットに値を入れたアクセント句の列と、各区切りにあたるアクセント句の範囲を返す。
+    ///
+    /// スロットの値は`analyze`でアクセント句にする。変わらない部分には、テンプレートの
+    /// アクセント句をそのまま使う。
+    pub(crate) fn fill(
+        &self,
+        values: &[(&str, &str)],
+        mut analyze: impl FnMut(&str) -> Result<Vec<AccentPhraseModel>>,
+    ) -> Result<(Vec<AccentPhraseModel>, Vec<Range<usize>>)> {
+        if let Some((name, _)) = values
+            .iter()
+            .find(|(name, _)| !self.slot_names().any(|slot| slot == *name))
+        {
+            return Err(Error::InvalidPromptTemplate(format!(
+                "テンプレートに無いスロットです: {name:?}"
+            )));
+        }
+
+        let mut accent_phrases = Vec::with_capacity(self.query.accent_phrases().len());
+        let mut ranges = Vec::with_capacity(self.segments.len());
+        for (segment, range) in self.segments.iter().zip(&self.ranges) {
+            let start = accent_phrases.len();
+            match segment {
+                Segment::Text(_) => {
+                    accent_phrases.extend_from_slice(&self.query.accent_phrases()[range.clone()]);
+                }
+                Segment::Slot(name) => {
+                    let (_, value) = values
+                        .iter()
+                        .find(|(slot, _)| *slot == name.as_str())
+                        .ok_or_else(|| {
+                            Error::InvalidPromptTemplate(format!(
+                                "スロットの値がありません: {name:?}"
+                            ))
+                        })?;
+                    accent_phrases.extend(analyze(value)?);
+                }
+            }
+            ranges.push(start..accent_phrases.len());
+        }
+        Ok((accent_phrases, ranges))
+    }
+
+    /// `fill`が返した範囲のうち、スロットにあたるアクセント句の位置を返す。
+    pub(crate) fn slot_accent_phrases(&self, ranges: &[Range<usize>]) -> Vec<usize> {
+        self.segments
+            .iter()
+            .zip(ranges)
+            .filter(|(segment, _)| matches!(segment, Segment::Slot(_)))
+            .flat_map(|(_, range)| range.clone())
+            .collect()
+    }
+
+    /// スロットに値を入れた音声を、テンプレートの音声からどう継ぎ合わせるかを決める。
+    ///
+    /// `ranges`は[`Self::fill`]が返した範囲、`frames`はスロットに値を入れたAudioQueryの各
+    /// アクセント句が始まるフレーム(`SynthesisEngine::accent_phrase_frames`)。
+    pub(crate) fn splice(&self, ranges: &[Range<usize>], frames: &[usize]) -> Splice {
+        let total_frames = *frames.last().unwrap();
+        let last = frames.len() - 2;
+        let template_last = self.frames.len() - 2;
+
+        // 前後の無音はテンプレートと変わらない
+        let mut copies = vec![(0..frames[0], 0)];
+        let mut slots = vec![];
+        for ((segment, range), template_range) in self.segments.iter().zip(ranges).zip(&self.ranges)
+        {
+            let new_frames = frames[range.start]..frames[range.end];
+            match segment {
+                Segment::Text(_) => copies.push((new_frames, self.frames[template_range.start])),
+                Segment::Slot(_) => slots.push(new_frames),
+            }
+        }
+        copies.push((frames[last]..total_frames, self.frames[template_last]));
+
+        Splice::new(copies, &slots, total_frames)
+    }
+
+    pub(crate) fn wave(&self) -> &[f32] {
+        &self.wave
+    }
+}
+
+/// `template`を区切りに分ける。
+///
+/// `{名前}`はスロットになる。`{`と`}`そのものは、`{{`と`}}`と書く。
+pub(crate) fn parse(template: &str) -> Result<Vec<Segment>> {
+    let error = |message: &str| Error::InvalidPromptTemplate(format!("{message}: {template:?}"));
+
+    let mut segments = vec![];
+    let mut text = String::new();
+    let mut chars = template.chars().peekable();
+    while let Some(c) = chars.next() {
+        match c {
+            '{' if chars.next_if_eq(&'{').is_some() => text.push('{'),
+            '}' if chars.next_if_eq(&'}').is_some() => text.push('}'),
+            '{' => {
+                let mut name = String::new();
+                loop {
+                    match chars.next() {
+                        Some('}') => break,
+                        Some('{') => return Err(error("スロットの名前に`{`は使えません")),
+                        Some(c) => name.push(c),
+                        None => return Err(error("`{`が閉じられていません")),
+                    }
+                }
+                let name = name.trim();
+                if name.is_empty() {
+                    return Err(error("スロットの名前が空です"));
+                }
+                if !text.is_empty() {
+                    segments.push(Segment::Text(std::mem::take(&mut text)));
+                }
+                segments.push(Segment::Slot(name.to_owned()));
+            }
+            '}' => return Err(error("対応する`{`の無い`}`があります")),
+            c => text.push(c),
+        }
+    }
+    if !text.is_empty() {
+        segments.push(Segment::Text(text));
+    }
+    Ok(segments)
+}
+
+/// テンプレートの音声とスロットの部分の音声との継ぎ合わせ方。
+#[derive(PartialEq, Debug)]
+pub(crate) struct Splice {
+    /// テンプレートの音声から写すフレームの範囲と、テンプレートの音声でのその開始フレーム。
+    copies: Vec<(Range<usize>, usize)>,
+    /// 生成しなおすフレームの範囲。スロットに前後の文脈を足し、重なるものはまとめてある。
+    windows: Vec<Range<usize>>,
+    total_frames: usize,
+}
+
+impl Splice {
+    fn new(
+        copies: Vec<(Range<usize>, usize)>,
+        slots: &[Range<usize>],
+        total_frames: usize,
+    ) -> Self {
+        let mut windows: Vec<Range<usize>> = vec![];
+        for slot in slots {
+            let start = slot.start.saturating_sub(CONTEXT_FRAMES);
+            let end = (slot.end + CONTEXT_FRAMES).min(total_frames);
+            match windows.last_mut() {
+                Some(last) if start <= last.end => last.end = end,
+                _ => windows.push(start..end),
+            }
+        }
+        Self {
+            copies,
+            windows,
+            total_frames,
+        }
+    }
+
+    pub(crate) fn windows(&self) -> &[Range<usize>] {
+        &self.windows
+    }
+
+    /// テンプレートの音声`template_wave`に、[`Self::windows`]のそれぞれから生成しなおした音声
+    /// `waves`を継ぎ合わせる。
+    pub(crate) fn apply(&self, template_wave: &[f32], waves: &[Vec<f32>]) -> Vec<f32> {
+        let mut wave = vec![0.; self.total_frames * FRAME_LEN];
+        for (frames, template_start) in &self.copies {
+            let start = template_start * FRAME_LEN;
+            let len = frames.len() * FRAME_LEN;
+            wave[frames.start * FRAME_LEN..frames.end * FRAME_LEN]
+                .copy_from_slice(&template_wave[start..start + len]);
+        }
+
+        for (window, window_wave) in self.windows.iter().zip(waves) {
+            let offset = window.start * FRAME_LEN;
+            let len = window.len() * FRAME_LEN;
+            // 文の端でなければ、文脈のフレームの中で元の音声から切り替える
+            let fade_in = window.start > 0;
+            let fade_out = window.end < self.total_frames;
+            for (i, &sample) in window_wave.iter().take(len).enumerate() {
+                let weight = f32::min(
+                    if fade_in { fade_weight(i) } else { 1. },
+                    if fade_out {
+                        fade_weight(len - 1 - i)
+                    } else {
+                        1.
+                    },
+                );
+                let out = &mut wave[offset + i];
+                *out = sample * weight + *out * (1. - weight);
+            }
+        }
+        wave
+    }
+}
+
+/// 生成しなおした部分の端から`i`サンプル目の、生成しなおした音声の重み。
+fn fade_weight(i: usize) -> f32 {
+    const MARGIN: usize = MARGIN_FRAMES * FRAME_LEN;
+    const FADE: usize = FADE_FRAMES * FRAME_LEN;
+    (i.saturating_sub(MARGIN) as f32 / FADE as f32).min(1.)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+
+    fn text(text: &str) -> Segment {
+        Segment::Text(text.to_owned())
+    }
+
+    fn slot(name: &str) -> Segment {
+        Segment::Slot(name.to_owned())
+    }
+
+    #[rstest]
+    #[case("", &[])]
+    #[case("こんにちは", &[text("こんにちは")])]
+    #[case(
+        "{名前}様、{日付}のご予約を承りました。",
+        &[slot("名前"), text("様、"), slot("日付"), text("のご予約を承りました。")]
+    )]
+    #[case("{ a }{b}", &[slot("a"), slot("b")])]
+    #[case("{{a}}は{a}", &[text("{a}は"), slot("a")])]
+    fn parse_works(#[case] template: &str, #[case] expected: &[Segment]) {
+        assert_eq!(expected, parse(template).unwrap());
+    }
+
+    #[rstest]
+    #[case("{名前")]
+    #[case("名前}")]
+    #[case("{}")]
+    #[case("{ }")]
+    #[case("{名{前}}")]
+    fn parse_fails(#[case] template: &str) {
+        assert!(
+            matches!(parse(template), Err(Error::InvalidPromptTemplate(_))),
+            "{template:?}"
+        );
+    }
+
+    #[rstest]
+    #[case(&[], 100, &[])]
+    #[case(&[40..50], 100, &[16..74])]
+    #[case(&[10..20], 100, &[0..44])]
+    #[case(&[80..90], 100, &[56..100])]
+    #[case(&[30..40, 60..70], 100, &[6..94])]
+    #[case(&[30..40, 100..110], 200, &[6..64, 76..134])]
+    #[case(&[40..40], 100, &[16..64])]
+    fn splice_windows_works(
+        #[case] slots: &[Range<usize>],
+        #[case] total_frames: usize,
+        #[case] expected: &[Range<usize>],
+    ) {
+        assert_eq!(expected, Splice::new(vec![], slots, total_frames).windows());
+    }
+
+    #[rstest]
+    fn splice_apply_works() {
+        let total_frames = 100;
+        let template_wave = (0..total_frames * FRAME_LEN)
+            .map(|i| (i as f32 * 0.01).sin())
+            .collect::<Vec<_>>();
+
+        // スロットの長さが変わらず、生成しなおした音声も同じであれば、元の音声と一致する
+        let splice = Splice::new(vec![(0..40, 0), (50..100, 50)], &[40..50], total_frames);
+        let window = &splice.windows()[0];
+        let same = template_wave[window.start * FRAME_LEN..window.end * FRAME_LEN].to_vec();
+        let wave = splice.apply(&template_wave, &[same]);
+        assert_eq!(template_wave.len(), wave.len());
+        for (a, b) in template_wave.iter().zip(&wave) {
+            assert!((a - b).abs() < 1e-6);
+        }
+
+        // スロットが10フレーム伸びると、後ろはそのままずれる
+        let splice = Splice::new(vec![(0..40, 0), (60..110, 50)], &[40..60], 110);
+        let window = splice.windows()[0].clone();
+        assert_eq!(16..84, window);
+        let wave = splice.apply(&template_wave, &[vec![2.; window.len() * FRAME_LEN]]);
+        assert_eq!(110 * FRAME_LEN, wave.len());
+        // 文脈の端は元の音声のまま
+        assert_eq!(template_wave[..24 * FRAME_LEN], wave[..24 * FRAME_LEN]);
+        assert_eq!(template_wave[66 * FRAME_LEN..], wave[76 * FRAME_LEN..]);
+        // 文脈のうちスロットに近い部分とスロットは、生成しなおした音声になる
+        assert!(wave[32 * FRAME_LEN..68 * FRAME_LEN]
+            .iter()
+            .all(|&v| v == 2.));
+        // その間は滑らかに切り替わる
+        let weights = (24 * FRAME_LEN..32 * FRAME_LEN)
+            .map(|i| (wave[i] - template_wave[i]) / (2. - template_wave[i]))
+            .collect::<Vec<_>>();
+        assert!(weights.windows(2).all(|w| w[0] <= w[1] + 1e-6));
+        assert!(weights[0] < 0.01 && weights[weights.len() - 1] > 0.99);
+    }
+}
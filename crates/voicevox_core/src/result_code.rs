@@ -55,6 +55,14 @@ pub enum VoicevoxResultCode {
     VOICEVOX_RESULT_INVALID_USER_DICT_WORD_ERROR = 24,
     /// UUIDの変換に失敗した
     VOICEVOX_RESULT_INVALID_UUID_ERROR = 25,
+    /// 期限までに推論を始められなかった
+    VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR = 26,
+    /// 処理が中断された
+    VOICEVOX_RESULT_CANCELED_ERROR = 27,
+    /// 処理がタイムアウトした
+    VOICEVOX_RESULT_TIMED_OUT_ERROR = 28,
+    /// プロンプトのテンプレートが不正だった
+    VOICEVOX_RESULT_INVALID_PROMPT_TEMPLATE_ERROR = 29,
 }
 
 pub const fn error_result_to_message(result_code: VoicevoxResultCode) -> &'static str {
@@ -101,5 +109,9 @@ pub const fn error_result_to_message(result_code: VoicevoxResultCode) -> &'stati
             "ユーザー辞書の単語のバリデーションに失敗しました\0"
         }
         VOICEVOX_RESULT_INVALID_UUID_ERROR => "UUIDの変換に失敗しました\0",
+        VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR => "期限までに推論を始められませんでした\0",
+        VOICEVOX_RESULT_CANCELED_ERROR => "処理が中断されました\0",
+        VOICEVOX_RESULT_TIMED_OUT_ERROR => "処理がタイムアウトしました\0",
+        VOICEVOX_RESULT_INVALID_PROMPT_TEMPLATE_ERROR => "プロンプトのテンプレートが不正です\0",
     }
 }
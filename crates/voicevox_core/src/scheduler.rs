@@ -0,0 +1,439 @@
+//! 推論セッションを、優先度と期限に従った順番で使わせるための排他制御と、推論の要求の中断。
+
+use std::{
+    collections::BTreeSet,
+    ops::{Deref, DerefMut},
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc, Condvar, Mutex, MutexGuard,
+    },
+    time::{Duration, Instant},
+};
+
+use crate::{trace::RequestTrace, Error, Priority, Result};
+
+/// 中断が要求されていないか、順番待ちの間に確かめる間隔。
+const CANCELLATION_POLL_INTERVAL: Duration = Duration::from_millis(10);
+
+/// 音声合成を中断するためのトークン。
+///
+/// [`TtsOptions::cancellation_token`]などに渡したトークンの[`cancel`]を呼ぶと、その音声合成は次の
+/// 処理段階に進む前、あるいは推論セッションの順番待ちの間に[`Error::Canceled`]で失敗する。
+/// 実行中の推論そのものは中断されない。
+///
+/// クローンしたトークンは同じ状態を共有する。
+///
+/// [`TtsOptions::cancellation_token`]: crate::TtsOptions::cancellation_token
+/// [`cancel`]: Self::cancel
+#[derive(Clone, Default, Debug)]
+pub struct CancellationToken(Arc<AtomicBool>);
+
+impl CancellationToken {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// 中断を要求する。
+    pub fn cancel(&self) {
+        self.0.store(true, Ordering::Relaxed);
+    }
+
+    /// 中断が要求されているか。
+    pub fn is_canceled(&self) -> bool {
+        self.0.load(Ordering::Relaxed)
+    }
+
+    /// 既に中断が要求されているトークン。
+    #[cfg(test)]
+    pub(crate) fn canceled() -> Self {
+        let cancellation_token = Self::new();
+        cancellation_token.cancel();
+        cancellation_token
+    }
+}
+
+/// 推論の要求の優先度・期限と、中断の条件。
+#[derive(Clone, Default, Debug)]
+pub struct Request {
+    pub(crate) priority: Priority,
+    /// 推論を始めるまでの期限。
+    pub(crate) deadline: Option<Instant>,
+    /// いずれかの推論セッションのロックを取ったかどうか。取った後は、以降の段階で期限を過ぎていても
+    /// 失敗させない。クローンとの間で共有する。
+    started: Arc<AtomicBool>,
+    /// 要求全体の期限。
+    expires_at: Option<Instant>,
+    cancellation_token: Option<CancellationToken>,
+    /// 処理段階とロック待ちの記録。記録の対象に選ばれた要求だけが持つ。
+    trace: Option<Arc<RequestTrace>>,
+}
+
+impl Request {
+    /// 現在時刻から`deadline`が経った時点を、推論を始めるまでの期限とする。
+    pub(crate) fn new(priority: Priority, deadline: Option<Duration>) -> Self {
+        Self {
+            priority,
+            deadline: after(deadline),
+            ..Default::default()
+        }
+    }
+
+    /// 現在時刻から`timeout`が経った時点か、`cancellation_token`で中断を要求された時点で中断する。
+    pub(crate) fn with_cancellation(
+        self,
+        timeout: Option<Duration>,
+        cancellation_token: Option<CancellationToken>,
+    ) -> Self {
+        Self {
+            expires_at: after(timeout),
+            cancellation_token,
+            ..self
+        }
+    }
+
+    /// トレースが有効にされていれば、この要求を`name`として記録の対象に選ぶかどうかを決める。
+    ///
+    /// 要求全体の区間は、クローンを含めたすべての`Request`がdropされた時点で閉じる。
+    pub(crate) fn traced(self, name: &'static str) -> Self {
+        Self {
+            trace: RequestTrace::start(name, self.priority).map(Arc::new),
+            ..self
+        }
+    }
+
+    pub(crate) fn trace(&self) -> Option<&RequestTrace> {
+        self.trace.as_deref()
+    }
+
+    /// 中断が要求されているか、タイムアウトしていれば失敗する。
+    pub(crate) fn ensure_not_canceled(&self) -> Result<()> {
+        if self
+            .cancellation_token
+            .as_ref()
+            .map_or(false, CancellationToken::is_canceled)
+        {
+            return Err(Error::Canceled);
+        }
+        if self.expires_at.map_or(false, |t| Instant::now() >= t) {
+            return Err(Error::TimedOut);
+        }
+        Ok(())
+    }
+
+    fn is_cancelable(&self) -> bool {
+        self.cancellation_token.is_some() || self.expires_at.is_some()
+    }
+
+    /// 守らせる期限。推論を始めた後は無い。
+    fn pending_deadline(&self) -> Option<Instant> {
+        self.deadline
+            .filter(|_| !self.started.load(Ordering::Relaxed))
+    }
+}
+
+/// 現在時刻から`duration`が経った時点。表現できないほど先であれば、期限無しとして扱う。
+fn after(duration: Option<Duration>) -> Option<Instant> {
+    duration.and_then(|duration| Instant::now().checked_add(duration))
+}
+
+/// 待っている要求のうち、優先度・期限・到着順で最も先のものからロックを取らせる`Mutex`。
+///
+/// 期限のある要求は、期限までにロックを取れなかった場合と、ロックを取るまでにかかる時間の見込みが
+/// 期限を超えている場合に[`Error::DeadlineExceeded`]で失敗する。期限は最初にロックを取るまでのもの
+/// であり、一度ロックを取った要求は以降の段階では期限で失敗しない。中断された要求は、その時点で待ち
+/// 行列から外れて失敗する。
+pub(crate) struct PriorityMutex<T> {
+    state: Mutex<State>,
+    condvar: Condvar,
+    value: Mutex<T>,
+}
+
+#[derive(Default)]
+struct State {
+    locked: bool,
+    waiters: BTreeSet<Ticket>,
+    next_seq: u64,
+    /// ロックが保持されていた時間の指数移動平均。
+    mean_hold: Option<Duration>,
+}
+
+/// 待ち行列での順番。小さいものほど先にロックを取る。
+#[derive(Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Debug)]
+struct Ticket {
+    priority: Priority,
+    // 同じ優先度の中では期限の近いものから。期限の無いものはその後にする
+    no_deadline: bool,
+    deadline: Option<Instant>,
+    seq: u64,
+}
+
+impl State {
+    /// `ticket`がロックを取るまでにかかる時間の見込み。
+    ///
+    /// 入力の長さによって推論の時間は大きく変わるため、あくまで目安である。
+    fn estimated_wait(&self, ticket: &Ticket) -> Duration {
+        let Some(mean_hold) = self.mean_hold else {
+            return Duration::ZERO;
+        };
+        let ahead = self.waiters.range(..ticket).count() + usize::from(self.locked);
+        mean_hold * ahead as u32
+    }
+
+    fn observe_hold(&mut self, held: Duration) {
+        self.mean_hold = Some(match self.mean_hold {
+            Some(mean_hold) => mean_hold.mul_f64(0.875) + held.mul_f64(0.125),
+            None => held,
+        });
+    }
+}
+
+impl<T> PriorityMutex<T> {
+    pub(crate) fn new(value: T) -> Self {
+        Self {
+            state: Mutex::default(),
+            condvar: Condvar::new(),
+            value: Mutex::new(value),
+        }
+    }
+
+    /// `request`の順番が来るまで待ってからロックする。
+    pub(crate) fn lock(&self, request: &Request) -> Result<PriorityMutexGuard<'_, T>> {
+        request.ensure_not_canceled()?;
+
+        let mut state = self.state.lock().unwrap();
+        let ticket = Ticket {
+            priority: request.priority,
+            no_deadline: request.deadline.is_none(),
+            deadline: request.deadline,
+            seq: state.next_seq,
+        };
+        state.next_seq += 1;
+
+        let deadline = request.pending_deadline();
+        if let Some(deadline) = deadline {
+            if Instant::now() + state.estimated_wait(&ticket) > deadline {
+                return Err(Error::DeadlineExceeded);
+            }
+        }
+
+        state.waiters.insert(ticket);
+        while state.locked || state.waiters.first() != Some(&ticket) {
+            let now = Instant::now();
+            let result = match deadline {
+                Some(deadline) if now >= deadline => Err(Error::DeadlineExceeded),
+                _ => request.ensure_not_canceled(),
+            };
+            if let Err(err) = result {
+                state.waiters.remove(&ticket);
+                // 先頭で待っていた場合に、後ろの要求が待ち続けないようにする
+                self.condvar.notify_all();
+                return Err(err);
+            }
+
+            let mut timeout = deadline.map(|deadline| deadline - now);
+            if request.is_cancelable() {
+                timeout = Some(timeout.map_or(CANCELLATION_POLL_INTERVAL, |timeout| {
+                    timeout.min(CANCELLATION_POLL_INTERVAL)
+                }));
+            }
+            state = match timeout {
+                None => self.condvar.wait(state).unwrap(),
+                Some(timeout) => self.condvar.wait_timeout(state, timeout).unwrap().0,
+            };
+        }
+        state.waiters.remove(&ticket);
+        state.locked = true;
+        drop(state);
+        request.started.store(true, Ordering::Relaxed);
+
+        Ok(PriorityMutexGuard {
+            mutex: self,
+            guard: Some(self.value.lock().unwrap()),
+            start: Instant::now(),
+        })
+    }
+}
+
+pub(crate) struct PriorityMutexGuard<'a, T> {
+    mutex: &'a PriorityMutex<T>,
+    guard: Option<MutexGuard<'a, T>>,
+    start: Instant,
+}
+
+impl<T> Deref for PriorityMutexGuard<'_, T> {
+    type Target = T;
+
+    fn deref(&self) -> &Self::Target {
+        self.guard.as_ref().unwrap()
+    }
+}
+
+impl<T> DerefMut for PriorityMutexGuard<'_, T> {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.guard.as_mut().unwrap()
+    }
+}
+
+impl<T> Drop for PriorityMutexGuard<'_, T> {
+    fn drop(&mut self) {
+        // 次の要求が中身のロックで待たないよう、先に解放する
+        drop(self.guard.take());
+        let mut state = self.mutex.state.lock().unwrap();
+        state.locked = false;
+        state.observe_hold(self.start.elapsed());
+        drop(state);
+        self.mutex.condvar.notify_all();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::{sync::Arc, thread};
+
+    use super::*;
+    use crate::macros::tests::assert_debug_fmt_eq;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+
+    #[rstest]
+    fn lock_prefers_higher_priority_and_earlier_deadline() {
+        let mutex = Arc::new(PriorityMutex::new(vec![]));
+        let guard = mutex.lock(&Request::default()).unwrap();
+
+        let far = Duration::from_secs(60);
+        let requests = [
+            ("batch", Request::new(Priority::Batch, None)),
+            ("normal", Request::new(Priority::Normal, None)),
+            ("normal_far", Request::new(Priority::Normal, Some(far * 2))),
+            ("normal_near", Request::new(Priority::Normal, Some(far))),
+            ("interactive", Request::new(Priority::Interactive, None)),
+        ];
+        let handles = requests
+            .into_iter()
+            .enumerate()
+            .map(|(i, (name, request))| {
+                let handle = {
+                    let mutex = mutex.clone();
+                    thread::spawn(move || mutex.lock(&request).unwrap().push(name))
+                };
+                // 到着順を固定するため、待ち行列に入ったのを確かめてから次の要求を出す
+                while mutex.state.lock().unwrap().waiters.len() <= i {
+                    thread::yield_now();
+                }
+                handle
+            })
+            .collect::<Vec<_>>();
+        drop(guard);
+        for handle in handles {
+            handle.join().unwrap();
+        }
+
+        assert_eq!(
+            vec![
+                "interactive",
+                "normal_near",
+                "normal_far",
+                "normal",
+                "batch"
+            ],
+            *mutex.lock(&Request::default()).unwrap(),
+        );
+    }
+
+    #[rstest]
+    fn lock_rejects_when_deadline_is_exceeded() {
+        let mutex = PriorityMutex::new(());
+        let guard = mutex.lock(&Request::default()).unwrap();
+
+        let result = mutex.lock(&Request::new(
+            Priority::Interactive,
+            Some(Duration::from_millis(10)),
+        ));
+        assert_debug_fmt_eq!(Err::<(), _>(Error::DeadlineExceeded), result.map(drop));
+        assert!(mutex.state.lock().unwrap().waiters.is_empty());
+
+        drop(guard);
+        assert!(mutex
+            .lock(&Request::new(Priority::Batch, Some(Duration::from_secs(1))))
+            .is_ok());
+    }
+
+    #[rstest]
+    fn lock_rejects_early_when_estimated_wait_exceeds_deadline() {
+        let mutex = PriorityMutex::new(());
+        mutex.state.lock().unwrap().mean_hold = Some(Duration::from_secs(10));
+        let guard = mutex.lock(&Request::default()).unwrap();
+
+        let start = Instant::now();
+        let result = mutex.lock(&Request::new(
+            Priority::Normal,
+            Some(Duration::from_secs(5)),
+        ));
+        assert_debug_fmt_eq!(Err::<(), _>(Error::DeadlineExceeded), result.map(drop));
+        assert!(start.elapsed() < Duration::from_secs(5));
+        drop(guard);
+    }
+
+    #[rstest]
+    fn lock_ignores_deadline_after_inference_started() {
+        // 音素長の推論と音声波形の生成のように、一つの要求が段階ごとに別のセッションのロックを取る
+        let duration = PriorityMutex::new(());
+        let decode = Arc::new(PriorityMutex::new(()));
+        let request = Request::new(Priority::Normal, Some(Duration::from_millis(50)));
+        let not_started = Request::new(Priority::Normal, Some(Duration::from_millis(50)));
+
+        drop(duration.lock(&request).unwrap());
+
+        // 音声波形の生成の順番を待つ間に期限が過ぎる
+        let guard = decode.lock(&Request::default()).unwrap();
+        let waiter = {
+            let decode = decode.clone();
+            let request = request.clone();
+            thread::spawn(move || decode.lock(&request).map(drop))
+        };
+        thread::sleep(Duration::from_millis(100));
+        drop(guard);
+
+        assert_debug_fmt_eq!(Ok::<_, Error>(()), waiter.join().unwrap());
+        assert_debug_fmt_eq!(
+            Err::<(), _>(Error::DeadlineExceeded),
+            decode.lock(&not_started).map(drop),
+        );
+    }
+
+    #[rstest]
+    fn lock_leaves_queue_when_canceled() {
+        let mutex = Arc::new(PriorityMutex::new(()));
+        let guard = mutex.lock(&Request::default()).unwrap();
+
+        let cancellation_token = CancellationToken::new();
+        let request = Request::default().with_cancellation(None, Some(cancellation_token.clone()));
+        let waiter = {
+            let mutex = mutex.clone();
+            thread::spawn(move || mutex.lock(&request).map(drop))
+        };
+        while mutex.state.lock().unwrap().waiters.is_empty() {
+            thread::yield_now();
+        }
+        cancellation_token.cancel();
+
+        // ロックを保持したままでも、中断された要求はすぐに失敗する
+        assert_debug_fmt_eq!(Err::<(), _>(Error::Canceled), waiter.join().unwrap());
+        assert!(mutex.state.lock().unwrap().waiters.is_empty());
+        drop(guard);
+    }
+
+    #[rstest]
+    #[case(Some(CancellationToken::new()), None, Ok(()))]
+    #[case(Some(CancellationToken::canceled()), None, Err(Error::Canceled))]
+    #[case(None, Some(Duration::ZERO), Err(Error::TimedOut))]
+    #[case(None, Some(Duration::from_secs(60)), Ok(()))]
+    fn ensure_not_canceled_works(
+        #[case] cancellation_token: Option<CancellationToken>,
+        #[case] timeout: Option<Duration>,
+        #[case] expected: Result<()>,
+    ) {
+        let request = Request::default().with_cancellation(timeout, cancellation_token);
+        assert_debug_fmt_eq!(expected, request.ensure_not_canceled());
+    }
+}
@@ -1,15 +1,26 @@
 use super::*;
+use crate::scheduler::{PriorityMutex, Request};
 use once_cell::sync::Lazy;
 use onnxruntime::{
     environment::Environment,
     session::{AnyArray, Session},
     GraphOptimizationLevel, LoggingLevel,
 };
-use std::sync::Mutex;
-use std::{env, path::Path};
+use std::sync::{
+    atomic::{AtomicU64, Ordering},
+    Arc, RwLock,
+};
+use std::{env, path::Path, time::Instant};
 use tracing::error;
 
+mod length_buckets;
 mod model_file;
+mod session_registry;
+mod shared_model_dir;
+
+use self::length_buckets::LengthBuckets;
+use self::session_registry::{SessionKey, SharedSession};
+use self::shared_model_dir::SharedModelDir;
 
 cfg_if! {
     if #[cfg(not(feature="directml"))]{
@@ -19,24 +30,68 @@ cfg_if! {
 use std::collections::BTreeMap;
 
 pub struct Status {
-    models: StatusModels,
-    merged_metas: VoiceModelMeta,
+    // 推論中はセッションの`Arc`を取り出すときだけ読み取りロックを取る。書き込みロックを取るのは
+    // モデルの読み込み・解除でマップを書き換えるときだけで、セッションの構築中は取らない
+    loaded_models: RwLock<LoadedModels>,
     light_session_options: SessionOptions, // 軽いモデルはこちらを使う
     heavy_session_options: SessionOptions, // 重いモデルはこちらを使う
-    pub id_relations: BTreeMap<StyleId, (VoiceModelId, ModelInnerId)>, // FIXME: pubはやめたい
+    metrics: Metrics,
+    auto_load: Option<AutoLoad>,
+    /// 音声モデルが使われた順番を表すための時計。
+    lru_clock: AtomicU64,
+    /// プロセス間で共有する、復号済みの推論モデルの置き場。
+    shared_model_dir: Option<SharedModelDir>,
+    /// 音声波形の生成の入力の長さを揃える場合の、揃える長さ。
+    decode_length_buckets: Option<LengthBuckets>,
+    /// 推論セッションを、プロセス内の他の`Status`と共有するか。
+    share_sessions: bool,
+}
+
+#[derive(Default)]
+struct LoadedModels {
+    models: StatusModels,
+    merged_metas: VoiceModelMeta,
+    id_relations: BTreeMap<StyleId, (VoiceModelId, ModelInnerId)>,
+    residents: BTreeMap<VoiceModelId, Resident>,
+}
+
+/// 読み込まれている音声モデルの大きさと、最後に使われた時点。
+struct Resident {
+    bytes: u64,
+    /// `bytes`のうち、他の[`Status`]と推論セッションを共有しているもの。
+    shared_bytes: u64,
+    /// 自動で読み込まれたものか。自動で読み込まれたものだけが、メモリの上限のために解除される。
+    auto_loaded: bool,
+    last_used: AtomicU64,
+}
+
+/// 推論を要求されたスタイルの音声モデルを、必要になった時点で読み込むための設定。
+struct AutoLoad {
+    /// スタイルIDと、それを含む音声モデル。
+    models: BTreeMap<StyleId, VoiceModel>,
+    /// 読み込まれている推論モデルのバイト数の上限。
+    memory_budget: Option<u64>,
+    /// 同じ音声モデルを同時に読み込まないよう、自動での読み込みは一つずつ行う。
+    loading: tokio::sync::Mutex<()>,
 }
 
+#[derive(Default)]
 struct StatusModels {
     metas: BTreeMap<VoiceModelId, VoiceModelMeta>,
-    predict_duration: BTreeMap<VoiceModelId, Mutex<Session<'static>>>,
-    predict_intonation: BTreeMap<VoiceModelId, Mutex<Session<'static>>>,
-    decode: BTreeMap<VoiceModelId, Mutex<Session<'static>>>,
+    predict_duration: BTreeMap<VoiceModelId, Arc<PriorityMutex<Session<'static>>>>,
+    predict_intonation: BTreeMap<VoiceModelId, Arc<PriorityMutex<Session<'static>>>>,
+    decode: BTreeMap<VoiceModelId, Arc<PriorityMutex<Session<'static>>>>,
 }
 
 #[derive(new, Getters)]
 struct SessionOptions {
-    cpu_num_threads: u16,
+    intra_op_num_threads: u16,
+    inter_op_num_threads: u16,
     use_gpu: bool,
+    model_precision: ModelPrecision,
+    /// 入力の形ごとのメモリの割り当て計画(memory pattern)を使うか。入力の形が限られている場合に
+    /// だけ使う。
+    mem_pattern: bool,
 }
 
 #[derive(thiserror::Error, Debug)]
@@ -65,93 +120,272 @@ unsafe impl Send for Status {}
 unsafe impl Sync for Status {}
 
 impl Status {
-    pub fn new(use_gpu: bool, cpu_num_threads: u16) -> Self {
+    pub fn new(
+        use_gpu: bool,
+        light_session_threads: SessionThreadOptions,
+        heavy_session_threads: SessionThreadOptions,
+        model_precision: ModelPrecision,
+    ) -> Self {
+        let decode_length_buckets = LengthBuckets::from_env();
         Self {
-            models: StatusModels {
-                metas: BTreeMap::new(),
-                predict_duration: BTreeMap::new(),
-                predict_intonation: BTreeMap::new(),
-                decode: BTreeMap::new(),
-            },
-            merged_metas: VoiceModelMeta::default(),
-            light_session_options: SessionOptions::new(cpu_num_threads, false),
-            heavy_session_options: SessionOptions::new(cpu_num_threads, use_gpu),
-            id_relations: BTreeMap::default(),
+            loaded_models: RwLock::default(),
+            // 音素長・音高の推論の入力の形は音素の数ごとに異なるため、割り当て計画は使わない
+            light_session_options: SessionOptions::new(
+                light_session_threads.intra_op_num_threads,
+                light_session_threads.inter_op_num_threads,
+                false,
+                model_precision,
+                false,
+            ),
+            heavy_session_options: SessionOptions::new(
+                heavy_session_threads.intra_op_num_threads,
+                heavy_session_threads.inter_op_num_threads,
+                use_gpu,
+                // 量子化されたモデルはCPUでの推論向けのものなので、GPUでは使わない
+                if use_gpu {
+                    ModelPrecision::Fp32
+                } else {
+                    model_precision
+                },
+                // DirectMLでは割り当て計画を使えない
+                decode_length_buckets.is_some() && !(use_gpu && cfg!(feature = "directml")),
+            ),
+            metrics: Metrics::default(),
+            auto_load: None,
+            lru_clock: AtomicU64::new(0),
+            shared_model_dir: SharedModelDir::from_env(),
+            decode_length_buckets,
+            share_sessions: false,
         }
     }
 
-    pub async fn load_model(&mut self, model: &VoiceModel) -> Result<()> {
-        for speaker in model.metas().iter() {
-            for style in speaker.styles().iter() {
-                if self.id_relations.contains_key(style.id()) {
-                    Err(Error::AlreadyLoadedModel {
-                        path: model.path().clone(),
-                    })?;
-                }
-            }
-        }
-        let models = model.read_inference_models().await?;
+    /// 推論セッションを、同じ内容の推論モデルを同じ設定で読み込んだプロセス内の他の`Status`と
+    /// 共有する。共有した推論セッションでの推論は、`Status`をまたいで一つずつ行われる。
+    pub fn enable_session_sharing(&mut self) {
+        self.share_sessions = true;
+    }
 
-        let predict_duration_session = self.new_session(
+    /// `models`に含まれるスタイルの推論を要求されたときに、その音声モデルを自動で読み込む。
+    ///
+    /// 自動で読み込まれた音声モデルは、読み込まれている推論モデルの合計が`memory_budget`バイトを
+    /// 超える場合に、最も長く使われていないものから読み込みを解除される。推論モデルのバイト数は
+    /// 推論セッションが実際に使うメモリの目安である。
+    pub fn enable_auto_load(&mut self, models: Vec<VoiceModel>, memory_budget: Option<u64>) {
+        let models = models
+            .into_iter()
+            .flat_map(|model| {
+                model
+                    .metas()
+                    .iter()
+                    .flat_map(|speaker| speaker.styles())
+                    .map(|style| (*style.id(), model.clone()))
+                    .collect::<Vec<_>>()
+            })
+            .collect();
+        self.auto_load = Some(AutoLoad {
+            models,
+            memory_budget,
+            loading: Default::default(),
+        });
+    }
+
+    pub async fn load_model(&self, model: &VoiceModel) -> Result<()> {
+        self.load_model_with(model, false).await
+    }
+
+    async fn load_model_with(&self, model: &VoiceModel, auto_loaded: bool) -> Result<()> {
+        self.ensure_not_loaded(&self.loaded_models.read().unwrap(), model)?;
+
+        let start = Instant::now();
+        let models = model
+            .read_inference_models(
+                self.light_session_options.model_precision,
+                self.heavy_session_options.model_precision,
+            )
+            .await?;
+        let bytes = [
             models.predict_duration_model(),
-            &self.light_session_options,
-            model.path(),
-        )?;
-        let predict_intonation_session = self.new_session(
             models.predict_intonation_model(),
-            &self.light_session_options,
-            model.path(),
-        )?;
-        let decode_model = self.new_session(
             models.decode_model(),
-            &self.heavy_session_options,
-            model.path(),
+        ]
+        .iter()
+        .map(|model| model.len() as u64)
+        .sum();
+
+        // 新しいセッションを構築する前に、上限に収まるよう使われていない音声モデルを解除する
+        if let Some(memory_budget) = self.auto_load.as_ref().and_then(|a| a.memory_budget) {
+            self.evict(memory_budget.saturating_sub(bytes));
+        }
+
+        let mut shared_bytes = 0;
+        let mut shared_session = |model_bytes: &[u8], session_options: &SessionOptions| {
+            let new_session = || self.new_session(model_bytes, session_options, model.path());
+            if !self.share_sessions {
+                return Ok(Arc::new(PriorityMutex::new(new_session()?)));
+            }
+            let key = SessionKey::new(model_bytes, session_options);
+            let (session, shared) = session_registry::get_or_try_insert_with(key, new_session)?;
+            if shared {
+                shared_bytes += model_bytes.len() as u64;
+            }
+            Ok::<_, Error>(session)
+        };
+        let predict_duration_session =
+            shared_session(models.predict_duration_model(), &self.light_session_options)?;
+        let predict_intonation_session = shared_session(
+            models.predict_intonation_model(),
+            &self.light_session_options,
         )?;
-        self.models
+        let decode_session = shared_session(models.decode_model(), &self.heavy_session_options)?;
+
+        let loaded_models = &mut *self.loaded_models.write().unwrap();
+        // セッションの構築中に同じモデルが読み込まれている可能性があるため、もう一度確かめる
+        self.ensure_not_loaded(loaded_models, model)?;
+
+        loaded_models
+            .models
             .metas
             .insert(model.id().clone(), model.metas().clone());
 
         for speaker in model.metas().iter() {
             for style in speaker.styles().iter() {
-                self.id_relations.insert(
+                loaded_models.id_relations.insert(
                     *style.id(),
                     (model.id().clone(), model.model_inner_id_for(*style.id())),
                 );
             }
         }
-        self.set_metas();
+        loaded_models.set_metas();
 
-        self.models
+        loaded_models
+            .models
             .predict_duration
-            .insert(model.id().clone(), Mutex::new(predict_duration_session));
-        self.models
+            .insert(model.id().clone(), predict_duration_session);
+        loaded_models
+            .models
             .predict_intonation
-            .insert(model.id().clone(), Mutex::new(predict_intonation_session));
+            .insert(model.id().clone(), predict_intonation_session);
 
-        self.models
+        loaded_models
+            .models
             .decode
-            .insert(model.id().clone(), Mutex::new(decode_model));
+            .insert(model.id().clone(), decode_session);
+
+        loaded_models.residents.insert(
+            model.id().clone(),
+            Resident {
+                bytes,
+                shared_bytes,
+                auto_loaded,
+                last_used: AtomicU64::new(self.lru_clock.fetch_add(1, Ordering::Relaxed)),
+            },
+        );
+        self.metrics
+            .record_model_load(start.elapsed(), bytes, shared_bytes);
 
         Ok(())
     }
 
-    pub fn unload_model(&mut self, voice_model_id: &VoiceModelId) -> Result<()> {
-        if self.is_loaded_model(voice_model_id) {
-            self.models.predict_intonation.remove(voice_model_id);
-            self.models.predict_duration.remove(voice_model_id);
-            self.models.decode.remove(voice_model_id);
+    /// スタイルIDに対応する音素長の推論セッションと、モデル内IDを返す。
+    ///
+    /// 読み込まれていない音声モデルは[`Self::session_or_load`]のとおり読み込む。
+    pub(crate) async fn predict_duration_session(
+        &self,
+        style_id: StyleId,
+    ) -> Result<(SharedSession, ModelInnerId)> {
+        self.session_or_load(style_id, |models| &models.predict_duration)
+            .await
+    }
 
-            let remove_style_ids = self
-                .id_relations
-                .iter()
-                .filter(|&(_, (loaded_model_id, _))| loaded_model_id == voice_model_id)
-                .map(|(&style_id, _)| style_id)
-                .collect::<Vec<_>>();
+    /// スタイルIDに対応する音高の推論セッションと、モデル内IDを返す。
+    ///
+    /// 読み込まれていない音声モデルは[`Self::session_or_load`]のとおり読み込む。
+    pub(crate) async fn predict_intonation_session(
+        &self,
+        style_id: StyleId,
+    ) -> Result<(SharedSession, ModelInnerId)> {
+        self.session_or_load(style_id, |models| &models.predict_intonation)
+            .await
+    }
+
+    /// スタイルIDに対応する音声波形の生成の推論セッションと、モデル内IDを返す。
+    ///
+    /// 読み込まれていない音声モデルは[`Self::session_or_load`]のとおり読み込む。
+    pub(crate) async fn decode_session(
+        &self,
+        style_id: StyleId,
+    ) -> Result<(SharedSession, ModelInnerId)> {
+        self.session_or_load(style_id, |models| &models.decode)
+            .await
+    }
+
+    /// スタイルIDに対応する推論セッションと、モデル内IDを返す。
+    ///
+    /// 自動での読み込みが有効であれば、読み込まれていない音声モデルはここで読み込む。音声モデルの
+    /// 特定とセッションの取り出しは同じ読み取りロックの中で行うため、その間に他の要求の自動での
+    /// 読み込みによって音声モデルが解除されることはない。解除された後の処理段階では、もう一度
+    /// 読み込む。
+    async fn session_or_load(
+        &self,
+        style_id: StyleId,
+        sessions: impl Fn(&StatusModels) -> &BTreeMap<VoiceModelId, SharedSession>,
+    ) -> Result<(SharedSession, ModelInnerId)> {
+        if let Some(session) = self.loaded_session(style_id, &sessions) {
+            return Ok(session);
+        }
+        let (auto_load, model) = self
+            .auto_load
+            .as_ref()
+            .and_then(|auto_load| Some((auto_load, auto_load.models.get(&style_id)?)))
+            .ok_or(Error::InvalidStyleId { style_id })?;
+
+        let _loading = auto_load.loading.lock().await;
+        // 順番を待っている間に、他の要求によって読み込まれている可能性がある
+        if let Some(session) = self.loaded_session(style_id, &sessions) {
+            return Ok(session);
+        }
+        self.load_model_with(model, true).await?;
+        // 自動での読み込みは一つずつ行うため、読み込んでから取り出すまでの間に他の要求によって解除
+        // されることはない
+        self.loaded_session(style_id, &sessions)
+            .ok_or(Error::InvalidStyleId { style_id })
+    }
+
+    /// 読み込まれている推論モデルの合計が`memory_budget`バイト以下になるまで、自動で読み込まれた
+    /// 音声モデルを最も長く使われていないものから解除する。
+    fn evict(&self, memory_budget: u64) {
+        let loaded_models = &mut *self.loaded_models.write().unwrap();
+        for model_id in loaded_models.eviction_candidates(memory_budget) {
+            if let Some(resident) = loaded_models.remove(&model_id) {
+                self.metrics
+                    .record_model_unload(resident.bytes, resident.shared_bytes, true);
+            }
+        }
+    }
 
-            for style_id in remove_style_ids.iter() {
-                self.id_relations.remove(style_id);
+    fn ensure_not_loaded(&self, loaded_models: &LoadedModels, model: &VoiceModel) -> Result<()> {
+        for speaker in model.metas().iter() {
+            for style in speaker.styles().iter() {
+                if loaded_models.id_relations.contains_key(style.id()) {
+                    Err(Error::AlreadyLoadedModel {
+                        path: model.path().clone(),
+                    })?;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// モデルの読み込みを解除する。
+    ///
+    /// 推論中のセッションは、その推論が終わった時点で解放される。
+    pub fn unload_model(&self, voice_model_id: &VoiceModelId) -> Result<()> {
+        let loaded_models = &mut *self.loaded_models.write().unwrap();
+        if loaded_models.is_loaded_model(voice_model_id) {
+            if let Some(resident) = loaded_models.remove(voice_model_id) {
+                self.metrics
+                    .record_model_unload(resident.bytes, resident.shared_bytes, false);
             }
-            self.set_metas();
             Ok(())
         } else {
             Err(Error::UnloadedModel {
@@ -160,26 +394,19 @@ impl Status {
         }
     }
 
-    fn set_metas(&mut self) {
-        let mut meta = VoiceModelMeta::default();
-        for m in self.models.metas.values() {
-            meta.extend_from_slice(m);
-        }
-        self.merged_metas = meta;
-    }
-
-    pub fn metas(&self) -> &VoiceModelMeta {
-        &self.merged_metas
+    pub fn metas(&self) -> VoiceModelMeta {
+        self.loaded_models.read().unwrap().merged_metas.clone()
     }
 
     pub fn is_loaded_model(&self, voice_model_id: &VoiceModelId) -> bool {
-        self.models.predict_duration.contains_key(voice_model_id)
-            && self.models.predict_intonation.contains_key(voice_model_id)
-            && self.models.decode.contains_key(voice_model_id)
+        self.loaded_models
+            .read()
+            .unwrap()
+            .is_loaded_model(voice_model_id)
     }
 
     pub fn is_loaded_model_by_style_id(&self, style_id: StyleId) -> bool {
-        self.id_relations.contains_key(&style_id)
+        self.validate_speaker_id(style_id)
     }
 
     fn new_session(
@@ -188,29 +415,41 @@ impl Status {
         session_options: &SessionOptions,
         path: impl AsRef<Path>,
     ) -> Result<Session<'static>> {
-        self.new_session_from_bytes(|| model_file::decrypt(model), session_options)
-            .map_err(|source| Error::LoadModel {
-                path: path.as_ref().into(),
-                source,
-            })
+        let session = match &self.shared_model_dir {
+            Some(shared_model_dir) => shared_model_dir
+                .map(model)
+                .and_then(|mmap| self.new_session_from_bytes(|| Ok(&*mmap), session_options)),
+            None => self.new_session_from_bytes(|| model_file::decrypt(model), session_options),
+        };
+        session.map_err(|source| Error::LoadModel {
+            path: path.as_ref().into(),
+            source,
+        })
     }
 
-    fn new_session_from_bytes(
+    fn new_session_from_bytes<B: AsRef<[u8]>>(
         &self,
-        model_bytes: impl FnOnce() -> std::result::Result<Vec<u8>, DecryptModelError>,
+        model_bytes: impl FnOnce() -> std::result::Result<B, DecryptModelError>,
         session_options: &SessionOptions,
     ) -> anyhow::Result<Session<'static>> {
         let session_builder = ENVIRONMENT
             .new_session_builder()?
             .with_optimization_level(GraphOptimizationLevel::Basic)?
-            .with_intra_op_num_threads(*session_options.cpu_num_threads() as i32)?
-            .with_inter_op_num_threads(*session_options.cpu_num_threads() as i32)?;
+            .with_intra_op_num_threads(*session_options.intra_op_num_threads() as i32)?
+            .with_inter_op_num_threads(*session_options.inter_op_num_threads() as i32)?;
+
+        // CPUのメモリアリーナはONNX Runtimeの既定のとおり使う。割り当て計画は、入力の形が一定しない
+        // 場合には形ごとに溜まり続けるだけになるため、使わない場合は明示的に無効にする
+        let session_builder = if *session_options.mem_pattern() {
+            session_builder
+        } else {
+            session_builder.with_disable_mem_pattern()?
+        };
 
         let session_builder = if *session_options.use_gpu() {
             cfg_if! {
                 if #[cfg(feature = "directml")]{
                     session_builder
-                        .with_disable_mem_pattern()?
                         .with_execution_mode(onnxruntime::ExecutionMode::ORT_SEQUENTIAL)?
                         .with_append_execution_provider_directml(0)?
                 } else {
@@ -225,62 +464,165 @@ impl Status {
         Ok(session_builder.with_model_from_memory(model_bytes()?)?)
     }
 
+    /// 音声波形の生成の入力の長さ`length`を、揃える長さに切り上げる。揃えない場合はそのまま返す。
+    pub fn decode_length(&self, length: usize) -> usize {
+        self.decode_length_buckets
+            .as_ref()
+            .map_or(length, |buckets| buckets.round_up(length))
+    }
+
+    pub(crate) fn metrics(&self) -> &Metrics {
+        &self.metrics
+    }
+
     pub fn validate_speaker_id(&self, style_id: StyleId) -> bool {
-        self.id_relations.contains_key(&style_id)
+        self.loaded_models
+            .read()
+            .unwrap()
+            .id_relations
+            .contains_key(&style_id)
     }
 
-    pub fn predict_duration_session_run(
+    /// 読み込まれているセッションを、スタイルIDに対応するモデル内IDと共に取り出す。取り出した後は
+    /// ロックを取らずに推論できる。
+    fn loaded_session(
         &self,
-        model_id: &VoiceModelId,
+        style_id: StyleId,
+        sessions: impl FnOnce(&StatusModels) -> &BTreeMap<VoiceModelId, SharedSession>,
+    ) -> Option<(SharedSession, ModelInnerId)> {
+        let loaded_models = self.loaded_models.read().unwrap();
+        let (model_id, model_inner_id) = loaded_models.id_relations.get(&style_id)?;
+        if let Some(resident) = loaded_models.residents.get(model_id) {
+            let now = self.lru_clock.fetch_add(1, Ordering::Relaxed);
+            resident.last_used.store(now, Ordering::Relaxed);
+        }
+        let session = sessions(&loaded_models.models).get(model_id)?.clone();
+        Some((session, *model_inner_id))
+    }
+
+    pub(crate) fn predict_duration_session_run(
+        &self,
+        session: &PriorityMutex<Session<'static>>,
         inputs: Vec<&mut dyn AnyArray>,
+        request: &Request,
     ) -> Result<Vec<f32>> {
-        if let Some(model) = self.models.predict_duration.get(model_id) {
-            if let Ok(output_tensors) = model.lock().unwrap().run(inputs) {
-                Ok(output_tensors[0].as_slice().unwrap().to_owned())
-            } else {
-                Err(Error::InferenceFailed)
-            }
-        } else {
-            Err(Error::InvalidModelId {
-                model_id: model_id.clone(),
-            })
-        }
+        let mut model = self.metrics.lock_prioritized(
+            LockedResource::PredictDurationSession,
+            session,
+            request,
+        )?;
+        run_session(
+            &mut model,
+            inputs,
+            LockedResource::PredictDurationSession,
+            request,
+        )
     }
 
-    pub fn predict_intonation_session_run(
+    pub(crate) fn predict_intonation_session_run(
         &self,
-        model_id: &VoiceModelId,
+        session: &PriorityMutex<Session<'static>>,
         inputs: Vec<&mut dyn AnyArray>,
+        request: &Request,
     ) -> Result<Vec<f32>> {
-        if let Some(model) = self.models.predict_intonation.get(model_id) {
-            if let Ok(output_tensors) = model.lock().unwrap().run(inputs) {
-                Ok(output_tensors[0].as_slice().unwrap().to_owned())
-            } else {
-                Err(Error::InferenceFailed)
-            }
-        } else {
-            Err(Error::InvalidModelId {
-                model_id: model_id.clone(),
-            })
-        }
+        let mut model = self.metrics.lock_prioritized(
+            LockedResource::PredictIntonationSession,
+            session,
+            request,
+        )?;
+        run_session(
+            &mut model,
+            inputs,
+            LockedResource::PredictIntonationSession,
+            request,
+        )
     }
 
-    pub fn decode_session_run(
+    pub(crate) fn decode_session_run(
         &self,
-        model_id: &VoiceModelId,
+        session: &PriorityMutex<Session<'static>>,
         inputs: Vec<&mut dyn AnyArray>,
+        request: &Request,
     ) -> Result<Vec<f32>> {
-        if let Some(model) = self.models.decode.get(model_id) {
-            if let Ok(output_tensors) = model.lock().unwrap().run(inputs) {
-                Ok(output_tensors[0].as_slice().unwrap().to_owned())
-            } else {
-                Err(Error::InferenceFailed)
-            }
-        } else {
-            Err(Error::InvalidModelId {
-                model_id: model_id.clone(),
-            })
+        let mut model =
+            self.metrics
+                .lock_prioritized(LockedResource::DecodeSession, session, request)?;
+        run_session(&mut model, inputs, LockedResource::DecodeSession, request)
+    }
+}
+
+/// 推論を行う。`request`が記録の対象であれば、その区間をトレースに記録する。
+fn run_session(
+    session: &mut Session<'static>,
+    inputs: Vec<&mut dyn AnyArray>,
+    resource: LockedResource,
+    request: &Request,
+) -> Result<Vec<f32>> {
+    let start = Instant::now();
+    let output_tensors = session.run(inputs);
+    if let Some(trace) = request.trace() {
+        trace.record("session_run", resource.into(), start);
+    }
+    if let Ok(output_tensors) = output_tensors {
+        Ok(output_tensors[0].as_slice().unwrap().to_owned())
+    } else {
+        Err(Error::InferenceFailed)
+    }
+}
+
+impl LoadedModels {
+    fn set_metas(&mut self) {
+        let mut meta = VoiceModelMeta::default();
+        for m in self.models.metas.values() {
+            meta.extend_from_slice(m);
         }
+        self.merged_metas = meta;
+    }
+
+    fn is_loaded_model(&self, voice_model_id: &VoiceModelId) -> bool {
+        self.models.predict_duration.contains_key(voice_model_id)
+            && self.models.predict_intonation.contains_key(voice_model_id)
+            && self.models.decode.contains_key(voice_model_id)
+    }
+
+    /// 音声モデルを取り除く。推論中のセッションは、その推論が終わった時点で解放される。
+    fn remove(&mut self, voice_model_id: &VoiceModelId) -> Option<Resident> {
+        self.models.predict_intonation.remove(voice_model_id);
+        self.models.predict_duration.remove(voice_model_id);
+        self.models.decode.remove(voice_model_id);
+        self.models.metas.remove(voice_model_id);
+        self.id_relations
+            .retain(|_, (loaded_model_id, _)| loaded_model_id != voice_model_id);
+        self.set_metas();
+        self.residents.remove(voice_model_id)
+    }
+
+    /// 合計を`memory_budget`バイト以下にするために解除する、自動で読み込まれた音声モデル。
+    ///
+    /// 最も長く使われていないものから順に選ぶ。手動で読み込まれたものだけで上限を超えている場合は、
+    /// 上限を超えたままとなる。
+    fn eviction_candidates(&self, memory_budget: u64) -> Vec<VoiceModelId> {
+        let mut total = self.residents.values().map(|r| r.bytes).sum::<u64>();
+        let mut candidates = self
+            .residents
+            .iter()
+            .filter(|(_, resident)| resident.auto_loaded)
+            .map(|(model_id, resident)| {
+                let last_used = resident.last_used.load(Ordering::Relaxed);
+                (last_used, resident.bytes, model_id)
+            })
+            .collect::<Vec<_>>();
+        candidates.sort_unstable_by_key(|&(last_used, ..)| last_used);
+
+        candidates
+            .into_iter()
+            .take_while(|&(_, bytes, _)| {
+                let over = total > memory_budget;
+                total -= bytes;
+                over
+            })
+            .map(|(_, _, model_id)| model_id.clone())
+            .collect()
     }
 }
 
@@ -292,46 +634,110 @@ mod tests {
     use pretty_assertions::assert_eq;
 
     #[rstest]
-    #[case(true, 0)]
-    #[case(true, 1)]
-    #[case(true, 8)]
-    #[case(false, 2)]
-    #[case(false, 4)]
-    #[case(false, 8)]
-    #[case(false, 0)]
-    fn status_new_works(#[case] use_gpu: bool, #[case] cpu_num_threads: u16) {
-        let status = Status::new(use_gpu, cpu_num_threads);
+    #[case(true, (0, 0), (0, 0))]
+    #[case(true, (1, 1), (1, 1))]
+    #[case(true, (8, 8), (8, 8))]
+    #[case(false, (2, 2), (2, 2))]
+    #[case(false, (4, 4), (4, 4))]
+    #[case(false, (8, 8), (8, 8))]
+    #[case(false, (0, 0), (0, 0))]
+    #[case(false, (1, 1), (4, 2))]
+    #[case(true, (2, 1), (8, 1))]
+    fn status_new_works(
+        #[case] use_gpu: bool,
+        #[case] (light_intra, light_inter): (u16, u16),
+        #[case] (heavy_intra, heavy_inter): (u16, u16),
+    ) {
+        let status = Status::new(
+            use_gpu,
+            SessionThreadOptions {
+                intra_op_num_threads: light_intra,
+                inter_op_num_threads: light_inter,
+            },
+            SessionThreadOptions {
+                intra_op_num_threads: heavy_intra,
+                inter_op_num_threads: heavy_inter,
+            },
+            Default::default(),
+        );
         assert_eq!(false, status.light_session_options.use_gpu);
         assert_eq!(use_gpu, status.heavy_session_options.use_gpu);
+        assert_eq!(false, status.light_session_options.mem_pattern);
+        assert_eq!(
+            light_intra,
+            status.light_session_options.intra_op_num_threads
+        );
+        assert_eq!(
+            light_inter,
+            status.light_session_options.inter_op_num_threads
+        );
         assert_eq!(
-            cpu_num_threads,
-            status.light_session_options.cpu_num_threads
+            heavy_intra,
+            status.heavy_session_options.intra_op_num_threads
         );
         assert_eq!(
-            cpu_num_threads,
-            status.heavy_session_options.cpu_num_threads
+            heavy_inter,
+            status.heavy_session_options.inter_op_num_threads
+        );
+        let loaded_models = status.loaded_models.read().unwrap();
+        assert!(loaded_models.models.predict_duration.is_empty());
+        assert!(loaded_models.models.predict_intonation.is_empty());
+        assert!(loaded_models.models.decode.is_empty());
+        assert!(loaded_models.id_relations.is_empty());
+    }
+
+    #[rstest]
+    #[case(false, ModelPrecision::Fp32, ModelPrecision::Fp32)]
+    #[case(false, ModelPrecision::Int8, ModelPrecision::Int8)]
+    #[case(false, ModelPrecision::Fp16, ModelPrecision::Fp16)]
+    #[case(true, ModelPrecision::Int8, ModelPrecision::Fp32)]
+    fn status_new_model_precision_works(
+        #[case] use_gpu: bool,
+        #[case] model_precision: ModelPrecision,
+        #[case] expected_heavy_precision: ModelPrecision,
+    ) {
+        let status = Status::new(
+            use_gpu,
+            Default::default(),
+            Default::default(),
+            model_precision,
+        );
+        assert_eq!(
+            model_precision,
+            status.light_session_options.model_precision
+        );
+        assert_eq!(
+            expected_heavy_precision,
+            status.heavy_session_options.model_precision
         );
-        assert!(status.models.predict_duration.is_empty());
-        assert!(status.models.predict_intonation.is_empty());
-        assert!(status.models.decode.is_empty());
-        assert!(status.id_relations.is_empty());
     }
 
     #[rstest]
     #[tokio::test]
     async fn status_load_model_works() {
-        let mut status = Status::new(false, 0);
+        let status = Status::new(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+        );
         let result = status.load_model(&open_default_vvm_file().await).await;
         assert_debug_fmt_eq!(Ok(()), result);
-        assert_eq!(1, status.models.predict_duration.len());
-        assert_eq!(1, status.models.predict_intonation.len());
-        assert_eq!(1, status.models.decode.len());
+        let loaded_models = status.loaded_models.read().unwrap();
+        assert_eq!(1, loaded_models.models.predict_duration.len());
+        assert_eq!(1, loaded_models.models.predict_intonation.len());
+        assert_eq!(1, loaded_models.models.decode.len());
     }
 
     #[rstest]
     #[tokio::test]
     async fn status_is_model_loaded_works() {
-        let mut status = Status::new(false, 0);
+        let status = Status::new(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+        );
         let vvm = open_default_vvm_file().await;
         assert!(
             !status.is_loaded_model(vvm.id()),
@@ -341,4 +747,157 @@ mod tests {
         assert_debug_fmt_eq!(Ok(()), result);
         assert!(status.is_loaded_model(vvm.id()), "model should be loaded");
     }
+
+    #[rstest]
+    #[case(true)]
+    #[case(false)]
+    #[tokio::test]
+    async fn status_shares_sessions_between_instances_if_enabled(#[case] share_sessions: bool) {
+        let new_status = || {
+            let mut status = Status::new(
+                false,
+                Default::default(),
+                Default::default(),
+                Default::default(),
+            );
+            if share_sessions {
+                status.enable_session_sharing();
+            }
+            status
+        };
+        let (status1, status2) = (new_status(), new_status());
+        let vvm = open_default_vvm_file().await;
+        status1.load_model(&vvm).await.unwrap();
+        status2.load_model(&vvm).await.unwrap();
+
+        let decode_session = |status: &Status| {
+            status
+                .loaded_session(StyleId::new(1), |models| &models.decode)
+                .unwrap()
+                .0
+        };
+        assert_eq!(
+            share_sessions,
+            Arc::ptr_eq(&decode_session(&status1), &decode_session(&status2)),
+        );
+        let stats = status2.metrics().snapshot();
+        let expected_shared_model_bytes = if share_sessions {
+            stats.resident_model_bytes.current
+        } else {
+            0
+        };
+        assert_eq!(
+            expected_shared_model_bytes,
+            stats.shared_model_bytes.current
+        );
+    }
+
+    #[rstest]
+    #[tokio::test]
+    async fn status_auto_load_works() {
+        let mut status = Status::new(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+        );
+        let vvm = open_default_vvm_file().await;
+        status.enable_auto_load(vec![vvm.clone()], Some(1));
+
+        let result = status
+            .decode_session(StyleId::new(1))
+            .await
+            .map(|(_, model_inner_id)| model_inner_id);
+        assert_debug_fmt_eq!(Ok(ModelInnerId::new(1)), result);
+        assert!(status.is_loaded_model(vvm.id()));
+        let stats = status.metrics().snapshot();
+        assert_eq!(1, stats.model_loads.count);
+        assert!(stats.resident_model_bytes.current > 0);
+
+        let result = status
+            .decode_session(StyleId::new(9999))
+            .await
+            .map(|(_, model_inner_id)| model_inner_id);
+        assert_debug_fmt_eq!(
+            Err::<ModelInnerId, _>(Error::InvalidStyleId {
+                style_id: StyleId::new(9999)
+            }),
+            result,
+        );
+    }
+
+    #[rstest]
+    #[tokio::test(flavor = "multi_thread", worker_threads = 4)]
+    async fn status_auto_load_survives_concurrent_eviction() {
+        const STYLE_ID_OFFSET: u32 = 1000;
+
+        let mut status = Status::new(
+            false,
+            Default::default(),
+            Default::default(),
+            Default::default(),
+        );
+        let vvm1 = open_default_vvm_file().await;
+        let vvm2 = open_vvm_file_with_style_id_offset(STYLE_ID_OFFSET).await;
+        // 上限が音声モデル一つ分にも満たないため、一方を読み込むたびにもう一方は解除される
+        status.enable_auto_load(vec![vvm1, vvm2], Some(1));
+        let status = Arc::new(status);
+
+        let tasks = (0..8)
+            .map(|i| {
+                let status = status.clone();
+                let style_id = StyleId::new(1 + STYLE_ID_OFFSET * (i % 2));
+                tokio::spawn(async move {
+                    // 一つの音声合成のように、処理段階ごとにセッションを取り出す
+                    for _ in 0..10 {
+                        status.predict_duration_session(style_id).await?;
+                        status.predict_intonation_session(style_id).await?;
+                        status.decode_session(style_id).await?;
+                    }
+                    Ok::<_, Error>(())
+                })
+            })
+            .collect::<Vec<_>>();
+        for task in tasks {
+            assert_debug_fmt_eq!(Ok(()), task.await.unwrap());
+        }
+
+        assert_eq!(1, status.loaded_models.read().unwrap().residents.len());
+        assert!(status.metrics().snapshot().model_loads.count > 2);
+    }
+
+    #[rstest]
+    #[case(300, &[])]
+    #[case(250, &["b"])]
+    #[case(150, &["b", "d"])]
+    #[case(0, &["b", "d", "c"])]
+    fn eviction_candidates_works(#[case] memory_budget: u64, #[case] expected: &[&str]) {
+        let mut loaded_models = LoadedModels::default();
+        // (ID, バイト数, 自動で読み込まれたか, 最後に使われた時点)
+        for (model_id, bytes, auto_loaded, last_used) in [
+            ("a", 100, false, 0),
+            ("b", 50, true, 1),
+            ("c", 50, true, 4),
+            ("d", 100, true, 2),
+        ] {
+            loaded_models.residents.insert(
+                VoiceModelId::new(model_id.to_owned()),
+                Resident {
+                    bytes,
+                    shared_bytes: 0,
+                    auto_loaded,
+                    last_used: AtomicU64::new(last_used),
+                },
+            );
+        }
+
+        let candidates = loaded_models.eviction_candidates(memory_budget);
+        assert_eq!(
+            expected,
+            candidates
+                .iter()
+                .map(|id| &**id.raw_voice_model_id())
+                .collect::<Vec<_>>(),
+        );
+    }
 }
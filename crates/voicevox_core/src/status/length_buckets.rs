@@ -0,0 +1,121 @@
+//! 音声波形の生成の入力の長さを、決まった長さのいずれかに切り上げる。
+//!
+//! 音声波形の生成モデルの入力の形は、文のフレーム数ごとに異なる。形が毎回異なると、ONNX Runtimeの
+//! メモリアリーナには様々な大きさの領域が確保されて断片化し、入力の形ごとのメモリの割り当て計画
+//! (memory pattern)も溜まり続けるため、メモリの使用量が長期間にわたって増え続ける。入力の後ろに
+//! 無音を足して長さを少数の長さに揃え、出力から足した分を切り落とすことで、確保される領域の大きさと
+//! 割り当て計画の数を限られたものにする。
+//!
+//! 揃える長さは環境変数`VV_DECODE_LENGTH_BUCKETS`に、フレーム数のカンマ区切りで指定する。空にすると
+//! 長さを揃えない。
+
+use std::env;
+
+use anyhow::ensure;
+use tracing::warn;
+
+const ENV_NAME: &str = "VV_DECODE_LENGTH_BUCKETS";
+
+/// 既定の長さ。およそ1.5倍ずつ増やし、切り上げて増える分を元の長さの半分以下に抑える。
+const DEFAULT: &[usize] = &[128, 192, 256, 384, 512, 768, 1024, 1536, 2048];
+
+/// 揃える長さの一覧。昇順で、空ではない。
+#[derive(PartialEq, Debug)]
+pub(super) struct LengthBuckets(Vec<usize>);
+
+impl LengthBuckets {
+    /// 環境変数`VV_DECODE_LENGTH_BUCKETS`で指定された長さ。指定されていなければ既定の長さ、
+    /// 空であれば`None`。
+    pub(super) fn from_env() -> Option<Self> {
+        let Ok(buckets) = env::var(ENV_NAME) else {
+            return Some(Self::default());
+        };
+        Self::parse(&buckets).unwrap_or_else(|err| {
+            warn!("`{ENV_NAME}`を解釈できないため、既定の長さを使います: {err}");
+            Some(Self::default())
+        })
+    }
+
+    fn parse(buckets: &str) -> anyhow::Result<Option<Self>> {
+        if buckets.trim().is_empty() {
+            return Ok(None);
+        }
+        let mut buckets = buckets
+            .split(',')
+            .map(|bucket| bucket.trim().parse())
+            .collect::<Result<Vec<usize>, _>>()?;
+        ensure!(!buckets.contains(&0), "長さに0は指定できません");
+        buckets.sort_unstable();
+        buckets.dedup();
+        Ok(Some(Self(buckets)))
+    }
+
+    /// `length`以上で最短の長さ。最も長いものより長い場合は、最も長いものから1.5倍ずつ増やして
+    /// いき、増える分を元の長さの半分以下に抑える。
+    pub(super) fn round_up(&self, length: usize) -> usize {
+        match self.0.iter().find(|&&bucket| bucket >= length) {
+            Some(&bucket) => bucket,
+            None => {
+                let mut bucket = *self.0.last().unwrap();
+                while bucket < length {
+                    bucket += (bucket + 1) / 2;
+                }
+                bucket
+            }
+        }
+    }
+}
+
+impl Default for LengthBuckets {
+    fn default() -> Self {
+        Self(DEFAULT.to_owned())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use rstest::rstest;
+
+    use super::*;
+
+    #[rstest]
+    #[case("", None)]
+    #[case(" ", None)]
+    #[case("256", Some(vec![256]))]
+    #[case("512, 128,256,128", Some(vec![128, 256, 512]))]
+    fn parse_works(#[case] buckets: &str, #[case] expected: Option<Vec<usize>>) {
+        assert_eq!(
+            expected.map(LengthBuckets),
+            LengthBuckets::parse(buckets).unwrap(),
+        );
+    }
+
+    #[rstest]
+    #[case("128,")]
+    #[case("128,0")]
+    #[case("-1")]
+    fn parse_fails(#[case] buckets: &str) {
+        assert!(LengthBuckets::parse(buckets).is_err());
+    }
+
+    #[rstest]
+    #[case(1, 128)]
+    #[case(128, 128)]
+    #[case(129, 192)]
+    #[case(2048, 2048)]
+    #[case(2049, 3072)]
+    #[case(3072, 3072)]
+    #[case(3073, 4608)]
+    #[case(6000, 6912)]
+    fn round_up_works(#[case] length: usize, #[case] expected: usize) {
+        assert_eq!(expected, LengthBuckets::default().round_up(length));
+    }
+
+    #[rstest]
+    #[case(1, 1)]
+    #[case(2, 2)]
+    #[case(4, 5)]
+    fn round_up_grows_past_short_buckets(#[case] length: usize, #[case] expected: usize) {
+        assert_eq!(expected, LengthBuckets(vec![1]).round_up(length));
+    }
+}
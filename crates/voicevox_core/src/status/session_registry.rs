@@ -0,0 +1,115 @@
+//! 同じ推論モデルから構築した推論セッションを、プロセス内の[`Status`]同士で共有する。
+//!
+//! [`Status`]: super::Status
+
+use super::{PriorityMutex, Result, SessionOptions};
+use once_cell::sync::Lazy;
+use onnxruntime::session::Session;
+use sha2::{Digest as _, Sha256};
+use std::{
+    collections::HashMap,
+    sync::{Arc, Mutex, Weak},
+};
+
+/// 推論セッション。音声モデルの読み込みが解除されても、取り出したものは推論が終わるまで使える。
+pub(crate) type SharedSession = Arc<PriorityMutex<Session<'static>>>;
+
+/// 推論セッションを共有してよいかを決めるキー。
+///
+/// 推論モデルの中身と、セッションの構築に使う設定から作る。モデルの精度は推論モデルの中身に
+/// 含まれる。衝突すると別のモデルで推論することになるため、中身はSHA-256で区別する。
+#[derive(PartialEq, Eq, Hash, Clone, Copy, Debug)]
+pub(super) struct SessionKey {
+    content_digest: [u8; 32],
+    intra_op_num_threads: u16,
+    inter_op_num_threads: u16,
+    use_gpu: bool,
+    mem_pattern: bool,
+}
+
+impl SessionKey {
+    pub(super) fn new(model: &[u8], session_options: &SessionOptions) -> Self {
+        Self {
+            content_digest: Sha256::digest(model).into(),
+            intra_op_num_threads: session_options.intra_op_num_threads,
+            inter_op_num_threads: session_options.inter_op_num_threads,
+            use_gpu: session_options.use_gpu,
+            mem_pattern: session_options.mem_pattern,
+        }
+    }
+}
+
+/// 構築済みの推論セッション。最後の[`Status`]が手放した時点で解放されるよう、弱参照で持つ。
+///
+/// [`Status`]: super::Status
+#[derive(Default)]
+struct SessionRegistry(HashMap<SessionKey, Weak<PriorityMutex<Session<'static>>>>);
+
+#[allow(unsafe_code)]
+unsafe impl Send for SessionRegistry {}
+
+static REGISTRY: Lazy<Mutex<SessionRegistry>> = Lazy::new(Default::default);
+
+/// `key`に対応する推論セッションがあればそれを、なければ`new_session`で構築したものを返す。
+///
+/// 戻り値の`bool`は既存のセッションを共有したかどうか。セッションの構築中は登録簿のロックを
+/// 取らないため、同じキーのセッションが同時に構築された場合は先に登録された方を使う。
+pub(super) fn get_or_try_insert_with(
+    key: SessionKey,
+    new_session: impl FnOnce() -> Result<Session<'static>>,
+) -> Result<(SharedSession, bool)> {
+    if let Some(session) = get(key) {
+        return Ok((session, true));
+    }
+    let session = Arc::new(PriorityMutex::new(new_session()?));
+
+    let SessionRegistry(registry) = &mut *REGISTRY.lock().unwrap();
+    registry.retain(|_, session| session.strong_count() > 0);
+    if let Some(existing) = registry.get(&key).and_then(Weak::upgrade) {
+        return Ok((existing, true));
+    }
+    registry.insert(key, Arc::downgrade(&session));
+    Ok((session, false))
+}
+
+fn get(key: SessionKey) -> Option<SharedSession> {
+    let SessionRegistry(registry) = &*REGISTRY.lock().unwrap();
+    registry.get(&key).and_then(Weak::upgrade)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ModelPrecision;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+
+    #[rstest]
+    #[case(b"model", 1, false, true, true)]
+    #[case(b"other", 1, false, true, false)]
+    #[case(b"model", 2, false, true, false)]
+    #[case(b"model", 1, true, true, false)]
+    #[case(b"model", 1, false, false, false)]
+    fn session_key_works(
+        #[case] model: &[u8],
+        #[case] intra_op_num_threads: u16,
+        #[case] use_gpu: bool,
+        #[case] mem_pattern: bool,
+        #[case] expected: bool,
+    ) {
+        let options = |intra_op_num_threads, use_gpu, mem_pattern| {
+            SessionOptions::new(
+                intra_op_num_threads,
+                1,
+                use_gpu,
+                ModelPrecision::Fp32,
+                mem_pattern,
+            )
+        };
+        assert_eq!(
+            expected,
+            SessionKey::new(b"model", &options(1, false, true))
+                == SessionKey::new(model, &options(intra_op_num_threads, use_gpu, mem_pattern)),
+        );
+    }
+}
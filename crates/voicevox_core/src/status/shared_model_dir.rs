@@ -0,0 +1,107 @@
+//! 複数のプロセスで共有する、復号済みの推論モデルの置き場。
+//!
+//! プロセスごとに音声モデルを読み込むと、推論モデルの読み出しと復号がプロセスの数だけ行われ、
+//! その間はプロセスごとに推論モデルの複製がメモリに載る。置き場が指定されている場合は、最初に
+//! 読み込んだプロセスが復号済みの推論モデルをファイルとして置き、すべてのプロセスはそれを読み込み
+//! 専用でメモリにマップして推論セッションを構築する。マップした領域はページキャッシュとして
+//! プロセス間で共有される。
+
+use super::{model_file, DecryptModelError};
+use memmap2::Mmap;
+use sha2::{Digest as _, Sha256};
+use std::{
+    env,
+    io::{self, Write as _},
+    path::PathBuf,
+};
+
+/// 置き場のディレクトリを指定する環境変数。
+const ENV_NAME: &str = "VV_SHARED_MODEL_DIR";
+
+pub(super) struct SharedModelDir(PathBuf);
+
+impl SharedModelDir {
+    /// 環境変数`VV_SHARED_MODEL_DIR`で指定された置き場。
+    pub(super) fn from_env() -> Option<Self> {
+        env::var_os(ENV_NAME).map(|dir| Self(dir.into()))
+    }
+
+    /// `model`を復号したものを、置き場から読み込み専用でマップする。まだ無ければ復号して置く。
+    ///
+    /// 置き場のファイルは、暗号化された推論モデルの中身のSHA-256を名前として置かれる。同時に複数の
+    /// プロセスが同じ推論モデルを置こうとしても、一時ファイルに書いてから置き換えるため、
+    /// 書きかけのファイルがマップされることはない。
+    pub(super) fn map(&self, model: &[u8]) -> anyhow::Result<Mmap> {
+        let path = self.0.join(file_name(model));
+        let file = match fs_err::File::open(&path) {
+            Ok(file) => file,
+            Err(err) if err.kind() == io::ErrorKind::NotFound => {
+                fs_err::create_dir_all(&self.0)?;
+                let mut file = tempfile::NamedTempFile::new_in(&self.0)?;
+                file.write_all(&model_file::decrypt(model)?)?;
+                file.persist(&path)?;
+                fs_err::File::open(&path)?
+            }
+            Err(err) => return Err(err.into()),
+        };
+        // SAFETY: 置き場のファイルは置き換えられることはあっても、書き換えられることはない
+        #[allow(unsafe_code)]
+        let mmap = unsafe { Mmap::map(file.file())? };
+        if mmap.is_empty() {
+            return Err(DecryptModelError.into());
+        }
+        Ok(mmap)
+    }
+}
+
+fn file_name(model: &[u8]) -> String {
+    format!("{:x}.onnx", Sha256::digest(model))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+    use tempfile::TempDir;
+
+    #[rstest]
+    fn shared_model_dir_works() {
+        let dir = TempDir::new().unwrap();
+        let shared_model_dir = SharedModelDir(dir.path().join("models"));
+
+        let model = b"model".as_slice();
+        let mmap = shared_model_dir.map(model).unwrap();
+        assert_eq!(model_file::decrypt(model).unwrap(), &*mmap);
+
+        // 二度目以降は置かれているものをマップする
+        let files = || fs_err::read_dir(&shared_model_dir.0).unwrap().count();
+        assert_eq!(1, files());
+        assert_eq!(&*mmap, &*shared_model_dir.map(model).unwrap());
+        assert_eq!(1, files());
+
+        shared_model_dir.map(b"another model").unwrap();
+        assert_eq!(2, files());
+    }
+
+    #[cfg(unix)]
+    #[rstest]
+    fn shared_model_dir_propagates_errors_other_than_not_found() {
+        use std::os::unix::fs::PermissionsExt as _;
+
+        let dir = TempDir::new().unwrap();
+        let shared_model_dir = SharedModelDir(dir.path().to_owned());
+        let model = b"model".as_slice();
+        let path = dir.path().join(file_name(model));
+        fs_err::write(&path, model_file::decrypt(model).unwrap()).unwrap();
+        fs_err::set_permissions(&path, std::fs::Permissions::from_mode(0o000)).unwrap();
+        if fs_err::File::open(&path).is_ok() {
+            // rootでは読めてしまうため確かめられない
+            return;
+        }
+
+        // 置かれているファイルを読めない場合は、置き換えずに失敗する
+        assert!(shared_model_dir.map(model).is_err());
+        assert_eq!(1, fs_err::read_dir(dir.path()).unwrap().count());
+    }
+}
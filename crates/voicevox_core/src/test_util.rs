@@ -1,19 +1,63 @@
-use std::path::PathBuf;
+use std::path::{Path, PathBuf};
+
+use serde_json::Value;
 
 use crate::VoiceModel;
 
 pub async fn open_default_vvm_file() -> VoiceModel {
-    VoiceModel::from_path(
-        ::test_util::convert_zip_vvm(
-            PathBuf::from(env!("CARGO_WORKSPACE_DIR"))
-                .join(file!())
-                .parent()
-                .unwrap()
-                .join("test_data/model_sources")
-                .join("load_model_works1"),
-        )
-        .await,
-    )
-    .await
-    .unwrap()
+    VoiceModel::from_path(::test_util::convert_zip_vvm(default_model_source_dir()).await)
+        .await
+        .unwrap()
+}
+
+/// [`open_default_vvm_file`]と同じ推論モデルを持ち、スタイルIDを`offset`だけずらした音声モデルを
+/// 開く。複数の音声モデルを読み込む場合のテストに用いる。
+pub async fn open_vvm_file_with_style_id_offset(offset: u32) -> VoiceModel {
+    let source_dir = default_model_source_dir();
+    let dir = std::env::temp_dir().join(format!("voicevox_core_style_id_offset_{offset}"));
+    fs_err::create_dir_all(&dir).unwrap();
+    for entry in fs_err::read_dir(&source_dir).unwrap() {
+        let path = entry.unwrap().path();
+        fs_err::copy(&path, dir.join(path.file_name().unwrap())).unwrap();
+    }
+
+    let mut metas = read_json(&dir.join("metas.json"));
+    let mut style_id_to_model_inner_id = serde_json::Map::new();
+    let mut manifest = read_json(&dir.join("manifest.json"));
+    for style in metas
+        .as_array_mut()
+        .unwrap()
+        .iter_mut()
+        .flat_map(|speaker| speaker["styles"].as_array_mut().unwrap())
+    {
+        let style_id = style["id"].as_u64().unwrap();
+        // モデル内IDは元のスタイルのものを使う
+        let model_inner_id = manifest["style_id_to_model_inner_id"]
+            .get(style_id.to_string())
+            .cloned()
+            .unwrap_or(style_id.into());
+        let style_id = style_id + u64::from(offset);
+        style["id"] = style_id.into();
+        style_id_to_model_inner_id.insert(style_id.to_string(), model_inner_id);
+    }
+    manifest["style_id_to_model_inner_id"] = style_id_to_model_inner_id.into();
+    fs_err::write(dir.join("metas.json"), metas.to_string()).unwrap();
+    fs_err::write(dir.join("manifest.json"), manifest.to_string()).unwrap();
+
+    VoiceModel::from_path(::test_util::convert_zip_vvm(dir).await)
+        .await
+        .unwrap()
+}
+
+fn default_model_source_dir() -> PathBuf {
+    PathBuf::from(env!("CARGO_WORKSPACE_DIR"))
+        .join(file!())
+        .parent()
+        .unwrap()
+        .join("test_data/model_sources")
+        .join("load_model_works1")
+}
+
+fn read_json(path: &Path) -> Value {
+    serde_json::from_str(&fs_err::read_to_string(path).unwrap()).unwrap()
 }
@@ -0,0 +1,437 @@
+//! 推論の要求ごとの処理段階とロック待ちの記録を、Chrome trace形式のJSONとして書き出す。
+//!
+//! 環境変数`VV_TRACE_PATH`でファイルが指定されている場合にだけ有効になる。書き出したファイルは
+//! `chrome://tracing`や[Perfetto UI]で開ける。実際のプロセスごとに、要求ごとのトラックとして
+//! 表示され、その中に処理段階ごとの区間が並ぶ。区間を処理したスレッドは引数として記録する。
+//! 時刻はUNIXエポックからの時間であるため、複数のプロセスが同じファイルに追記しても重ならない。
+//!
+//! 常に有効にしておけるよう、記録する要求は次の環境変数で絞り込める。
+//!
+//! - `VV_TRACE_SAMPLE_RATE`: 記録する要求の割合(0から1)。既定では1。
+//! - `VV_TRACE_MIN_DURATION_MS`: 記録した要求のうち、全体でこの時間(ミリ秒)以上かかったものだけを
+//!   書き出す。既定では0。
+//!
+//! 記録されない要求にかかるのは、記録するかどうかの判定だけである。ファイルへの書き出しは
+//! 専用のスレッドで行う。
+//!
+//! [Perfetto UI]: https://ui.perfetto.dev
+
+use std::{
+    env, fmt,
+    io::{BufWriter, Write as _},
+    iter, mem,
+    path::Path,
+    process,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        mpsc, Arc, Mutex,
+    },
+    thread::{self, JoinHandle},
+    time::{Duration, Instant, SystemTime},
+};
+
+use once_cell::sync::Lazy;
+use serde::Serialize;
+use tracing::warn;
+
+use crate::Priority;
+
+const PATH_ENV_NAME: &str = "VV_TRACE_PATH";
+const SAMPLE_RATE_ENV_NAME: &str = "VV_TRACE_SAMPLE_RATE";
+const MIN_DURATION_ENV_NAME: &str = "VV_TRACE_MIN_DURATION_MS";
+
+static TRACER: Lazy<Option<Arc<Tracer>>> = Lazy::new(|| match Tracer::from_env() {
+    Ok(tracer) => tracer.map(Arc::new),
+    Err(err) => {
+        warn!("トレースを有効にできませんでした: {err}");
+        None
+    }
+});
+
+/// 要求を記録するかどうかの判定と、記録した要求の書き出し先。
+pub(crate) struct Tracer {
+    sample_rate: f64,
+    min_duration: Duration,
+    /// 記録するかどうかを判定した要求の数。
+    sampled: AtomicU64,
+    next_request_id: AtomicU64,
+    /// 書き出しを行うスレッドへの送り口。
+    sender: Mutex<Option<mpsc::Sender<FinishedRequest>>>,
+    writer: Option<JoinHandle<()>>,
+}
+
+impl Tracer {
+    fn from_env() -> anyhow::Result<Option<Self>> {
+        let Some(path) = env::var_os(PATH_ENV_NAME) else {
+            return Ok(None);
+        };
+        let sample_rate = match env::var(SAMPLE_RATE_ENV_NAME) {
+            Ok(rate) => rate.parse()?,
+            Err(_) => 1.,
+        };
+        let min_duration = match env::var(MIN_DURATION_ENV_NAME) {
+            Ok(millis) => Duration::from_millis(millis.parse()?),
+            Err(_) => Duration::ZERO,
+        };
+        Self::new(path.as_ref(), sample_rate, min_duration).map(Some)
+    }
+
+    fn new(path: &Path, sample_rate: f64, min_duration: Duration) -> anyhow::Result<Self> {
+        let mut file = fs_err::OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(path)?;
+        // JSON Array Formatでは閉じ括弧を省略できるため、イベントを追記していくだけでよい
+        if file.metadata()?.len() == 0 {
+            file.write_all(b"[\n")?;
+        }
+        let mut writer = TraceWriter {
+            out: BufWriter::new(file),
+            epoch: Epoch::now(),
+            pid: process::id().into(),
+        };
+        writer.write_process_name()?;
+
+        let (sender, receiver) = mpsc::channel();
+        let writer = thread::Builder::new()
+            .name("voicevox_core-trace".to_owned())
+            .spawn(move || writer.run(receiver))?;
+        Ok(Self {
+            sample_rate: sample_rate.clamp(0., 1.),
+            min_duration,
+            sampled: AtomicU64::new(0),
+            next_request_id: AtomicU64::new(1),
+            sender: Mutex::new(Some(sender)),
+            writer: Some(writer),
+        })
+    }
+
+    /// 要求を`sample_rate`の割合で、偏りなく選ぶ。
+    fn sample(&self) -> bool {
+        let n = self.sampled.fetch_add(1, Ordering::Relaxed) as f64;
+        ((n + 1.) * self.sample_rate).floor() > (n * self.sample_rate).floor()
+    }
+
+    fn start(self: &Arc<Self>, name: &'static str, priority: Priority) -> Option<RequestTrace> {
+        if !self.sample() {
+            return None;
+        }
+        Some(RequestTrace {
+            tracer: self.clone(),
+            id: self.next_request_id.fetch_add(1, Ordering::Relaxed),
+            name,
+            priority,
+            start: Instant::now(),
+            thread: thread_number(),
+            spans: Mutex::default(),
+        })
+    }
+}
+
+impl Drop for Tracer {
+    fn drop(&mut self) {
+        // 送り口を閉じ、送った記録を書き出し終えるまで待つ
+        drop(self.sender.get_mut().unwrap().take());
+        if let Some(writer) = self.writer.take() {
+            writer.join().unwrap();
+        }
+    }
+}
+
+/// 時刻の基準。[`Instant`]をUNIXエポックからの時間に直す。
+struct Epoch {
+    instant: Instant,
+    unix_micros: f64,
+}
+
+impl Epoch {
+    fn now() -> Self {
+        Self {
+            instant: Instant::now(),
+            unix_micros: SystemTime::now()
+                .duration_since(SystemTime::UNIX_EPOCH)
+                .unwrap_or_default()
+                .as_secs_f64()
+                * 1e6,
+        }
+    }
+
+    fn micros(&self, t: Instant) -> f64 {
+        let since = match t.checked_duration_since(self.instant) {
+            Some(since) => since.as_secs_f64(),
+            None => -self.instant.duration_since(t).as_secs_f64(),
+        };
+        self.unix_micros + since * 1e6
+    }
+}
+
+/// 書き出し終えた要求の記録。
+struct FinishedRequest {
+    id: u64,
+    name: &'static str,
+    priority: Priority,
+    start: Instant,
+    duration: Duration,
+    thread: u64,
+    spans: Vec<Span>,
+}
+
+/// 記録を受け取ってファイルに書き出す。
+struct TraceWriter {
+    out: BufWriter<fs_err::File>,
+    epoch: Epoch,
+    pid: u64,
+}
+
+impl TraceWriter {
+    fn run(mut self, receiver: mpsc::Receiver<FinishedRequest>) {
+        while let Ok(request) = receiver.recv() {
+            let result = iter::once(request)
+                .chain(receiver.try_iter())
+                .try_for_each(|request| self.write(&request))
+                // 溜まっていた記録を書き終えたら、プロセスが途中で終了しても読めるようにする
+                .and_then(|()| Ok(self.out.flush()?));
+            if let Err(err) = result {
+                warn!("トレースを書き出せませんでした: {err}");
+            }
+        }
+    }
+
+    fn write_process_name(&mut self) -> anyhow::Result<()> {
+        self.write_event(&Event {
+            name: "process_name",
+            ph: "M",
+            pid: self.pid,
+            args: Some(Args {
+                name: Some(env!("CARGO_PKG_NAME")),
+                ..Default::default()
+            }),
+            ..Default::default()
+        })?;
+        Ok(self.out.flush()?)
+    }
+
+    fn write(&mut self, request: &FinishedRequest) -> anyhow::Result<()> {
+        let track_name = format!("{} #{}", request.name, request.id);
+        self.write_event(&Event {
+            name: "thread_name",
+            ph: "M",
+            pid: self.pid,
+            tid: request.id,
+            args: Some(Args {
+                name: Some(&track_name),
+                ..Default::default()
+            }),
+            ..Default::default()
+        })?;
+        self.write_event(&Event {
+            name: request.name,
+            cat: "request",
+            ph: "X",
+            ts: self.epoch.micros(request.start),
+            dur: request.duration.as_secs_f64() * 1e6,
+            pid: self.pid,
+            tid: request.id,
+            args: Some(Args {
+                priority: Some(request.priority.into()),
+                thread: Some(request.thread),
+                ..Default::default()
+            }),
+        })?;
+        for span in &request.spans {
+            self.write_event(&Event {
+                name: span.name,
+                cat: span.category,
+                ph: "X",
+                ts: self.epoch.micros(span.start),
+                dur: span.duration.as_secs_f64() * 1e6,
+                pid: self.pid,
+                tid: request.id,
+                args: Some(Args {
+                    thread: Some(span.thread),
+                    ..Default::default()
+                }),
+            })?;
+        }
+        Ok(())
+    }
+
+    fn write_event(&mut self, event: &Event<'_>) -> anyhow::Result<()> {
+        serde_json::to_writer(&mut self.out, event)?;
+        self.out.write_all(b",\n")?;
+        Ok(())
+    }
+}
+
+/// Chrome trace形式のイベント。
+#[derive(Serialize, Default)]
+struct Event<'a> {
+    name: &'a str,
+    #[serde(skip_serializing_if = "str::is_empty")]
+    cat: &'a str,
+    ph: &'a str,
+    ts: f64,
+    dur: f64,
+    pid: u64,
+    tid: u64,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    args: Option<Args<'a>>,
+}
+
+#[derive(Serialize, Default)]
+struct Args<'a> {
+    #[serde(skip_serializing_if = "Option::is_none")]
+    name: Option<&'a str>,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    priority: Option<&'a str>,
+    /// 区間を処理したスレッドの、トレースの中での番号。
+    #[serde(skip_serializing_if = "Option::is_none")]
+    thread: Option<u64>,
+}
+
+/// 一つの要求の記録。最後の参照が無くなった時点で、書き出しを行うスレッドに送られる。
+pub(crate) struct RequestTrace {
+    tracer: Arc<Tracer>,
+    id: u64,
+    name: &'static str,
+    priority: Priority,
+    start: Instant,
+    /// 要求を始めたスレッド。
+    thread: u64,
+    spans: Mutex<Vec<Span>>,
+}
+
+impl RequestTrace {
+    /// 環境変数で有効にされていて、かつこの要求が記録の対象に選ばれた場合に記録を始める。
+    pub(crate) fn start(name: &'static str, priority: Priority) -> Option<Self> {
+        TRACER.as_ref()?.start(name, priority)
+    }
+
+    /// `start`から現在までの区間を記録する。
+    pub(crate) fn record(&self, category: &'static str, name: &'static str, start: Instant) {
+        let span = Span {
+            category,
+            name,
+            start,
+            duration: start.elapsed(),
+            thread: thread_number(),
+        };
+        self.spans.lock().unwrap().push(span);
+    }
+}
+
+impl fmt::Debug for RequestTrace {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("RequestTrace")
+            .field("id", &self.id)
+            .field("name", &self.name)
+            .finish_non_exhaustive()
+    }
+}
+
+impl Drop for RequestTrace {
+    fn drop(&mut self) {
+        let duration = self.start.elapsed();
+        if duration < self.tracer.min_duration {
+            return;
+        }
+        let request = FinishedRequest {
+            id: self.id,
+            name: self.name,
+            priority: self.priority,
+            start: self.start,
+            duration,
+            thread: self.thread,
+            spans: mem::take(self.spans.get_mut().unwrap()),
+        };
+        if let Some(sender) = &*self.tracer.sender.lock().unwrap() {
+            // 受け取り側が無くなるのは書き出しのスレッドが異常終了した場合だけであり、その場合は
+            // 記録を捨てる
+            let _ = sender.send(request);
+        }
+    }
+}
+
+struct Span {
+    category: &'static str,
+    name: &'static str,
+    start: Instant,
+    duration: Duration,
+    thread: u64,
+}
+
+/// 現在のスレッドの、トレースの中での番号。
+fn thread_number() -> u64 {
+    static NEXT: AtomicU64 = AtomicU64::new(1);
+    thread_local! {
+        static NUMBER: u64 = NEXT.fetch_add(1, Ordering::Relaxed);
+    }
+    NUMBER.with(|&number| number)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+    use tempfile::TempDir;
+
+    #[rstest]
+    #[case(1., 8)]
+    #[case(0.25, 2)]
+    #[case(0., 0)]
+    fn sample_works(#[case] sample_rate: f64, #[case] expected: usize) {
+        let dir = TempDir::new().unwrap();
+        let tracer =
+            Tracer::new(&dir.path().join("trace.json"), sample_rate, Duration::ZERO).unwrap();
+        assert_eq!(expected, (0..8).filter(|_| tracer.sample()).count());
+    }
+
+    #[rstest]
+    fn request_trace_works() {
+        let dir = TempDir::new().unwrap();
+        let path = dir.path().join("trace.json");
+        let tracer = Arc::new(Tracer::new(&path, 1., Duration::ZERO).unwrap());
+
+        let trace = tracer.start("tts", Priority::Normal).unwrap();
+        trace.record("stage", "decode", Instant::now());
+        drop(trace);
+        // 書き出しを待つ
+        drop(tracer);
+        // 全体の時間が短い要求は書き出さない
+        let tracer = Arc::new(Tracer::new(&path, 1., Duration::from_secs(60)).unwrap());
+        drop(tracer.start("tts", Priority::Normal).unwrap());
+        drop(tracer);
+
+        let content = fs_err::read_to_string(&path).unwrap();
+        let content = format!("{}]", content.trim_end().trim_end_matches(','));
+        let events = serde_json::from_str::<Vec<serde_json::Value>>(&content).unwrap();
+        let names = events
+            .iter()
+            .map(|event| event["name"].as_str().unwrap())
+            .collect::<Vec<_>>();
+        assert_eq!(
+            vec![
+                "process_name",
+                "thread_name",
+                "tts",
+                "decode",
+                "process_name"
+            ],
+            names,
+        );
+        assert!(events
+            .iter()
+            .all(|event| event["pid"] == u64::from(process::id())));
+        assert_eq!("tts #1", events[1]["args"]["name"]);
+        assert_eq!("stage", events[3]["cat"]);
+        // 時刻はUNIXエポックからの時間(マイクロ秒)
+        let unix_micros = SystemTime::now()
+            .duration_since(SystemTime::UNIX_EPOCH)
+            .unwrap()
+            .as_secs_f64()
+            * 1e6;
+        let ts = events[2]["ts"].as_f64().unwrap();
+        assert!((unix_micros - 60e6..=unix_micros).contains(&ts));
+    }
+}
@@ -3,12 +3,17 @@ use async_zip::{read::fs::ZipFileReader, ZipEntry};
 use futures::future::{join3, join_all};
 use serde::{de::DeserializeOwned, Deserialize};
 
+use self::vvm_index::VvmIndex;
 use super::*;
 use std::{
     collections::HashMap,
     env,
     path::{Path, PathBuf},
+    sync::Arc,
 };
+use tokio::sync::OnceCell;
+
+mod vvm_index;
 
 /// [`VoiceModelId`]の実体。
 ///
@@ -24,7 +29,7 @@ pub struct VoiceModelId {
 /// 音声モデル。
 ///
 /// VVMファイルと対応する。
-#[derive(Getters, Clone)]
+#[derive(Clone)]
 pub struct VoiceModel {
     /// ID。
     id: VoiceModelId,
@@ -32,6 +37,8 @@ pub struct VoiceModel {
     /// メタ情報。
     metas: VoiceModelMeta,
     path: PathBuf,
+    /// 開いたVVMファイル。最初に必要になった時点で開き、以降は使い回す。
+    reader: Arc<OnceCell<VvmEntryReader>>,
 }
 
 #[derive(Getters)]
@@ -42,13 +49,27 @@ pub(crate) struct InferenceModels {
 }
 
 impl VoiceModel {
-    pub(crate) async fn read_inference_models(&self) -> Result<InferenceModels> {
-        let reader = VvmEntryReader::open(&self.path).await?;
+    /// 推論モデルを読む。
+    ///
+    /// `light_precision`は音素長・音高の推論モデルに、`heavy_precision`は音声波形の生成モデルに
+    /// 適用される。
+    pub(crate) async fn read_inference_models(
+        &self,
+        light_precision: ModelPrecision,
+        heavy_precision: ModelPrecision,
+    ) -> Result<InferenceModels> {
+        let reader = self
+            .reader
+            .get_or_try_init(|| VvmEntryReader::open(&self.path))
+            .await?;
         let (decode_model_result, predict_duration_model_result, predict_intonation_model_result) =
             join3(
-                reader.read_vvm_entry(self.manifest.decode_filename()),
-                reader.read_vvm_entry(self.manifest.predict_duration_filename()),
-                reader.read_vvm_entry(self.manifest.predict_intonation_filename()),
+                reader.read_vvm_entry(self.manifest.decode_filename_for(heavy_precision)),
+                reader.read_vvm_entry(self.manifest.predict_duration_filename_for(light_precision)),
+                reader.read_vvm_entry(
+                    self.manifest
+                        .predict_intonation_filename_for(light_precision),
+                ),
             )
             .await;
 
@@ -69,6 +90,25 @@ impl VoiceModel {
             })?,
         })
     }
+
+    /// ID。
+    pub fn id(&self) -> &VoiceModelId {
+        &self.id
+    }
+
+    pub fn manifest(&self) -> &Manifest {
+        &self.manifest
+    }
+
+    /// メタ情報。
+    pub fn metas(&self) -> &VoiceModelMeta {
+        &self.metas
+    }
+
+    pub fn path(&self) -> &PathBuf {
+        &self.path
+    }
+
     /// VVMファイルから`VoiceModel`をコンストラクトする。
     pub async fn from_path(path: impl AsRef<Path>) -> Result<Self> {
         let reader = VvmEntryReader::open(&path).await?;
@@ -93,9 +133,28 @@ impl VoiceModel {
             metas,
             manifest,
             path: path.as_ref().into(),
+            reader: Arc::new(reader.into()),
         })
     }
 
+    /// メタデータのインデックスに記録されている内容から`VoiceModel`をコンストラクトする。
+    ///
+    /// VVMファイルは推論モデルを読む時点まで開かない。
+    fn from_index(path: &Path, manifest: Manifest, metas: VoiceModelMeta) -> Self {
+        Self {
+            id: VoiceModelId::new(nanoid!()),
+            metas,
+            manifest,
+            path: path.into(),
+            reader: Default::default(),
+        }
+    }
+
+    /// モデルディレクトリにあるすべてのVVMファイルから`VoiceModel`をコンストラクトする。
+    ///
+    /// 環境変数`VV_MODELS_INDEX_PATH`が指定されている場合、そのファイルをメタデータのインデックスと
+    /// して使う。パス・更新日時・サイズが変わっていないVVMファイルは開かずにインデックスの内容を使い、
+    /// 変わっていればインデックスを更新する。
     pub async fn get_all_models() -> Result<Vec<Self>> {
         let root_dir = if cfg!(test) {
             Path::new(env!("CARGO_WORKSPACE_DIR")).join("model")
@@ -118,12 +177,29 @@ impl VoiceModel {
                 source: e.into(),
             })?
             .into_iter()
-            .filter(|entry| entry.path().extension().map_or(false, |ext| ext == "vvm"))
-            .map(|entry| Self::from_path(entry.path()));
+            .map(|entry| entry.path())
+            .filter(|path| path.extension().map_or(false, |ext| ext == "vvm"))
+            .collect::<Vec<_>>();
+
+        let index = env::var_os(Self::INDEX_PATH_ENV_NAME).map(VvmIndex::load);
+
+        let models = join_all(vvm_paths.iter().map(|path| async {
+            match index.as_ref().and_then(|index| index.get(path)) {
+                Some((manifest, metas)) => Ok(Self::from_index(path, manifest, metas)),
+                None => Self::from_path(path).await,
+            }
+        }))
+        .await
+        .into_iter()
+        .collect::<Result<Vec<_>>>()?;
 
-        join_all(vvm_paths).await.into_iter().collect()
+        if let Some(index) = index {
+            index.update(&models);
+        }
+        Ok(models)
     }
     const ROOT_DIR_ENV_NAME: &str = "VV_MODELS_ROOT_DIR";
+    const INDEX_PATH_ENV_NAME: &str = "VV_MODELS_INDEX_PATH";
 
     /// スタイルIDからモデル内IDを取得する。
     /// モデル内IDのマッピングが存在しない場合はそのままスタイルIDを返す。
@@ -0,0 +1,159 @@
+//! VVMファイルのメタデータのインデックス。
+//!
+//! モデルディレクトリを列挙するたびにすべてのVVMファイルを開いて`manifest.json`と`metas.json`を
+//! 読むのを避けるため、パス・更新日時・サイズをキーとしてそれらを保存しておく。
+
+use super::{Manifest, VoiceModel, VoiceModelMeta};
+use serde::{Deserialize, Serialize};
+use std::{
+    collections::BTreeMap,
+    io::Write as _,
+    path::{Path, PathBuf},
+    time::SystemTime,
+};
+use tracing::warn;
+
+/// インデックスのファイルの形式のバージョン。形式を変えたら上げる。
+const FORMAT_VERSION: u32 = 1;
+
+pub(super) struct VvmIndex {
+    path: PathBuf,
+    entries: BTreeMap<PathBuf, VvmIndexEntry>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct VvmIndexFile {
+    format_version: u32,
+    entries: BTreeMap<PathBuf, VvmIndexEntry>,
+}
+
+#[derive(Serialize, Deserialize, Clone)]
+struct VvmIndexEntry {
+    stamp: FileStamp,
+    manifest: Manifest,
+    metas: VoiceModelMeta,
+}
+
+/// VVMファイルが変更されていないかを判定するための、更新日時とサイズ。
+#[derive(Serialize, Deserialize, PartialEq, Eq, Clone, Copy, Debug)]
+struct FileStamp {
+    modified: SystemTime,
+    len: u64,
+}
+
+impl FileStamp {
+    fn of(path: &Path) -> Option<Self> {
+        let metadata = fs_err::metadata(path).ok()?;
+        Some(Self {
+            modified: metadata.modified().ok()?,
+            len: metadata.len(),
+        })
+    }
+}
+
+impl VvmIndex {
+    /// インデックスを読む。ファイルが無い場合や壊れている場合は空のインデックスとする。
+    pub(super) fn load(path: impl Into<PathBuf>) -> Self {
+        let path = path.into();
+        let entries = fs_err::read(&path)
+            .ok()
+            .and_then(|content| serde_json::from_slice::<VvmIndexFile>(&content).ok())
+            .filter(|file| file.format_version == FORMAT_VERSION)
+            .map(|file| file.entries)
+            .unwrap_or_default();
+        Self { path, entries }
+    }
+
+    /// `path`のVVMファイルが記録されたときから変わっていなければ、そのマニフェストとメタ情報を返す。
+    pub(super) fn get(&self, path: &Path) -> Option<(Manifest, VoiceModelMeta)> {
+        let entry = self.entries.get(path)?;
+        if FileStamp::of(path)? != entry.stamp {
+            return None;
+        }
+        Some((entry.manifest.clone(), entry.metas.clone()))
+    }
+
+    /// インデックスを`models`の内容で置き換え、変わっていればファイルに書き出す。
+    ///
+    /// インデックスはキャッシュにすぎないため、書き出しに失敗しても警告を出すだけとする。
+    pub(super) fn update(self, models: &[VoiceModel]) {
+        let entries = models
+            .iter()
+            .filter_map(|model| {
+                let entry = VvmIndexEntry {
+                    stamp: FileStamp::of(model.path())?,
+                    manifest: model.manifest().clone(),
+                    metas: model.metas().clone(),
+                };
+                Some((model.path().clone(), entry))
+            })
+            .collect::<BTreeMap<_, _>>();
+
+        let unchanged = entries.len() == self.entries.len()
+            && entries.iter().all(|(path, entry)| {
+                self.entries
+                    .get(path)
+                    .map_or(false, |old| old.stamp == entry.stamp)
+            });
+        if unchanged {
+            return;
+        }
+
+        if let Err(err) = save(&self.path, entries) {
+            warn!("VVMのインデックスを書き出せませんでした: {err}");
+        }
+    }
+}
+
+fn save(path: &Path, entries: BTreeMap<PathBuf, VvmIndexEntry>) -> anyhow::Result<()> {
+    let content = serde_json::to_vec(&VvmIndexFile {
+        format_version: FORMAT_VERSION,
+        entries,
+    })?;
+    // 同時に読まれても壊れたファイルが見えないよう、一時ファイルに書いてから置き換える
+    let dir = path.parent().filter(|dir| !dir.as_os_str().is_empty());
+    let mut file = tempfile::NamedTempFile::new_in(dir.unwrap_or_else(|| ".".as_ref()))?;
+    file.write_all(&content)?;
+    file.persist(path)?;
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::test_util::open_default_vvm_file;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+    use tempfile::TempDir;
+
+    #[rstest]
+    #[tokio::test]
+    async fn vvm_index_works() {
+        let dir = TempDir::new().unwrap();
+        let index_path = dir.path().join("index.json");
+        let vvm_path = dir.path().join("model.vvm");
+        fs_err::copy(open_default_vvm_file().await.path(), &vvm_path).unwrap();
+        let model = VoiceModel::from_path(&vvm_path).await.unwrap();
+
+        let index = VvmIndex::load(&index_path);
+        assert!(index.get(&vvm_path).is_none());
+        index.update(&[model.clone()]);
+
+        let index = VvmIndex::load(&index_path);
+        let (manifest, metas) = index.get(&vvm_path).unwrap();
+        assert_eq!(model.manifest().metas_filename(), manifest.metas_filename());
+        assert_eq!(
+            serde_json::to_string(model.metas()).unwrap(),
+            serde_json::to_string(&metas).unwrap(),
+        );
+
+        // サイズが変われば、変更されたものとみなす
+        fs_err::OpenOptions::new()
+            .append(true)
+            .open(&vvm_path)
+            .unwrap()
+            .write_all(b"\0")
+            .unwrap();
+        assert!(index.get(&vvm_path).is_none());
+    }
+}
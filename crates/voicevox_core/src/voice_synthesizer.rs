@@ -1,9 +1,14 @@
-use std::sync::Arc;
+use std::{sync::Arc, time::Duration};
 
 use const_default::ConstDefault;
 use duplicate::duplicate_item;
+use futures::future;
+use serde::{Deserialize, Serialize};
+use strum::{EnumCount, EnumIter, IntoStaticStr};
 
 use crate::engine::{create_kana, parse_kana, AccentPhraseModel, OpenJtalk, SynthesisEngine};
+use crate::prompt_template::{self, PromptTemplate};
+use crate::scheduler::{CancellationToken, Request};
 
 use super::*;
 
@@ -12,6 +17,22 @@ use super::*;
 /// [`Synthesizer::synthesis`]: Synthesizer::synthesis
 pub struct SynthesisOptions {
     pub enable_interrogative_upspeak: bool,
+    /// 推論の優先度。
+    pub priority: Priority,
+    /// 推論を始めるまでの期限。
+    ///
+    /// 呼び出しからこの時間が経っても推論を始められなかった場合、あるいは推論の順番待ちの見込みが
+    /// この時間を超える場合は[`Error::DeadlineExceeded`]で失敗する。始まった推論は中断されない。
+    pub deadline: Option<Duration>,
+    /// 音声合成を中断するためのトークン。
+    pub cancellation_token: Option<CancellationToken>,
+    /// 音声合成全体のタイムアウト。
+    ///
+    /// 呼び出しからこの時間が経つと、次の処理段階に進む前、あるいは推論セッションの順番待ちの間に
+    /// [`Error::TimedOut`]で失敗する。
+    pub timeout: Option<Duration>,
+    /// 返す音声の形式。
+    pub output_format: OutputFormat,
 }
 
 impl AsRef<SynthesisOptions> for SynthesisOptions {
@@ -24,10 +45,22 @@ impl From<&TtsOptions> for SynthesisOptions {
     fn from(options: &TtsOptions) -> Self {
         Self {
             enable_interrogative_upspeak: options.enable_interrogative_upspeak,
+            priority: options.priority,
+            deadline: options.deadline,
+            cancellation_token: options.cancellation_token.clone(),
+            timeout: options.timeout,
+            output_format: options.output_format,
         }
     }
 }
 
+impl From<&SynthesisOptions> for Request {
+    fn from(options: &SynthesisOptions) -> Self {
+        Self::new(options.priority, options.deadline)
+            .with_cancellation(options.timeout, options.cancellation_token.clone())
+    }
+}
+
 /// [`Synthesizer::create_accent_phrases`]のオプション。
 ///
 /// [`Synthesizer::create_accent_phrases`]: Synthesizer::create_accent_phrases
@@ -59,6 +92,21 @@ pub struct TtsOptions {
     /// AquesTalk風記法としてテキストを解釈する。
     pub kana: bool,
     pub enable_interrogative_upspeak: bool,
+    /// 推論の優先度。
+    pub priority: Priority,
+    /// 推論を始めるまでの期限。
+    ///
+    /// [`SynthesisOptions::deadline`]と同様。期限は呼び出しの時点から、テキストの解析を含めた全体に
+    /// 対して適用される。
+    pub deadline: Option<Duration>,
+    /// 音声合成を中断するためのトークン。
+    pub cancellation_token: Option<CancellationToken>,
+    /// 音声合成全体のタイムアウト。
+    ///
+    /// [`SynthesisOptions::timeout`]と同様。テキストの解析を含めた全体に対して適用される。
+    pub timeout: Option<Duration>,
+    /// 返す音声の形式。
+    pub output_format: OutputFormat,
 }
 
 impl AsRef<TtsOptions> for TtsOptions {
@@ -71,6 +119,31 @@ impl ConstDefault for TtsOptions {
     const DEFAULT: Self = Self {
         enable_interrogative_upspeak: true,
         kana: ConstDefault::DEFAULT,
+        priority: ConstDefault::DEFAULT,
+        deadline: None,
+        cancellation_token: None,
+        timeout: None,
+        output_format: ConstDefault::DEFAULT,
+    };
+}
+
+impl From<&TtsOptions> for Request {
+    fn from(options: &TtsOptions) -> Self {
+        Self::new(options.priority, options.deadline)
+            .with_cancellation(options.timeout, options.cancellation_token.clone())
+    }
+}
+
+/// [`Synthesizer::create_prompt_template`]のオプション。
+///
+/// [`Synthesizer::create_prompt_template`]: Synthesizer::create_prompt_template
+pub struct PromptTemplateOptions {
+    pub enable_interrogative_upspeak: bool,
+}
+
+impl ConstDefault for PromptTemplateOptions {
+    const DEFAULT: Self = Self {
+        enable_interrogative_upspeak: true,
     };
 }
 
@@ -89,6 +162,80 @@ impl ConstDefault for AccelerationMode {
     const DEFAULT: Self = Self::Auto;
 }
 
+/// 推論に使うモデルの数値精度。
+///
+/// VVMの`manifest.json`に該当する精度のモデルが無い場合は[`ModelPrecision::Fp32`]のモデルが使われる。
+/// また、GPUで実行される音声波形の生成には常に[`ModelPrecision::Fp32`]のモデルが使われる。
+#[derive(Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Debug, Deserialize, Serialize)]
+#[serde(rename_all = "lowercase")]
+pub enum ModelPrecision {
+    /// 32ビット浮動小数点数。
+    Fp32,
+    /// 16ビット浮動小数点数。
+    Fp16,
+    /// 8ビット整数に量子化されたもの。
+    Int8,
+}
+
+impl ConstDefault for ModelPrecision {
+    const DEFAULT: Self = Self::Fp32;
+}
+
+/// 推論の優先度。
+///
+/// 推論セッションの順番待ちでは、優先度の高いものから順に推論される。同じ優先度の中では期限の近い
+/// ものから、期限の無いものは到着順に推論される。
+#[derive(
+    Clone,
+    Copy,
+    PartialEq,
+    Eq,
+    PartialOrd,
+    Ord,
+    Debug,
+    Deserialize,
+    Serialize,
+    EnumCount,
+    EnumIter,
+    IntoStaticStr,
+)]
+#[serde(rename_all = "snake_case")]
+#[strum(serialize_all = "snake_case")]
+pub enum Priority {
+    /// 対話的な用途。最も優先される。
+    Interactive,
+    /// 通常。
+    Normal,
+    /// バッチ処理。最も後回しにされる。
+    Batch,
+}
+
+impl ConstDefault for Priority {
+    const DEFAULT: Self = Self::Normal;
+}
+
+/// 推論セッションが使うスレッド数の設定値。
+///
+/// それぞれ`0`を指定すると[`InitializeOptions::cpu_num_threads`]の値が使われる。
+#[derive(ConstDefault, Clone, Copy, PartialEq, Eq, Debug, Deserialize, Serialize)]
+pub struct SessionThreadOptions {
+    /// 演算子内の並列化(intra-op)に使うスレッド数。
+    pub intra_op_num_threads: u16,
+    /// 演算子間の並列化(inter-op)に使うスレッド数。
+    pub inter_op_num_threads: u16,
+}
+
+impl SessionThreadOptions {
+    /// `0`となっている値を`cpu_num_threads`で埋める。
+    pub(crate) fn or_cpu_num_threads(self, cpu_num_threads: u16) -> Self {
+        let or = |n| if n == 0 { cpu_num_threads } else { n };
+        Self {
+            intra_op_num_threads: or(self.intra_op_num_threads),
+            inter_op_num_threads: or(self.inter_op_num_threads),
+        }
+    }
+}
+
 /// [`Synthesizer::new_with_initialize`]のオプション。
 ///
 /// [`Synthesizer::new_with_initialize`]: Synthesizer::new_with_initialize
@@ -97,6 +244,30 @@ pub struct InitializeOptions {
     pub acceleration_mode: AccelerationMode,
     pub cpu_num_threads: u16,
     pub load_all_models: bool,
+    /// 軽いモデル(音素長・音高の推論)のスレッド数。
+    pub light_session_threads: SessionThreadOptions,
+    /// 重いモデル(音声波形の生成)のスレッド数。
+    pub heavy_session_threads: SessionThreadOptions,
+    /// 推論に使うモデルの数値精度。
+    pub model_precision: ModelPrecision,
+    /// 読み込まれていないスタイルの推論を要求されたときに、そのスタイルを含む音声モデルを
+    /// [`load_all_models`]と同じディレクトリから自動で読み込む。
+    ///
+    /// [`load_all_models`]: Self::load_all_models
+    pub auto_load_models: bool,
+    /// 読み込まれている推論モデルの合計バイト数の上限。
+    ///
+    /// 上限を超える場合、自動で読み込まれた音声モデルを最も長く使われていないものから解除する。
+    /// [`Synthesizer::load_voice_model`]などで読み込んだ音声モデルは解除しない。推論中の音声モデル
+    /// は、その推論が終わった時点で解放される。`None`のときは上限を設けない。
+    pub model_memory_budget: Option<u64>,
+    /// 同じ内容の推論モデルを同じ設定で読み込んだ、プロセス内の他の`Synthesizer`と推論セッションを
+    /// 共有する。
+    ///
+    /// 共有すると推論モデルの重みが一つ分のメモリで済むが、その推論モデルでの推論は
+    /// `Synthesizer`をまたいで一つずつ行われるようになる。複数の`Synthesizer`で並列に推論させたい
+    /// 場合は`false`のままにする。
+    pub share_sessions: bool,
 }
 
 #[duplicate_item(
@@ -104,7 +275,12 @@ pub struct InitializeOptions {
     [ AccentPhrasesOptions ];
     [ AudioQueryOptions ];
     [ TtsOptions ];
+    [ PromptTemplateOptions ];
     [ AccelerationMode ];
+    [ ModelPrecision ];
+    [ Priority ];
+    [ OutputFormat ];
+    [ SessionThreadOptions ];
     [ InitializeOptions ];
 )]
 impl Default for T {
@@ -122,6 +298,10 @@ pub struct Synthesizer {
 impl Synthesizer {
     /// `Synthesizer`をコンストラクトする。
     ///
+    /// 音声波形の生成では、入力の形の種類を限ってメモリの使用量を安定させるため、入力の長さを
+    /// 決まった長さに切り上げて推論し、出力から切り上げた分を切り落とす。揃える長さは環境変数
+    /// `VV_DECODE_LENGTH_BUCKETS`にフレーム数のカンマ区切りで指定でき、空にすると揃えなくなる。
+    ///
     /// # Example
     ///
     #[cfg_attr(windows, doc = "```no_run")] // https://github.com/VOICEVOX/voicevox_core/issues/537
@@ -136,7 +316,7 @@ impl Synthesizer {
     ///
     /// use voicevox_core::{AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer};
     ///
-    /// let mut syntesizer = Synthesizer::new_with_initialize(
+    /// let syntesizer = Synthesizer::new_with_initialize(
     ///     Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
     ///     &InitializeOptions {
     ///         acceleration_mode: ACCELERATION_MODE,
@@ -175,8 +355,17 @@ impl Synthesizer {
             synthesis_engine: SynthesisEngine::new(
                 InferenceCore::new_with_initialize(
                     use_gpu,
-                    options.cpu_num_threads,
+                    options
+                        .light_session_threads
+                        .or_cpu_num_threads(options.cpu_num_threads),
+                    options
+                        .heavy_session_threads
+                        .or_cpu_num_threads(options.cpu_num_threads),
+                    options.model_precision,
                     options.load_all_models,
+                    options.auto_load_models,
+                    options.model_memory_budget,
+                    options.share_sessions,
                 )
                 .await?,
                 open_jtalk,
@@ -191,18 +380,28 @@ impl Synthesizer {
     }
 
     /// 音声モデルを読み込む。
-    pub async fn load_voice_model(&mut self, model: &VoiceModel) -> Result<()> {
+    ///
+    /// 読み込み中も、既に読み込まれている音声モデルでの音声合成はブロックされない。
+    ///
+    /// [`InitializeOptions::share_sessions`]が有効で、同じ内容の推論モデルが同じ設定で他の
+    /// `Synthesizer`に読み込まれている場合は、その推論セッションを共有する。共有されたセッション
+    /// は、最後に使っている`Synthesizer`が解除した時点で解放される。
+    ///
+    /// 環境変数`VV_SHARED_MODEL_DIR`でディレクトリが指定されている場合、復号済みの推論モデルを
+    /// そこに置き、メモリにマップして推論セッションを構築する。複数のプロセスで同じ音声モデルを
+    /// 読み込むときに、推論モデルの復号とその複製がプロセスごとに行われなくなる。
+    pub async fn load_voice_model(&self, model: &VoiceModel) -> Result<()> {
         self.synthesis_engine
-            .inference_core_mut()
+            .inference_core()
             .load_model(model)
             .await?;
         Ok(())
     }
 
     /// 音声モデルの読み込みを解除する。
-    pub fn unload_voice_model(&mut self, voice_model_id: &VoiceModelId) -> Result<()> {
+    pub fn unload_voice_model(&self, voice_model_id: &VoiceModelId) -> Result<()> {
         self.synthesis_engine
-            .inference_core_mut()
+            .inference_core()
             .unload_model(voice_model_id)
     }
 
@@ -221,11 +420,27 @@ impl Synthesizer {
     }
 
     /// 今読み込んでいる音声モデルのメタ情報を返す。
-    pub fn metas(&self) -> &VoiceModelMeta {
+    pub fn metas(&self) -> VoiceModelMeta {
         self.synthesis_engine.inference_core().metas()
     }
 
+    /// 処理段階ごとの所要時間やロック待ちの時間などの計測値を返す。
+    ///
+    /// 個々の要求の内訳を見たい場合は、環境変数`VV_TRACE_PATH`にファイルを指定すると、[`tts`]・
+    /// [`audio_query`]・[`synthesis`]などの要求ごとの処理段階・ロック待ち・推論の区間がChrome
+    /// trace形式のJSONとして書き出される。`VV_TRACE_SAMPLE_RATE`(記録する要求の割合)と
+    /// `VV_TRACE_MIN_DURATION_MS`(書き出す要求の最短の所要時間)で、記録する要求を絞り込める。
+    ///
+    /// [`tts`]: Self::tts
+    /// [`audio_query`]: Self::audio_query
+    /// [`synthesis`]: Self::synthesis
+    pub fn stats(&self) -> SynthesizerStats {
+        self.synthesis_engine.inference_core().metrics().snapshot()
+    }
+
     /// AudioQueryから音声合成を行う。
+    ///
+    /// 音声は[`SynthesisOptions::output_format`]の形式で返す。
     pub async fn synthesis(
         &self,
         audio_query: &AudioQueryModel,
@@ -233,7 +448,34 @@ impl Synthesizer {
         options: &SynthesisOptions,
     ) -> Result<Vec<u8>> {
         self.synthesis_engine
-            .synthesis_wave_format(audio_query, style_id, options.enable_interrogative_upspeak)
+            .synthesis_wave_format(
+                audio_query,
+                style_id,
+                options.enable_interrogative_upspeak,
+                options.output_format,
+                &Request::from(options).traced("synthesis"),
+            )
+            .await
+    }
+
+    /// AudioQueryから音声合成を行い、WAVにする前の音声波形を返す。
+    ///
+    /// [`synthesis`]と同じ音声を、呼び出し側が用意した領域にWAVやヘッダの無いPCMとして書き出せる。
+    ///
+    /// [`synthesis`]: Self::synthesis
+    pub async fn synthesis_waveform(
+        &self,
+        audio_query: &AudioQueryModel,
+        style_id: StyleId,
+        options: &SynthesisOptions,
+    ) -> Result<Waveform> {
+        self.synthesis_engine
+            .synthesis_waveform(
+                audio_query,
+                style_id,
+                options.enable_interrogative_upspeak,
+                &Request::from(options).traced("synthesis"),
+            )
             .await
     }
 
@@ -245,7 +487,7 @@ impl Synthesizer {
     ) -> Result<Vec<f32>> {
         self.synthesis_engine
             .inference_core()
-            .predict_duration(phoneme_vector, style_id)
+            .predict_duration(phoneme_vector, style_id, &Request::default())
             .await
     }
 
@@ -273,6 +515,7 @@ impl Synthesizer {
                 start_accent_phrase_vector,
                 end_accent_phrase_vector,
                 style_id,
+                &Request::default(),
             )
             .await
     }
@@ -287,7 +530,14 @@ impl Synthesizer {
     ) -> Result<Vec<f32>> {
         self.synthesis_engine
             .inference_core()
-            .decode(length, phoneme_size, f0, phoneme_vector, style_id)
+            .decode(
+                length,
+                phoneme_size,
+                f0,
+                phoneme_vector,
+                style_id,
+                &Request::default(),
+            )
             .await
     }
 
@@ -310,7 +560,7 @@ impl Synthesizer {
     /// #         AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer, VoiceModel,
     /// #     };
     /// #
-    /// #     let mut syntesizer = Synthesizer::new_with_initialize(
+    /// #     let syntesizer = Synthesizer::new_with_initialize(
     /// #         Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
     /// #         &InitializeOptions {
     /// #             acceleration_mode: AccelerationMode::Cpu,
@@ -355,7 +605,7 @@ impl Synthesizer {
     /// #         AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer, VoiceModel,
     /// #     };
     /// #
-    /// #     let mut syntesizer = Synthesizer::new_with_initialize(
+    /// #     let syntesizer = Synthesizer::new_with_initialize(
     /// #         Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
     /// #         &InitializeOptions {
     /// #             acceleration_mode: AccelerationMode::Cpu,
@@ -394,17 +644,29 @@ impl Synthesizer {
         text: &str,
         style_id: StyleId,
         options: &AccentPhrasesOptions,
+    ) -> Result<Vec<AccentPhraseModel>> {
+        self.create_accent_phrases_with_request(text, style_id, options.kana, &Request::default())
+            .await
+    }
+
+    async fn create_accent_phrases_with_request(
+        &self,
+        text: &str,
+        style_id: StyleId,
+        kana: bool,
+        request: &Request,
     ) -> Result<Vec<AccentPhraseModel>> {
         if !self.synthesis_engine.is_openjtalk_dict_loaded() {
             return Err(Error::NotLoadedOpenjtalkDict);
         }
-        if options.kana {
+        request.ensure_not_canceled()?;
+        if kana {
             self.synthesis_engine
-                .replace_mora_data(&parse_kana(text)?, style_id)
+                .replace_mora_data(parse_kana(text)?, style_id, request)
                 .await
         } else {
             self.synthesis_engine
-                .create_accent_phrases(text, style_id)
+                .create_accent_phrases(text, style_id, request)
                 .await
         }
     }
@@ -416,7 +678,7 @@ impl Synthesizer {
         style_id: StyleId,
     ) -> Result<Vec<AccentPhraseModel>> {
         self.synthesis_engine
-            .replace_mora_data(accent_phrases, style_id)
+            .replace_mora_data(accent_phrases.to_vec(), style_id, &Request::default())
             .await
     }
 
@@ -427,7 +689,7 @@ impl Synthesizer {
         style_id: StyleId,
     ) -> Result<Vec<AccentPhraseModel>> {
         self.synthesis_engine
-            .replace_phoneme_length(accent_phrases, style_id)
+            .replace_phoneme_length(accent_phrases.to_vec(), style_id, &Request::default())
             .await
     }
 
@@ -438,7 +700,55 @@ impl Synthesizer {
         style_id: StyleId,
     ) -> Result<Vec<AccentPhraseModel>> {
         self.synthesis_engine
-            .replace_mora_pitch(accent_phrases, style_id)
+            .replace_mora_pitch(accent_phrases.to_vec(), style_id, &Request::default())
+            .await
+    }
+
+    /// AccentPhraseの配列のうち、`changed`のインデックスで示すものの音高・音素長を、特定の声で生成しなおす。
+    ///
+    /// 推論は変更されたアクセント句とその前後の数個のアクセント句を、句読点による無音の位置まで
+    /// 広げた範囲のみに対して行われる。それ以外のアクセント句はそのまま返る。アクセント句の多い
+    /// 文章で一部のアクセント句だけを編集したときに、[`replace_mora_data`]の代わりに用いることで
+    /// 推論の量を減らせる。結果は前後の文脈が限られる分、[`replace_mora_data`]とわずかに異なる
+    /// 場合がある。
+    ///
+    /// `changed`のうち範囲外のインデックスは無視される。
+    ///
+    /// [`replace_mora_data`]: Self::replace_mora_data
+    pub async fn replace_mora_data_incrementally(
+        &self,
+        accent_phrases: &[AccentPhraseModel],
+        changed: &[usize],
+        style_id: StyleId,
+    ) -> Result<Vec<AccentPhraseModel>> {
+        self.synthesis_engine
+            .replace_mora_data_incrementally(
+                accent_phrases.to_vec(),
+                changed,
+                style_id,
+                &Request::default(),
+            )
+            .await
+    }
+
+    /// AccentPhraseの配列のうち、`changed`のインデックスで示すものの音高を、特定の声で生成しなおす。
+    ///
+    /// [`replace_mora_data_incrementally`]の音高のみ版。
+    ///
+    /// [`replace_mora_data_incrementally`]: Self::replace_mora_data_incrementally
+    pub async fn replace_mora_pitch_incrementally(
+        &self,
+        accent_phrases: &[AccentPhraseModel],
+        changed: &[usize],
+        style_id: StyleId,
+    ) -> Result<Vec<AccentPhraseModel>> {
+        self.synthesis_engine
+            .replace_mora_pitch_incrementally(
+                accent_phrases.to_vec(),
+                changed,
+                style_id,
+                &Request::default(),
+            )
             .await
     }
 
@@ -461,7 +771,7 @@ impl Synthesizer {
     /// #         AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer, VoiceModel,
     /// #     };
     /// #
-    /// #     let mut syntesizer = Synthesizer::new_with_initialize(
+    /// #     let syntesizer = Synthesizer::new_with_initialize(
     /// #         Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
     /// #         &InitializeOptions {
     /// #             acceleration_mode: AccelerationMode::Cpu,
@@ -506,7 +816,7 @@ impl Synthesizer {
     /// #         AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer, VoiceModel,
     /// #     };
     /// #
-    /// #     let mut syntesizer = Synthesizer::new_with_initialize(
+    /// #     let syntesizer = Synthesizer::new_with_initialize(
     /// #         Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
     /// #         &InitializeOptions {
     /// #             acceleration_mode: AccelerationMode::Cpu,
@@ -547,42 +857,274 @@ impl Synthesizer {
         style_id: StyleId,
         options: &AudioQueryOptions,
     ) -> Result<AudioQueryModel> {
+        let request = &Request::default().traced("audio_query");
         let accent_phrases = self
-            .create_accent_phrases(text, style_id, &AccentPhrasesOptions { kana: options.kana })
+            .create_accent_phrases_with_request(text, style_id, options.kana, request)
             .await?;
-        let kana = create_kana(&accent_phrases);
-        Ok(AudioQueryModel::new(
-            accent_phrases,
-            1.,
-            0.,
-            1.,
-            1.,
-            0.1,
-            0.1,
-            SynthesisEngine::DEFAULT_SAMPLING_RATE,
-            false,
-            Some(kana),
-        ))
+        Ok(new_audio_query(accent_phrases))
     }
 
     /// テキスト音声合成を行う。
     ///
     /// `text`は[`options.kana`]が有効化されているときにはAquesTalk風記法として、そうでないときには
-    /// 日本語のテキストとして解釈される。
+    /// 日本語のテキストとして解釈される。音声は[`options.output_format`]の形式で返す。
     ///
     /// [`options.kana`]: crate::TtsOptions::kana
+    /// [`options.output_format`]: crate::TtsOptions::output_format
     pub async fn tts(
         &self,
         text: &str,
         style_id: StyleId,
         options: &TtsOptions,
     ) -> Result<Vec<u8>> {
-        let audio_query = &self
-            .audio_query(text, style_id, &AudioQueryOptions::from(options))
+        // 期限はテキストの解析を含めた全体に対して適用する
+        let request = &Request::from(options).traced("tts");
+        let accent_phrases = self
+            .create_accent_phrases_with_request(text, style_id, options.kana, request)
+            .await?;
+        let audio_query = &new_audio_query(accent_phrases);
+        self.synthesis_engine
+            .synthesis_wave_format(
+                audio_query,
+                style_id,
+                options.enable_interrogative_upspeak,
+                options.output_format,
+                request,
+            )
+            .await
+    }
+
+    /// テキスト音声合成を行い、WAVにする前の音声波形を返す。
+    ///
+    /// [`tts`]と同じ音声を、呼び出し側が用意した領域にWAVやヘッダの無いPCMとして書き出せる。
+    ///
+    /// [`tts`]: Self::tts
+    pub async fn tts_waveform(
+        &self,
+        text: &str,
+        style_id: StyleId,
+        options: &TtsOptions,
+    ) -> Result<Waveform> {
+        let request = &Request::from(options).traced("tts");
+        let accent_phrases = self
+            .create_accent_phrases_with_request(text, style_id, options.kana, request)
             .await?;
-        self.synthesis(audio_query, style_id, &SynthesisOptions::from(options))
+        let audio_query = &new_audio_query(accent_phrases);
+        self.synthesis_engine
+            .synthesis_waveform(
+                audio_query,
+                style_id,
+                options.enable_interrogative_upspeak,
+                request,
+            )
             .await
     }
+
+    /// 一つのテキストを、複数の声でそれぞれテキスト音声合成する。
+    ///
+    /// テキストの解析は一度だけ行い、それ以降の推論を声ごとに行う。同じテキストに対して[`tts`]を
+    /// `style_ids`の数だけ呼ぶのと同じ結果を、`style_ids`と同じ順で返す。声ごとの推論は呼び出した
+    /// タスクの中で行い、スレッドを新たに立てることはない。声ごとに並列に推論したい場合は、声ごとに
+    /// [`tts`]を別のタスクから呼ぶ。
+    ///
+    /// [`tts`]: Self::tts
+    pub async fn tts_multi_style(
+        &self,
+        text: &str,
+        style_ids: &[StyleId],
+        options: &TtsOptions,
+    ) -> Result<Vec<Vec<u8>>> {
+        if !self.synthesis_engine.is_openjtalk_dict_loaded() {
+            return Err(Error::NotLoadedOpenjtalkDict);
+        }
+        let request = &Request::from(options).traced("tts_multi_style");
+        request.ensure_not_canceled()?;
+        let accent_phrases = if options.kana {
+            parse_kana(text)?
+        } else {
+            self.synthesis_engine.analyze_text(text, request)?
+        };
+
+        future::try_join_all(style_ids.iter().map(|&style_id| {
+            let accent_phrases = accent_phrases.clone();
+            async move {
+                let accent_phrases = self
+                    .synthesis_engine
+                    .replace_mora_data(accent_phrases, style_id, request)
+                    .await?;
+                let audio_query = &new_audio_query(accent_phrases);
+                self.synthesis_engine
+                    .synthesis_wave_format(
+                        audio_query,
+                        style_id,
+                        options.enable_interrogative_upspeak,
+                        options.output_format,
+                        request,
+                    )
+                    .await
+            }
+        }))
+        .await
+    }
+
+    /// 定型文の一部だけを差し替えて読み上げるための、プロンプトのテンプレートを作る。
+    ///
+    /// `template`は日本語のテキストで、`{名前}`の部分が読み上げのたびに値を入れるスロットになる。
+    /// `{`と`}`そのものは`{{`と`}}`と書く。スロットの前後はアクセント句の区切りになる。
+    ///
+    /// テンプレート全体の音素長と音高を、スロットにはスロットの名前を仮に読ませて文全体から推論し、
+    /// その音声をあらかじめ生成しておく。
+    ///
+    /// # Errors
+    ///
+    /// `template`が不正であれば[`Error::InvalidPromptTemplate`]で失敗する。
+    pub async fn create_prompt_template(
+        &self,
+        template: &str,
+        style_id: StyleId,
+        options: &PromptTemplateOptions,
+    ) -> Result<PromptTemplate> {
+        if !self.synthesis_engine.is_openjtalk_dict_loaded() {
+            return Err(Error::NotLoadedOpenjtalkDict);
+        }
+        let request = &Request::default().traced("create_prompt_template");
+        let segments = prompt_template::parse(template)?;
+
+        let mut accent_phrases = vec![];
+        let mut ranges = Vec::with_capacity(segments.len());
+        for segment in &segments {
+            let start = accent_phrases.len();
+            accent_phrases.extend(
+                self.synthesis_engine
+                    .analyze_text(segment.text(), request)?,
+            );
+            ranges.push(start..accent_phrases.len());
+        }
+        let accent_phrases = self
+            .synthesis_engine
+            .replace_mora_data(accent_phrases, style_id, request)
+            .await?;
+        let audio_query = new_audio_query(accent_phrases);
+
+        let upspeak = options.enable_interrogative_upspeak;
+        let wave = self
+            .synthesis_engine
+            .synthesis(&audio_query, style_id, upspeak, request)
+            .await?;
+        let frames = SynthesisEngine::accent_phrase_frames(&audio_query, upspeak);
+        Ok(PromptTemplate::new(
+            style_id,
+            upspeak,
+            segments,
+            ranges,
+            audio_query,
+            frames,
+            wave,
+        ))
+    }
+
+    /// プロンプトのテンプレートのスロットに値を入れて読み上げる。
+    ///
+    /// `values`は、スロットの名前と値の組。値は[`options.kana`]が有効化されているときには
+    /// AquesTalk風記法として、そうでないときには日本語のテキストとして解釈される。
+    ///
+    /// スロットのアクセント句の音素長と音高だけを前後の文脈とともに推論しなおし、スロットとその
+    /// 前後の数フレームだけから音声波形を生成して、テンプレートの音声に継ぎ合わせる。そのため、
+    /// 同じ文を[`tts`]で読み上げるよりも推論が少なく済む。
+    /// [`options.enable_interrogative_upspeak`]がテンプレートを作ったときと異なる場合は、文全体から
+    /// 音声波形を生成する。
+    ///
+    /// 音声は[`options.output_format`]の形式で返す。
+    ///
+    /// # Errors
+    ///
+    /// スロットの値が足りない、あるいはテンプレートに無いスロットの値がある場合は
+    /// [`Error::InvalidPromptTemplate`]で失敗する。
+    ///
+    /// [`tts`]: Self::tts
+    /// [`options.kana`]: crate::TtsOptions::kana
+    /// [`options.enable_interrogative_upspeak`]: crate::TtsOptions::enable_interrogative_upspeak
+    /// [`options.output_format`]: crate::TtsOptions::output_format
+    pub async fn render_prompt_template(
+        &self,
+        template: &PromptTemplate,
+        values: &[(&str, &str)],
+        options: &TtsOptions,
+    ) -> Result<Vec<u8>> {
+        if !options.kana && !self.synthesis_engine.is_openjtalk_dict_loaded() {
+            return Err(Error::NotLoadedOpenjtalkDict);
+        }
+        let request = &Request::from(options).traced("render_prompt_template");
+        request.ensure_not_canceled()?;
+        let style_id = template.style_id();
+
+        let (accent_phrases, ranges) = template.fill(values, |value| {
+            if value.is_empty() {
+                Ok(Vec::new())
+            } else if options.kana {
+                Ok(parse_kana(value)?)
+            } else {
+                self.synthesis_engine.analyze_text(value, request)
+            }
+        })?;
+        let accent_phrases = self
+            .synthesis_engine
+            .replace_mora_data_incrementally(
+                accent_phrases,
+                &template.slot_accent_phrases(&ranges),
+                style_id,
+                request,
+            )
+            .await?;
+        let audio_query = &new_audio_query(accent_phrases);
+
+        let upspeak = options.enable_interrogative_upspeak;
+        if upspeak != template.enable_interrogative_upspeak() {
+            return self
+                .synthesis_engine
+                .synthesis_wave_format(
+                    audio_query,
+                    style_id,
+                    upspeak,
+                    options.output_format,
+                    request,
+                )
+                .await;
+        }
+
+        let frames = SynthesisEngine::accent_phrase_frames(audio_query, upspeak);
+        let splice = template.splice(&ranges, &frames);
+        let waves = self
+            .synthesis_engine
+            .synthesis_windows(audio_query, style_id, upspeak, splice.windows(), request)
+            .await?;
+        request.ensure_not_canceled()?;
+        let waveform = Waveform::new(splice.apply(template.wave(), &waves), audio_query);
+
+        let _timer = self
+            .synthesis_engine
+            .inference_core()
+            .metrics()
+            .start(Stage::WavEncode, request);
+        Ok(waveform.encode(options.output_format))
+    }
+}
+
+/// [`Synthesizer::audio_query`]が返す既定値のAudioQueryを作る。
+fn new_audio_query(accent_phrases: Vec<AccentPhraseModel>) -> AudioQueryModel {
+    let kana = create_kana(&accent_phrases);
+    AudioQueryModel::new(
+        accent_phrases,
+        1.,
+        0.,
+        1.,
+        1.,
+        0.1,
+        0.1,
+        SynthesisEngine::DEFAULT_SAMPLING_RATE,
+        false,
+        Some(kana),
+    )
 }
 
 #[cfg(windows)]
@@ -630,11 +1172,32 @@ mod tests {
     use crate::{engine::MoraModel, macros::tests::assert_debug_fmt_eq};
     use ::test_util::OPEN_JTALK_DIC_DIR;
 
+    #[rstest]
+    #[case((0, 0), 4, (4, 4))]
+    #[case((1, 0), 4, (1, 4))]
+    #[case((2, 3), 4, (2, 3))]
+    #[case((0, 0), 0, (0, 0))]
+    fn session_thread_options_or_cpu_num_threads_works(
+        #[case] (intra_op_num_threads, inter_op_num_threads): (u16, u16),
+        #[case] cpu_num_threads: u16,
+        #[case] expected: (u16, u16),
+    ) {
+        let options = SessionThreadOptions {
+            intra_op_num_threads,
+            inter_op_num_threads,
+        }
+        .or_cpu_num_threads(cpu_num_threads);
+        assert_eq!(
+            expected,
+            (options.intra_op_num_threads, options.inter_op_num_threads),
+        );
+    }
+
     #[rstest]
     #[case(Ok(()))]
     #[tokio::test]
     async fn load_model_works(#[case] expected_result_at_initialized: Result<()>) {
-        let mut syntesizer = Synthesizer::new_with_initialize(
+        let syntesizer = Synthesizer::new_with_initialize(
             Arc::new(OpenJtalk::new_without_dic()),
             &InitializeOptions {
                 acceleration_mode: AccelerationMode::Cpu,
@@ -675,7 +1238,7 @@ mod tests {
     #[tokio::test]
     async fn is_loaded_model_by_style_id_works(#[case] style_id: u32, #[case] expected: bool) {
         let style_id = StyleId::new(style_id);
-        let mut syntesizer = Synthesizer::new_with_initialize(
+        let syntesizer = Synthesizer::new_with_initialize(
             Arc::new(OpenJtalk::new_without_dic()),
             &InitializeOptions {
                 acceleration_mode: AccelerationMode::Cpu,
@@ -704,7 +1267,7 @@ mod tests {
     #[rstest]
     #[tokio::test]
     async fn predict_duration_works() {
-        let mut syntesizer = Synthesizer::new_with_initialize(
+        let syntesizer = Synthesizer::new_with_initialize(
             Arc::new(OpenJtalk::new_without_dic()),
             &InitializeOptions {
                 acceleration_mode: AccelerationMode::Cpu,
@@ -736,7 +1299,7 @@ mod tests {
     #[rstest]
     #[tokio::test]
     async fn predict_intonation_works() {
-        let mut syntesizer = Synthesizer::new_with_initialize(
+        let syntesizer = Synthesizer::new_with_initialize(
             Arc::new(OpenJtalk::new_without_dic()),
             &InitializeOptions {
                 acceleration_mode: AccelerationMode::Cpu,
@@ -778,7 +1341,7 @@ mod tests {
     #[rstest]
     #[tokio::test]
     async fn decode_works() {
-        let mut syntesizer = Synthesizer::new_with_initialize(
+        let syntesizer = Synthesizer::new_with_initialize(
             Arc::new(OpenJtalk::new_without_dic()),
             &InitializeOptions {
                 acceleration_mode: AccelerationMode::Cpu,
@@ -1119,6 +1682,414 @@ mod tests {
         );
     }
 
+    #[rstest]
+    #[tokio::test]
+    async fn mora_data_incrementally_matches_full_recomputation() {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+
+        // 複数の文からなる文章の途中のアクセント句を一つだけ編集する
+        let mut accent_phrases = syntesizer
+            .create_accent_phrases(
+                "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。\
+                 何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。",
+                StyleId::new(0),
+                &AccentPhrasesOptions { kana: false },
+            )
+            .await
+            .unwrap();
+        let edited = (accent_phrases.len() / 2..accent_phrases.len())
+            .find(|&i| accent_phrases[i].moras().len() >= 2)
+            .unwrap();
+        let accent_phrase = &accent_phrases[edited];
+        accent_phrases[edited] = AccentPhraseModel::new(
+            accent_phrase.moras().clone(),
+            if *accent_phrase.accent() == 1 {
+                accent_phrase.moras().len()
+            } else {
+                1
+            },
+            accent_phrase.pause_mora().clone(),
+            *accent_phrase.is_interrogative(),
+        );
+
+        let full = syntesizer
+            .replace_mora_data(&accent_phrases, StyleId::new(1))
+            .await
+            .unwrap();
+        let incremental = syntesizer
+            .replace_mora_data_incrementally(&accent_phrases, &[edited], StyleId::new(1))
+            .await
+            .unwrap();
+        assert_moras_approx_eq(&full[edited], &incremental[edited]);
+        for i in (0..accent_phrases.len()).filter(|&i| i != edited) {
+            assert_eq!(
+                serde_json::to_value(&accent_phrases[i]).unwrap(),
+                serde_json::to_value(&incremental[i]).unwrap(),
+                "unchanged accent phrases should be returned as is",
+            );
+        }
+
+        let full = syntesizer
+            .replace_mora_pitch(&accent_phrases, StyleId::new(1))
+            .await
+            .unwrap();
+        let incremental = syntesizer
+            .replace_mora_pitch_incrementally(&accent_phrases, &[edited], StyleId::new(1))
+            .await
+            .unwrap();
+        assert_moras_approx_eq(&full[edited], &incremental[edited]);
+    }
+
+    #[rstest]
+    #[tokio::test]
+    async fn mora_data_incrementally_leaves_distant_accent_phrases() {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+
+        let accent_phrases = syntesizer
+            .create_accent_phrases(
+                "同じ、文章、です。完全に、同一です。これは、テストの、ための、長い、文章です。",
+                StyleId::new(0),
+                &AccentPhrasesOptions { kana: false },
+            )
+            .await
+            .unwrap();
+        let last = accent_phrases.len() - 1;
+
+        let modified_accent_phrases = syntesizer
+            .replace_mora_data_incrementally(
+                &accent_phrases,
+                &[last, accent_phrases.len() + 10],
+                StyleId::new(1),
+            )
+            .await
+            .unwrap();
+
+        assert_eq!(accent_phrases.len(), modified_accent_phrases.len());
+        assert_eq!(
+            serde_json::to_value(&accent_phrases[..last]).unwrap(),
+            serde_json::to_value(&modified_accent_phrases[..last]).unwrap(),
+        );
+        assert!(
+            any_mora_param_changed(
+                &accent_phrases[last..],
+                &modified_accent_phrases[last..],
+                MoraModel::pitch
+            ),
+            "replace_mora_data_incrementally() does not work: mora.pitch() is not changed."
+        );
+    }
+
+    #[rstest]
+    #[case(false, "これはテストです")]
+    #[case(true, "コレワ'/テ'_ストデ_ス")]
+    #[tokio::test]
+    async fn tts_multi_style_matches_tts(#[case] kana: bool, #[case] text: &str) {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        let style_ids = [StyleId::new(0), StyleId::new(1), StyleId::new(0)];
+        let options = TtsOptions {
+            kana,
+            ..Default::default()
+        };
+
+        let wavs = syntesizer
+            .tts_multi_style(text, &style_ids, &options)
+            .await
+            .unwrap();
+
+        assert_eq!(style_ids.len(), wavs.len());
+        for (&style_id, wav) in style_ids.iter().zip(&wavs) {
+            let expected = syntesizer.tts(text, style_id, &options).await.unwrap();
+            assert!(expected == *wav, "result for {style_id} differs from `tts`");
+        }
+    }
+
+    #[rstest]
+    #[case(&[("名前", "山田"), ("日付", "三月五日")], true)]
+    #[case(&[("日付", "明日"), ("名前", "")], true)]
+    #[case(&[("名前", "山田"), ("日付", "三月五日")], false)]
+    #[tokio::test]
+    async fn render_prompt_template_works(
+        #[case] values: &[(&str, &str)],
+        #[case] enable_interrogative_upspeak: bool,
+    ) {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        let template = syntesizer
+            .create_prompt_template(
+                "{名前}様、{日付}のご予約を承りました。",
+                StyleId::new(1),
+                &Default::default(),
+            )
+            .await
+            .unwrap();
+        assert_eq!(
+            vec!["名前", "日付"],
+            template.slot_names().collect::<Vec<_>>()
+        );
+
+        let options = TtsOptions {
+            enable_interrogative_upspeak,
+            ..Default::default()
+        };
+        let wav = syntesizer
+            .render_prompt_template(&template, values, &options)
+            .await
+            .unwrap();
+        assert_eq!(b"RIFF", &wav[..4]);
+        assert!(wav.len() > 44);
+    }
+
+    #[rstest]
+    #[case(&[("名前", "山田")])]
+    #[case(&[("名前", "山田"), ("日付", "明日"), ("時刻", "三時")])]
+    #[tokio::test]
+    async fn render_prompt_template_fails_with_mismatched_slots(#[case] values: &[(&str, &str)]) {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        let template = syntesizer
+            .create_prompt_template(
+                "{名前}様、{日付}のご予約を承りました。",
+                StyleId::new(1),
+                &Default::default(),
+            )
+            .await
+            .unwrap();
+
+        let result = syntesizer
+            .render_prompt_template(&template, values, &Default::default())
+            .await;
+
+        assert!(
+            matches!(result, Err(Error::InvalidPromptTemplate(_))),
+            "{result:?}"
+        );
+    }
+
+    #[rstest]
+    #[tokio::test]
+    async fn stats_works() {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        assert!(syntesizer.stats().stages.values().all(|h| h.count == 0));
+
+        syntesizer
+            .tts("これはテストです", StyleId::new(0), &Default::default())
+            .await
+            .unwrap();
+
+        let stats = syntesizer.stats();
+        for stage in [
+            Stage::OpenJtalkAnalysis,
+            Stage::LabelParse,
+            Stage::PredictDuration,
+            Stage::PredictIntonation,
+            Stage::FrameExpansion,
+            Stage::Decode,
+            Stage::WavEncode,
+        ] {
+            assert_eq!(1, stats.stages[&stage].count, "{stage:?}");
+        }
+        assert_eq!(1, stats.lock_waits[&LockedResource::OpenJtalk].count);
+        assert_eq!(1, stats.lock_waits[&LockedResource::DecodeSession].count);
+        assert_eq!(3, stats.queue_waits[&Priority::Normal].count);
+        assert_eq!(0, stats.queue_waits[&Priority::Interactive].count);
+        assert_eq!(0, stats.deadline_rejections[&Priority::Normal]);
+    }
+
+    #[rstest]
+    #[tokio::test]
+    async fn tts_auto_loads_voice_model() {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                auto_load_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        let style_id = StyleId::new(0);
+        assert!(!syntesizer.is_loaded_model_by_style_id(style_id));
+
+        for _ in 0..2 {
+            syntesizer
+                .tts("これはテストです", style_id, &Default::default())
+                .await
+                .unwrap();
+        }
+
+        assert!(syntesizer.is_loaded_model_by_style_id(style_id));
+        let stats = syntesizer.stats();
+        assert_eq!(1, stats.model_loads.count);
+        assert!(stats.resident_model_bytes.current > 0);
+    }
+
+    #[rstest]
+    #[case(Some(CancellationToken::canceled()), None, Error::Canceled)]
+    #[case(None, Some(Duration::ZERO), Error::TimedOut)]
+    #[tokio::test]
+    async fn tts_stops_when_canceled(
+        #[case] cancellation_token: Option<CancellationToken>,
+        #[case] timeout: Option<Duration>,
+        #[case] expected: Error,
+    ) {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        let options = TtsOptions {
+            cancellation_token,
+            timeout,
+            ..Default::default()
+        };
+
+        let result = syntesizer
+            .tts("これはテストです", StyleId::new(0), &options)
+            .await;
+
+        assert_debug_fmt_eq!(Err::<Vec<u8>, _>(expected), result);
+        // テキストの解析も推論も行われない
+        let stats = syntesizer.stats();
+        assert!(stats.stages.values().all(|h| h.count == 0));
+        assert!(stats.queue_waits.values().all(|h| h.count == 0));
+    }
+
+    #[rstest]
+    #[tokio::test]
+    async fn tts_stops_when_canceled_while_running() {
+        let syntesizer = Synthesizer::new_with_initialize(
+            Arc::new(OpenJtalk::new_with_initialize(OPEN_JTALK_DIC_DIR).unwrap()),
+            &InitializeOptions {
+                acceleration_mode: AccelerationMode::Cpu,
+                load_all_models: true,
+                ..Default::default()
+            },
+        )
+        .await
+        .unwrap();
+        let cancellation_token = CancellationToken::new();
+        // 音素長の推論を終え、音高の推論に進んだところで中断する
+        syntesizer
+            .synthesis_engine
+            .inference_core()
+            .metrics()
+            .set_stage_hook({
+                let cancellation_token = cancellation_token.clone();
+                move |stage| {
+                    if stage == Stage::PredictIntonation {
+                        cancellation_token.cancel();
+                    }
+                }
+            });
+        let options = TtsOptions {
+            cancellation_token: Some(cancellation_token),
+            ..Default::default()
+        };
+
+        let result = syntesizer
+            .tts("これはテストです", StyleId::new(0), &options)
+            .await;
+
+        assert_debug_fmt_eq!(Err::<Vec<u8>, _>(Error::Canceled), result);
+        let stats = syntesizer.stats();
+        // 中断までに一つ目の推論セッションは使われている
+        assert_eq!(
+            1,
+            stats.lock_waits[&LockedResource::PredictDurationSession].count,
+        );
+        // 以降の推論セッションは使われず、音声波形の生成に関わる段階も行われない
+        for resource in [
+            LockedResource::PredictIntonationSession,
+            LockedResource::DecodeSession,
+        ] {
+            assert_eq!(0, stats.lock_waits[&resource].count, "{resource:?}");
+        }
+        for stage in [Stage::FrameExpansion, Stage::Decode, Stage::WavEncode] {
+            assert_eq!(0, stats.stages[&stage].count, "{stage:?}");
+        }
+    }
+
+    /// 長さの異なる入力で推論した結果を比べるため、浮動小数点数の誤差は許容する。
+    fn assert_moras_approx_eq(expected: &AccentPhraseModel, actual: &AccentPhraseModel) {
+        let params = |mora: &MoraModel| {
+            [
+                mora.consonant_length().unwrap_or_default(),
+                *mora.vowel_length(),
+                *mora.pitch(),
+            ]
+        };
+        assert_eq!(expected.moras().len(), actual.moras().len());
+        let moras = std::iter::zip(expected.moras(), actual.moras())
+            .chain(std::iter::zip(expected.pause_mora(), actual.pause_mora()));
+        for (expected_mora, actual_mora) in moras {
+            for (expected, actual) in std::iter::zip(params(expected_mora), params(actual_mora)) {
+                assert!(
+                    (expected - actual).abs() < 1e-4,
+                    "{expected} != {actual} ({})",
+                    actual_mora.text(),
+                );
+            }
+        }
+    }
+
     fn any_mora_param_changed<T: PartialEq>(
         before: &[AccentPhraseModel],
         after: &[AccentPhraseModel],
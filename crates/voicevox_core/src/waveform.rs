@@ -0,0 +1,508 @@
+//! 音声合成の結果の音声波形と、その書き出し。
+
+mod flac;
+mod g711;
+
+use const_default::ConstDefault;
+use serde::{Deserialize, Serialize};
+
+use self::{
+    flac::FlacEncoder,
+    g711::{G711Encoder, Law},
+};
+use crate::{engine::SynthesisEngine, AudioQueryModel};
+
+/// [`Synthesizer::synthesis`]などが返す音声の形式。
+///
+/// [`Synthesizer::synthesis`]: crate::Synthesizer::synthesis
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Deserialize, Serialize)]
+#[serde(rename_all = "snake_case")]
+pub enum OutputFormat {
+    /// 16ビットのリニアPCMのWAV。
+    Wav,
+    /// 可逆圧縮のFLAC。WAVと同じサンプルを、およそ半分以下の大きさで表す。
+    Flac,
+    /// G.711のμ-law。電話向けに、ヘッダの無い8kHzのモノラルの8ビットのサンプルとする。
+    ///
+    /// AudioQueryのチャンネル数とサンプリングレートは無視される。
+    MuLaw,
+    /// G.711のA-law。[`OutputFormat::MuLaw`]と同様。
+    ALaw,
+}
+
+impl ConstDefault for OutputFormat {
+    const DEFAULT: Self = Self::Wav;
+}
+
+/// ヘッダの無いPCMとして書き出すときの、サンプルの形式。
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum SampleFormat {
+    /// 16ビット符号付き整数。WAVと同じ値になる。
+    I16,
+    /// 32ビット浮動小数点数。値は-1から1の範囲に収められる。
+    F32,
+}
+
+impl SampleFormat {
+    /// 1サンプルのバイト数。
+    pub fn bytes_per_sample(self) -> usize {
+        match self {
+            Self::I16 => 2,
+            Self::F32 => 4,
+        }
+    }
+}
+
+/// 音声合成の結果の音声波形。
+///
+/// AudioQueryの音量・チャンネル数・サンプリングレートは書き出す時点で適用される。書き出し先の領域は
+/// 呼び出し側が用意するため、途中で別の領域を確保してコピーすることなく、WAVやヘッダの無いPCMとして
+/// 書き出せる。
+pub struct Waveform {
+    /// 音声波形の生成モデルの出力。24kHzのモノラル。
+    wave: Vec<f32>,
+    output: OutputParams,
+}
+
+/// AudioQueryのうち、書き出しに関わるもの。
+#[derive(Clone, Copy)]
+struct OutputParams {
+    volume_scale: f32,
+    sampling_rate: u32,
+    num_channels: u16,
+}
+
+impl Waveform {
+    pub(crate) fn new(wave: Vec<f32>, query: &AudioQueryModel) -> Self {
+        Self {
+            wave,
+            output: OutputParams::new(query),
+        }
+    }
+
+    /// サンプリングレート。
+    pub fn sampling_rate(&self) -> u32 {
+        self.output.sampling_rate
+    }
+
+    /// チャンネル数。
+    pub fn num_channels(&self) -> u16 {
+        self.output.num_channels
+    }
+
+    /// フレーム数。1フレームはチャンネル数分のサンプルからなる。
+    pub fn num_frames(&self) -> usize {
+        self.output.num_samples(self.wave.len()) / usize::from(self.output.num_channels)
+    }
+
+    /// ヘッダの無いPCMとして書き出したときのバイト数。
+    pub fn pcm_len(&self, format: SampleFormat) -> usize {
+        self.output.num_samples(self.wave.len()) * format.bytes_per_sample()
+    }
+
+    /// ヘッダの無いPCMとして`out`に書き出す。
+    ///
+    /// サンプルはネイティブのバイトオーダーで、チャンネルはインターリーブされる。
+    ///
+    /// # Panics
+    ///
+    /// `out`の長さが[`pcm_len`]と異なるときパニックする。
+    ///
+    /// [`pcm_len`]: Self::pcm_len
+    pub fn write_pcm(&self, format: SampleFormat, out: &mut [u8]) {
+        match format {
+            SampleFormat::I16 => self
+                .output
+                .write_samples(&self.wave, out, |v| to_i16(v).to_ne_bytes()),
+            SampleFormat::F32 => self.output.write_samples(&self.wave, out, f32::to_ne_bytes),
+        }
+    }
+
+    /// WAVとして書き出したときのバイト数。
+    pub fn wav_len(&self) -> usize {
+        WAV_HEADER_LEN + self.pcm_len(SampleFormat::I16)
+    }
+
+    /// WAVとして`out`に書き出す。
+    ///
+    /// # Panics
+    ///
+    /// `out`の長さが[`wav_len`]と異なるときパニックする。
+    ///
+    /// [`wav_len`]: Self::wav_len
+    pub fn write_wav(&self, out: &mut [u8]) {
+        self.output.write_wav(&self.wave, out);
+    }
+
+    /// WAVにする。
+    pub fn to_wav(&self) -> Vec<u8> {
+        self.output.to_wav(&self.wave)
+    }
+
+    /// `format`の形式にする。
+    ///
+    /// [`Encoder`]に一つだけ音声波形を渡した場合と異なり、WAVやFLACのヘッダには全体の長さが
+    /// 書かれる。
+    pub fn encode(&self, format: OutputFormat) -> Vec<u8> {
+        if format == OutputFormat::Wav {
+            return self.to_wav();
+        }
+        let mut out = Vec::new();
+        let mut encoder = Encoder {
+            total_frames: Some(self.num_frames() as u64),
+            ..Encoder::new(format)
+        };
+        encoder.write(self, &mut out);
+        encoder.finish(&mut out);
+        out
+    }
+}
+
+/// 音声波形を少しずつ受け取り、一続きの音声として書き出すエンコーダ。
+///
+/// 文ごとなどに分けて合成した音声を、合成できたものから順に書き出すのに使う。最初の音声波形を
+/// 受け取った時点でヘッダを書き出す。WAVのヘッダには長さが分からないことを示す最大値が書かれ、
+/// FLACのヘッダには長さが書かれない。どちらも一般的なデコーダで読める。
+///
+/// ```
+/// # fn write(
+/// #     waveforms: &[voicevox_core::Waveform],
+/// #     mut send: impl FnMut(&[u8]),
+/// # ) {
+/// use voicevox_core::{Encoder, OutputFormat};
+///
+/// let mut encoder = Encoder::new(OutputFormat::Flac);
+/// let mut buf = Vec::new();
+/// for waveform in waveforms {
+///     encoder.write(waveform, &mut buf);
+///     send(&buf);
+///     buf.clear();
+/// }
+/// encoder.finish(&mut buf);
+/// send(&buf);
+/// # }
+/// ```
+pub struct Encoder {
+    format: OutputFormat,
+    /// 分かっている場合の、全体のフレーム数。
+    total_frames: Option<u64>,
+    /// 最初の音声波形を受け取るまでは`None`。
+    state: Option<(StreamParams, Box<dyn FormatEncoder>)>,
+}
+
+/// 一続きの音声の中で変わってはならない、サンプリングレートとチャンネル数。
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+struct StreamParams {
+    sampling_rate: u32,
+    num_channels: u16,
+}
+
+impl Encoder {
+    pub fn new(format: OutputFormat) -> Self {
+        Self {
+            format,
+            total_frames: None,
+            state: None,
+        }
+    }
+
+    /// 音声波形の続きを`out`の末尾に書き出す。
+    ///
+    /// # Panics
+    ///
+    /// `waveform`のサンプリングレートかチャンネル数が、最初に渡した音声波形と異なるときパニック
+    /// する。
+    pub fn write(&mut self, waveform: &Waveform, out: &mut Vec<u8>) {
+        let params = StreamParams {
+            sampling_rate: waveform.sampling_rate(),
+            num_channels: waveform.num_channels(),
+        };
+        let (first_params, encoder) = self.state.get_or_insert_with(|| {
+            let encoder = new_format_encoder(self.format, params, self.total_frames, out);
+            (params, encoder)
+        });
+        assert_eq!(
+            *first_params, params,
+            "サンプリングレートとチャンネル数は変えられません",
+        );
+        encoder.write(waveform, out);
+    }
+
+    /// 残りを`out`の末尾に書き出す。一つも音声波形を受け取っていなければ何も書き出さない。
+    pub fn finish(self, out: &mut Vec<u8>) {
+        if let Some((_, encoder)) = self.state {
+            encoder.finish(out);
+        }
+    }
+}
+
+/// 出力形式ごとのエンコーダ。
+trait FormatEncoder: Send {
+    fn write(&mut self, waveform: &Waveform, out: &mut Vec<u8>);
+    fn finish(self: Box<Self>, out: &mut Vec<u8>);
+}
+
+/// `format`のエンコーダを作り、ヘッダを書き出す。
+fn new_format_encoder(
+    format: OutputFormat,
+    params: StreamParams,
+    total_frames: Option<u64>,
+    out: &mut Vec<u8>,
+) -> Box<dyn FormatEncoder> {
+    match format {
+        OutputFormat::Wav => {
+            let mut header = [0; WAV_HEADER_LEN];
+            let num_samples = total_frames.map(|n| n as usize * usize::from(params.num_channels));
+            write_wav_header(params, num_samples, &mut header);
+            out.extend_from_slice(&header);
+            Box::new(WavEncoder)
+        }
+        OutputFormat::Flac => {
+            let encoder = FlacEncoder::new(params.sampling_rate, params.num_channels, total_frames);
+            encoder.write_header(out);
+            Box::new(encoder)
+        }
+        OutputFormat::MuLaw => Box::new(G711Encoder::new(
+            Law::MuLaw,
+            SynthesisEngine::DEFAULT_SAMPLING_RATE,
+        )),
+        OutputFormat::ALaw => Box::new(G711Encoder::new(
+            Law::ALaw,
+            SynthesisEngine::DEFAULT_SAMPLING_RATE,
+        )),
+    }
+}
+
+struct WavEncoder;
+
+impl FormatEncoder for WavEncoder {
+    fn write(&mut self, waveform: &Waveform, out: &mut Vec<u8>) {
+        let start = out.len();
+        out.resize(start + waveform.pcm_len(SampleFormat::I16), 0);
+        waveform
+            .output
+            .write_samples(&waveform.wave, &mut out[start..], |v| {
+                to_i16(v).to_le_bytes()
+            });
+    }
+
+    fn finish(self: Box<Self>, _: &mut Vec<u8>) {}
+}
+
+impl FormatEncoder for FlacEncoder {
+    fn write(&mut self, waveform: &Waveform, out: &mut Vec<u8>) {
+        let samples = waveform
+            .output
+            .i16_samples(&waveform.wave)
+            .collect::<Vec<_>>();
+        FlacEncoder::write(self, &samples, out);
+    }
+
+    fn finish(self: Box<Self>, out: &mut Vec<u8>) {
+        FlacEncoder::finish(*self, out);
+    }
+}
+
+impl FormatEncoder for G711Encoder {
+    fn write(&mut self, waveform: &Waveform, out: &mut Vec<u8>) {
+        G711Encoder::write(self, &waveform.wave, waveform.output.volume_scale, out);
+    }
+
+    fn finish(self: Box<Self>, out: &mut Vec<u8>) {
+        G711Encoder::finish(*self, out);
+    }
+}
+
+const WAV_HEADER_LEN: usize = 44;
+
+/// WAVと同じく、16ビット整数に量子化する。
+fn to_i16(v: f32) -> i16 {
+    (v * 0x7fff as f32) as i16
+}
+
+impl OutputParams {
+    fn new(query: &AudioQueryModel) -> Self {
+        Self {
+            volume_scale: *query.volume_scale(),
+            sampling_rate: *query.output_sampling_rate(),
+            num_channels: if *query.output_stereo() { 2 } else { 1 },
+        }
+    }
+
+    /// 元の1サンプルを、何サンプルとして書き出すか。
+    fn repeat_count(&self) -> usize {
+        // TODO: 44.1kHzなどの対応
+        (self.sampling_rate / SynthesisEngine::DEFAULT_SAMPLING_RATE) as usize
+            * usize::from(self.num_channels)
+    }
+
+    fn num_samples(&self, wave_len: usize) -> usize {
+        wave_len * self.repeat_count()
+    }
+
+    /// 音量を適用した各サンプルを`encode`で変換し、チャンネル数とサンプリングレートに合わせて
+    /// 繰り返しながら`out`に書き込む。
+    fn write_samples<const N: usize>(
+        &self,
+        wave: &[f32],
+        out: &mut [u8],
+        encode: impl Fn(f32) -> [u8; N],
+    ) {
+        let repeat_count = self.repeat_count();
+        assert_eq!(self.num_samples(wave.len()) * N, out.len());
+        if repeat_count == 0 {
+            return;
+        }
+        for (value, out) in wave.iter().zip(out.chunks_exact_mut(repeat_count * N)) {
+            let sample = encode((value * self.volume_scale).clamp(-1., 1.));
+            for out in out.chunks_exact_mut(N) {
+                out.copy_from_slice(&sample);
+            }
+        }
+    }
+
+    /// [`write_samples`]と同じサンプルを、16ビット整数として返す。
+    ///
+    /// [`write_samples`]: Self::write_samples
+    fn i16_samples<'a>(&self, wave: &'a [f32]) -> impl Iterator<Item = i16> + 'a {
+        let Self { volume_scale, .. } = *self;
+        let repeat_count = self.repeat_count();
+        wave.iter().flat_map(move |value| {
+            let sample = to_i16((value * volume_scale).clamp(-1., 1.));
+            std::iter::repeat(sample).take(repeat_count)
+        })
+    }
+
+    fn write_wav(&self, wave: &[f32], out: &mut [u8]) {
+        assert!(out.len() >= WAV_HEADER_LEN);
+        let (header, data) = out.split_at_mut(WAV_HEADER_LEN);
+        let params = StreamParams {
+            sampling_rate: self.sampling_rate,
+            num_channels: self.num_channels,
+        };
+        write_wav_header(params, Some(self.num_samples(wave.len())), header);
+        self.write_samples(wave, data, |v| to_i16(v).to_le_bytes());
+    }
+
+    fn to_wav(&self, wave: &[f32]) -> Vec<u8> {
+        let mut wav = vec![0; WAV_HEADER_LEN + self.num_samples(wave.len()) * 2];
+        self.write_wav(wave, &mut wav);
+        wav
+    }
+}
+
+/// WAVのヘッダを書く。`num_samples`が分からなければ、長さには最大値を書く。
+fn write_wav_header(params: StreamParams, num_samples: Option<usize>, header: &mut [u8]) {
+    let bit_depth: u16 = 16;
+    let block_size: u16 = bit_depth * params.num_channels / 8;
+    let bytes_size = num_samples.map_or(u32::MAX - WAV_HEADER_LEN as u32, |n| (n * 2) as u32);
+    let wave_size = bytes_size + WAV_HEADER_LEN as u32;
+    let block_rate = params.sampling_rate * block_size as u32;
+
+    let fields: [&[u8]; 12] = [
+        b"RIFF",
+        &(wave_size - 8).to_le_bytes(),
+        b"WAVEfmt ",
+        &16_u32.to_le_bytes(), // fmt header length
+        &1_u16.to_le_bytes(),  //linear PCM
+        &params.num_channels.to_le_bytes(),
+        &params.sampling_rate.to_le_bytes(),
+        &block_rate.to_le_bytes(),
+        &block_size.to_le_bytes(),
+        &bit_depth.to_le_bytes(),
+        b"data",
+        &bytes_size.to_le_bytes(),
+    ];
+    let mut pos = 0;
+    for field in fields {
+        header[pos..pos + field.len()].copy_from_slice(field);
+        pos += field.len();
+    }
+}
+
+/// 音声波形を、AudioQueryの音量・チャンネル数・サンプリングレートに従ってWAVにする。
+pub(crate) fn to_wav(wave: &[f32], query: &AudioQueryModel) -> Vec<u8> {
+    OutputParams::new(query).to_wav(wave)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+
+    fn query(volume_scale: f32, output_sampling_rate: u32, output_stereo: bool) -> AudioQueryModel {
+        AudioQueryModel::new(
+            vec![],
+            1.,
+            0.,
+            1.,
+            volume_scale,
+            0.1,
+            0.1,
+            output_sampling_rate,
+            output_stereo,
+            None,
+        )
+    }
+
+    #[rstest]
+    #[case(24000, false, 1, 3)]
+    #[case(48000, true, 2, 6)]
+    fn waveform_works(
+        #[case] sampling_rate: u32,
+        #[case] stereo: bool,
+        #[case] num_channels: u16,
+        #[case] num_frames: usize,
+    ) {
+        let waveform = Waveform::new(vec![0.5, -2., 0.], &query(1., sampling_rate, stereo));
+        assert_eq!(num_channels, waveform.num_channels());
+        assert_eq!(num_frames, waveform.num_frames());
+
+        let mut f32_pcm = vec![0; waveform.pcm_len(SampleFormat::F32)];
+        waveform.write_pcm(SampleFormat::F32, &mut f32_pcm);
+        let samples = f32_pcm
+            .chunks_exact(4)
+            .map(|b| f32::from_ne_bytes(b.try_into().unwrap()))
+            .collect::<Vec<_>>();
+        let repeat_count = usize::from(num_channels) * (sampling_rate / 24000) as usize;
+        let expected = [0.5, -1., 0.]
+            .iter()
+            .flat_map(|&v| std::iter::repeat(v).take(repeat_count))
+            .collect::<Vec<_>>();
+        assert_eq!(expected, samples);
+
+        let mut i16_pcm = vec![0; waveform.pcm_len(SampleFormat::I16)];
+        waveform.write_pcm(SampleFormat::I16, &mut i16_pcm);
+        let wav = waveform.to_wav();
+        assert_eq!(waveform.wav_len(), wav.len());
+        assert_eq!(i16_pcm, wav[WAV_HEADER_LEN..]);
+        assert_eq!(b"RIFF", &wav[..4]);
+        assert_eq!(num_channels.to_le_bytes(), wav[22..24]);
+        assert_eq!(sampling_rate.to_le_bytes(), wav[24..28]);
+        assert_eq!(((wav.len() - 44) as u32).to_le_bytes(), wav[40..44]);
+    }
+
+    #[rstest]
+    #[case(OutputFormat::Wav, WAV_HEADER_LEN)]
+    #[case(OutputFormat::Flac, 42)]
+    #[case(OutputFormat::MuLaw, 0)]
+    #[case(OutputFormat::ALaw, 0)]
+    fn encoder_works(#[case] format: OutputFormat, #[case] header_len: usize) {
+        let query = query(1., 48000, true);
+        let wave = (0..10000)
+            .map(|i| (i as f32 / 100.).sin() * 0.5)
+            .collect::<Vec<_>>();
+        let whole = Waveform::new(wave.clone(), &query).encode(format);
+
+        // 分けて渡しても、ヘッダに書かれる長さ以外は同じものになる
+        let mut encoder = Encoder::new(format);
+        let mut streamed = Vec::new();
+        for chunk in wave.chunks(3000) {
+            encoder.write(&Waveform::new(chunk.to_vec(), &query), &mut streamed);
+        }
+        encoder.finish(&mut streamed);
+        assert_eq!(whole.len(), streamed.len());
+        assert_eq!(whole[header_len..], streamed[header_len..]);
+    }
+}
@@ -0,0 +1,563 @@
+//! 可逆圧縮の音声形式、FLACのエンコーダ。
+//!
+//! 固定の予測器(0〜4次)とライス符号だけを使う。線形予測(LPC)は使わないため圧縮率はlibFLACの
+//! 既定の設定に及ばないが、音声合成の出力のように滑らかな波形であれば十分に小さくなる。
+//!
+//! ステレオは左チャンネルと、左右の差(サイド)として符号化する。音声合成の出力は左右が同じである
+//! ため、サイドはほぼ無視できる大きさになる。
+
+/// 1フレームあたりのサンプル数。
+const BLOCK_SIZE: usize = 4096;
+const BITS_PER_SAMPLE: u32 = 16;
+const MAX_FIXED_ORDER: usize = 4;
+const MAX_PARTITION_ORDER: u32 = 6;
+/// 4ビットのライスパラメータで表せる最大値。15はエスケープに使われる。
+const MAX_RICE_PARAMETER: u32 = 14;
+
+/// インターリーブされた16ビットのサンプルを、少しずつFLACにするエンコーダ。
+pub(super) struct FlacEncoder {
+    sampling_rate: u32,
+    num_channels: usize,
+    /// STREAMINFOに書くフレーム数。分からなければ0。
+    total_frames: u64,
+    /// まだフレームにしていないサンプル。
+    pending: Vec<i16>,
+    frame_number: u32,
+    /// 左チャンネルとサイドの作業用の領域。
+    channels: [Vec<i32>; 2],
+    residuals: Vec<i32>,
+}
+
+impl FlacEncoder {
+    /// `total_frames`が分からなければ`None`とする。その場合もデコードには差し支えない。
+    pub(super) fn new(sampling_rate: u32, num_channels: u16, total_frames: Option<u64>) -> Self {
+        assert!(matches!(num_channels, 1 | 2));
+        Self {
+            sampling_rate,
+            num_channels: num_channels.into(),
+            total_frames: total_frames.unwrap_or(0),
+            pending: Vec::new(),
+            frame_number: 0,
+            channels: Default::default(),
+            residuals: Vec::new(),
+        }
+    }
+
+    /// `fLaC`とSTREAMINFOを書き出す。
+    pub(super) fn write_header(&self, out: &mut Vec<u8>) {
+        out.extend_from_slice(b"fLaC");
+        // 最後のメタデータブロックであるSTREAMINFO。長さは34バイト
+        out.extend_from_slice(&[0x80, 0, 0, 34]);
+        let mut w = BitWriter::new(out);
+        w.write(BLOCK_SIZE as u64, 16); // 最小のブロックサイズ
+        w.write(BLOCK_SIZE as u64, 16); // 最大のブロックサイズ
+        w.write(0, 24); // 最小のフレームサイズ(不明)
+        w.write(0, 24); // 最大のフレームサイズ(不明)
+        w.write(self.sampling_rate.into(), 20);
+        w.write(self.num_channels as u64 - 1, 3);
+        w.write(u64::from(BITS_PER_SAMPLE) - 1, 5);
+        w.write(self.total_frames, 36);
+        w.finish();
+        out.extend_from_slice(&[0; 16]); // MD5(不明)
+    }
+
+    /// インターリーブされたサンプルの続きを渡し、埋まったフレームを書き出す。
+    pub(super) fn write(&mut self, samples: &[i16], out: &mut Vec<u8>) {
+        let block_len = BLOCK_SIZE * self.num_channels;
+        let mut samples = samples;
+        if !self.pending.is_empty() {
+            let n = (block_len - self.pending.len()).min(samples.len());
+            self.pending.extend_from_slice(&samples[..n]);
+            samples = &samples[n..];
+            if self.pending.len() < block_len {
+                return;
+            }
+            let pending = std::mem::take(&mut self.pending);
+            self.write_frame(&pending, out);
+            self.pending = pending;
+            self.pending.clear();
+        }
+        let mut blocks = samples.chunks_exact(block_len);
+        for block in &mut blocks {
+            self.write_frame(block, out);
+        }
+        self.pending.extend_from_slice(blocks.remainder());
+    }
+
+    /// 残りのサンプルを最後のフレームとして書き出す。
+    pub(super) fn finish(mut self, out: &mut Vec<u8>) {
+        if !self.pending.is_empty() {
+            let pending = std::mem::take(&mut self.pending);
+            self.write_frame(&pending, out);
+        }
+    }
+
+    fn write_frame(&mut self, block: &[i16], out: &mut Vec<u8>) {
+        let block_size = block.len() / self.num_channels;
+        let [left, side] = &mut self.channels;
+        left.clear();
+        side.clear();
+        if self.num_channels == 1 {
+            left.extend(block.iter().map(|&s| i32::from(s)));
+        } else {
+            for frame in block.chunks_exact(2) {
+                let (l, r) = (i32::from(frame[0]), i32::from(frame[1]));
+                left.push(l);
+                side.push(l - r);
+            }
+        }
+
+        let start = out.len();
+        let mut w = BitWriter::new(out);
+        w.write(0xfff8, 16); // 同期コードと、固定のブロックサイズ
+        let (block_size_code, block_size_extra) = match block_size {
+            BLOCK_SIZE => (0b1100, None),
+            1..=256 => (0b0110, Some((block_size as u64 - 1, 8))),
+            _ => (0b0111, Some((block_size as u64 - 1, 16))),
+        };
+        w.write(block_size_code, 4);
+        let (sampling_rate_code, sampling_rate_extra) = match self.sampling_rate {
+            8000 => (0b0100, None),
+            16000 => (0b0101, None),
+            22050 => (0b0110, None),
+            24000 => (0b0111, None),
+            32000 => (0b1000, None),
+            44100 => (0b1001, None),
+            48000 => (0b1010, None),
+            96000 => (0b1011, None),
+            rate @ ..=0xffff => (0b1101, Some((u64::from(rate), 16))),
+            _ => (0b0000, None),
+        };
+        w.write(sampling_rate_code, 4);
+        // モノラルか、左チャンネルとサイド
+        w.write(
+            if self.num_channels == 1 {
+                0b0000
+            } else {
+                0b1000
+            },
+            4,
+        );
+        w.write(0b100, 3); // 16ビット
+        w.write(0, 1);
+        write_utf8(&mut w, self.frame_number);
+        for (value, bits) in [block_size_extra, sampling_rate_extra]
+            .into_iter()
+            .flatten()
+        {
+            w.write(value, bits);
+        }
+        w.finish();
+        let crc = crc8(&out[start..]);
+        out.push(crc);
+
+        let mut w = BitWriter::new(out);
+        write_subframe(&mut w, left, BITS_PER_SAMPLE, &mut self.residuals);
+        if self.num_channels == 2 {
+            write_subframe(&mut w, side, BITS_PER_SAMPLE + 1, &mut self.residuals);
+        }
+        w.finish();
+        let crc = crc16(&out[start..]);
+        out.extend_from_slice(&crc.to_be_bytes());
+
+        self.frame_number += 1;
+    }
+}
+
+fn write_subframe(w: &mut BitWriter<'_>, samples: &[i32], bits: u32, residuals: &mut Vec<i32>) {
+    if samples.iter().all(|&s| s == samples[0]) {
+        w.write(0b0_000000_0, 8); // CONSTANT
+        w.write_signed(samples[0], bits);
+        return;
+    }
+
+    // 残差の絶対値の和が最も小さい次数を選ぶ
+    let order = (0..=MAX_FIXED_ORDER.min(samples.len() - 1))
+        .min_by_key(|&order| {
+            fixed_residuals(samples, order, residuals);
+            residuals
+                .iter()
+                .map(|r| u64::from(r.unsigned_abs()))
+                .sum::<u64>()
+        })
+        .unwrap();
+    fixed_residuals(samples, order, residuals);
+    let (partition_order, rice_bits) = best_partition_order(residuals, samples.len(), order);
+
+    let verbatim_bits = samples.len() as u64 * u64::from(bits);
+    if order as u64 * u64::from(bits) + 6 + rice_bits >= verbatim_bits {
+        w.write(0b0_000001_0, 8); // VERBATIM
+        for &s in samples {
+            w.write_signed(s, bits);
+        }
+        return;
+    }
+
+    w.write(0b0_001000_0 | (order as u64) << 1, 8); // FIXED
+    for &s in &samples[..order] {
+        w.write_signed(s, bits);
+    }
+    w.write(0b00, 2); // 4ビットのライスパラメータ
+    w.write(partition_order.into(), 4);
+    let partition_size = samples.len() >> partition_order;
+    let mut residuals = &residuals[..];
+    for i in 0..1 << partition_order {
+        let len = if i == 0 {
+            partition_size - order
+        } else {
+            partition_size
+        };
+        let (partition, rest) = residuals.split_at(len);
+        residuals = rest;
+        let sum = partition.iter().map(|&r| u64::from(zigzag(r))).sum();
+        let k = rice_parameter(sum, len);
+        w.write(k.into(), 4);
+        for &r in partition {
+            w.write_rice(zigzag(r), k);
+        }
+    }
+}
+
+/// `order`次の固定の予測器での残差。最初の`order`個のサンプルの分は含まない。
+fn fixed_residuals(samples: &[i32], order: usize, residuals: &mut Vec<i32>) {
+    residuals.clear();
+    let s = samples;
+    match order {
+        0 => residuals.extend_from_slice(s),
+        1 => residuals.extend(s.windows(2).map(|w| w[1] - w[0])),
+        2 => residuals.extend(s.windows(3).map(|w| w[2] - 2 * w[1] + w[0])),
+        3 => residuals.extend(s.windows(4).map(|w| w[3] - 3 * w[2] + 3 * w[1] - w[0])),
+        4 => residuals.extend(
+            s.windows(5)
+                .map(|w| w[4] - 4 * w[3] + 6 * w[2] - 4 * w[1] + w[0]),
+        ),
+        _ => unreachable!(),
+    }
+}
+
+/// 残差を分割する数(の指数)のうち、符号が最も短くなるものと、その見込みのビット数。
+fn best_partition_order(residuals: &[i32], block_size: usize, order: usize) -> (u32, u64) {
+    (0..=MAX_PARTITION_ORDER)
+        .take_while(|&p| block_size % (1 << p) == 0 && block_size >> p > order)
+        .map(|p| {
+            let partition_size = block_size >> p;
+            let mut bits = 0;
+            let mut start = 0;
+            for i in 0..1 << p {
+                let len = if i == 0 {
+                    partition_size - order
+                } else {
+                    partition_size
+                };
+                let partition = &residuals[start..start + len];
+                start += len;
+                let sum = partition.iter().map(|&r| u64::from(zigzag(r))).sum();
+                let k = rice_parameter(sum, len);
+                bits += 4 + rice_bits(sum, len, k);
+            }
+            (p, bits)
+        })
+        .min_by_key(|&(_, bits)| bits)
+        .unwrap()
+}
+
+/// 符号化する値の和が`sum`、数が`len`のときに適したライスパラメータ。
+fn rice_parameter(sum: u64, len: usize) -> u32 {
+    if len == 0 {
+        return 0;
+    }
+    let mean = sum / len as u64;
+    let k = u64::BITS - mean.leading_zeros();
+    let k = k.min(MAX_RICE_PARAMETER);
+    // 平均から見積もった値とその前後のうち、最も短くなるもの
+    (k.saturating_sub(1)..=(k + 1).min(MAX_RICE_PARAMETER))
+        .min_by_key(|&k| rice_bits(sum, len, k))
+        .unwrap()
+}
+
+/// ライス符号のビット数の見込み。
+fn rice_bits(sum: u64, len: usize, k: u32) -> u64 {
+    len as u64 * u64::from(k + 1) + (sum >> k)
+}
+
+fn zigzag(r: i32) -> u32 {
+    ((r << 1) ^ (r >> 31)) as u32
+}
+
+/// フレーム番号を、UTF-8と同じ方法で可変長に符号化する。
+fn write_utf8(w: &mut BitWriter<'_>, n: u32) {
+    let n = u64::from(n);
+    if n < 0x80 {
+        w.write(n, 8);
+        return;
+    }
+    let len = match n {
+        ..=0x7ff => 2,
+        ..=0xffff => 3,
+        ..=0x1f_ffff => 4,
+        ..=0x3ff_ffff => 5,
+        _ => 6,
+    };
+    let first_prefix = (0xff00 >> len) & 0xff;
+    w.write(first_prefix | n >> (6 * (len - 1)), 8);
+    for i in (0..len - 1).rev() {
+        w.write(0x80 | (n >> (6 * i)) & 0x3f, 8);
+    }
+}
+
+/// 上位のビットから順に書き出す。
+struct BitWriter<'a> {
+    out: &'a mut Vec<u8>,
+    acc: u64,
+    bits: u32,
+}
+
+impl<'a> BitWriter<'a> {
+    fn new(out: &'a mut Vec<u8>) -> Self {
+        Self {
+            out,
+            acc: 0,
+            bits: 0,
+        }
+    }
+
+    /// `value`の下位`bits`ビットを書き出す。`bits`は32以下。
+    fn write(&mut self, value: u64, bits: u32) {
+        debug_assert!(bits <= 32);
+        if bits == 0 {
+            return;
+        }
+        self.acc = self.acc << bits | (value & ((1 << bits) - 1));
+        self.bits += bits;
+        while self.bits >= 8 {
+            self.bits -= 8;
+            self.out.push((self.acc >> self.bits) as u8);
+        }
+    }
+
+    fn write_signed(&mut self, value: i32, bits: u32) {
+        self.write(value as u32 as u64, bits);
+    }
+
+    fn write_rice(&mut self, value: u32, k: u32) {
+        let mut quotient = value >> k;
+        while quotient >= 32 {
+            self.write(0, 32);
+            quotient -= 32;
+        }
+        self.write(1, quotient + 1);
+        self.write(value.into(), k);
+    }
+
+    /// バイト境界まで0で埋める。
+    fn finish(mut self) {
+        if self.bits > 0 {
+            self.write(0, 8 - self.bits);
+        }
+    }
+}
+
+const fn crc_table(poly: u16, width: u32) -> [u16; 256] {
+    let top = 1 << (width - 1);
+    let mask = if width == 16 {
+        0xffff
+    } else {
+        (1 << width) - 1
+    };
+    let mut table = [0; 256];
+    let mut i = 0;
+    while i < 256 {
+        let mut crc = (i as u16) << (width - 8);
+        let mut j = 0;
+        while j < 8 {
+            crc = if crc & top != 0 {
+                (crc << 1) ^ poly
+            } else {
+                crc << 1
+            } & mask;
+            j += 1;
+        }
+        table[i] = crc;
+        i += 1;
+    }
+    table
+}
+
+static CRC8_TABLE: [u16; 256] = crc_table(0x07, 8);
+static CRC16_TABLE: [u16; 256] = crc_table(0x8005, 16);
+
+fn crc8(data: &[u8]) -> u8 {
+    data.iter()
+        .fold(0, |crc, &b| CRC8_TABLE[usize::from(crc ^ b)] as u8)
+}
+
+fn crc16(data: &[u8]) -> u16 {
+    data.iter().fold(0, |crc, &b| {
+        (crc << 8) ^ CRC16_TABLE[usize::from((crc >> 8) as u8 ^ b)]
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+
+    #[rstest]
+    #[case(1, 24000, 10000)]
+    #[case(2, 48000, 5000)]
+    #[case(1, 24000, 100)]
+    fn flac_round_trips(
+        #[case] num_channels: u16,
+        #[case] sampling_rate: u32,
+        #[case] num_frames: usize,
+    ) {
+        let samples = (0..num_frames)
+            .flat_map(|i| {
+                let t = i as f32 / sampling_rate as f32;
+                let s = ((t * 440. * std::f32::consts::TAU).sin() * 20000.) as i16;
+                std::iter::repeat(s).take(num_channels.into())
+            })
+            .collect::<Vec<_>>();
+
+        // 一度に渡しても、細かく分けて渡しても同じものになる
+        let mut whole = Vec::new();
+        let encoder = FlacEncoder::new(sampling_rate, num_channels, None);
+        encoder.write_header(&mut whole);
+        let mut encoder = encoder;
+        encoder.write(&samples, &mut whole);
+        encoder.finish(&mut whole);
+
+        let mut chunked = Vec::new();
+        let mut encoder = FlacEncoder::new(sampling_rate, num_channels, None);
+        encoder.write_header(&mut chunked);
+        for chunk in samples.chunks(1000 * usize::from(num_channels)) {
+            encoder.write(chunk, &mut chunked);
+        }
+        encoder.finish(&mut chunked);
+        assert_eq!(whole, chunked);
+
+        let (decoded_rate, decoded_channels, decoded) = decode(&whole);
+        assert_eq!(sampling_rate, decoded_rate);
+        assert_eq!(num_channels, decoded_channels);
+        assert_eq!(samples, decoded);
+        assert!(whole.len() < samples.len() * 2);
+    }
+
+    #[rstest]
+    fn crc_works() {
+        assert_eq!(0xf4, crc8(b"123456789"));
+        assert_eq!(0xfee8, crc16(b"123456789"));
+    }
+
+    /// テスト用の、このエンコーダが使う機能に限ったデコーダ。
+    fn decode(flac: &[u8]) -> (u32, u16, Vec<i16>) {
+        assert_eq!(b"fLaC", &flac[..4]);
+        let mut r = BitReader {
+            data: flac,
+            pos: 8 * 8,
+        };
+        r.read(16 + 16 + 24 + 24);
+        let sampling_rate = r.read(20) as u32;
+        let num_channels = r.read(3) as u16 + 1;
+        r.read(5 + 36);
+        r.pos += 128;
+
+        let mut samples = Vec::new();
+        while r.pos / 8 < flac.len() {
+            let start = r.pos / 8;
+            assert_eq!(0xfff8, r.read(16));
+            let block_size_code = r.read(4);
+            let sampling_rate_code = r.read(4);
+            let channel_assignment = r.read(4);
+            r.read(4);
+            let first = r.read(8);
+            for _ in 0..(first as u8).leading_ones().saturating_sub(1) {
+                r.read(8);
+            }
+            let block_size = match block_size_code {
+                0b1100 => BLOCK_SIZE,
+                0b0110 => r.read(8) as usize + 1,
+                0b0111 => r.read(16) as usize + 1,
+                _ => unreachable!(),
+            };
+            if sampling_rate_code == 0b1101 {
+                r.read(16);
+            }
+            assert_eq!(crc8(&flac[start..r.pos / 8]), r.read(8) as u8);
+
+            let left = read_subframe(&mut r, block_size, 16);
+            let channels = if channel_assignment == 0b1000 {
+                let side = read_subframe(&mut r, block_size, 17);
+                let right = left.iter().zip(&side).map(|(l, s)| l - s).collect();
+                vec![left, right]
+            } else {
+                vec![left]
+            };
+            r.pos = (r.pos + 7) / 8 * 8;
+            assert_eq!(crc16(&flac[start..r.pos / 8]), r.read(16) as u16);
+            for i in 0..block_size {
+                samples.extend(channels.iter().map(|c| c[i] as i16));
+            }
+        }
+        (sampling_rate, num_channels, samples)
+    }
+
+    fn read_subframe(r: &mut BitReader<'_>, block_size: usize, bits: u32) -> Vec<i32> {
+        let kind = r.read(8) >> 1;
+        match kind {
+            0b000000 => vec![r.read_signed(bits); block_size],
+            0b000001 => (0..block_size).map(|_| r.read_signed(bits)).collect(),
+            _ => {
+                let order = (kind & 0b111) as usize;
+                let mut s = (0..order).map(|_| r.read_signed(bits)).collect::<Vec<_>>();
+                assert_eq!(0, r.read(2));
+                let partition_order = r.read(4);
+                let mut residuals = Vec::new();
+                for i in 0..1 << partition_order {
+                    let len = (block_size >> partition_order) - if i == 0 { order } else { 0 };
+                    let k = r.read(4) as u32;
+                    for _ in 0..len {
+                        let mut q = 0;
+                        while r.read(1) == 0 {
+                            q += 1;
+                        }
+                        let u = (q << k | r.read(k)) as u32;
+                        residuals.push((u >> 1) as i32 ^ -((u & 1) as i32));
+                    }
+                }
+                const COEFS: [&[i32]; 5] = [&[], &[1], &[2, -1], &[3, -3, 1], &[4, -6, 4, -1]];
+                for r in residuals {
+                    let n = s.len();
+                    let prediction = COEFS[order]
+                        .iter()
+                        .enumerate()
+                        .map(|(j, c)| c * s[n - 1 - j])
+                        .sum::<i32>();
+                    s.push(prediction + r);
+                }
+                s
+            }
+        }
+    }
+
+    struct BitReader<'a> {
+        data: &'a [u8],
+        pos: usize,
+    }
+
+    impl BitReader<'_> {
+        fn read(&mut self, bits: u32) -> u64 {
+            (0..bits).fold(0, |acc, _| {
+                let bit = self.data[self.pos / 8] >> (7 - self.pos % 8) & 1;
+                self.pos += 1;
+                acc << 1 | u64::from(bit)
+            })
+        }
+
+        fn read_signed(&mut self, bits: u32) -> i32 {
+            let v = self.read(bits) as i64;
+            (v << (64 - bits) >> (64 - bits)) as i32
+        }
+    }
+}
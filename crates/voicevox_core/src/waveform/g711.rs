@@ -0,0 +1,221 @@
+//! 電話で使われる音声形式、G.711のμ-law・A-lawのエンコーダ。
+//!
+//! 出力はヘッダの無い、8kHzのモノラルの8ビットのサンプルの列である。音声波形の生成モデルの出力を
+//! 低域通過フィルタにかけてから間引く。
+
+/// G.711のサンプリングレート。
+pub(super) const SAMPLING_RATE: u32 = 8000;
+
+/// 低域通過フィルタのタップ数。[`LANES`]の倍数とする。
+const TAPS: usize = 64;
+/// 積和を並べて計算する数。
+const LANES: usize = 8;
+/// 通過させる周波数の上限。電話の帯域に合わせる。
+const CUTOFF_HZ: f32 = 3400.;
+
+/// 圧伸の方式。
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub(super) enum Law {
+    /// μ-law。北米や日本で使われる。
+    MuLaw,
+    /// A-law。欧州などで使われる。
+    ALaw,
+}
+
+/// 音声波形を少しずつ受け取り、G.711にするエンコーダ。
+pub(super) struct G711Encoder {
+    law: Law,
+    /// 何サンプルごとに一つを残すか。
+    factor: usize,
+    coefs: [f32; TAPS],
+    /// まだ間引いていない入力。フィルタにかけるため、直前の`TAPS`サンプル程度を含む。
+    input: Vec<f32>,
+    output: Vec<f32>,
+}
+
+impl G711Encoder {
+    /// `input_sampling_rate`は[`SAMPLING_RATE`]の倍数でなければならない。
+    pub(super) fn new(law: Law, input_sampling_rate: u32) -> Self {
+        assert_eq!(0, input_sampling_rate % SAMPLING_RATE);
+        Self {
+            law,
+            factor: (input_sampling_rate / SAMPLING_RATE) as usize,
+            coefs: lowpass(CUTOFF_HZ / input_sampling_rate as f32),
+            // フィルタの遅延の分だけ前を埋め、入力と出力の時刻を揃える
+            input: vec![0.; TAPS / 2],
+            output: Vec::new(),
+        }
+    }
+
+    /// 音量を掛けた音声波形の続きを渡し、出せるところまでを書き出す。
+    pub(super) fn write(&mut self, wave: &[f32], volume_scale: f32, out: &mut Vec<u8>) {
+        self.input.extend(wave.iter().map(|v| v * volume_scale));
+        self.flush(out);
+    }
+
+    /// 残りを書き出す。
+    pub(super) fn finish(mut self, out: &mut Vec<u8>) {
+        // 入力の最後のサンプルの時刻までを出す
+        self.input.extend([0.; TAPS / 2 - 1]);
+        self.flush(out);
+    }
+
+    fn flush(&mut self, out: &mut Vec<u8>) {
+        self.output.clear();
+        let mut start = 0;
+        while start + TAPS <= self.input.len() {
+            self.output
+                .push(dot(&self.input[start..start + TAPS], &self.coefs));
+            start += self.factor;
+        }
+        self.input.drain(..start);
+
+        let samples = self.output.iter().map(|v| to_i16(v.clamp(-1., 1.)));
+        match self.law {
+            Law::MuLaw => out.extend(samples.map(encode_mu_law)),
+            Law::ALaw => out.extend(samples.map(encode_a_law)),
+        }
+    }
+}
+
+/// 正規化された遮断周波数`cutoff`の、ハミング窓をかけたsinc関数による低域通過フィルタ。
+fn lowpass(cutoff: f32) -> [f32; TAPS] {
+    let center = (TAPS - 1) as f32 / 2.;
+    let mut coefs = [0.; TAPS];
+    for (i, coef) in coefs.iter_mut().enumerate() {
+        let t = i as f32 - center;
+        let sinc = (2. * std::f32::consts::PI * cutoff * t).sin() / (std::f32::consts::PI * t);
+        let window = 0.54 - 0.46 * (2. * std::f32::consts::PI * i as f32 / (TAPS - 1) as f32).cos();
+        *coef = sinc * window;
+    }
+    // 直流の利得を1にする
+    let sum = coefs.iter().sum::<f32>();
+    coefs.iter_mut().for_each(|coef| *coef /= sum);
+    coefs
+}
+
+/// 内積。浮動小数点数の加算の順序を固定したままベクトル化されるよう、`LANES`個に分けて足す。
+fn dot(a: &[f32], b: &[f32; TAPS]) -> f32 {
+    let mut acc = [0.; LANES];
+    for (a, b) in a.chunks_exact(LANES).zip(b.chunks_exact(LANES)) {
+        for i in 0..LANES {
+            acc[i] += a[i] * b[i];
+        }
+    }
+    acc.iter().sum()
+}
+
+fn to_i16(v: f32) -> i16 {
+    (v * 0x7fff as f32) as i16
+}
+
+/// ITU-T G.711のμ-law。分岐を持たないため、まとめて変換するループはベクトル化されうる。
+fn encode_mu_law(sample: i16) -> u8 {
+    const BIAS: i32 = 0x84;
+    const CLIP: i32 = 32635;
+    let sample = i32::from(sample);
+    let sign = if sample < 0 { 0x80 } else { 0 };
+    let magnitude = sample.abs().min(CLIP) + BIAS;
+    // `magnitude`は`BIAS`以上であるため、最上位のビットは7ビット目以上
+    let exponent = (31 - magnitude.leading_zeros() as i32) - 7;
+    let mantissa = (magnitude >> (exponent + 3)) & 0x0f;
+    !(sign | exponent << 4 | mantissa) as u8
+}
+
+/// ITU-T G.711のA-law。
+fn encode_a_law(sample: i16) -> u8 {
+    let sample = i32::from(sample) >> 3;
+    let (magnitude, mask) = if sample >= 0 {
+        (sample, 0xd5)
+    } else {
+        (-sample - 1, 0x55)
+    };
+    // `magnitude`は12ビットに収まるため、セグメントは0から7
+    let segment = (32 - magnitude.leading_zeros() as i32 - 5).max(0);
+    let shift = segment.max(1);
+    let value = segment << 4 | (magnitude >> shift) & 0x0f;
+    (value ^ mask) as u8
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use pretty_assertions::assert_eq;
+    use rstest::rstest;
+
+    fn decode_mu_law(u: u8) -> i16 {
+        let u = !u;
+        let t = ((i32::from(u & 0x0f) << 3) + 0x84) << ((u & 0x70) >> 4);
+        (if u & 0x80 != 0 { 0x84 - t } else { t - 0x84 }) as i16
+    }
+
+    fn decode_a_law(a: u8) -> i16 {
+        let a = a ^ 0x55;
+        let mut t = i32::from(a & 0x0f) << 4;
+        let segment = (a & 0x70) >> 4;
+        match segment {
+            0 => t += 8,
+            1 => t += 0x108,
+            _ => t = (t + 0x108) << (segment - 1),
+        }
+        (if a & 0x80 != 0 { t } else { -t }) as i16
+    }
+
+    #[rstest]
+    #[case(0, 0xff, 0xd5)]
+    #[case(-1, 0x7f, 0x55)]
+    #[case(1000, 0xce, 0xfa)]
+    #[case(-1000, 0x4e, 0x7a)]
+    #[case(i16::MAX, 0x80, 0xaa)]
+    #[case(i16::MIN, 0x00, 0x2a)]
+    fn encode_works(#[case] sample: i16, #[case] mu_law: u8, #[case] a_law: u8) {
+        assert_eq!(mu_law, encode_mu_law(sample));
+        assert_eq!(a_law, encode_a_law(sample));
+    }
+
+    #[rstest]
+    fn encode_round_trips() {
+        for sample in (i16::MIN..=i16::MAX).step_by(7) {
+            // 量子化の誤差は、値の大きさのおよそ1/16以内に収まる
+            let tolerance = i32::from(sample).abs() / 16 + 16;
+            let mu_law = i32::from(decode_mu_law(encode_mu_law(sample)));
+            let a_law = i32::from(decode_a_law(encode_a_law(sample)));
+            assert!((mu_law - i32::from(sample)).abs() <= tolerance, "{sample}");
+            assert!((a_law - i32::from(sample)).abs() <= tolerance, "{sample}");
+        }
+    }
+
+    #[rstest]
+    #[case(300., 0.9, 1.1)]
+    #[case(1000., 0.9, 1.1)]
+    #[case(8000., 0., 0.05)]
+    fn g711_encoder_works(#[case] frequency: f32, #[case] min_gain: f32, #[case] max_gain: f32) {
+        let wave = (0..24000)
+            .map(|i| (i as f32 / 24000. * frequency * std::f32::consts::TAU).sin() * 0.5)
+            .collect::<Vec<_>>();
+
+        // 一度に渡しても、細かく分けて渡しても同じものになる
+        let mut whole = Vec::new();
+        let mut encoder = G711Encoder::new(Law::MuLaw, 24000);
+        encoder.write(&wave, 1., &mut whole);
+        encoder.finish(&mut whole);
+
+        let mut chunked = Vec::new();
+        let mut encoder = G711Encoder::new(Law::MuLaw, 24000);
+        for chunk in wave.chunks(1001) {
+            encoder.write(chunk, 1., &mut chunked);
+        }
+        encoder.finish(&mut chunked);
+        assert_eq!(whole, chunked);
+        assert_eq!(8000, whole.len());
+
+        // 通過域は元の振幅のまま、阻止域(4kHz以上)は取り除かれる
+        let peak = whole[1000..7000]
+            .iter()
+            .map(|&u| i32::from(decode_mu_law(u)).abs())
+            .max()
+            .unwrap() as f32
+            / (0.5 * 0x7fff as f32);
+        assert!((min_gain..=max_gain).contains(&peak), "{peak}");
+    }
+}
@@ -0,0 +1,132 @@
+//! 旧来のAPI(`yukarin_s_forward`・`yukarin_sa_forward`・`decode_forward`)を複数のネイティブスレッド
+//! から呼んだときのスループットを計測する。
+//!
+//! 事前に`cargo build --release -p voicevox_core_c_api`でcdylibをビルドしておく必要がある。
+
+use std::{
+    env, thread,
+    time::{Duration, Instant},
+};
+
+use libloading::{Library, Symbol};
+use test_util::EXAMPLE_DATA;
+
+const NUM_THREADS: &[usize] = &[1, 2, 4, 8];
+const DURATION: Duration = Duration::from_secs(10);
+
+type Initialize = unsafe extern "C" fn(bool, i32, bool) -> bool;
+type LoadModel = unsafe extern "C" fn(i64) -> bool;
+type Finalize = unsafe extern "C" fn();
+type YukarinSForward = unsafe extern "C" fn(i64, *mut i64, *mut i64, *mut f32) -> bool;
+type YukarinSaForward = unsafe extern "C" fn(
+    i64,
+    *mut i64,
+    *mut i64,
+    *mut i64,
+    *mut i64,
+    *mut i64,
+    *mut i64,
+    *mut i64,
+    *mut f32,
+) -> bool;
+type DecodeForward = unsafe extern "C" fn(i64, i64, *mut f32, *mut f32, *mut i64, *mut f32) -> bool;
+
+fn main() -> anyhow::Result<()> {
+    if env::var_os("VV_MODELS_ROOT_DIR").is_none() {
+        env::set_var(
+            "VV_MODELS_ROOT_DIR",
+            concat!(env!("CARGO_MANIFEST_DIR"), "/../../model"),
+        );
+    }
+    let lib_path = concat!(env!("CARGO_MANIFEST_DIR"), "/../../target/release/").to_owned()
+        + &libloading::library_filename("voicevox_core").to_string_lossy();
+
+    unsafe {
+        let lib = Library::new(lib_path)?;
+        let initialize = lib.get::<Initialize>(b"initialize")?;
+        let load_model = lib.get::<LoadModel>(b"load_model")?;
+        let finalize = lib.get::<Finalize>(b"finalize")?;
+        let yukarin_s_forward = lib.get::<YukarinSForward>(b"yukarin_s_forward")?;
+        let yukarin_sa_forward = lib.get::<YukarinSaForward>(b"yukarin_sa_forward")?;
+        let decode_forward = lib.get::<DecodeForward>(b"decode_forward")?;
+
+        assert!(initialize(false, 0, false));
+        assert!(load_model(EXAMPLE_DATA.speaker_id));
+
+        println!("| threads | forward | calls/s |");
+        println!("|---------|---------|---------|");
+        for &num_threads in NUM_THREADS {
+            let yukarin_s = || forward_yukarin_s(&yukarin_s_forward);
+            let yukarin_sa = || forward_yukarin_sa(&yukarin_sa_forward);
+            let decode = || forward_decode(&decode_forward);
+            for (name, throughput) in [
+                ("yukarin_s", measure(num_threads, yukarin_s)),
+                ("yukarin_sa", measure(num_threads, yukarin_sa)),
+                ("decode", measure(num_threads, decode)),
+            ] {
+                println!("| {num_threads} | {name} | {throughput:.2} |");
+            }
+        }
+
+        finalize();
+    }
+    Ok(())
+}
+
+/// `num_threads`個のスレッドで`DURATION`の間`f`を呼び続け、秒間の呼び出し回数を返す。
+fn measure(num_threads: usize, f: impl Fn() + Sync) -> f64 {
+    let start = Instant::now();
+    let calls = thread::scope(|s| {
+        let handles = (0..num_threads)
+            .map(|_| {
+                s.spawn(|| {
+                    let mut calls = 0;
+                    while start.elapsed() < DURATION {
+                        f();
+                        calls += 1;
+                    }
+                    calls
+                })
+            })
+            .collect::<Vec<_>>();
+        handles.into_iter().map(|h| h.join().unwrap()).sum::<u64>()
+    });
+    calls as f64 / start.elapsed().as_secs_f64()
+}
+
+unsafe fn forward_yukarin_s(yukarin_s_forward: &Symbol<'_, YukarinSForward>) {
+    let mut phoneme_length = [0.; 8];
+    assert!(yukarin_s_forward(
+        EXAMPLE_DATA.duration.length,
+        EXAMPLE_DATA.duration.phoneme_vector.as_ptr() as *mut i64,
+        &mut { EXAMPLE_DATA.speaker_id } as *mut i64,
+        phoneme_length.as_mut_ptr(),
+    ));
+}
+
+unsafe fn forward_yukarin_sa(yukarin_sa_forward: &Symbol<'_, YukarinSaForward>) {
+    let mut intonation_list = [0.; 5];
+    assert!(yukarin_sa_forward(
+        EXAMPLE_DATA.intonation.length,
+        EXAMPLE_DATA.intonation.vowel_phoneme_vector.as_ptr() as *mut i64,
+        EXAMPLE_DATA.intonation.consonant_phoneme_vector.as_ptr() as *mut i64,
+        EXAMPLE_DATA.intonation.start_accent_vector.as_ptr() as *mut i64,
+        EXAMPLE_DATA.intonation.end_accent_vector.as_ptr() as *mut i64,
+        EXAMPLE_DATA.intonation.start_accent_phrase_vector.as_ptr() as *mut i64,
+        EXAMPLE_DATA.intonation.end_accent_phrase_vector.as_ptr() as *mut i64,
+        &mut { EXAMPLE_DATA.speaker_id } as *mut i64,
+        intonation_list.as_mut_ptr(),
+    ));
+}
+
+unsafe fn forward_decode(decode_forward: &Symbol<'_, DecodeForward>) {
+    let mut wave = vec![0.; 256 * EXAMPLE_DATA.decode.f0_length as usize];
+    assert!(decode_forward(
+        EXAMPLE_DATA.decode.f0_length,
+        EXAMPLE_DATA.decode.phoneme_size,
+        EXAMPLE_DATA.decode.f0_vector.as_ptr() as *mut f32,
+        EXAMPLE_DATA.decode.phoneme_vector.as_ptr() as *mut f32,
+        &mut { EXAMPLE_DATA.speaker_id } as *mut i64,
+        wave.as_mut_ptr(),
+    ));
+}
@@ -78,6 +78,90 @@ enum VoicevoxAccelerationMode
 typedef int32_t VoicevoxAccelerationMode;
 #endif // __cplusplus
 
+/**
+ * 推論に使うモデルの数値精度。
+ *
+ * VVMに該当する精度のモデルが無い場合は ::VOICEVOX_MODEL_PRECISION_FP32 のモデルが使われる。
+ * また、GPUで実行される音声波形の生成には常に ::VOICEVOX_MODEL_PRECISION_FP32 のモデルが使われる。
+ */
+enum VoicevoxModelPrecision
+#ifdef __cplusplus
+  : int32_t
+#endif // __cplusplus
+ {
+  /**
+   * 32ビット浮動小数点数
+   */
+  VOICEVOX_MODEL_PRECISION_FP32 = 0,
+  /**
+   * 16ビット浮動小数点数
+   */
+  VOICEVOX_MODEL_PRECISION_FP16 = 1,
+  /**
+   * 8ビット整数に量子化されたもの
+   */
+  VOICEVOX_MODEL_PRECISION_INT8 = 2,
+};
+#ifndef __cplusplus
+typedef int32_t VoicevoxModelPrecision;
+#endif // __cplusplus
+
+/**
+ * 音声合成で出力する音声の形式。
+ */
+enum VoicevoxOutputFormat
+#ifdef __cplusplus
+  : int32_t
+#endif // __cplusplus
+ {
+  /**
+   * 16ビットのリニアPCMのWAV
+   */
+  VOICEVOX_OUTPUT_FORMAT_WAV = 0,
+  /**
+   * 可逆圧縮のFLAC
+   */
+  VOICEVOX_OUTPUT_FORMAT_FLAC = 1,
+  /**
+   * G.711のμ-law。ヘッダの無い、8kHzのモノラルの8ビットのサンプル
+   */
+  VOICEVOX_OUTPUT_FORMAT_MULAW = 2,
+  /**
+   * G.711のA-law。ヘッダの無い、8kHzのモノラルの8ビットのサンプル
+   */
+  VOICEVOX_OUTPUT_FORMAT_ALAW = 3,
+};
+#ifndef __cplusplus
+typedef int32_t VoicevoxOutputFormat;
+#endif // __cplusplus
+
+/**
+ * 推論の優先度。
+ *
+ * 推論セッションの順番待ちでは、優先度の高いものから順に推論される。
+ */
+enum VoicevoxPriority
+#ifdef __cplusplus
+  : int32_t
+#endif // __cplusplus
+ {
+  /**
+   * 対話的な用途。最も優先される
+   */
+  VOICEVOX_PRIORITY_INTERACTIVE = 0,
+  /**
+   * 通常
+   */
+  VOICEVOX_PRIORITY_NORMAL = 1,
+  /**
+   * バッチ処理。最も後回しにされる
+   */
+  VOICEVOX_PRIORITY_BATCH = 2,
+};
+#ifndef __cplusplus
+typedef int32_t VoicevoxPriority;
+#endif // __cplusplus
+
 /**
  * 処理結果を示す結果コード。
  */
@@ -182,6 +266,22 @@ enum VoicevoxResultCode
    * UUIDの変換に失敗した
    */
   VOICEVOX_RESULT_INVALID_UUID_ERROR = 25,
+  /**
+   * 期限までに推論を始められなかった
+   */
+  VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR = 26,
+  /**
+   * 処理が中断された
+   */
+  VOICEVOX_RESULT_CANCELED_ERROR = 27,
+  /**
+   * 処理がタイムアウトした
+   */
+  VOICEVOX_RESULT_TIMED_OUT_ERROR = 28,
+  /**
+   * プロンプトのテンプレートが不正だった
+   */
+  VOICEVOX_RESULT_INVALID_PROMPT_TEMPLATE_ERROR = 29,
 };
 #ifndef __cplusplus
 typedef int32_t VoicevoxResultCode;
@@ -239,6 +339,15 @@ typedef int32_t VoicevoxUserDictWordType;
  */
 typedef struct OpenJtalkRc OpenJtalkRc;
 
+/**
+ * 音声合成を中断するためのトークン。
+ *
+ * ::voicevox_cancellation_token_new で<b>生成</b>(_create_)し、 ::voicevox_cancellation_token_delete で<b>解放</b>(_delete_)する。
+ *
+ * ::VoicevoxTtsOptions などの`cancellation_token`に渡したトークンに対して ::voicevox_cancellation_token_cancel を呼ぶと、その音声合成は次の処理段階に進む前、あるいは推論セッションの順番待ちの間に ::VOICEVOX_RESULT_CANCELED_ERROR で失敗する。
+ */
+typedef struct VoicevoxCancellationToken VoicevoxCancellationToken;
+
 /**
  * 音声シンセサイザ。
  *
@@ -264,6 +373,22 @@ typedef struct VoicevoxVoiceModel VoicevoxVoiceModel;
  */
 typedef const char *VoicevoxVoiceModelId;
 
+/**
+ * 推論セッションが使うスレッド数の設定値。
+ *
+ * それぞれ0を指定すると ::VoicevoxInitializeOptions の `cpu_num_threads` の値が使われる。
+ */
+typedef struct VoicevoxSessionThreadOptions {
+  /**
+   * 演算子内の並列化(intra-op)に使うスレッド数
+   */
+  uint16_t intra_op_num_threads;
+  /**
+   * 演算子間の並列化(inter-op)に使うスレッド数
+   */
+  uint16_t inter_op_num_threads;
+} VoicevoxSessionThreadOptions;
+
 /**
  * ::voicevox_synthesizer_new_with_initialize のオプション。
  */
@@ -281,6 +406,34 @@ typedef struct VoicevoxInitializeOptions {
    * 全てのモデルを読み込む
    */
   bool load_all_models;
+  /**
+   * 軽いモデル(音素長・音高の推論)のスレッド数
+   */
+  struct VoicevoxSessionThreadOptions light_session_threads;
+  /**
+   * 重いモデル(音声波形の生成)のスレッド数
+   */
+  struct VoicevoxSessionThreadOptions heavy_session_threads;
+  /**
+   * 推論に使うモデルの数値精度
+   */
+  VoicevoxModelPrecision model_precision;
+  /**
+   * 読み込まれていないスタイルの推論を要求されたときに、そのスタイルを含む音声モデルを自動で読み込む
+   */
+  bool auto_load_models;
+  /**
+   * 読み込まれている推論モデルの合計バイト数の上限。0のときは上限を設けない
+   *
+   * 上限を超える場合、自動で読み込まれた音声モデルを最も長く使われていないものから解除する。
+   */
+  uint64_t model_memory_budget;
+  /**
+   * 同じ内容の推論モデルを同じ設定で読み込んだ、プロセス内の他の ::VoicevoxSynthesizer と推論セッションを共有する
+   *
+   * 共有すると推論モデルの重みが一つ分のメモリで済むが、その推論モデルでの推論は ::VoicevoxSynthesizer をまたいで一つずつ行われるようになる。
+   */
+  bool share_sessions;
 } VoicevoxInitializeOptions;
 
 /**
@@ -318,6 +471,30 @@ typedef struct VoicevoxSynthesisOptions {
    * 疑問文の調整を有効にする
    */
   bool enable_interrogative_upspeak;
+  /**
+   * 推論の優先度
+   */
+  VoicevoxPriority priority;
+  /**
+   * 推論を始めるまでの期限(ミリ秒)。0のときは期限を設けない
+   *
+   * 期限までに推論を始められない場合、あるいは始められない見込みの場合は ::VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR で失敗する。
+   */
+  uint64_t deadline_ms;
+  /**
+   * 音声合成を中断するためのトークン。NULLのときは中断しない
+   */
+  const struct VoicevoxCancellationToken *cancellation_token;
+  /**
+   * 音声合成全体のタイムアウト(ミリ秒)。0のときはタイムアウトしない
+   *
+   * タイムアウトすると、次の処理段階に進む前、あるいは推論セッションの順番待ちの間に ::VOICEVOX_RESULT_TIMED_OUT_ERROR で失敗する。
+   */
+  uint64_t timeout_ms;
+  /**
+   * 出力する音声の形式
+   */
+  VoicevoxOutputFormat output_format;
 } VoicevoxSynthesisOptions;
 
 /**
@@ -332,8 +509,53 @@ typedef struct VoicevoxTtsOptions {
    * 疑問文の調整を有効にする
    */
   bool enable_interrogative_upspeak;
+  /**
+   * 推論の優先度
+   */
+  VoicevoxPriority priority;
+  /**
+   * 推論を始めるまでの期限(ミリ秒)。0のときは期限を設けない
+   *
+   * 期限はテキストの解析を含めた全体に対して適用される。
+   */
+  uint64_t deadline_ms;
+  /**
+   * 音声合成を中断するためのトークン。NULLのときは中断しない
+   */
+  const struct VoicevoxCancellationToken *cancellation_token;
+  /**
+   * 音声合成全体のタイムアウト(ミリ秒)。0のときはタイムアウトしない
+   *
+   * タイムアウトはテキストの解析を含めた全体に対して適用される。
+   */
+  uint64_t timeout_ms;
+  /**
+   * 出力する音声の形式
+   */
+  VoicevoxOutputFormat output_format;
 } VoicevoxTtsOptions;
 
+/**
+ * ::voicevox_synthesizer_tts_async などの完了時に呼ばれるコールバック。
+ *
+ * 引数は順に、非同期版の関数に渡した`user_data`、結果コード、WAVデータのバイト長、WAVデータである。
+ * 結果コードが ::VOICEVOX_RESULT_OK でないとき、WAVデータはヌルポインタとなる。WAVデータは
+ * ::voicevox_wav_free で解放する。
+ *
+ * コールバックはvoicevox_coreの内部の、合成を行ったスレッドから呼ばれる。コールバックの中では
+ * ::voicevox_wav_free や ::voicevox_synthesizer_tts などの同期版のAPIも、非同期版のAPIも
+ * 呼んでよい。ただしコールバックが返るまでそのスレッドは他の合成に使われないため、長くブロック
+ * することは避ける。イベントループに結果を渡すには、キューに積んでeventfdやパイプに書き込むなど
+ * するとよい。
+ *
+ * 合成の途中でvoicevox_coreの内部でパニックが起きた場合も、コールバックは
+ * ::VOICEVOX_RESULT_INFERENCE_ERROR とともに一度だけ呼ばれる。
+ */
+typedef void (*VoicevoxWavCallback)(void *user_data,
+                                    VoicevoxResultCode result_code,
+                                    uintptr_t wav_length,
+                                    uint8_t *wav);
+
 /**
  * ユーザー辞書の単語。
  */
@@ -637,6 +859,34 @@ __declspec(dllimport)
 #endif
 const char *voicevox_synthesizer_get_metas_json(const struct VoicevoxSynthesizer *synthesizer);
 
+/**
+ * 処理段階ごとの所要時間やロック待ちの時間などの計測値を、JSONで取得する。
+ *
+ * JSONの解放は ::voicevox_json_free で行う。
+ *
+ * @param [in] synthesizer 音声シンセサイザ
+ * @param [out] output_stats_json 計測値のJSON文字列
+ *
+ * @returns 結果コード
+ *
+ * \example{
+ * ```c
+ * char *stats;
+ * VoicevoxResultCode result = voicevox_synthesizer_get_stats_json(synthesizer, &stats);
+ * ```
+ * }
+ *
+ * \safety{
+ * - `synthesizer`は ::voicevox_synthesizer_new_with_initialize で得たものでなければならず、また ::voicevox_synthesizer_delete で解放されていてはいけない。
+ * - `output_stats_json`は<a href="#voicevox-core-safety">書き込みについて有効</a>でなければならない。
+ * }
+ */
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+VoicevoxResultCode voicevox_synthesizer_get_stats_json(const struct VoicevoxSynthesizer *synthesizer,
+                                                       char **output_stats_json);
+
 /**
  * このライブラリで利用可能なデバイスの情報を、JSONで取得する。
  *
@@ -839,10 +1089,53 @@ VoicevoxResultCode voicevox_synthesizer_replace_mora_pitch(const struct Voicevox
                                                            VoicevoxStyleId style_id,
                                                            char **output_accent_phrases_json);
 
+/**
+ * ::VoicevoxCancellationToken を<b>生成</b>(_create_)する。
+ *
+ * @returns ::VoicevoxCancellationToken
+ */
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+struct VoicevoxCancellationToken *voicevox_cancellation_token_new(void);
+
+/**
+ * 音声合成の中断を要求する。
+ *
+ * 別のスレッドから、音声合成の実行中に呼んでもよい。
+ *
+ * @param [in] cancellation_token 中断に使うトークン
+ *
+ * \safety{
+ * - `cancellation_token`は ::voicevox_cancellation_token_new で得たものでなければならず、また ::voicevox_cancellation_token_delete で解放されていてはいけない。
+ * }
+ */
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+void voicevox_cancellation_token_cancel(const struct VoicevoxCancellationToken *cancellation_token);
+
+/**
+ * ::VoicevoxCancellationToken を<b>解放</b>(_delete_)する。
+ *
+ * 音声合成の関数に渡したトークンは、その関数が返った後であれば解放してよい。
+ *
+ * @param [in] cancellation_token 解放する ::VoicevoxCancellationToken
+ *
+ * \safety{
+ * - `cancellation_token`は ::voicevox_cancellation_token_new で得たものでなければならず、また既にこの関数で解放されていてはいけない。
+ * }
+ */
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+void voicevox_cancellation_token_delete(struct VoicevoxCancellationToken *cancellation_token);
+
 /**
  * AudioQueryから音声合成を行う。
  *
- * 生成したWAVデータを解放するには ::voicevox_wav_free を使う。
+ * 生成したWAVデータを解放するには ::voicevox_wav_free を使う。オプションの`output_format`でWAV以外の形式
+ * を指定した場合も同様である。
  *
  * @param [in] synthesizer 音声シンセサイザ
  * @param [in] audio_query_json AudioQueryのJSON文字列
@@ -873,7 +1166,8 @@ VoicevoxResultCode voicevox_synthesizer_synthesis(const struct VoicevoxSynthesiz
 /**
  * テキスト音声合成を行う。
  *
- * 生成したWAVデータを解放するには ::voicevox_wav_free を使う。
+ * 生成したWAVデータを解放するには ::voicevox_wav_free を使う。オプションの`output_format`でWAV以外の形式
+ * を指定した場合も同様である。
  *
  * @param [in] synthesizer
  * @param [in] text UTF-8の日本語テキストまたはAquesTalk風記法
@@ -901,6 +1195,88 @@ VoicevoxResultCode voicevox_synthesizer_tts(const struct VoicevoxSynthesizer *sy
                                             uintptr_t *output_wav_length,
                                             uint8_t **output_wav);
 
+/**
+ * ::voicevox_synthesizer_synthesis の非同期版。
+ *
+ * 合成はvoicevox_coreの内部のスレッドプールで行われ、この関数は即座に返る。合成が終わると
+ * `callback`が`user_data`とともに一度だけ呼ばれる。
+ *
+ * `audio_query_json`の解釈に失敗したときはエラーの結果コードを返し、`callback`は呼ばれない。
+ *
+ * @param [in] synthesizer 音声シンセサイザ
+ * @param [in] audio_query_json AudioQueryのJSON文字列
+ * @param [in] style_id スタイルID
+ * @param [in] options オプション
+ * @param [in] callback 完了時に呼ばれるコールバック
+ * @param [in] user_data `callback`に渡される任意のポインタ
+ *
+ * @returns 結果コード
+ *
+ * \safety{
+ * - `synthesizer`は ::voicevox_synthesizer_new_with_initialize で得たものでなければならず、また ::voicevox_synthesizer_delete で解放されていてはいけない。ただし`callback`が呼ばれる前に ::voicevox_synthesizer_delete を呼んでもよい。
+ * - `audio_query_json`はヌル終端文字列を指し、かつ<a href="#voicevox-core-safety">読み込みについて有効</a>でなければならない。
+ * - `user_data`は`callback`が呼ばれるまで、別のスレッドから利用できなければならない。
+ * }
+ */
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+VoicevoxResultCode voicevox_synthesizer_synthesis_async(const struct VoicevoxSynthesizer *synthesizer,
+                                                        const char *audio_query_json,
+                                                        VoicevoxStyleId style_id,
+                                                        struct VoicevoxSynthesisOptions options,
+                                                        VoicevoxWavCallback callback,
+                                                        void *user_data);
+
+/**
+ * ::voicevox_synthesizer_tts の非同期版。
+ *
+ * 合成はvoicevox_coreの内部のスレッドプールで行われ、この関数は即座に返る。合成が終わると
+ * `callback`が`user_data`とともに一度だけ呼ばれる。
+ *
+ * `text`がUTF-8として不正なときはエラーの結果コードを返し、`callback`は呼ばれない。
+ *
+ * \example{
+ * ```c
+ * void on_complete(void *user_data, VoicevoxResultCode result_code,
+ *                  uintptr_t wav_length, uint8_t *wav) {
+ *   if (result_code == VOICEVOX_RESULT_OK) {
+ *     // ⋮
+ *     voicevox_wav_free(wav);
+ *   }
+ * }
+ *
+ * voicevox_synthesizer_tts_async(synthesizer, "こんにちは", 0,
+ *                                voicevox_default_tts_options, on_complete,
+ *                                NULL);
+ * ```
+ * }
+ *
+ * @param [in] synthesizer 音声シンセサイザ
+ * @param [in] text UTF-8の日本語テキストまたはAquesTalk風記法
+ * @param [in] style_id スタイルID
+ * @param [in] options オプション
+ * @param [in] callback 完了時に呼ばれるコールバック
+ * @param [in] user_data `callback`に渡される任意のポインタ
+ *
+ * @returns 結果コード
+ *
+ * \safety{
+ * - `synthesizer`は ::voicevox_synthesizer_new_with_initialize で得たものでなければならず、また ::voicevox_synthesizer_delete で解放されていてはいけない。ただし`callback`が呼ばれる前に ::voicevox_synthesizer_delete を呼んでもよい。
+ * - `text`はヌル終端文字列を指し、かつ<a href="#voicevox-core-safety">読み込みについて有効</a>でなければならない。
+ * - `user_data`は`callback`が呼ばれるまで、別のスレッドから利用できなければならない。
+ * }
+ */
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+VoicevoxResultCode voicevox_synthesizer_tts_async(const struct VoicevoxSynthesizer *synthesizer,
+                                                  const char *text,
+                                                  VoicevoxStyleId style_id,
+                                                  struct VoicevoxTtsOptions options,
+                                                  VoicevoxWavCallback callback,
+                                                  void *user_data);
+
 /**
  * JSON文字列を解放する。
  *
@@ -934,6 +1310,8 @@ void voicevox_json_free(char *json);
  * - `wav`は以下のAPIで得られたポインタでなくてはいけない。
  *     - ::voicevox_synthesizer_synthesis
  *     - ::voicevox_synthesizer_tts
+ *     - ::voicevox_synthesizer_synthesis_async
+ *     - ::voicevox_synthesizer_tts_async
  * - `wav`は<a href="#voicevox-core-safety">読み込みと書き込みについて有効</a>でなければならない。
  * - `wav`は以後<b>ダングリングポインタ</b>(_dangling pointer_)として扱われなくてはならない。
  * }
@@ -0,0 +1,445 @@
+/**
+ * @file voicevox_core.hpp
+ *
+ * voicevox_core.h をC++から扱うための、ヘッダーのみのラッパー。C++17以降が必要。
+ *
+ * - ::OpenJtalkRc などのハンドルは、ムーブのみ可能なクラスとして所有され、破棄時に解放される。
+ * - JSONやWAVデータは ::voicevox_json_free や ::voicevox_wav_free で解放されるクラスとして返され、
+ *   `std::string`などへのコピーは行わない。返されたJSONはそのまま他の関数に渡せる。
+ * - 結果コードが ::VOICEVOX_RESULT_OK でない場合は voicevox::Error が投げられる。
+ *
+ * \example{
+ * ```cpp
+ * voicevox::OpenJtalk open_jtalk("./open_jtalk_dic_utf_8-1.11");
+ * auto options = voicevox_default_initialize_options;
+ * options.load_all_models = true;
+ * voicevox::Synthesizer synthesizer(open_jtalk, options);
+ *
+ * auto wav = synthesizer.tts("こんにちは", 0);  // voicevox::Wav
+ * ```
+ * }
+ */
+
+#ifndef VOICEVOX_CORE_HPP
+#define VOICEVOX_CORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#include "voicevox_core.h"
+
+namespace voicevox {
+
+/**
+ * voicevox_coreの関数が返したエラー。
+ */
+class Error : public std::runtime_error {
+ public:
+  explicit Error(VoicevoxResultCode code)
+      : std::runtime_error(voicevox_error_result_to_message(code)), code_(code) {}
+
+  /**
+   * 結果コード。
+   */
+  VoicevoxResultCode code() const noexcept { return code_; }
+
+ private:
+  VoicevoxResultCode code_;
+};
+
+namespace detail {
+
+inline void check(VoicevoxResultCode code) {
+  if (code != VOICEVOX_RESULT_OK) {
+    throw Error(code);
+  }
+}
+
+// Windowsではdllimportされた関数のアドレスが定数式にならないため、テンプレート引数にはせず
+// 解放関数ごとにデリータを書く
+struct JsonDeleter {
+  void operator()(char *json) const noexcept { voicevox_json_free(json); }
+};
+struct WavDeleter {
+  void operator()(uint8_t *wav) const noexcept { voicevox_wav_free(wav); }
+};
+struct OpenJtalkDeleter {
+  void operator()(OpenJtalkRc *open_jtalk) const noexcept {
+    voicevox_open_jtalk_rc_delete(open_jtalk);
+  }
+};
+struct VoiceModelDeleter {
+  void operator()(VoicevoxVoiceModel *model) const noexcept {
+    voicevox_voice_model_delete(model);
+  }
+};
+struct SynthesizerDeleter {
+  void operator()(VoicevoxSynthesizer *synthesizer) const noexcept {
+    voicevox_synthesizer_delete(synthesizer);
+  }
+};
+struct UserDictDeleter {
+  void operator()(VoicevoxUserDict *user_dict) const noexcept {
+    voicevox_user_dict_delete(user_dict);
+  }
+};
+struct CancellationTokenDeleter {
+  void operator()(VoicevoxCancellationToken *cancellation_token) const noexcept {
+    voicevox_cancellation_token_delete(cancellation_token);
+  }
+};
+
+}  // namespace detail
+
+/**
+ * voicevox_coreが生成したJSON文字列。ムーブのみ可能で、破棄時に ::voicevox_json_free で解放される。
+ */
+class Json {
+ public:
+  Json() = default;
+  explicit Json(char *json) noexcept : json_(json) {}
+
+  const char *c_str() const noexcept { return json_ ? json_.get() : ""; }
+  std::string_view view() const noexcept { return c_str(); }
+  explicit operator bool() const noexcept { return static_cast<bool>(json_); }
+
+ private:
+  std::unique_ptr<char, detail::JsonDeleter> json_;
+};
+
+/**
+ * voicevox_coreが生成したWAVデータ。ムーブのみ可能で、破棄時に ::voicevox_wav_free で解放される。
+ */
+class Wav {
+ public:
+  Wav() = default;
+  Wav(uint8_t *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+  const uint8_t *data() const noexcept { return data_.get(); }
+  std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  const uint8_t *begin() const noexcept { return data(); }
+  const uint8_t *end() const noexcept { return data() + size_; }
+
+#if __cplusplus >= 202002L
+  std::span<const uint8_t> span() const noexcept { return {data(), size_}; }
+#endif
+
+ private:
+  std::unique_ptr<uint8_t, detail::WavDeleter> data_;
+  std::size_t size_ = 0;
+};
+
+namespace detail {
+
+// C APIに渡すNUL終端の文字列。`const char *`・`std::string`・ ::voicevox::Json はそのまま渡し、
+// NUL終端とは限らない`std::string_view`だけをコピーする。引数の型としてのみ使う。
+class CStr {
+ public:
+  CStr(const char *s) noexcept : ptr_(s) {}
+  CStr(const std::string &s) noexcept : ptr_(s.c_str()) {}
+  CStr(const Json &json) noexcept : ptr_(json.c_str()) {}
+  CStr(std::string_view s) : owned_(s), ptr_(owned_.c_str()) {}
+  CStr(const CStr &) = delete;
+  CStr &operator=(const CStr &) = delete;
+
+  const char *get() const noexcept { return ptr_; }
+
+ private:
+  std::string owned_;
+  const char *ptr_;
+};
+
+template <class F>
+Json json_from(F &&f) {
+  char *json = nullptr;
+  check(std::forward<F>(f)(&json));
+  return Json(json);
+}
+
+template <class F>
+Wav wav_from(F &&f) {
+  uintptr_t length = 0;
+  uint8_t *wav = nullptr;
+  check(std::forward<F>(f)(&length, &wav));
+  return Wav(wav, length);
+}
+
+inline void on_wav_complete(void *user_data, VoicevoxResultCode result_code,
+                            uintptr_t wav_length, uint8_t *wav) {
+  std::unique_ptr<std::promise<Wav>> promise(static_cast<std::promise<Wav> *>(user_data));
+  if (result_code == VOICEVOX_RESULT_OK) {
+    promise->set_value(Wav(wav, wav_length));
+  } else {
+    promise->set_exception(std::make_exception_ptr(Error(result_code)));
+  }
+}
+
+template <class F>
+std::future<Wav> wav_async(F &&f) {
+  auto promise = std::make_unique<std::promise<Wav>>();
+  auto future = promise->get_future();
+  check(std::forward<F>(f)(on_wav_complete, promise.get()));
+  // 以降はコールバックが所有する
+  promise.release();
+  return future;
+}
+
+}  // namespace detail
+
+/**
+ * 音声合成を中断するためのトークン。 ::VoicevoxCancellationToken を所有する。
+ */
+class CancellationToken {
+ public:
+  CancellationToken() : token_(voicevox_cancellation_token_new()) {}
+
+  /**
+   * 音声合成の中断を要求する。別のスレッドから呼んでもよい。
+   */
+  void cancel() const noexcept { voicevox_cancellation_token_cancel(get()); }
+
+  const VoicevoxCancellationToken *get() const noexcept { return token_.get(); }
+
+ private:
+  std::unique_ptr<VoicevoxCancellationToken, detail::CancellationTokenDeleter> token_;
+};
+
+/**
+ * ユーザー辞書。 ::VoicevoxUserDict を所有する。
+ */
+class UserDict {
+ public:
+  /**
+   * 単語のUUID。
+   */
+  using WordUuid = uint8_t[16];
+
+  UserDict() : user_dict_(voicevox_user_dict_new()) {}
+
+  void load(detail::CStr dict_path) const {
+    detail::check(voicevox_user_dict_load(get(), dict_path.get()));
+  }
+
+  void save(detail::CStr path) const { detail::check(voicevox_user_dict_save(get(), path.get())); }
+
+  void add_word(const VoicevoxUserDictWord &word, WordUuid &output_word_uuid) const {
+    detail::check(voicevox_user_dict_add_word(get(), &word, &output_word_uuid));
+  }
+
+  void update_word(const WordUuid &word_uuid, const VoicevoxUserDictWord &word) const {
+    detail::check(voicevox_user_dict_update_word(get(), &word_uuid, &word));
+  }
+
+  void remove_word(const WordUuid &word_uuid) const {
+    detail::check(voicevox_user_dict_remove_word(get(), &word_uuid));
+  }
+
+  void import(const UserDict &other) const {
+    detail::check(voicevox_user_dict_import(get(), other.get()));
+  }
+
+  Json to_json() const {
+    return detail::json_from([&](char **json) { return voicevox_user_dict_to_json(get(), json); });
+  }
+
+  const VoicevoxUserDict *get() const noexcept { return user_dict_.get(); }
+
+ private:
+  std::unique_ptr<VoicevoxUserDict, detail::UserDictDeleter> user_dict_;
+};
+
+/**
+ * テキスト解析器としてのOpen JTalk。 ::OpenJtalkRc を所有する。
+ */
+class OpenJtalk {
+ public:
+  explicit OpenJtalk(detail::CStr open_jtalk_dic_dir) {
+    OpenJtalkRc *open_jtalk = nullptr;
+    detail::check(voicevox_open_jtalk_rc_new(open_jtalk_dic_dir.get(), &open_jtalk));
+    open_jtalk_.reset(open_jtalk);
+  }
+
+  void use_user_dict(const UserDict &user_dict) const {
+    detail::check(voicevox_open_jtalk_rc_use_user_dict(get(), user_dict.get()));
+  }
+
+  const OpenJtalkRc *get() const noexcept { return open_jtalk_.get(); }
+
+ private:
+  std::unique_ptr<OpenJtalkRc, detail::OpenJtalkDeleter> open_jtalk_;
+};
+
+/**
+ * 音声モデル。 ::VoicevoxVoiceModel を所有する。
+ */
+class VoiceModel {
+ public:
+  explicit VoiceModel(detail::CStr path) {
+    VoicevoxVoiceModel *model = nullptr;
+    detail::check(voicevox_voice_model_new_from_path(path.get(), &model));
+    model_.reset(model);
+  }
+
+  /**
+   * 音声モデルID。この`VoiceModel`が破棄されるまで有効。
+   */
+  VoicevoxVoiceModelId id() const noexcept { return voicevox_voice_model_id(get()); }
+
+  /**
+   * メタ情報のJSON文字列。この`VoiceModel`が破棄されるまで有効。
+   */
+  std::string_view metas_json() const noexcept {
+    return voicevox_voice_model_get_metas_json(get());
+  }
+
+  const VoicevoxVoiceModel *get() const noexcept { return model_.get(); }
+
+ private:
+  std::unique_ptr<VoicevoxVoiceModel, detail::VoiceModelDeleter> model_;
+};
+
+/**
+ * 音声シンセサイザ。 ::VoicevoxSynthesizer を所有する。
+ *
+ * `const`なメンバ関数は、複数のスレッドから同時に呼んでよい。
+ */
+class Synthesizer {
+ public:
+  Synthesizer(const OpenJtalk &open_jtalk,
+              const VoicevoxInitializeOptions &options = voicevox_default_initialize_options) {
+    VoicevoxSynthesizer *synthesizer = nullptr;
+    detail::check(
+        voicevox_synthesizer_new_with_initialize(open_jtalk.get(), options, &synthesizer));
+    synthesizer_.reset(synthesizer);
+  }
+
+  void load_voice_model(const VoiceModel &model) {
+    detail::check(voicevox_synthesizer_load_voice_model(get_mut(), model.get()));
+  }
+
+  void unload_voice_model(VoicevoxVoiceModelId model_id) {
+    detail::check(voicevox_synthesizer_unload_voice_model(get_mut(), model_id));
+  }
+
+  bool is_gpu_mode() const noexcept { return voicevox_synthesizer_is_gpu_mode(get()); }
+
+  bool is_loaded_voice_model(VoicevoxVoiceModelId model_id) const noexcept {
+    return voicevox_synthesizer_is_loaded_voice_model(get(), model_id);
+  }
+
+  /**
+   * 今読み込んでいる音声モデルのメタ情報のJSON文字列。次にこの`Synthesizer`に音声モデルを読み込む
+   * か、解除するまで有効。
+   */
+  std::string_view metas_json() const noexcept {
+    return voicevox_synthesizer_get_metas_json(get());
+  }
+
+  Json stats_json() const {
+    return detail::json_from(
+        [&](char **json) { return voicevox_synthesizer_get_stats_json(get(), json); });
+  }
+
+  Json create_audio_query(
+      detail::CStr text, VoicevoxStyleId style_id,
+      VoicevoxAudioQueryOptions options = voicevox_default_audio_query_options) const {
+    return detail::json_from([&](char **json) {
+      return voicevox_synthesizer_create_audio_query(get(), text.get(), style_id, options, json);
+    });
+  }
+
+  Json create_accent_phrases(
+      detail::CStr text, VoicevoxStyleId style_id,
+      VoicevoxAccentPhrasesOptions options = voicevox_default_accent_phrases_options) const {
+    return detail::json_from([&](char **json) {
+      return voicevox_synthesizer_create_accent_phrases(get(), text.get(), style_id, options,
+                                                        json);
+    });
+  }
+
+  Json replace_mora_data(detail::CStr accent_phrases_json, VoicevoxStyleId style_id) const {
+    return detail::json_from([&](char **json) {
+      return voicevox_synthesizer_replace_mora_data(get(), accent_phrases_json.get(), style_id,
+                                                    json);
+    });
+  }
+
+  Json replace_phoneme_length(detail::CStr accent_phrases_json, VoicevoxStyleId style_id) const {
+    return detail::json_from([&](char **json) {
+      return voicevox_synthesizer_replace_phoneme_length(get(), accent_phrases_json.get(),
+                                                         style_id, json);
+    });
+  }
+
+  Json replace_mora_pitch(detail::CStr accent_phrases_json, VoicevoxStyleId style_id) const {
+    return detail::json_from([&](char **json) {
+      return voicevox_synthesizer_replace_mora_pitch(get(), accent_phrases_json.get(), style_id,
+                                                     json);
+    });
+  }
+
+  Wav synthesis(detail::CStr audio_query_json, VoicevoxStyleId style_id,
+                VoicevoxSynthesisOptions options = voicevox_default_synthesis_options) const {
+    return detail::wav_from([&](uintptr_t *length, uint8_t **wav) {
+      return voicevox_synthesizer_synthesis(get(), audio_query_json.get(), style_id, options,
+                                            length, wav);
+    });
+  }
+
+  Wav tts(detail::CStr text, VoicevoxStyleId style_id,
+          VoicevoxTtsOptions options = voicevox_default_tts_options) const {
+    return detail::wav_from([&](uintptr_t *length, uint8_t **wav) {
+      return voicevox_synthesizer_tts(get(), text.get(), style_id, options, length, wav);
+    });
+  }
+
+  /**
+   * ::voicevox_synthesizer_synthesis_async を呼び、結果を`std::future`で返す。
+   *
+   * 合成の失敗は`std::future::get`から voicevox::Error として投げられる。
+   */
+  std::future<Wav> synthesis_async(
+      detail::CStr audio_query_json, VoicevoxStyleId style_id,
+      VoicevoxSynthesisOptions options = voicevox_default_synthesis_options) const {
+    return detail::wav_async([&](VoicevoxWavCallback callback, void *user_data) {
+      return voicevox_synthesizer_synthesis_async(get(), audio_query_json.get(), style_id,
+                                                  options, callback, user_data);
+    });
+  }
+
+  /**
+   * ::voicevox_synthesizer_tts_async を呼び、結果を`std::future`で返す。
+   *
+   * 合成の失敗は`std::future::get`から voicevox::Error として投げられる。
+   */
+  std::future<Wav> tts_async(detail::CStr text, VoicevoxStyleId style_id,
+                             VoicevoxTtsOptions options = voicevox_default_tts_options) const {
+    return detail::wav_async([&](VoicevoxWavCallback callback, void *user_data) {
+      return voicevox_synthesizer_tts_async(get(), text.get(), style_id, options, callback,
+                                            user_data);
+    });
+  }
+
+  const VoicevoxSynthesizer *get() const noexcept { return synthesizer_.get(); }
+
+ private:
+  VoicevoxSynthesizer *get_mut() noexcept { return synthesizer_.get(); }
+
+  std::unique_ptr<VoicevoxSynthesizer, detail::SynthesizerDeleter> synthesizer_;
+};
+
+}  // namespace voicevox
+
+#endif  // VOICEVOX_CORE_HPP
@@ -26,7 +26,7 @@ impl VoicevoxSynthesizer {
         let metas = synthesizer.metas();
         let metas_cstring = CString::new(serde_json::to_string(&metas).unwrap()).unwrap();
         Ok(Self {
-            synthesizer,
+            synthesizer: synthesizer.into(),
             metas_cstring,
         })
     }
@@ -34,14 +34,14 @@ impl VoicevoxSynthesizer {
     pub(crate) async fn load_voice_model(&mut self, model: &VoiceModel) -> Result<()> {
         self.synthesizer.load_voice_model(model).await?;
         let metas = self.synthesizer.metas();
-        self.metas_cstring = CString::new(serde_json::to_string(metas).unwrap()).unwrap();
+        self.metas_cstring = CString::new(serde_json::to_string(&metas).unwrap()).unwrap();
         Ok(())
     }
 
     pub(crate) fn unload_voice_model(&mut self, model_id: &VoiceModelId) -> Result<()> {
         self.synthesizer.unload_voice_model(model_id)?;
         let metas = self.synthesizer.metas();
-        self.metas_cstring = CString::new(serde_json::to_string(metas).unwrap()).unwrap();
+        self.metas_cstring = CString::new(serde_json::to_string(&metas).unwrap()).unwrap();
         Ok(())
     }
 
@@ -1,4 +1,4 @@
-use std::{collections::BTreeMap, sync::Arc};
+use std::{cell::RefCell, collections::BTreeMap, sync::Arc};
 
 use super::*;
 use libc::c_int;
@@ -18,7 +18,14 @@ macro_rules! ensure_initialized {
     };
 }
 
-static ERROR_MESSAGE: Lazy<Mutex<String>> = Lazy::new(|| Mutex::new(String::new()));
+// 各関数は複数のスレッドから同時に呼ばれうるため、エラーメッセージはスレッドごとに持つ
+thread_local! {
+    static ERROR_MESSAGE: RefCell<Option<String>> = RefCell::new(None);
+}
+
+// 以前はエラーメッセージをプロセス全体で一つだけ持っていた。失敗した呼び出しとは別のスレッドで
+// `last_error_message`を呼ぶ使い方のために、そのスレッドでまだ何も失敗していなければこちらを返す
+static PROCESS_ERROR_MESSAGE: Lazy<Mutex<String>> = Lazy::new(|| Mutex::new("\0".to_owned()));
 
 struct VoiceModelSet {
     all_metas_json: CString,
@@ -26,7 +33,8 @@ struct VoiceModelSet {
     model_map: BTreeMap<VoiceModelId, VoiceModel>,
 }
 
-static VOICE_MODEL_SET: Lazy<Mutex<VoiceModelSet>> = Lazy::new(|| {
+// 初期化後は読み取りのみのため、ロックは取らない
+static VOICE_MODEL_SET: Lazy<VoiceModelSet> = Lazy::new(|| {
     let all_vvms = RUNTIME.block_on(VoiceModel::get_all_models()).unwrap();
     let model_map: BTreeMap<_, _> = all_vvms
         .iter()
@@ -42,29 +50,29 @@ static VOICE_MODEL_SET: Lazy<Mutex<VoiceModelSet>> = Lazy::new(|| {
         }
     }
 
-    Mutex::new(VoiceModelSet {
+    VoiceModelSet {
         all_metas_json: CString::new(serde_json::to_string(&metas).unwrap()).unwrap(),
         style_model_map,
         model_map,
-    })
+    }
 });
 
-fn voice_model_set() -> MutexGuard<'static, VoiceModelSet> {
-    VOICE_MODEL_SET.lock().unwrap()
-}
-
-static SYNTHESIZER: Lazy<Mutex<Option<voicevox_core::Synthesizer>>> =
+// `Synthesizer`は`&self`のまま推論もモデルの読み込みもできる。ここでのロックは`Arc`を取り出す間
+// だけ取り、推論中やモデルの読み込み中には持たない
+static SYNTHESIZER: Lazy<Mutex<Option<Arc<voicevox_core::Synthesizer>>>> =
     Lazy::new(|| Mutex::new(None));
 
-fn lock_synthesizer() -> MutexGuard<'static, Option<voicevox_core::Synthesizer>> {
-    SYNTHESIZER.lock().unwrap()
+fn synthesizer() -> Option<Arc<voicevox_core::Synthesizer>> {
+    SYNTHESIZER.lock().unwrap().clone()
 }
 
 fn set_message(message: &str) {
-    ERROR_MESSAGE
+    let message = format!("{message}\0");
+    PROCESS_ERROR_MESSAGE
         .lock()
         .unwrap()
-        .replace_range(.., &format!("{message}\0"));
+        .replace_range(.., &message);
+    ERROR_MESSAGE.with(|error_message| *error_message.borrow_mut() = Some(message));
 }
 
 #[no_mangle]
@@ -79,11 +87,12 @@ pub extern "C" fn initialize(use_gpu: bool, cpu_num_threads: c_int, load_all_mod
             },
             cpu_num_threads: cpu_num_threads as u16,
             load_all_models,
+            ..Default::default()
         },
     ));
     match result {
         Ok(synthesizer) => {
-            *lock_synthesizer() = Some(synthesizer);
+            *SYNTHESIZER.lock().unwrap() = Some(Arc::new(synthesizer));
             true
         }
         Err(err) => {
@@ -96,11 +105,11 @@ pub extern "C" fn initialize(use_gpu: bool, cpu_num_threads: c_int, load_all_mod
 #[no_mangle]
 pub extern "C" fn load_model(style_id: i64) -> bool {
     let style_id = StyleId::new(style_id as u32);
-    let model_set = voice_model_set();
+    let model_set = &*VOICE_MODEL_SET;
     if let Some(model_id) = model_set.style_model_map.get(&style_id) {
         let vvm = model_set.model_map.get(model_id).unwrap();
-        let synthesizer = &mut *lock_synthesizer();
-        let result = RUNTIME.block_on(ensure_initialized!(synthesizer).load_voice_model(vvm));
+        let synthesizer = ensure_initialized!(synthesizer());
+        let result = RUNTIME.block_on(synthesizer.load_voice_model(vvm));
         if let Some(err) = result.err() {
             set_message(&format!("{err}"));
             false
@@ -115,24 +124,26 @@ pub extern "C" fn load_model(style_id: i64) -> bool {
 
 #[no_mangle]
 pub extern "C" fn is_model_loaded(speaker_id: i64) -> bool {
-    ensure_initialized!(&*lock_synthesizer())
-        .is_loaded_model_by_style_id(StyleId::new(speaker_id as u32))
+    ensure_initialized!(synthesizer()).is_loaded_model_by_style_id(StyleId::new(speaker_id as u32))
 }
 
 #[no_mangle]
 pub extern "C" fn finalize() {
-    *lock_synthesizer() = None;
+    // 実行中の推論があれば、それが終わった時点で解放される
+    *SYNTHESIZER.lock().unwrap() = None;
 }
 
 #[no_mangle]
 pub extern "C" fn metas() -> *const c_char {
-    let model_set = voice_model_set();
-    model_set.all_metas_json.as_ptr()
+    VOICE_MODEL_SET.all_metas_json.as_ptr()
 }
 
 #[no_mangle]
 pub extern "C" fn last_error_message() -> *const c_char {
-    ERROR_MESSAGE.lock().unwrap().as_ptr() as *const c_char
+    ERROR_MESSAGE.with(|error_message| match &*error_message.borrow() {
+        Some(error_message) => error_message.as_ptr() as *const c_char,
+        None => PROCESS_ERROR_MESSAGE.lock().unwrap().as_ptr() as *const c_char,
+    })
 }
 
 #[no_mangle]
@@ -151,8 +162,8 @@ pub extern "C" fn yukarin_s_forward(
     speaker_id: *mut i64,
     output: *mut f32,
 ) -> bool {
-    let synthesizer = &*lock_synthesizer();
-    let result = RUNTIME.block_on(ensure_initialized!(synthesizer).predict_duration(
+    let synthesizer = ensure_initialized!(synthesizer());
+    let result = RUNTIME.block_on(synthesizer.predict_duration(
         unsafe { std::slice::from_raw_parts_mut(phoneme_list, length as usize) },
         StyleId::new(unsafe { *speaker_id as u32 }),
     ));
@@ -181,8 +192,8 @@ pub extern "C" fn yukarin_sa_forward(
     speaker_id: *mut i64,
     output: *mut f32,
 ) -> bool {
-    let synthesizer = &*lock_synthesizer();
-    let result = RUNTIME.block_on(ensure_initialized!(synthesizer).predict_intonation(
+    let synthesizer = ensure_initialized!(synthesizer());
+    let result = RUNTIME.block_on(synthesizer.predict_intonation(
         length as usize,
         unsafe { std::slice::from_raw_parts(vowel_phoneme_list, length as usize) },
         unsafe { std::slice::from_raw_parts(consonant_phoneme_list, length as usize) },
@@ -216,8 +227,8 @@ pub extern "C" fn decode_forward(
 ) -> bool {
     let length = length as usize;
     let phoneme_size = phoneme_size as usize;
-    let synthesizer = &*lock_synthesizer();
-    let result = RUNTIME.block_on(ensure_initialized!(synthesizer).decode(
+    let synthesizer = ensure_initialized!(synthesizer());
+    let result = RUNTIME.block_on(synthesizer.decode(
         length,
         phoneme_size,
         unsafe { std::slice::from_raw_parts(f0, length) },
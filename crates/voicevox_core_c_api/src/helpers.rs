@@ -1,4 +1,7 @@
 use std::fmt::Debug;
+use std::future::Future;
+use std::panic::{self, AssertUnwindSafe};
+use std::time::Duration;
 use voicevox_core::UserDictWord;
 
 use const_default::ConstDefault;
@@ -32,6 +35,9 @@ pub(crate) fn into_result_code_with_error(result: CApiResult<()>) -> VoicevoxRes
             Err(RustApi(InvalidStyleId { .. })) => VOICEVOX_RESULT_INVALID_STYLE_ID_ERROR,
             Err(RustApi(InvalidModelId { .. })) => VOICEVOX_RESULT_INVALID_MODEL_ID_ERROR,
             Err(RustApi(InferenceFailed)) => VOICEVOX_RESULT_INFERENCE_ERROR,
+            Err(RustApi(DeadlineExceeded)) => VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR,
+            Err(RustApi(Canceled)) => VOICEVOX_RESULT_CANCELED_ERROR,
+            Err(RustApi(TimedOut)) => VOICEVOX_RESULT_TIMED_OUT_ERROR,
             Err(RustApi(ExtractFullContextLabel(_))) => {
                 VOICEVOX_RESULT_EXTRACT_FULL_CONTEXT_LABEL_ERROR
             }
@@ -45,6 +51,7 @@ pub(crate) fn into_result_code_with_error(result: CApiResult<()>) -> VoicevoxRes
             Err(RustApi(UnknownWord(_))) => VOICEVOX_RESULT_UNKNOWN_USER_DICT_WORD_ERROR,
             Err(RustApi(UseUserDict(_))) => VOICEVOX_RESULT_USE_USER_DICT_ERROR,
             Err(RustApi(InvalidWord(_))) => VOICEVOX_RESULT_INVALID_USER_DICT_WORD_ERROR,
+            Err(RustApi(InvalidPromptTemplate(_))) => VOICEVOX_RESULT_INVALID_PROMPT_TEMPLATE_ERROR,
             Err(InvalidUtf8Input) => VOICEVOX_RESULT_INVALID_UTF8_INPUT_ERROR,
             Err(InvalidAudioQuery(_)) => VOICEVOX_RESULT_INVALID_AUDIO_QUERY_ERROR,
             Err(InvalidAccentPhrase(_)) => VOICEVOX_RESULT_INVALID_ACCENT_PHRASE_ERROR,
@@ -53,6 +60,46 @@ pub(crate) fn into_result_code_with_error(result: CApiResult<()>) -> VoicevoxRes
     }
 }
 
+/// `wav`を内部のランタイムのブロッキング用のスレッドで実行し、結果を`callback`に渡す。
+///
+/// 推論はスレッドをブロックするため、ランタイムのワーカースレッドでは行わない。`callback`も同じ
+/// スレッドから呼ぶため、`callback`の中で同期版のAPIを呼んでもよい。`wav`がパニックしても
+/// `callback`は必ず一度呼ばれる。
+pub(crate) fn spawn_with_wav_callback(
+    callback: VoicevoxWavCallback,
+    user_data: *mut c_void,
+    wav: impl Future<Output = voicevox_core::Result<Vec<u8>>> + Send + 'static,
+) {
+    let user_data = UserData(user_data);
+    RUNTIME.spawn_blocking(move || {
+        // `user_data.0`だけが捕捉されないよう、全体を束縛し直す
+        let user_data = user_data;
+        let mut wav_ptr = ptr::null_mut();
+        let mut wav_length = 0;
+        let result_code = match panic::catch_unwind(AssertUnwindSafe(|| RUNTIME.block_on(wav))) {
+            Ok(wav) => into_result_code_with_error(wav.map_err(Into::into).map(|wav| {
+                // SAFETY: `wav_ptr`と`wav_length`はこの関数のローカル変数である
+                unsafe {
+                    U8_SLICE_OWNER.own_and_lend(
+                        wav,
+                        NonNull::from(&mut wav_ptr),
+                        NonNull::from(&mut wav_length),
+                    );
+                }
+            })),
+            // パニックの内容はパニックフックによって既に表示されている
+            Err(_) => VoicevoxResultCode::VOICEVOX_RESULT_INFERENCE_ERROR,
+        };
+        // SAFETY: `user_data`を別スレッドで用いてよいことは、呼び出し側が保証している
+        unsafe { callback(user_data.0, result_code, wav_length, wav_ptr) };
+    });
+
+    struct UserData(*mut c_void);
+
+    // SAFETY: C API利用者に、別スレッドから利用できることを要求している
+    unsafe impl Send for UserData {}
+}
+
 type CApiResult<T> = std::result::Result<T, CApiError>;
 
 #[derive(Error, Debug)]
@@ -105,14 +152,38 @@ impl From<VoicevoxAccentPhrasesOptions> for voicevox_core::AccentPhrasesOptions
     }
 }
 
-impl From<VoicevoxSynthesisOptions> for voicevox_core::SynthesisOptions {
-    fn from(options: VoicevoxSynthesisOptions) -> Self {
+impl From<VoicevoxSynthesisOptions<'_>> for voicevox_core::SynthesisOptions {
+    fn from(options: VoicevoxSynthesisOptions<'_>) -> Self {
         Self {
             enable_interrogative_upspeak: options.enable_interrogative_upspeak,
+            priority: options.priority.into(),
+            deadline: deadline_from_millis(options.deadline_ms),
+            cancellation_token: options
+                .cancellation_token
+                .map(|cancellation_token| cancellation_token.token.clone()),
+            timeout: deadline_from_millis(options.timeout_ms),
+            output_format: options.output_format.into(),
         }
     }
 }
 
+/// `0`を期限無しとして、ミリ秒の期限やタイムアウトを変換する。
+const fn deadline_from_millis(deadline_ms: u64) -> Option<Duration> {
+    if deadline_ms == 0 {
+        None
+    } else {
+        Some(Duration::from_millis(deadline_ms))
+    }
+}
+
+/// 期限無しを`0`として、期限やタイムアウトをミリ秒に変換する。
+const fn deadline_to_millis(deadline: Option<Duration>) -> u64 {
+    match deadline {
+        Some(deadline) => deadline.as_millis() as u64,
+        None => 0,
+    }
+}
+
 impl VoicevoxAccelerationMode {
     const fn from_rust(mode: voicevox_core::AccelerationMode) -> Self {
         use voicevox_core::AccelerationMode::*;
@@ -136,6 +207,77 @@ impl From<VoicevoxAccelerationMode> for voicevox_core::AccelerationMode {
     }
 }
 
+impl VoicevoxModelPrecision {
+    const fn from_rust(precision: voicevox_core::ModelPrecision) -> Self {
+        use voicevox_core::ModelPrecision::*;
+
+        match precision {
+            Fp32 => Self::VOICEVOX_MODEL_PRECISION_FP32,
+            Fp16 => Self::VOICEVOX_MODEL_PRECISION_FP16,
+            Int8 => Self::VOICEVOX_MODEL_PRECISION_INT8,
+        }
+    }
+}
+impl From<VoicevoxModelPrecision> for voicevox_core::ModelPrecision {
+    fn from(precision: VoicevoxModelPrecision) -> Self {
+        use VoicevoxModelPrecision::*;
+
+        match precision {
+            VOICEVOX_MODEL_PRECISION_FP32 => Self::Fp32,
+            VOICEVOX_MODEL_PRECISION_FP16 => Self::Fp16,
+            VOICEVOX_MODEL_PRECISION_INT8 => Self::Int8,
+        }
+    }
+}
+
+impl VoicevoxPriority {
+    const fn from_rust(priority: voicevox_core::Priority) -> Self {
+        use voicevox_core::Priority::*;
+
+        match priority {
+            Interactive => Self::VOICEVOX_PRIORITY_INTERACTIVE,
+            Normal => Self::VOICEVOX_PRIORITY_NORMAL,
+            Batch => Self::VOICEVOX_PRIORITY_BATCH,
+        }
+    }
+}
+impl From<VoicevoxPriority> for voicevox_core::Priority {
+    fn from(priority: VoicevoxPriority) -> Self {
+        use VoicevoxPriority::*;
+
+        match priority {
+            VOICEVOX_PRIORITY_INTERACTIVE => Self::Interactive,
+            VOICEVOX_PRIORITY_NORMAL => Self::Normal,
+            VOICEVOX_PRIORITY_BATCH => Self::Batch,
+        }
+    }
+}
+
+impl VoicevoxOutputFormat {
+    const fn from_rust(output_format: voicevox_core::OutputFormat) -> Self {
+        use voicevox_core::OutputFormat::*;
+
+        match output_format {
+            Wav => Self::VOICEVOX_OUTPUT_FORMAT_WAV,
+            Flac => Self::VOICEVOX_OUTPUT_FORMAT_FLAC,
+            MuLaw => Self::VOICEVOX_OUTPUT_FORMAT_MULAW,
+            ALaw => Self::VOICEVOX_OUTPUT_FORMAT_ALAW,
+        }
+    }
+}
+impl From<VoicevoxOutputFormat> for voicevox_core::OutputFormat {
+    fn from(output_format: VoicevoxOutputFormat) -> Self {
+        use VoicevoxOutputFormat::*;
+
+        match output_format {
+            VOICEVOX_OUTPUT_FORMAT_WAV => Self::Wav,
+            VOICEVOX_OUTPUT_FORMAT_FLAC => Self::Flac,
+            VOICEVOX_OUTPUT_FORMAT_MULAW => Self::MuLaw,
+            VOICEVOX_OUTPUT_FORMAT_ALAW => Self::ALaw,
+        }
+    }
+}
+
 impl ConstDefault for VoicevoxInitializeOptions {
     const DEFAULT: Self = {
         let options = voicevox_core::InitializeOptions::DEFAULT;
@@ -143,6 +285,19 @@ impl ConstDefault for VoicevoxInitializeOptions {
             acceleration_mode: VoicevoxAccelerationMode::from_rust(options.acceleration_mode),
             cpu_num_threads: options.cpu_num_threads,
             load_all_models: options.load_all_models,
+            light_session_threads: VoicevoxSessionThreadOptions::from_rust(
+                options.light_session_threads,
+            ),
+            heavy_session_threads: VoicevoxSessionThreadOptions::from_rust(
+                options.heavy_session_threads,
+            ),
+            model_precision: VoicevoxModelPrecision::from_rust(options.model_precision),
+            auto_load_models: options.auto_load_models,
+            model_memory_budget: match options.model_memory_budget {
+                Some(model_memory_budget) => model_memory_budget,
+                None => 0,
+            },
+            share_sessions: options.share_sessions,
         }
     };
 }
@@ -153,34 +308,78 @@ impl From<VoicevoxInitializeOptions> for voicevox_core::InitializeOptions {
             acceleration_mode: value.acceleration_mode.into(),
             cpu_num_threads: value.cpu_num_threads,
             load_all_models: value.load_all_models,
+            light_session_threads: value.light_session_threads.into(),
+            heavy_session_threads: value.heavy_session_threads.into(),
+            model_precision: value.model_precision.into(),
+            auto_load_models: value.auto_load_models,
+            model_memory_budget: match value.model_memory_budget {
+                0 => None,
+                model_memory_budget => Some(model_memory_budget),
+            },
+            share_sessions: value.share_sessions,
+        }
+    }
+}
+
+impl VoicevoxSessionThreadOptions {
+    const fn from_rust(options: voicevox_core::SessionThreadOptions) -> Self {
+        Self {
+            intra_op_num_threads: options.intra_op_num_threads,
+            inter_op_num_threads: options.inter_op_num_threads,
+        }
+    }
+}
+
+impl From<VoicevoxSessionThreadOptions> for voicevox_core::SessionThreadOptions {
+    fn from(options: VoicevoxSessionThreadOptions) -> Self {
+        Self {
+            intra_op_num_threads: options.intra_op_num_threads,
+            inter_op_num_threads: options.inter_op_num_threads,
         }
     }
 }
 
-impl ConstDefault for VoicevoxTtsOptions {
+impl ConstDefault for VoicevoxTtsOptions<'_> {
     const DEFAULT: Self = {
         let options = voicevox_core::TtsOptions::DEFAULT;
         Self {
             kana: options.kana,
             enable_interrogative_upspeak: options.enable_interrogative_upspeak,
+            priority: VoicevoxPriority::from_rust(options.priority),
+            deadline_ms: deadline_to_millis(options.deadline),
+            cancellation_token: None,
+            timeout_ms: deadline_to_millis(options.timeout),
+            output_format: VoicevoxOutputFormat::from_rust(options.output_format),
         }
     };
 }
 
-impl From<VoicevoxTtsOptions> for voicevox_core::TtsOptions {
-    fn from(options: VoicevoxTtsOptions) -> Self {
+impl From<VoicevoxTtsOptions<'_>> for voicevox_core::TtsOptions {
+    fn from(options: VoicevoxTtsOptions<'_>) -> Self {
         Self {
             kana: options.kana,
             enable_interrogative_upspeak: options.enable_interrogative_upspeak,
+            priority: options.priority.into(),
+            deadline: deadline_from_millis(options.deadline_ms),
+            cancellation_token: options
+                .cancellation_token
+                .map(|cancellation_token| cancellation_token.token.clone()),
+            timeout: deadline_from_millis(options.timeout_ms),
+            output_format: options.output_format.into(),
         }
     }
 }
 
-impl ConstDefault for VoicevoxSynthesisOptions {
+impl ConstDefault for VoicevoxSynthesisOptions<'_> {
     const DEFAULT: Self = {
         let options = voicevox_core::TtsOptions::DEFAULT;
         Self {
             enable_interrogative_upspeak: options.enable_interrogative_upspeak,
+            priority: VoicevoxPriority::from_rust(options.priority),
+            deadline_ms: deadline_to_millis(options.deadline),
+            cancellation_token: None,
+            timeout_ms: deadline_to_millis(options.timeout),
+            output_format: VoicevoxOutputFormat::from_rust(options.output_format),
         }
     };
 }
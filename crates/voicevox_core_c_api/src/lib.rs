@@ -16,12 +16,12 @@ use const_default::ConstDefault;
 use derive_getters::Getters;
 use once_cell::sync::Lazy;
 use std::env;
-use std::ffi::{CStr, CString};
+use std::ffi::{c_void, CStr, CString};
 use std::fmt;
 use std::io::{self, IsTerminal, Write};
 use std::os::raw::c_char;
-use std::ptr::NonNull;
-use std::sync::{Arc, Mutex, MutexGuard};
+use std::ptr::{self, NonNull};
+use std::sync::{Arc, Mutex};
 use tokio::runtime::Runtime;
 use tracing_subscriber::fmt::format::Writer;
 use tracing_subscriber::EnvFilter;
@@ -193,6 +193,63 @@ pub enum VoicevoxAccelerationMode {
     VOICEVOX_ACCELERATION_MODE_GPU = 2,
 }
 
+/// 推論に使うモデルの数値精度。
+///
+/// VVMに該当する精度のモデルが無い場合は ::VOICEVOX_MODEL_PRECISION_FP32 のモデルが使われる。
+/// また、GPUで実行される音声波形の生成には常に ::VOICEVOX_MODEL_PRECISION_FP32 のモデルが使われる。
+#[repr(i32)]
+#[derive(Debug, PartialEq, Eq)]
+#[allow(non_camel_case_types)]
+pub enum VoicevoxModelPrecision {
+    /// 32ビット浮動小数点数
+    VOICEVOX_MODEL_PRECISION_FP32 = 0,
+    /// 16ビット浮動小数点数
+    VOICEVOX_MODEL_PRECISION_FP16 = 1,
+    /// 8ビット整数に量子化されたもの
+    VOICEVOX_MODEL_PRECISION_INT8 = 2,
+}
+
+/// 推論の優先度。
+///
+/// 推論セッションの順番待ちでは、優先度の高いものから順に推論される。
+#[repr(i32)]
+#[derive(Debug, PartialEq, Eq)]
+#[allow(non_camel_case_types)]
+pub enum VoicevoxPriority {
+    /// 対話的な用途。最も優先される
+    VOICEVOX_PRIORITY_INTERACTIVE = 0,
+    /// 通常
+    VOICEVOX_PRIORITY_NORMAL = 1,
+    /// バッチ処理。最も後回しにされる
+    VOICEVOX_PRIORITY_BATCH = 2,
+}
+
+/// 音声合成で出力する音声の形式。
+#[repr(i32)]
+#[derive(Debug, PartialEq, Eq)]
+#[allow(non_camel_case_types)]
+pub enum VoicevoxOutputFormat {
+    /// 16ビットのリニアPCMのWAV
+    VOICEVOX_OUTPUT_FORMAT_WAV = 0,
+    /// 可逆圧縮のFLAC
+    VOICEVOX_OUTPUT_FORMAT_FLAC = 1,
+    /// G.711のμ-law。ヘッダの無い、8kHzのモノラルの8ビットのサンプル
+    VOICEVOX_OUTPUT_FORMAT_MULAW = 2,
+    /// G.711のA-law。ヘッダの無い、8kHzのモノラルの8ビットのサンプル
+    VOICEVOX_OUTPUT_FORMAT_ALAW = 3,
+}
+
+/// 推論セッションが使うスレッド数の設定値。
+///
+/// それぞれ0を指定すると ::VoicevoxInitializeOptions の `cpu_num_threads` の値が使われる。
+#[repr(C)]
+pub struct VoicevoxSessionThreadOptions {
+    /// 演算子内の並列化(intra-op)に使うスレッド数
+    intra_op_num_threads: u16,
+    /// 演算子間の並列化(inter-op)に使うスレッド数
+    inter_op_num_threads: u16,
+}
+
 /// ::voicevox_synthesizer_new_with_initialize のオプション。
 #[repr(C)]
 pub struct VoicevoxInitializeOptions {
@@ -203,6 +260,22 @@ pub struct VoicevoxInitializeOptions {
     cpu_num_threads: u16,
     /// 全てのモデルを読み込む
     load_all_models: bool,
+    /// 軽いモデル(音素長・音高の推論)のスレッド数
+    light_session_threads: VoicevoxSessionThreadOptions,
+    /// 重いモデル(音声波形の生成)のスレッド数
+    heavy_session_threads: VoicevoxSessionThreadOptions,
+    /// 推論に使うモデルの数値精度
+    model_precision: VoicevoxModelPrecision,
+    /// 読み込まれていないスタイルの推論を要求されたときに、そのスタイルを含む音声モデルを自動で読み込む
+    auto_load_models: bool,
+    /// 読み込まれている推論モデルの合計バイト数の上限。0のときは上限を設けない
+    ///
+    /// 上限を超える場合、自動で読み込まれた音声モデルを最も長く使われていないものから解除する。
+    model_memory_budget: u64,
+    /// 同じ内容の推論モデルを同じ設定で読み込んだ、プロセス内の他の ::VoicevoxSynthesizer と推論セッションを共有する
+    ///
+    /// 共有すると推論モデルの重みが一つ分のメモリで済むが、その推論モデルでの推論は ::VoicevoxSynthesizer をまたいで一つずつ行われるようになる。
+    share_sessions: bool,
 }
 
 /// デフォルトの初期化オプション
@@ -313,7 +386,7 @@ pub extern "C" fn voicevox_voice_model_delete(model: Box<VoicevoxVoiceModel>) {
 /// <b>構築</b>(_construction_)は ::voicevox_synthesizer_new_with_initialize で行い、<b>破棄</b>(_destruction_)は ::voicevox_synthesizer_delete で行う。
 #[derive(Getters)]
 pub struct VoicevoxSynthesizer {
-    synthesizer: Synthesizer,
+    synthesizer: Arc<Synthesizer>,
     metas_cstring: CString,
 }
 
@@ -461,6 +534,41 @@ pub extern "C" fn voicevox_synthesizer_get_metas_json(
     synthesizer.metas().as_ptr()
 }
 
+/// 処理段階ごとの所要時間やロック待ちの時間などの計測値を、JSONで取得する。
+///
+/// JSONの解放は ::voicevox_json_free で行う。
+///
+/// @param [in] synthesizer 音声シンセサイザ
+/// @param [out] output_stats_json 計測値のJSON文字列
+///
+/// @returns 結果コード
+///
+/// \example{
+/// ```c
+/// char *stats;
+/// VoicevoxResultCode result = voicevox_synthesizer_get_stats_json(synthesizer, &stats);
+/// ```
+/// }
+///
+/// \safety{
+/// - `synthesizer`は ::voicevox_synthesizer_new_with_initialize で得たものでなければならず、また ::voicevox_synthesizer_delete で解放されていてはいけない。
+/// - `output_stats_json`は<a href="#voicevox-core-safety">書き込みについて有効</a>でなければならない。
+/// }
+#[no_mangle]
+pub unsafe extern "C" fn voicevox_synthesizer_get_stats_json(
+    synthesizer: &VoicevoxSynthesizer,
+    output_stats_json: NonNull<*mut c_char>,
+) -> VoicevoxResultCode {
+    into_result_code_with_error((|| {
+        let stats = serde_json::to_string(&synthesizer.synthesizer().stats()).unwrap();
+        let stats = CString::new(stats).expect("should not contain '\\0'");
+        output_stats_json
+            .as_ptr()
+            .write_unaligned(C_STRING_DROP_CHECKER.whitelist(stats).into_raw());
+        Ok(())
+    })())
+}
+
 /// このライブラリで利用可能なデバイスの情報を、JSONで取得する。
 ///
 /// JSONの解放は ::voicevox_json_free で行う。
@@ -767,20 +875,87 @@ pub unsafe extern "C" fn voicevox_synthesizer_replace_mora_pitch(
     })())
 }
 
+/// 音声合成を中断するためのトークン。
+///
+/// ::voicevox_cancellation_token_new で<b>生成</b>(_create_)し、 ::voicevox_cancellation_token_delete で<b>解放</b>(_delete_)する。
+///
+/// ::VoicevoxTtsOptions などの`cancellation_token`に渡したトークンに対して ::voicevox_cancellation_token_cancel を呼ぶと、その音声合成は次の処理段階に進む前、あるいは推論セッションの順番待ちの間に ::VOICEVOX_RESULT_CANCELED_ERROR で失敗する。
+pub struct VoicevoxCancellationToken {
+    token: voicevox_core::CancellationToken,
+}
+
+/// ::VoicevoxCancellationToken を<b>生成</b>(_create_)する。
+///
+/// @returns ::VoicevoxCancellationToken
+#[no_mangle]
+pub extern "C" fn voicevox_cancellation_token_new() -> Box<VoicevoxCancellationToken> {
+    Box::new(VoicevoxCancellationToken {
+        token: voicevox_core::CancellationToken::new(),
+    })
+}
+
+/// 音声合成の中断を要求する。
+///
+/// 別のスレッドから、音声合成の実行中に呼んでもよい。
+///
+/// @param [in] cancellation_token 中断に使うトークン
+///
+/// \safety{
+/// - `cancellation_token`は ::voicevox_cancellation_token_new で得たものでなければならず、また ::voicevox_cancellation_token_delete で解放されていてはいけない。
+/// }
+#[no_mangle]
+pub extern "C" fn voicevox_cancellation_token_cancel(
+    cancellation_token: &VoicevoxCancellationToken,
+) {
+    cancellation_token.token.cancel();
+}
+
+/// ::VoicevoxCancellationToken を<b>解放</b>(_delete_)する。
+///
+/// 音声合成の関数に渡したトークンは、その関数が返った後であれば解放してよい。
+///
+/// @param [in] cancellation_token 解放する ::VoicevoxCancellationToken
+///
+/// \safety{
+/// - `cancellation_token`は ::voicevox_cancellation_token_new で得たものでなければならず、また既にこの関数で解放されていてはいけない。
+/// }
+#[no_mangle]
+pub extern "C" fn voicevox_cancellation_token_delete(
+    cancellation_token: Box<VoicevoxCancellationToken>,
+) {
+    drop(cancellation_token);
+}
+
 /// ::voicevox_synthesizer_synthesis のオプション。
 #[repr(C)]
-pub struct VoicevoxSynthesisOptions {
+pub struct VoicevoxSynthesisOptions<'a> {
     /// 疑問文の調整を有効にする
     enable_interrogative_upspeak: bool,
+    /// 推論の優先度
+    priority: VoicevoxPriority,
+    /// 推論を始めるまでの期限(ミリ秒)。0のときは期限を設けない
+    ///
+    /// 期限までに推論を始められない場合、あるいは始められない見込みの場合は ::VOICEVOX_RESULT_DEADLINE_EXCEEDED_ERROR で失敗する。
+    deadline_ms: u64,
+    /// 音声合成を中断するためのトークン。NULLのときは中断しない
+    cancellation_token: Option<&'a VoicevoxCancellationToken>,
+    /// 音声合成全体のタイムアウト(ミリ秒)。0のときはタイムアウトしない
+    ///
+    /// タイムアウトすると、次の処理段階に進む前、あるいは推論セッションの順番待ちの間に ::VOICEVOX_RESULT_TIMED_OUT_ERROR で失敗する。
+    timeout_ms: u64,
+    /// 出力する音声の形式
+    output_format: VoicevoxOutputFormat,
 }
 
 /// デフォルトの `voicevox_synthesizer_synthesis` のオプション
 #[no_mangle]
-pub static voicevox_default_synthesis_options: VoicevoxSynthesisOptions = ConstDefault::DEFAULT;
+pub static voicevox_default_synthesis_options: VoicevoxSynthesisOptions<'static> =
+    ConstDefault::DEFAULT;
 
 /// AudioQueryから音声合成を行う。
 ///
-/// 生成したWAVデータを解放するには ::voicevox_wav_free を使う。
+/// 生成したWAVデータを解放するには ::voicevox_wav_free を使う。オプションの`output_format`でWAV以外の形式
+/// を指定した場合も同様である。
 ///
 /// @param [in] synthesizer 音声シンセサイザ
 /// @param [in] audio_query_json AudioQueryのJSON文字列
@@ -802,7 +977,7 @@ pub unsafe extern "C" fn voicevox_synthesizer_synthesis(
     synthesizer: &VoicevoxSynthesizer,
     audio_query_json: *const c_char,
     style_id: VoicevoxStyleId,
-    options: VoicevoxSynthesisOptions,
+    options: VoicevoxSynthesisOptions<'_>,
     output_wav_length: NonNull<usize>,
     output_wav: NonNull<*mut u8>,
 ) -> VoicevoxResultCode {
@@ -824,20 +999,35 @@ pub unsafe extern "C" fn voicevox_synthesizer_synthesis(
 
 /// ::voicevox_synthesizer_tts のオプション。
 #[repr(C)]
-pub struct VoicevoxTtsOptions {
+pub struct VoicevoxTtsOptions<'a> {
     /// AquesTalk風記法としてテキストを解釈する
     kana: bool,
     /// 疑問文の調整を有効にする
     enable_interrogative_upspeak: bool,
+    /// 推論の優先度
+    priority: VoicevoxPriority,
+    /// 推論を始めるまでの期限(ミリ秒)。0のときは期限を設けない
+    ///
+    /// 期限はテキストの解析を含めた全体に対して適用される。
+    deadline_ms: u64,
+    /// 音声合成を中断するためのトークン。NULLのときは中断しない
+    cancellation_token: Option<&'a VoicevoxCancellationToken>,
+    /// 音声合成全体のタイムアウト(ミリ秒)。0のときはタイムアウトしない
+    ///
+    /// タイムアウトはテキストの解析を含めた全体に対して適用される。
+    timeout_ms: u64,
+    /// 出力する音声の形式
+    output_format: VoicevoxOutputFormat,
 }
 
 /// デフォルトのテキスト音声合成オプション
 #[no_mangle]
-pub static voicevox_default_tts_options: VoicevoxTtsOptions = ConstDefault::DEFAULT;
+pub static voicevox_default_tts_options: VoicevoxTtsOptions<'static> = ConstDefault::DEFAULT;
 
 /// テキスト音声合成を行う。
 ///
-/// 生成したWAVデータを解放するには ::voicevox_wav_free を使う。
+/// 生成したWAVデータを解放するには ::voicevox_wav_free を使う。オプションの`output_format`でWAV以外の形式
+/// を指定した場合も同様である。
 ///
 /// @param [in] synthesizer
 /// @param [in] text UTF-8の日本語テキストまたはAquesTalk風記法
@@ -859,7 +1049,7 @@ pub unsafe extern "C" fn voicevox_synthesizer_tts(
     synthesizer: &VoicevoxSynthesizer,
     text: *const c_char,
     style_id: VoicevoxStyleId,
-    options: VoicevoxTtsOptions,
+    options: VoicevoxTtsOptions<'_>,
     output_wav_length: NonNull<usize>,
     output_wav: NonNull<*mut u8>,
 ) -> VoicevoxResultCode {
@@ -875,6 +1065,131 @@ pub unsafe extern "C" fn voicevox_synthesizer_tts(
     })())
 }
 
+/// ::voicevox_synthesizer_tts_async などの完了時に呼ばれるコールバック。
+///
+/// 引数は順に、非同期版の関数に渡した`user_data`、結果コード、WAVデータのバイト長、WAVデータである。
+/// 結果コードが ::VOICEVOX_RESULT_OK でないとき、WAVデータはヌルポインタとなる。WAVデータは
+/// ::voicevox_wav_free で解放する。
+///
+/// コールバックはvoicevox_coreの内部の、合成を行ったスレッドから呼ばれる。コールバックの中では
+/// ::voicevox_wav_free や ::voicevox_synthesizer_tts などの同期版のAPIも、非同期版のAPIも
+/// 呼んでよい。ただしコールバックが返るまでそのスレッドは他の合成に使われないため、長くブロック
+/// することは避ける。イベントループに結果を渡すには、キューに積んでeventfdやパイプに書き込むなど
+/// するとよい。
+///
+/// 合成の途中でvoicevox_coreの内部でパニックが起きた場合も、コールバックは
+/// ::VOICEVOX_RESULT_INFERENCE_ERROR とともに一度だけ呼ばれる。
+pub type VoicevoxWavCallback = unsafe extern "C" fn(
+    user_data: *mut c_void,
+    result_code: VoicevoxResultCode,
+    wav_length: usize,
+    wav: *mut u8,
+);
+
+/// ::voicevox_synthesizer_synthesis の非同期版。
+///
+/// 合成はvoicevox_coreの内部のスレッドプールで行われ、この関数は即座に返る。合成が終わると
+/// `callback`が`user_data`とともに一度だけ呼ばれる。
+///
+/// `audio_query_json`の解釈に失敗したときはエラーの結果コードを返し、`callback`は呼ばれない。
+///
+/// @param [in] synthesizer 音声シンセサイザ
+/// @param [in] audio_query_json AudioQueryのJSON文字列
+/// @param [in] style_id スタイルID
+/// @param [in] options オプション
+/// @param [in] callback 完了時に呼ばれるコールバック
+/// @param [in] user_data `callback`に渡される任意のポインタ
+///
+/// @returns 結果コード
+///
+/// \safety{
+/// - `synthesizer`は ::voicevox_synthesizer_new_with_initialize で得たものでなければならず、また ::voicevox_synthesizer_delete で解放されていてはいけない。ただし`callback`が呼ばれる前に ::voicevox_synthesizer_delete を呼んでもよい。
+/// - `audio_query_json`はヌル終端文字列を指し、かつ<a href="#voicevox-core-safety">読み込みについて有効</a>でなければならない。
+/// - `user_data`は`callback`が呼ばれるまで、別のスレッドから利用できなければならない。
+/// }
+#[no_mangle]
+pub unsafe extern "C" fn voicevox_synthesizer_synthesis_async(
+    synthesizer: &VoicevoxSynthesizer,
+    audio_query_json: *const c_char,
+    style_id: VoicevoxStyleId,
+    options: VoicevoxSynthesisOptions<'_>,
+    callback: VoicevoxWavCallback,
+    user_data: *mut c_void,
+) -> VoicevoxResultCode {
+    into_result_code_with_error((|| {
+        let audio_query_json = ensure_utf8(CStr::from_ptr(audio_query_json))?;
+        let audio_query: AudioQueryModel =
+            serde_json::from_str(audio_query_json).map_err(CApiError::InvalidAudioQuery)?;
+        let synthesizer = synthesizer.synthesizer().clone();
+        let options = SynthesisOptions::from(options);
+        spawn_with_wav_callback(callback, user_data, async move {
+            synthesizer
+                .synthesis(&audio_query, StyleId::new(style_id), &options)
+                .await
+        });
+        Ok(())
+    })())
+}
+
+/// ::voicevox_synthesizer_tts の非同期版。
+///
+/// 合成はvoicevox_coreの内部のスレッドプールで行われ、この関数は即座に返る。合成が終わると
+/// `callback`が`user_data`とともに一度だけ呼ばれる。
+///
+/// `text`がUTF-8として不正なときはエラーの結果コードを返し、`callback`は呼ばれない。
+///
+/// \example{
+/// ```c
+/// void on_complete(void *user_data, VoicevoxResultCode result_code,
+///                  uintptr_t wav_length, uint8_t *wav) {
+///   if (result_code == VOICEVOX_RESULT_OK) {
+///     // ⋮
+///     voicevox_wav_free(wav);
+///   }
+/// }
+///
+/// voicevox_synthesizer_tts_async(synthesizer, "こんにちは", 0,
+///                                voicevox_default_tts_options, on_complete,
+///                                NULL);
+/// ```
+/// }
+///
+/// @param [in] synthesizer 音声シンセサイザ
+/// @param [in] text UTF-8の日本語テキストまたはAquesTalk風記法
+/// @param [in] style_id スタイルID
+/// @param [in] options オプション
+/// @param [in] callback 完了時に呼ばれるコールバック
+/// @param [in] user_data `callback`に渡される任意のポインタ
+///
+/// @returns 結果コード
+///
+/// \safety{
+/// - `synthesizer`は ::voicevox_synthesizer_new_with_initialize で得たものでなければならず、また ::voicevox_synthesizer_delete で解放されていてはいけない。ただし`callback`が呼ばれる前に ::voicevox_synthesizer_delete を呼んでもよい。
+/// - `text`はヌル終端文字列を指し、かつ<a href="#voicevox-core-safety">読み込みについて有効</a>でなければならない。
+/// - `user_data`は`callback`が呼ばれるまで、別のスレッドから利用できなければならない。
+/// }
+#[no_mangle]
+pub unsafe extern "C" fn voicevox_synthesizer_tts_async(
+    synthesizer: &VoicevoxSynthesizer,
+    text: *const c_char,
+    style_id: VoicevoxStyleId,
+    options: VoicevoxTtsOptions<'_>,
+    callback: VoicevoxWavCallback,
+    user_data: *mut c_void,
+) -> VoicevoxResultCode {
+    into_result_code_with_error((|| {
+        let text = ensure_utf8(CStr::from_ptr(text))?.to_owned();
+        let synthesizer = synthesizer.synthesizer().clone();
+        let options = TtsOptions::from(options);
+        spawn_with_wav_callback(callback, user_data, async move {
+            synthesizer
+                .tts(&text, StyleId::new(style_id), &options)
+                .await
+        });
+        Ok(())
+    })())
+}
+
 /// JSON文字列を解放する。
 ///
 /// @param [in] json 解放するJSON文字列
@@ -905,6 +1220,8 @@ pub unsafe extern "C" fn voicevox_json_free(json: *mut c_char) {
 /// - `wav`は以下のAPIで得られたポインタでなくてはいけない。
 ///     - ::voicevox_synthesizer_synthesis
 ///     - ::voicevox_synthesizer_tts
+///     - ::voicevox_synthesizer_synthesis_async
+///     - ::voicevox_synthesizer_tts_async
 /// - `wav`は<a href="#voicevox-core-safety">読み込みと書き込みについて有効</a>でなければならない。
 /// - `wav`は以後<b>ダングリングポインタ</b>(_dangling pointer_)として扱われなくてはならない。
 /// }
@@ -59,6 +59,10 @@ pub(crate) struct Symbols<'lib> {
     >,
     pub(crate) voicevox_synthesizer_get_metas_json:
         Symbol<'lib, unsafe extern "C" fn(*const VoicevoxSynthesizer) -> *const c_char>,
+    pub(crate) voicevox_synthesizer_get_stats_json: Symbol<
+        'lib,
+        unsafe extern "C" fn(*const VoicevoxSynthesizer, *mut *mut c_char) -> VoicevoxResultCode,
+    >,
     pub(crate) voicevox_create_supported_devices_json:
         Symbol<'lib, unsafe extern "C" fn(*mut *mut c_char) -> VoicevoxResultCode>,
     pub(crate) voicevox_synthesizer_create_audio_query: Symbol<
@@ -71,6 +75,12 @@ pub(crate) struct Symbols<'lib> {
             *mut *mut c_char,
         ) -> VoicevoxResultCode,
     >,
+    pub(crate) voicevox_cancellation_token_new:
+        Symbol<'lib, unsafe extern "C" fn() -> *mut VoicevoxCancellationToken>,
+    pub(crate) voicevox_cancellation_token_cancel:
+        Symbol<'lib, unsafe extern "C" fn(*const VoicevoxCancellationToken)>,
+    pub(crate) voicevox_cancellation_token_delete:
+        Symbol<'lib, unsafe extern "C" fn(*mut VoicevoxCancellationToken)>,
     pub(crate) voicevox_synthesizer_synthesis: Symbol<
         'lib,
         unsafe extern "C" fn(
@@ -93,6 +103,28 @@ pub(crate) struct Symbols<'lib> {
             *mut *mut u8,
         ) -> VoicevoxResultCode,
     >,
+    pub(crate) voicevox_synthesizer_synthesis_async: Symbol<
+        'lib,
+        unsafe extern "C" fn(
+            *const VoicevoxSynthesizer,
+            *const c_char,
+            VoicevoxStyleId,
+            VoicevoxSynthesisOptions,
+            VoicevoxWavCallback,
+            *mut c_void,
+        ) -> VoicevoxResultCode,
+    >,
+    pub(crate) voicevox_synthesizer_tts_async: Symbol<
+        'lib,
+        unsafe extern "C" fn(
+            *const VoicevoxSynthesizer,
+            *const c_char,
+            VoicevoxStyleId,
+            VoicevoxTtsOptions,
+            VoicevoxWavCallback,
+            *mut c_void,
+        ) -> VoicevoxResultCode,
+    >,
     pub(crate) voicevox_json_free: Symbol<'lib, unsafe extern "C" fn(*mut c_char)>,
     pub(crate) voicevox_wav_free: Symbol<'lib, unsafe extern "C" fn(*mut u8)>,
     pub(crate) voicevox_error_result_to_message:
@@ -203,10 +235,16 @@ impl<'lib> Symbols<'lib> {
             voicevox_synthesizer_is_gpu_mode,
             voicevox_synthesizer_is_loaded_voice_model,
             voicevox_synthesizer_get_metas_json,
+            voicevox_synthesizer_get_stats_json,
             voicevox_create_supported_devices_json,
             voicevox_synthesizer_create_audio_query,
+            voicevox_cancellation_token_new,
+            voicevox_cancellation_token_cancel,
+            voicevox_cancellation_token_delete,
             voicevox_synthesizer_synthesis,
             voicevox_synthesizer_tts,
+            voicevox_synthesizer_synthesis_async,
+            voicevox_synthesizer_tts_async,
             voicevox_json_free,
             voicevox_wav_free,
             voicevox_error_result_to_message,
@@ -239,6 +277,8 @@ type VoicevoxVoiceModel = c_void;
 type VoicevoxVoiceModelId = *const c_char;
 type VoicevoxSynthesizer = c_void;
 type VoicevoxStyleId = u32;
+pub(crate) type VoicevoxWavCallback =
+    unsafe extern "C" fn(*mut c_void, VoicevoxResultCode, usize, *mut u8);
 
 #[repr(i32)]
 #[allow(non_camel_case_types)]
@@ -246,11 +286,34 @@ pub(crate) enum VoicevoxAccelerationMode {
     VOICEVOX_ACCELERATION_MODE_CPU = 1,
 }
 
+#[derive(Clone, Copy)]
+#[repr(i32)]
+#[allow(non_camel_case_types)]
+pub(crate) enum VoicevoxOutputFormat {
+    VOICEVOX_OUTPUT_FORMAT_WAV = 0,
+    VOICEVOX_OUTPUT_FORMAT_FLAC = 1,
+    VOICEVOX_OUTPUT_FORMAT_MULAW = 2,
+    VOICEVOX_OUTPUT_FORMAT_ALAW = 3,
+}
+
+#[derive(Clone, Copy)]
+#[repr(C)]
+pub(crate) struct VoicevoxSessionThreadOptions {
+    _intra_op_num_threads: u16,
+    _inter_op_num_threads: u16,
+}
+
 #[repr(C)]
 pub(crate) struct VoicevoxInitializeOptions {
     pub(crate) acceleration_mode: VoicevoxAccelerationMode,
     pub(crate) _cpu_num_threads: u16,
     pub(crate) load_all_models: bool,
+    pub(crate) _light_session_threads: VoicevoxSessionThreadOptions,
+    pub(crate) _heavy_session_threads: VoicevoxSessionThreadOptions,
+    pub(crate) _model_precision: i32,
+    pub(crate) _auto_load_models: bool,
+    pub(crate) _model_memory_budget: u64,
+    pub(crate) _share_sessions: bool,
 }
 
 #[derive(Clone, Copy)]
@@ -263,6 +326,11 @@ pub(crate) struct VoicevoxAudioQueryOptions {
 #[repr(C)]
 pub(crate) struct VoicevoxSynthesisOptions {
     _enable_interrogative_upspeak: bool,
+    _priority: i32,
+    _deadline_ms: u64,
+    pub(crate) cancellation_token: *const VoicevoxCancellationToken,
+    pub(crate) timeout_ms: u64,
+    pub(crate) output_format: VoicevoxOutputFormat,
 }
 
 #[derive(Clone, Copy)]
@@ -270,6 +338,16 @@ pub(crate) struct VoicevoxSynthesisOptions {
 pub(crate) struct VoicevoxTtsOptions {
     _kana: bool,
     _enable_interrogative_upspeak: bool,
+    _priority: i32,
+    _deadline_ms: u64,
+    pub(crate) cancellation_token: *const VoicevoxCancellationToken,
+    pub(crate) timeout_ms: u64,
+    pub(crate) output_format: VoicevoxOutputFormat,
+}
+
+#[repr(C)]
+pub(crate) struct VoicevoxCancellationToken {
+    _private: [u8; 0],
 }
 
 #[repr(C)]
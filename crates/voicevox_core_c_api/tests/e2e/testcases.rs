@@ -1,8 +1,12 @@
 mod compatible_engine;
+mod compatible_engine_concurrent;
 mod compatible_engine_load_model_before_initialize;
 mod global_info;
 mod simple_tts;
 mod synthesizer_new_with_initialize_output_json;
+mod synthesizer_tts_async;
+mod synthesizer_tts_cancel;
+mod synthesizer_tts_output_format;
 mod tts_via_audio_query;
 mod user_dict_load;
 mod user_dict_manipulate;
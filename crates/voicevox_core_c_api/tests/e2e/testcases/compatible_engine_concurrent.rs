@@ -0,0 +1,123 @@
+// 複数のスレッドから同時にyukarin_s・yukarin_sa・decodeの推論を行う
+
+use std::thread;
+
+use assert_cmd::assert::AssertResult;
+use libloading::Library;
+use once_cell::sync::Lazy;
+use serde::{Deserialize, Serialize};
+
+use test_util::EXAMPLE_DATA;
+
+use crate::{
+    assert_cdylib::{self, case, Utf8Output},
+    float_assert, snapshots,
+    symbols::Symbols,
+};
+
+case!(TestCase);
+
+#[derive(Serialize, Deserialize)]
+struct TestCase;
+
+const NUM_THREADS: usize = 4;
+const NUM_ITERATIONS: usize = 5;
+
+#[typetag::serde(name = "compatible_engine_concurrent")]
+impl assert_cdylib::TestCase for TestCase {
+    unsafe fn exec(&self, lib: &Library) -> anyhow::Result<()> {
+        let Symbols {
+            initialize,
+            load_model,
+            is_model_loaded,
+            finalize,
+            yukarin_s_forward,
+            yukarin_sa_forward,
+            decode_forward,
+            ..
+        } = Symbols::new(lib)?;
+
+        assert!(initialize(false, 0, false));
+        assert!(load_model(EXAMPLE_DATA.speaker_id));
+
+        thread::scope(|s| {
+            for _ in 0..NUM_THREADS {
+                s.spawn(|| {
+                    for _ in 0..NUM_ITERATIONS {
+                        let mut phoneme_length = [0.; 8];
+                        assert!(yukarin_s_forward(
+                            EXAMPLE_DATA.duration.length,
+                            EXAMPLE_DATA.duration.phoneme_vector.as_ptr() as *mut i64,
+                            &mut { EXAMPLE_DATA.speaker_id } as *mut i64,
+                            phoneme_length.as_mut_ptr(),
+                        ));
+                        float_assert::close_l1(
+                            &phoneme_length,
+                            &EXAMPLE_DATA.duration.result,
+                            0.01,
+                        );
+
+                        let mut intonation_list = [0.; 5];
+                        assert!(yukarin_sa_forward(
+                            EXAMPLE_DATA.intonation.length,
+                            EXAMPLE_DATA.intonation.vowel_phoneme_vector.as_ptr() as *mut i64,
+                            EXAMPLE_DATA.intonation.consonant_phoneme_vector.as_ptr() as *mut i64,
+                            EXAMPLE_DATA.intonation.start_accent_vector.as_ptr() as *mut i64,
+                            EXAMPLE_DATA.intonation.end_accent_vector.as_ptr() as *mut i64,
+                            EXAMPLE_DATA.intonation.start_accent_phrase_vector.as_ptr() as *mut i64,
+                            EXAMPLE_DATA.intonation.end_accent_phrase_vector.as_ptr() as *mut i64,
+                            &mut { EXAMPLE_DATA.speaker_id } as *mut i64,
+                            intonation_list.as_mut_ptr(),
+                        ));
+                        float_assert::close_l1(
+                            &intonation_list,
+                            &EXAMPLE_DATA.intonation.result,
+                            0.01,
+                        );
+
+                        let mut wave = vec![0.; 256 * EXAMPLE_DATA.decode.f0_length as usize];
+                        assert!(decode_forward(
+                            EXAMPLE_DATA.decode.f0_length,
+                            EXAMPLE_DATA.decode.phoneme_size,
+                            EXAMPLE_DATA.decode.f0_vector.as_ptr() as *mut f32,
+                            EXAMPLE_DATA.decode.phoneme_vector.as_ptr() as *mut f32,
+                            &mut { EXAMPLE_DATA.speaker_id } as *mut i64,
+                            wave.as_mut_ptr(),
+                        ));
+                        assert!(wave.iter().copied().all(f32::is_normal));
+                    }
+                });
+            }
+
+            // 推論中も他の関数はブロックされない
+            s.spawn(|| {
+                for _ in 0..NUM_ITERATIONS {
+                    assert!(is_model_loaded(EXAMPLE_DATA.speaker_id));
+                    // 読み込み済みのモデルなので失敗する
+                    assert!(!load_model(EXAMPLE_DATA.speaker_id));
+                }
+            });
+        });
+
+        finalize();
+        Ok(())
+    }
+
+    fn assert_output(&self, output: Utf8Output) -> AssertResult {
+        output
+            .mask_timestamps()
+            .mask_windows_video_cards()
+            .assert()
+            .try_success()?
+            .try_stdout("")?
+            .try_stderr(&*SNAPSHOTS.stderr)
+    }
+}
+
+static SNAPSHOTS: Lazy<Snapshots> = snapshots::section!(compatible_engine_concurrent);
+
+#[derive(Deserialize)]
+struct Snapshots {
+    #[serde(deserialize_with = "snapshots::deserialize_platform_specific_snapshot")]
+    stderr: String,
+}
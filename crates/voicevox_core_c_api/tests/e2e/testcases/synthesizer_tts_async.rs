@@ -0,0 +1,172 @@
+//! `voicevox_synthesizer_tts_async`で複数の合成を同時に走らせ、すべてのコールバックが呼ばれること
+//! を確認する。
+//!
+//! 完了を待たずに`voicevox_synthesizer_delete`しても問題ないことも確認する。
+
+use std::{
+    collections::HashMap,
+    ffi::{c_void, CStr, CString},
+    mem::MaybeUninit,
+    sync::{
+        mpsc::{self, Sender},
+        Mutex,
+    },
+    time::Duration,
+};
+
+use assert_cmd::assert::AssertResult;
+use libloading::Library;
+use once_cell::sync::Lazy;
+use serde::{Deserialize, Serialize};
+use test_util::OPEN_JTALK_DIC_DIR;
+use voicevox_core::result_code::VoicevoxResultCode;
+
+use crate::{
+    assert_cdylib::{self, case, Utf8Output},
+    snapshots,
+    symbols::{Symbols, VoicevoxAccelerationMode, VoicevoxInitializeOptions},
+};
+
+macro_rules! cstr {
+    ($s:literal $(,)?) => {
+        CStr::from_bytes_with_nul(concat!($s, '\0').as_ref()).unwrap()
+    };
+}
+
+case!(TestCase {
+    text: "こんにちは、音声合成の世界へようこそ".to_owned(),
+    num_requests: 8,
+});
+
+#[derive(Serialize, Deserialize)]
+struct TestCase {
+    text: String,
+    num_requests: usize,
+}
+
+#[typetag::serde(name = "synthesizer_tts_async")]
+impl assert_cdylib::TestCase for TestCase {
+    unsafe fn exec(&self, lib: &Library) -> anyhow::Result<()> {
+        let Symbols {
+            voicevox_default_initialize_options,
+            voicevox_default_tts_options,
+            voicevox_open_jtalk_rc_new,
+            voicevox_open_jtalk_rc_delete,
+            voicevox_voice_model_new_from_path,
+            voicevox_voice_model_delete,
+            voicevox_synthesizer_new_with_initialize,
+            voicevox_synthesizer_delete,
+            voicevox_synthesizer_load_voice_model,
+            voicevox_synthesizer_tts_async,
+            voicevox_wav_free,
+            ..
+        } = Symbols::new(lib)?;
+
+        let model = {
+            let mut model = MaybeUninit::uninit();
+            assert_ok(voicevox_voice_model_new_from_path(
+                cstr!("../../model/sample.vvm").as_ptr(),
+                model.as_mut_ptr(),
+            ));
+            model.assume_init()
+        };
+
+        let openjtalk = {
+            let mut openjtalk = MaybeUninit::uninit();
+            let open_jtalk_dic_dir = CString::new(OPEN_JTALK_DIC_DIR).unwrap();
+            assert_ok(voicevox_open_jtalk_rc_new(
+                open_jtalk_dic_dir.as_ptr(),
+                openjtalk.as_mut_ptr(),
+            ));
+            openjtalk.assume_init()
+        };
+
+        let synthesizer = {
+            let mut synthesizer = MaybeUninit::uninit();
+            assert_ok(voicevox_synthesizer_new_with_initialize(
+                openjtalk,
+                VoicevoxInitializeOptions {
+                    acceleration_mode: VoicevoxAccelerationMode::VOICEVOX_ACCELERATION_MODE_CPU,
+                    ..**voicevox_default_initialize_options
+                },
+                synthesizer.as_mut_ptr(),
+            ));
+            synthesizer.assume_init()
+        };
+
+        assert_ok(voicevox_synthesizer_load_voice_model(synthesizer, model));
+
+        let (tx, rx) = mpsc::channel();
+        let tx = Mutex::new(tx);
+        let text = CString::new(&*self.text).unwrap();
+        for _ in 0..self.num_requests {
+            assert_ok(voicevox_synthesizer_tts_async(
+                synthesizer,
+                text.as_ptr(),
+                STYLE_ID,
+                **voicevox_default_tts_options,
+                on_complete,
+                &tx as *const Mutex<Sender<Completion>> as *mut c_void,
+            ));
+        }
+        voicevox_synthesizer_delete(synthesizer);
+
+        for _ in 0..self.num_requests {
+            let (result_code, wav_length, wav) = rx.recv_timeout(TIMEOUT)?;
+            assert_ok(result_code);
+            std::assert_eq!(SNAPSHOTS.output[&self.text].wav_length, wav_length);
+            voicevox_wav_free(wav as *mut u8);
+        }
+
+        voicevox_voice_model_delete(model);
+        voicevox_open_jtalk_rc_delete(openjtalk);
+
+        return Ok(());
+
+        const STYLE_ID: u32 = 0;
+        const TIMEOUT: Duration = Duration::from_secs(60);
+
+        type Completion = (VoicevoxResultCode, usize, usize);
+
+        unsafe extern "C" fn on_complete(
+            user_data: *mut c_void,
+            result_code: VoicevoxResultCode,
+            wav_length: usize,
+            wav: *mut u8,
+        ) {
+            let tx = &*(user_data as *const Mutex<Sender<Completion>>);
+            tx.lock()
+                .unwrap()
+                .send((result_code, wav_length, wav as usize))
+                .unwrap();
+        }
+
+        fn assert_ok(result_code: VoicevoxResultCode) {
+            std::assert_eq!(VoicevoxResultCode::VOICEVOX_RESULT_OK, result_code);
+        }
+    }
+
+    fn assert_output(&self, output: Utf8Output) -> AssertResult {
+        output
+            .mask_timestamps()
+            .mask_windows_video_cards()
+            .assert()
+            .try_success()?
+            .try_stdout("")?
+            .try_stderr(&*SNAPSHOTS.stderr)
+    }
+}
+
+static SNAPSHOTS: Lazy<Snapshots> = snapshots::section!(synthesizer_tts_async);
+
+#[derive(Deserialize)]
+struct Snapshots {
+    output: HashMap<String, ExpectedOutput>,
+    #[serde(deserialize_with = "snapshots::deserialize_platform_specific_snapshot")]
+    stderr: String,
+}
+
+#[derive(Deserialize)]
+struct ExpectedOutput {
+    wav_length: usize,
+}
@@ -0,0 +1,166 @@
+//! `voicevox_synthesizer_tts`に中断済みのトークンを渡すと合成が行われずに失敗し、中断されていない
+//! トークンやタイムアウトでは合成できることを確認する。
+
+use std::{
+    collections::HashMap,
+    ffi::{CStr, CString},
+    mem::MaybeUninit,
+    ptr,
+};
+
+use assert_cmd::assert::AssertResult;
+use libloading::Library;
+use once_cell::sync::Lazy;
+use serde::{Deserialize, Serialize};
+use test_util::OPEN_JTALK_DIC_DIR;
+use voicevox_core::result_code::VoicevoxResultCode;
+
+use crate::{
+    assert_cdylib::{self, case, Utf8Output},
+    snapshots,
+    symbols::{Symbols, VoicevoxAccelerationMode, VoicevoxInitializeOptions, VoicevoxTtsOptions},
+};
+
+macro_rules! cstr {
+    ($s:literal $(,)?) => {
+        CStr::from_bytes_with_nul(concat!($s, '\0').as_ref()).unwrap()
+    };
+}
+
+case!(TestCase {
+    text: "こんにちは、音声合成の世界へようこそ".to_owned()
+});
+
+#[derive(Serialize, Deserialize)]
+struct TestCase {
+    text: String,
+}
+
+#[typetag::serde(name = "synthesizer_tts_cancel")]
+impl assert_cdylib::TestCase for TestCase {
+    unsafe fn exec(&self, lib: &Library) -> anyhow::Result<()> {
+        let Symbols {
+            voicevox_default_initialize_options,
+            voicevox_default_tts_options,
+            voicevox_open_jtalk_rc_new,
+            voicevox_open_jtalk_rc_delete,
+            voicevox_voice_model_new_from_path,
+            voicevox_voice_model_delete,
+            voicevox_synthesizer_new_with_initialize,
+            voicevox_synthesizer_delete,
+            voicevox_synthesizer_load_voice_model,
+            voicevox_cancellation_token_new,
+            voicevox_cancellation_token_cancel,
+            voicevox_cancellation_token_delete,
+            voicevox_synthesizer_tts,
+            voicevox_wav_free,
+            ..
+        } = Symbols::new(lib)?;
+
+        let model = {
+            let mut model = MaybeUninit::uninit();
+            assert_ok(voicevox_voice_model_new_from_path(
+                cstr!("../../model/sample.vvm").as_ptr(),
+                model.as_mut_ptr(),
+            ));
+            model.assume_init()
+        };
+
+        let openjtalk = {
+            let mut openjtalk = MaybeUninit::uninit();
+            let open_jtalk_dic_dir = CString::new(OPEN_JTALK_DIC_DIR).unwrap();
+            assert_ok(voicevox_open_jtalk_rc_new(
+                open_jtalk_dic_dir.as_ptr(),
+                openjtalk.as_mut_ptr(),
+            ));
+            openjtalk.assume_init()
+        };
+
+        let synthesizer = {
+            let mut synthesizer = MaybeUninit::uninit();
+            assert_ok(voicevox_synthesizer_new_with_initialize(
+                openjtalk,
+                VoicevoxInitializeOptions {
+                    acceleration_mode: VoicevoxAccelerationMode::VOICEVOX_ACCELERATION_MODE_CPU,
+                    ..**voicevox_default_initialize_options
+                },
+                synthesizer.as_mut_ptr(),
+            ));
+            synthesizer.assume_init()
+        };
+
+        assert_ok(voicevox_synthesizer_load_voice_model(synthesizer, model));
+
+        let text = CString::new(&*self.text).unwrap();
+        let cancellation_token = voicevox_cancellation_token_new();
+        let tts = |options: VoicevoxTtsOptions| {
+            let mut wav_length = 0;
+            let mut wav = ptr::null_mut();
+            let result_code = voicevox_synthesizer_tts(
+                synthesizer,
+                text.as_ptr(),
+                STYLE_ID,
+                options,
+                &mut wav_length,
+                &mut wav,
+            );
+            if result_code == VoicevoxResultCode::VOICEVOX_RESULT_OK {
+                std::assert_eq!(SNAPSHOTS.output[&self.text].wav_length, wav_length);
+                voicevox_wav_free(wav);
+            }
+            result_code
+        };
+
+        assert_ok(tts(VoicevoxTtsOptions {
+            cancellation_token,
+            timeout_ms: 60_000,
+            ..**voicevox_default_tts_options
+        }));
+
+        voicevox_cancellation_token_cancel(cancellation_token);
+        std::assert_eq!(
+            VoicevoxResultCode::VOICEVOX_RESULT_CANCELED_ERROR,
+            tts(VoicevoxTtsOptions {
+                cancellation_token,
+                ..**voicevox_default_tts_options
+            }),
+        );
+        voicevox_cancellation_token_delete(cancellation_token);
+
+        voicevox_synthesizer_delete(synthesizer);
+        voicevox_voice_model_delete(model);
+        voicevox_open_jtalk_rc_delete(openjtalk);
+
+        return Ok(());
+
+        const STYLE_ID: u32 = 0;
+
+        fn assert_ok(result_code: VoicevoxResultCode) {
+            std::assert_eq!(VoicevoxResultCode::VOICEVOX_RESULT_OK, result_code);
+        }
+    }
+
+    fn assert_output(&self, output: Utf8Output) -> AssertResult {
+        output
+            .mask_timestamps()
+            .mask_windows_video_cards()
+            .assert()
+            .try_success()?
+            .try_stdout("")?
+            .try_stderr(&*SNAPSHOTS.stderr)
+    }
+}
+
+static SNAPSHOTS: Lazy<Snapshots> = snapshots::section!(synthesizer_tts_cancel);
+
+#[derive(Deserialize)]
+struct Snapshots {
+    output: HashMap<String, ExpectedOutput>,
+    #[serde(deserialize_with = "snapshots::deserialize_platform_specific_snapshot")]
+    stderr: String,
+}
+
+#[derive(Deserialize)]
+struct ExpectedOutput {
+    wav_length: usize,
+}
@@ -0,0 +1,166 @@
+//! `voicevox_synthesizer_tts`の`output_format`で、同じ音声がWAV・FLAC・G.711のそれぞれで返ることを
+//! 確認する。
+
+use std::{
+    collections::HashMap,
+    ffi::{CStr, CString},
+    mem::MaybeUninit,
+    ptr, slice,
+};
+
+use assert_cmd::assert::AssertResult;
+use libloading::Library;
+use once_cell::sync::Lazy;
+use serde::{Deserialize, Serialize};
+use test_util::OPEN_JTALK_DIC_DIR;
+use voicevox_core::result_code::VoicevoxResultCode;
+
+use crate::{
+    assert_cdylib::{self, case, Utf8Output},
+    snapshots,
+    symbols::{
+        Symbols, VoicevoxAccelerationMode, VoicevoxInitializeOptions, VoicevoxOutputFormat,
+        VoicevoxTtsOptions,
+    },
+};
+
+macro_rules! cstr {
+    ($s:literal $(,)?) => {
+        CStr::from_bytes_with_nul(concat!($s, '\0').as_ref()).unwrap()
+    };
+}
+
+case!(TestCase {
+    text: "こんにちは、音声合成の世界へようこそ".to_owned()
+});
+
+#[derive(Serialize, Deserialize)]
+struct TestCase {
+    text: String,
+}
+
+#[typetag::serde(name = "synthesizer_tts_output_format")]
+impl assert_cdylib::TestCase for TestCase {
+    unsafe fn exec(&self, lib: &Library) -> anyhow::Result<()> {
+        let Symbols {
+            voicevox_default_initialize_options,
+            voicevox_default_tts_options,
+            voicevox_open_jtalk_rc_new,
+            voicevox_open_jtalk_rc_delete,
+            voicevox_voice_model_new_from_path,
+            voicevox_voice_model_delete,
+            voicevox_synthesizer_new_with_initialize,
+            voicevox_synthesizer_delete,
+            voicevox_synthesizer_load_voice_model,
+            voicevox_synthesizer_tts,
+            voicevox_wav_free,
+            ..
+        } = Symbols::new(lib)?;
+
+        let model = {
+            let mut model = MaybeUninit::uninit();
+            assert_ok(voicevox_voice_model_new_from_path(
+                cstr!("../../model/sample.vvm").as_ptr(),
+                model.as_mut_ptr(),
+            ));
+            model.assume_init()
+        };
+
+        let openjtalk = {
+            let mut openjtalk = MaybeUninit::uninit();
+            let open_jtalk_dic_dir = CString::new(OPEN_JTALK_DIC_DIR).unwrap();
+            assert_ok(voicevox_open_jtalk_rc_new(
+                open_jtalk_dic_dir.as_ptr(),
+                openjtalk.as_mut_ptr(),
+            ));
+            openjtalk.assume_init()
+        };
+
+        let synthesizer = {
+            let mut synthesizer = MaybeUninit::uninit();
+            assert_ok(voicevox_synthesizer_new_with_initialize(
+                openjtalk,
+                VoicevoxInitializeOptions {
+                    acceleration_mode: VoicevoxAccelerationMode::VOICEVOX_ACCELERATION_MODE_CPU,
+                    ..**voicevox_default_initialize_options
+                },
+                synthesizer.as_mut_ptr(),
+            ));
+            synthesizer.assume_init()
+        };
+
+        assert_ok(voicevox_synthesizer_load_voice_model(synthesizer, model));
+
+        let text = CString::new(&*self.text).unwrap();
+        let tts = |output_format| {
+            let mut length = 0;
+            let mut output = ptr::null_mut();
+            assert_ok(voicevox_synthesizer_tts(
+                synthesizer,
+                text.as_ptr(),
+                STYLE_ID,
+                VoicevoxTtsOptions {
+                    output_format,
+                    ..**voicevox_default_tts_options
+                },
+                &mut length,
+                &mut output,
+            ));
+            let bytes = slice::from_raw_parts(output, length).to_owned();
+            voicevox_wav_free(output);
+            bytes
+        };
+
+        let expected = &SNAPSHOTS.output[&self.text];
+        let wav = tts(VoicevoxOutputFormat::VOICEVOX_OUTPUT_FORMAT_WAV);
+        std::assert_eq!(expected.wav_length, wav.len());
+
+        let flac = tts(VoicevoxOutputFormat::VOICEVOX_OUTPUT_FORMAT_FLAC);
+        std::assert_eq!(b"fLaC", &flac[..4]);
+        std::assert!(flac.len() < wav.len());
+
+        for output_format in [
+            VoicevoxOutputFormat::VOICEVOX_OUTPUT_FORMAT_MULAW,
+            VoicevoxOutputFormat::VOICEVOX_OUTPUT_FORMAT_ALAW,
+        ] {
+            std::assert_eq!(expected.g711_length, tts(output_format).len());
+        }
+
+        voicevox_synthesizer_delete(synthesizer);
+        voicevox_voice_model_delete(model);
+        voicevox_open_jtalk_rc_delete(openjtalk);
+
+        return Ok(());
+
+        const STYLE_ID: u32 = 0;
+
+        fn assert_ok(result_code: VoicevoxResultCode) {
+            std::assert_eq!(VoicevoxResultCode::VOICEVOX_RESULT_OK, result_code);
+        }
+    }
+
+    fn assert_output(&self, output: Utf8Output) -> AssertResult {
+        output
+            .mask_timestamps()
+            .mask_windows_video_cards()
+            .assert()
+            .try_success()?
+            .try_stdout("")?
+            .try_stderr(&*SNAPSHOTS.stderr)
+    }
+}
+
+static SNAPSHOTS: Lazy<Snapshots> = snapshots::section!(synthesizer_tts_output_format);
+
+#[derive(Deserialize)]
+struct Snapshots {
+    output: HashMap<String, ExpectedOutput>,
+    #[serde(deserialize_with = "snapshots::deserialize_platform_specific_snapshot")]
+    stderr: String,
+}
+
+#[derive(Deserialize)]
+struct ExpectedOutput {
+    wav_length: usize,
+    g711_length: usize,
+}
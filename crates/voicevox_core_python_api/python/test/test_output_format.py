@@ -0,0 +1,48 @@
+# output_formatによって、同じ音声がWAV・FLAC・G.711・ヘッダの無いPCMのそれぞれで返るかをテストする。
+
+import numpy as np
+import pytest
+import conftest  # noqa: F401
+import voicevox_core  # noqa: F401
+
+TEXT = "こんにちは"
+
+
+@pytest.mark.asyncio
+async def test_output_format() -> None:
+    open_jtalk = voicevox_core.OpenJtalk(conftest.open_jtalk_dic_dir)
+    model = await voicevox_core.VoiceModel.from_path(conftest.model_dir)
+    synthesizer = await voicevox_core.Synthesizer.new_with_initialize(
+        open_jtalk=open_jtalk,
+    )
+    await synthesizer.load_voice_model(model)
+
+    wav = await synthesizer.tts(TEXT, 0)
+    assert isinstance(wav, bytes)
+    assert wav[:4] == b"RIFF"
+
+    int16 = await synthesizer.tts(TEXT, 0, output_format="int16")
+    assert int16.dtype == np.int16
+    assert np.array_equal(int16, np.frombuffer(wav[44:], dtype="<i2"))
+
+    float32 = await synthesizer.tts(TEXT, 0, output_format="float32")
+    assert float32.dtype == np.float32
+    assert float32.shape == int16.shape
+    assert np.all(np.abs(float32) <= 1)
+
+    audio_query = await synthesizer.audio_query(TEXT, 0)
+    audio_query.output_stereo = True
+    stereo = await synthesizer.synthesis(audio_query, 0, output_format="int16")
+    assert stereo.shape == (len(int16), 2)
+
+    flac = await synthesizer.tts(TEXT, 0, output_format="flac")
+    assert flac[:4] == b"fLaC"
+    assert len(flac) < len(wav)
+
+    # G.711は24kHzから8kHzに間引かれる
+    for output_format in ["mulaw", "alaw"]:
+        g711 = await synthesizer.tts(TEXT, 0, output_format=output_format)
+        assert len(g711) == -(-len(int16) // 3)
+
+    with pytest.raises(voicevox_core.VoicevoxError):
+        await synthesizer.tts(TEXT, 0, output_format="mp3")
@@ -5,13 +5,17 @@ from ._models import (  # noqa: F401
     AccelerationMode,
     AccentPhrase,
     AudioQuery,
+    ModelPrecision,
     Mora,
+    Priority,
+    SessionThreadOptions,
     SpeakerMeta,
     SupportedDevices,
     UserDictWord,
     UserDictWordType,
 )
 from ._rust import (
+    CancellationToken,
     OpenJtalk,
     Synthesizer,
     VoiceModel,
@@ -24,8 +28,12 @@ __all__ = [
     "AccelerationMode",
     "AccentPhrase",
     "AudioQuery",
+    "CancellationToken",
+    "ModelPrecision",
     "Mora",
     "OpenJtalk",
+    "Priority",
+    "SessionThreadOptions",
     "SpeakerMeta",
     "SupportedDevices",
     "Synthesizer",
@@ -85,6 +85,57 @@ class AccelerationMode(str, Enum):
     """ハードウェアアクセラレーションモードを"GPU"に設定する。"""
 
 
+class ModelPrecision(str, Enum):
+    """
+    推論に使うモデルの数値精度。
+
+    VVMに該当する精度のモデルが無い場合は ``FP32`` のモデルが使われる。また、GPUで実行される音声波形の
+    生成には常に ``FP32`` のモデルが使われる。
+    """
+
+    FP32 = "fp32"
+    """32ビット浮動小数点数。"""
+
+    FP16 = "fp16"
+    """16ビット浮動小数点数。"""
+
+    INT8 = "int8"
+    """8ビット整数に量子化されたもの。"""
+
+
+class Priority(str, Enum):
+    """
+    推論の優先度。
+
+    推論セッションの順番待ちでは、優先度の高いものから順に推論される。同じ優先度の中では期限の近い
+    ものから、期限の無いものは到着順に推論される。
+    """
+
+    INTERACTIVE = "interactive"
+    """対話的な用途。最も優先される。"""
+
+    NORMAL = "normal"
+    """通常。"""
+
+    BATCH = "batch"
+    """バッチ処理。最も後回しにされる。"""
+
+
+@pydantic.dataclasses.dataclass
+class SessionThreadOptions:
+    """
+    推論セッションが使うスレッド数の設定値。
+
+    それぞれ ``0`` を指定すると ``cpu_num_threads`` の値が使われる。
+    """
+
+    intra_op_num_threads: int = 0
+    """演算子内の並列化(intra-op)に使うスレッド数。"""
+
+    inter_op_num_threads: int = 0
+    """演算子間の並列化(inter-op)に使うスレッド数。"""
+
+
 @pydantic.dataclasses.dataclass
 class Mora:
     """モーラ（子音＋母音）ごとの情報。"""
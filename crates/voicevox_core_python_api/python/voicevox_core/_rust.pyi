@@ -1,5 +1,5 @@
 from pathlib import Path
-from typing import Dict, Final, List, Literal, Union
+from typing import Any, Dict, Final, List, Literal, Optional, Union
 from uuid import UUID
 
 import numpy as np
@@ -8,6 +8,9 @@ from voicevox_core import (
     AccelerationMode,
     AccentPhrase,
     AudioQuery,
+    ModelPrecision,
+    Priority,
+    SessionThreadOptions,
     SpeakerMeta,
     SupportedDevices,
     UserDict,
@@ -67,6 +70,41 @@ class OpenJtalk:
             ユーザー辞書。
         """
         ...
+    def export_compiled_user_dict(
+        self, user_dict: UserDict, dir: Union[Path, str]
+    ) -> None:
+        """ユーザー辞書をコンパイルしたものを、ディレクトリに書き出す。
+
+        書き出したものは :meth:`use_compiled_user_dict` でコンパイルし直さずに設定できる。
+
+        Parameters
+        ----------
+        user_dict
+            ユーザー辞書。
+        dir
+            書き出し先のディレクトリ。
+        """
+        ...
+    def use_compiled_user_dict(
+        self, user_dict: UserDict, dir: Union[Path, str]
+    ) -> bool:
+        """:meth:`export_compiled_user_dict` で書き出された辞書を、コンパイルし直さずに設定する。
+
+        ``dir`` の中から、ユーザー辞書と今のシステム辞書から作られたものを探す。該当するものが無い場合は
+        何もせずに ``False`` を返す。
+
+        Parameters
+        ----------
+        user_dict
+            ユーザー辞書。
+        dir
+            :meth:`export_compiled_user_dict` で書き出したディレクトリ。
+
+        Returns
+        -------
+        コンパイル済みの辞書を設定したかどうか。
+        """
+        ...
 
 class Synthesizer:
     """音声シンセサイザ。"""
@@ -79,6 +117,14 @@ class Synthesizer:
         ] = AccelerationMode.AUTO,
         cpu_num_threads: int = 0,
         load_all_models: bool = False,
+        light_session_threads: SessionThreadOptions = SessionThreadOptions(),
+        heavy_session_threads: SessionThreadOptions = SessionThreadOptions(),
+        model_precision: Union[
+            ModelPrecision, Literal["fp32", "fp16", "int8"]
+        ] = ModelPrecision.FP32,
+        auto_load_models: bool = False,
+        model_memory_budget: Optional[int] = None,
+        share_sessions: bool = False,
     ) -> "Synthesizer":
         """
         :class:`Synthesizer` を生成する。
@@ -87,6 +133,12 @@ class Synthesizer:
         :param acceleration_mode: ハードウェアアクセラレーションモード。
         :param cpu_num_threads: CPU利用数を指定。0を指定すると環境に合わせたCPUが利用される。
         :param load_all_models: 全てのモデルを読み込む。
+        :param light_session_threads: 軽いモデル(音素長・音高の推論)のスレッド数。
+        :param heavy_session_threads: 重いモデル(音声波形の生成)のスレッド数。
+        :param model_precision: 推論に使うモデルの数値精度。
+        :param auto_load_models: 読み込まれていないスタイルの推論を要求されたときに、そのスタイルを含む音声モデルを自動で読み込む。
+        :param model_memory_budget: 読み込まれている推論モデルの合計バイト数の上限。上限を超える場合、自動で読み込まれた音声モデルを最も長く使われていないものから解除する。
+        :param share_sessions: 同じ内容の推論モデルを同じ設定で読み込んだ、プロセス内の他の :class:`Synthesizer` と推論セッションを共有する。共有すると推論モデルの重みが一つ分のメモリで済むが、その推論モデルでの推論は :class:`Synthesizer` をまたいで一つずつ行われるようになる。
         """
         ...
     def __repr__(self) -> str: ...
@@ -98,6 +150,16 @@ class Synthesizer:
     def metas(self) -> SpeakerMeta:
         """メタ情報。"""
         ...
+    def stats(self) -> Dict[str, Any]:
+        """
+        処理段階ごとの所要時間、ロック待ちの時間、ロック待ちをしている処理の数の計測値。
+
+        :returns: ``stages`` 、 ``lock_waits`` 、 ``queue_depths`` をキーに持つ辞書。
+        """
+        ...
+    def stats_prometheus(self) -> str:
+        """:meth:`stats` をPrometheusのテキスト形式で出力する。"""
+        ...
     async def load_voice_model(self, model: VoiceModel) -> None:
         """
         モデルを読み込む。
@@ -190,15 +252,29 @@ class Synthesizer:
         audio_query: AudioQuery,
         style_id: int,
         enable_interrogative_upspeak: bool = True,
-    ) -> bytes:
+        priority: Union[
+            Priority, Literal["interactive", "normal", "batch"]
+        ] = Priority.NORMAL,
+        deadline: Optional[float] = None,
+        cancellation_token: Optional["CancellationToken"] = None,
+        timeout: Optional[float] = None,
+        output_format: Literal[
+            "wav", "flac", "mulaw", "alaw", "int16", "float32"
+        ] = "wav",
+    ) -> Union[bytes, NDArray[np.int16], NDArray[np.float32]]:
         """
         :class:`AudioQuery` から音声合成する。
 
         :param audio_query: :class:`AudioQuery` 。
         :param style_id: スタイルID。
         :param enable_interrogative_upspeak: 疑問文の調整を有効にする。
+        :param priority: 推論の優先度。
+        :param deadline: 推論を始めるまでの期限(秒)。期限までに推論を始められない場合、あるいは始められない見込みの場合は :class:`VoicevoxError` を送出する。
+        :param cancellation_token: 音声合成を中断するためのトークン。
+        :param timeout: 音声合成全体のタイムアウト(秒)。
+        :param output_format: 出力の形式。 ``"wav"`` と ``"flac"`` のときはそれぞれの形式のデータを、 ``"mulaw"`` と ``"alaw"`` のときはG.711のヘッダの無い8kHzのモノラルのデータを ``bytes`` で返す。 ``"int16"`` と ``"float32"`` のときはヘッダの無いPCMを読み取り専用のNumPy配列で返す。PCMのサンプルはネイティブのバイトオーダーで、ステレオのときは ``(フレーム数, 2)`` の形になる。
 
-        :returns: WAVデータ。
+        :returns: ``output_format`` に応じた音声データ。
         """
         ...
     async def tts(
@@ -207,7 +283,16 @@ class Synthesizer:
         style_id: int,
         kana: bool = False,
         enable_interrogative_upspeak: bool = True,
-    ) -> bytes:
+        priority: Union[
+            Priority, Literal["interactive", "normal", "batch"]
+        ] = Priority.NORMAL,
+        deadline: Optional[float] = None,
+        cancellation_token: Optional["CancellationToken"] = None,
+        timeout: Optional[float] = None,
+        output_format: Literal[
+            "wav", "flac", "mulaw", "alaw", "int16", "float32"
+        ] = "wav",
+    ) -> Union[bytes, NDArray[np.int16], NDArray[np.float32]]:
         """
         テキスト音声合成を実行する。
 
@@ -215,11 +300,32 @@ class Synthesizer:
         :param style_id: スタイルID。
         :param kana: ``text`` をAquesTalk風記法として解釈する。
         :param enable_interrogative_upspeak: 疑問文の調整を有効にする。
+        :param priority: 推論の優先度。
+        :param deadline: 推論を始めるまでの期限(秒)。テキストの解析を含めた全体に対して適用される。
+        :param cancellation_token: 音声合成を中断するためのトークン。
+        :param timeout: 音声合成全体のタイムアウト(秒)。テキストの解析を含めた全体に対して適用される。
+        :param output_format: 出力の形式。 :meth:`synthesis` と同じ。
 
-        :returns: WAVデータ。
+        :returns: ``output_format`` に応じた音声データ。
         """
         ...
 
+class CancellationToken:
+    """
+    音声合成を中断するためのトークン。
+
+    :meth:`Synthesizer.tts` などに渡したトークンの :meth:`cancel` を呼ぶと、その音声合成は次の処理段階に進む前、あるいは推論セッションの順番待ちの間に :class:`VoicevoxError` を送出する。
+    """
+
+    def __init__(self) -> None: ...
+    def cancel(self) -> None:
+        """中断を要求する。"""
+        ...
+    @property
+    def is_canceled(self) -> bool:
+        """中断が要求されているか。"""
+        ...
+
 class UserDict:
     """ユーザー辞書。
 
@@ -1,13 +1,17 @@
 use crate::VoicevoxError;
-use std::{fmt::Display, future::Future, path::PathBuf};
+use std::{fmt::Display, future::Future, path::PathBuf, time::Duration};
 
 use easy_ext::ext;
-use pyo3::{types::PyList, FromPyObject as _, PyAny, PyObject, PyResult, Python, ToPyObject};
+use pyo3::{
+    types::{PyBytes, PyList},
+    FromPyObject as _, PyAny, PyObject, PyResult, Python, ToPyObject,
+};
 use serde::{de::DeserializeOwned, Serialize};
 use serde_json::json;
 use uuid::Uuid;
 use voicevox_core::{
-    AccelerationMode, AccentPhraseModel, StyleId, UserDictWordType, VoiceModelMeta,
+    AccelerationMode, AccentPhraseModel, ModelPrecision, OutputFormat, Priority, SampleFormat,
+    StyleId, UserDictWordType, VoiceModelMeta, Waveform,
 };
 
 pub fn from_acceleration_mode(ob: &PyAny) -> PyResult<AccelerationMode> {
@@ -27,6 +31,57 @@ pub fn from_acceleration_mode(ob: &PyAny) -> PyResult<AccelerationMode> {
     }
 }
 
+pub fn from_model_precision(ob: &PyAny) -> PyResult<ModelPrecision> {
+    let py = ob.py();
+
+    let class = py.import("voicevox_core")?.getattr("ModelPrecision")?;
+    let precision = class.call1((ob,))?.getattr("value")?.extract::<String>()?;
+    serde_json::from_value(json!(precision)).into_py_result()
+}
+
+pub fn from_priority(ob: &PyAny) -> PyResult<Priority> {
+    let py = ob.py();
+
+    let class = py.import("voicevox_core")?.getattr("Priority")?;
+    let priority = class.call1((ob,))?.getattr("value")?.extract::<String>()?;
+    serde_json::from_value(json!(priority)).into_py_result()
+}
+
+pub fn from_deadline(ob: &PyAny) -> PyResult<Option<Duration>> {
+    if ob.is_none() {
+        return Ok(None);
+    }
+    let secs = ob.extract::<f64>()?;
+    Duration::try_from_secs_f64(secs).map(Some).into_py_result()
+}
+
+/// Python側の`output_format`。
+#[derive(Clone, Copy)]
+pub enum PyOutputFormat {
+    /// `bytes`として返す形式。
+    Encoded(OutputFormat),
+    /// ヘッダの無いPCMとして、NumPy配列で返す形式。
+    Pcm(SampleFormat),
+}
+
+pub fn from_output_format(ob: &PyAny) -> PyResult<PyOutputFormat> {
+    if ob.is_none() {
+        return Ok(PyOutputFormat::Encoded(OutputFormat::Wav));
+    }
+    match ob.extract::<&str>()? {
+        "wav" => Ok(PyOutputFormat::Encoded(OutputFormat::Wav)),
+        "flac" => Ok(PyOutputFormat::Encoded(OutputFormat::Flac)),
+        "mulaw" => Ok(PyOutputFormat::Encoded(OutputFormat::MuLaw)),
+        "alaw" => Ok(PyOutputFormat::Encoded(OutputFormat::ALaw)),
+        "int16" => Ok(PyOutputFormat::Pcm(SampleFormat::I16)),
+        "float32" => Ok(PyOutputFormat::Pcm(SampleFormat::F32)),
+        s => Err(VoicevoxError::new_err(format!(
+            "{s:?} should be one of \
+             {{\"wav\", \"flac\", \"mulaw\", \"alaw\", \"int16\", \"float32\"}}"
+        ))),
+    }
+}
+
 pub fn from_utf8_path(ob: &PyAny) -> PyResult<String> {
     PathBuf::extract(ob)?
         .into_os_string()
@@ -146,3 +201,38 @@ pub impl<T, E: Display> Result<T, E> {
         self.map_err(|e| VoicevoxError::new_err(e.to_string()))
     }
 }
+
+/// 音声波形を、WAVとPCMのときはRust側でバッファを確保せずに直接`bytes`に書き出す。
+///
+/// PCMのときは、その`bytes`をコピーせずに参照するNumPy配列を返す。
+pub fn to_py_audio(py: Python, waveform: &Waveform, format: PyOutputFormat) -> PyResult<PyObject> {
+    let format = match format {
+        PyOutputFormat::Pcm(format) => format,
+        PyOutputFormat::Encoded(OutputFormat::Wav) => {
+            let wav = PyBytes::new_with(py, waveform.wav_len(), |buf| {
+                waveform.write_wav(buf);
+                Ok(())
+            })?;
+            return Ok(wav.to_object(py));
+        }
+        PyOutputFormat::Encoded(format) => {
+            // 圧縮後の長さは前もって分からないため、一度Rust側で書き出す
+            return Ok(PyBytes::new(py, &waveform.encode(format)).to_object(py));
+        }
+    };
+    let pcm = PyBytes::new_with(py, waveform.pcm_len(format), |buf| {
+        waveform.write_pcm(format, buf);
+        Ok(())
+    })?;
+    let dtype = match format {
+        SampleFormat::I16 => "int16",
+        SampleFormat::F32 => "float32",
+    };
+    let mut array = py
+        .import("numpy")?
+        .call_method1("frombuffer", (pcm, dtype))?;
+    if waveform.num_channels() > 1 {
+        array = array.call_method1("reshape", (-1, waveform.num_channels()))?;
+    }
+    Ok(array.to_object(py))
+}
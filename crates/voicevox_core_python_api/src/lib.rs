@@ -1,25 +1,22 @@
-use std::sync::Arc;
+use std::{sync::Arc, time::Duration};
 
 mod convert;
 use convert::*;
 use log::debug;
-use once_cell::sync::Lazy;
 use pyo3::{
     create_exception,
     exceptions::PyException,
     pyclass, pyfunction, pymethods, pymodule,
-    types::{IntoPyDict as _, PyBytes, PyDict, PyList, PyModule},
+    types::{IntoPyDict as _, PyDict, PyList, PyModule},
     wrap_pyfunction, PyAny, PyObject, PyResult, Python, ToPyObject,
 };
-use tokio::{runtime::Runtime, sync::Mutex};
 use uuid::Uuid;
 use voicevox_core::{
     AccelerationMode, AccentPhrasesOptions, AudioQueryModel, AudioQueryOptions, InitializeOptions,
-    StyleId, SynthesisOptions, TtsOptions, UserDictWord, VoiceModelId,
+    ModelPrecision, Priority, SessionThreadOptions, StyleId, SynthesisOptions, TtsOptions,
+    UserDictWord, VoiceModelId,
 };
 
-static RUNTIME: Lazy<Runtime> = Lazy::new(|| Runtime::new().unwrap());
-
 #[pymodule]
 #[pyo3(name = "_rust")]
 fn rust(py: Python<'_>, module: &PyModule) -> PyResult<()> {
@@ -34,6 +31,7 @@ fn rust(py: Python<'_>, module: &PyModule) -> PyResult<()> {
     module.add_class::<OpenJtalk>()?;
     module.add_class::<VoiceModel>()?;
     module.add_class::<UserDict>()?;
+    module.add_class::<CancellationToken>()?;
     module.add("VoicevoxError", py.get_type::<VoicevoxError>())?;
     Ok(())
 }
@@ -110,11 +108,31 @@ impl OpenJtalk {
             .use_user_dict(&user_dict.dict)
             .into_py_result()
     }
+
+    fn export_compiled_user_dict(
+        &self,
+        user_dict: UserDict,
+        #[pyo3(from_py_with = "from_utf8_path")] dir: String,
+    ) -> PyResult<()> {
+        self.open_jtalk
+            .export_compiled_user_dict(&user_dict.dict, dir)
+            .into_py_result()
+    }
+
+    fn use_compiled_user_dict(
+        &self,
+        user_dict: UserDict,
+        #[pyo3(from_py_with = "from_utf8_path")] dir: String,
+    ) -> PyResult<bool> {
+        self.open_jtalk
+            .use_compiled_user_dict(&user_dict.dict, dir)
+            .into_py_result()
+    }
 }
 
 #[pyclass]
 struct Synthesizer {
-    synthesizer: Arc<Mutex<voicevox_core::Synthesizer>>,
+    synthesizer: Arc<voicevox_core::Synthesizer>,
 }
 
 #[pymethods]
@@ -125,13 +143,26 @@ impl Synthesizer {
         acceleration_mode = InitializeOptions::default().acceleration_mode,
         cpu_num_threads = InitializeOptions::default().cpu_num_threads,
         load_all_models = InitializeOptions::default().load_all_models,
+        light_session_threads = InitializeOptions::default().light_session_threads,
+        heavy_session_threads = InitializeOptions::default().heavy_session_threads,
+        model_precision = InitializeOptions::default().model_precision,
+        auto_load_models = InitializeOptions::default().auto_load_models,
+        model_memory_budget = InitializeOptions::default().model_memory_budget,
+        share_sessions = InitializeOptions::default().share_sessions,
     ))]
+    #[allow(clippy::too_many_arguments)]
     fn new_with_initialize(
         py: Python,
         open_jtalk: OpenJtalk,
         #[pyo3(from_py_with = "from_acceleration_mode")] acceleration_mode: AccelerationMode,
         cpu_num_threads: u16,
         load_all_models: bool,
+        #[pyo3(from_py_with = "from_dataclass")] light_session_threads: SessionThreadOptions,
+        #[pyo3(from_py_with = "from_dataclass")] heavy_session_threads: SessionThreadOptions,
+        #[pyo3(from_py_with = "from_model_precision")] model_precision: ModelPrecision,
+        auto_load_models: bool,
+        model_memory_budget: Option<u64>,
+        share_sessions: bool,
     ) -> PyResult<&PyAny> {
         pyo3_asyncio::tokio::future_into_py(py, async move {
             let synthesizer = voicevox_core::Synthesizer::new_with_initialize(
@@ -140,12 +171,18 @@ impl Synthesizer {
                     acceleration_mode,
                     cpu_num_threads,
                     load_all_models,
+                    light_session_threads,
+                    heavy_session_threads,
+                    model_precision,
+                    auto_load_models,
+                    model_memory_budget,
+                    share_sessions,
                 },
             )
             .await
             .into_py_result()?;
             Ok(Self {
-                synthesizer: Arc::new(Mutex::new(synthesizer)),
+                synthesizer: Arc::new(synthesizer),
             })
         })
     }
@@ -156,12 +193,22 @@ impl Synthesizer {
 
     #[getter]
     fn is_gpu_mode(&self) -> bool {
-        RUNTIME.block_on(self.synthesizer.lock()).is_gpu_mode()
+        self.synthesizer.is_gpu_mode()
     }
 
     #[getter]
     fn metas<'py>(&self, py: Python<'py>) -> Vec<&'py PyAny> {
-        to_pydantic_voice_model_meta(RUNTIME.block_on(self.synthesizer.lock()).metas(), py).unwrap()
+        to_pydantic_voice_model_meta(&self.synthesizer.metas(), py).unwrap()
+    }
+
+    fn stats<'py>(&self, py: Python<'py>) -> PyResult<&'py PyAny> {
+        let stats = self.synthesizer.stats();
+        let stats = serde_json::to_string(&stats).into_py_result()?;
+        py.import("json")?.call_method1("loads", (stats,))
+    }
+
+    fn stats_prometheus(&self) -> String {
+        self.synthesizer.stats().to_prometheus_text()
     }
 
     fn load_voice_model<'py>(
@@ -173,8 +220,6 @@ impl Synthesizer {
         let synthesizer = self.synthesizer.clone();
         pyo3_asyncio::tokio::future_into_py(py, async move {
             synthesizer
-                .lock()
-                .await
                 .load_voice_model(&model.model)
                 .await
                 .into_py_result()
@@ -182,15 +227,13 @@ impl Synthesizer {
     }
 
     fn unload_voice_model(&mut self, voice_model_id: &str) -> PyResult<()> {
-        RUNTIME
-            .block_on(self.synthesizer.lock())
+        self.synthesizer
             .unload_voice_model(&VoiceModelId::new(voice_model_id.to_string()))
             .into_py_result()
     }
 
     fn is_loaded_voice_model(&self, voice_model_id: &str) -> bool {
-        RUNTIME
-            .block_on(self.synthesizer.lock())
+        self.synthesizer
             .is_loaded_voice_model(&VoiceModelId::new(voice_model_id.to_string()))
     }
 
@@ -209,8 +252,6 @@ impl Synthesizer {
             pyo3_asyncio::tokio::get_current_locals(py)?,
             async move {
                 let audio_query = synthesizer
-                    .lock()
-                    .await
                     .audio_query(&text, StyleId::new(style_id), &AudioQueryOptions { kana })
                     .await
                     .into_py_result()?;
@@ -239,8 +280,6 @@ impl Synthesizer {
             pyo3_asyncio::tokio::get_current_locals(py)?,
             async move {
                 let accent_phrases = synthesizer
-                    .lock()
-                    .await
                     .create_accent_phrases(
                         &text,
                         StyleId::new(style_id),
@@ -272,7 +311,7 @@ impl Synthesizer {
             accent_phrases,
             StyleId::new(style_id),
             py,
-            |a, s| async move { synthesizer.lock().await.replace_mora_data(&a, s).await },
+            |a, s| async move { synthesizer.replace_mora_data(&a, s).await },
         )
     }
 
@@ -287,7 +326,7 @@ impl Synthesizer {
             accent_phrases,
             StyleId::new(style_id),
             py,
-            |a, s| async move { synthesizer.lock().await.replace_phoneme_length(&a, s).await },
+            |a, s| async move { synthesizer.replace_phoneme_length(&a, s).await },
         )
     }
 
@@ -302,16 +341,31 @@ impl Synthesizer {
             accent_phrases,
             StyleId::new(style_id),
             py,
-            |a, s| async move { synthesizer.lock().await.replace_mora_pitch(&a, s).await },
+            |a, s| async move { synthesizer.replace_mora_pitch(&a, s).await },
         )
     }
 
-    #[pyo3(signature=(audio_query,style_id,enable_interrogative_upspeak = TtsOptions::default().enable_interrogative_upspeak))]
+    #[pyo3(signature=(
+        audio_query,
+        style_id,
+        enable_interrogative_upspeak = TtsOptions::default().enable_interrogative_upspeak,
+        priority = TtsOptions::default().priority,
+        deadline = None,
+        cancellation_token = None,
+        timeout = None,
+        output_format = None
+    ))]
+    #[allow(clippy::too_many_arguments)]
     fn synthesis<'py>(
         &self,
         #[pyo3(from_py_with = "from_dataclass")] audio_query: AudioQueryModel,
         style_id: u32,
         enable_interrogative_upspeak: bool,
+        #[pyo3(from_py_with = "from_priority")] priority: Priority,
+        #[pyo3(from_py_with = "from_deadline")] deadline: Option<Duration>,
+        cancellation_token: Option<CancellationToken>,
+        #[pyo3(from_py_with = "from_deadline")] timeout: Option<Duration>,
+        #[pyo3(from_py_with = "from_output_format")] output_format: PyOutputFormat,
         py: Python<'py>,
     ) -> PyResult<&'py PyAny> {
         let synthesizer = self.synthesizer.clone();
@@ -319,19 +373,22 @@ impl Synthesizer {
             py,
             pyo3_asyncio::tokio::get_current_locals(py)?,
             async move {
-                let wav = synthesizer
-                    .lock()
-                    .await
-                    .synthesis(
+                let waveform = synthesizer
+                    .synthesis_waveform(
                         &audio_query,
                         StyleId::new(style_id),
                         &SynthesisOptions {
                             enable_interrogative_upspeak,
+                            priority,
+                            deadline,
+                            cancellation_token: cancellation_token.map(|t| t.token),
+                            timeout,
+                            output_format: Default::default(),
                         },
                     )
                     .await
                     .into_py_result()?;
-                Python::with_gil(|py| Ok(PyBytes::new(py, &wav).to_object(py)))
+                Python::with_gil(|py| to_py_audio(py, &waveform, output_format))
             },
         )
     }
@@ -340,20 +397,36 @@ impl Synthesizer {
         text,
         style_id,
         kana = TtsOptions::default().kana,
-        enable_interrogative_upspeak = TtsOptions::default().enable_interrogative_upspeak
+        enable_interrogative_upspeak = TtsOptions::default().enable_interrogative_upspeak,
+        priority = TtsOptions::default().priority,
+        deadline = None,
+        cancellation_token = None,
+        timeout = None,
+        output_format = None
     ))]
+    #[allow(clippy::too_many_arguments)]
     fn tts<'py>(
         &self,
         text: &str,
         style_id: u32,
         kana: bool,
         enable_interrogative_upspeak: bool,
+        #[pyo3(from_py_with = "from_priority")] priority: Priority,
+        #[pyo3(from_py_with = "from_deadline")] deadline: Option<Duration>,
+        cancellation_token: Option<CancellationToken>,
+        #[pyo3(from_py_with = "from_deadline")] timeout: Option<Duration>,
+        #[pyo3(from_py_with = "from_output_format")] output_format: PyOutputFormat,
         py: Python<'py>,
     ) -> PyResult<&'py PyAny> {
         let style_id = StyleId::new(style_id);
         let options = TtsOptions {
             kana,
             enable_interrogative_upspeak,
+            priority,
+            deadline,
+            cancellation_token: cancellation_token.map(|t| t.token),
+            timeout,
+            output_format: Default::default(),
         };
         let synthesizer = self.synthesizer.clone();
         let text = text.to_owned();
@@ -361,18 +434,39 @@ impl Synthesizer {
             py,
             pyo3_asyncio::tokio::get_current_locals(py)?,
             async move {
-                let wav = synthesizer
-                    .lock()
-                    .await
-                    .tts(&text, style_id, &options)
+                let waveform = synthesizer
+                    .tts_waveform(&text, style_id, &options)
                     .await
                     .into_py_result()?;
-                Python::with_gil(|py| Ok(PyBytes::new(py, &wav).to_object(py)))
+                Python::with_gil(|py| to_py_audio(py, &waveform, output_format))
             },
         )
     }
 }
 
+#[pyclass]
+#[derive(Default, Clone)]
+struct CancellationToken {
+    token: voicevox_core::CancellationToken,
+}
+
+#[pymethods]
+impl CancellationToken {
+    #[new]
+    fn new() -> Self {
+        Self::default()
+    }
+
+    fn cancel(&self) {
+        self.token.cancel();
+    }
+
+    #[getter]
+    fn is_canceled(&self) -> bool {
+        self.token.is_canceled()
+    }
+}
+
 #[pyfunction]
 fn _validate_pronunciation(pronunciation: &str) -> PyResult<()> {
     voicevox_core::validate_pronunciation(pronunciation).into_py_result()
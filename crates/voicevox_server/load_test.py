@@ -0,0 +1,205 @@
+"""
+ローカルの voicevox_server に負荷をかけ、スループットとレイテンシを測る。
+
+``--connections`` 個のスレッドがそれぞれキープアライブの接続を一つずつ持ち、``--duration`` 秒の間
+リクエストを送り続ける。前のレスポンスを受け取り終えてから次のリクエストを送る。
+
+``--endpoint tts`` では ``/tts`` を使い、最初の文の音声が届くまでの時間 (TTFB) も測る。
+``--endpoint synthesis`` では VOICEVOX ENGINE と同じく ``/audio_query`` と ``/synthesis`` を続けて
+呼び、その合計を一つのリクエストとして数える。標準ライブラリのみで動く。
+
+    python load_test.py --connections 8 --duration 60
+"""
+
+import http.client
+import json
+import struct
+import threading
+import time
+from argparse import ArgumentParser
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+from urllib.parse import urlencode, urlsplit
+
+TEXTS = [
+    "こんにちは。",
+    "この音声は、ボイスボックスを使用して、出力されています。",
+    "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。"
+    "何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。",
+]
+
+
+@dataclass
+class Stats:
+    """一つの接続の計測結果。"""
+
+    latencies: List[float] = field(default_factory=list)
+    ttfbs: List[float] = field(default_factory=list)
+    errors: Dict[str, int] = field(default_factory=dict)
+    audio_seconds: float = 0.0
+    connects: int = 0
+
+
+def main() -> None:
+    args = parse_args()
+    url = urlsplit(args.url)
+    texts = args.text or TEXTS
+    deadline = time.monotonic() + args.duration
+
+    stats = [Stats() for _ in range(args.connections)]
+    threads = [
+        threading.Thread(
+            target=run_connection,
+            args=(url.hostname, url.port or 80, args, texts[i:] + texts[:i], deadline, s),
+        )
+        for i, s in enumerate(stats)
+    ]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    report(stats, time.monotonic() - start, args)
+
+
+def parse_args():
+    argparser = ArgumentParser()
+    argparser.add_argument("--url", default="http://127.0.0.1:50021", help="サーバーのURL")
+    argparser.add_argument("--speaker", type=int, default=0, help="スタイルID")
+    argparser.add_argument(
+        "--endpoint", choices=["tts", "synthesis"], default="tts", help="使うエンドポイント"
+    )
+    argparser.add_argument(
+        "--output-format",
+        choices=["wav", "flac", "mu_law", "a_law"],
+        default="wav",
+        help="/ttsの出力の形式。音声の長さはwavでのみ測る",
+    )
+    argparser.add_argument("--connections", type=int, default=4, help="同時に使う接続の数")
+    argparser.add_argument("--duration", type=float, default=30.0, help="計測の時間(秒)")
+    argparser.add_argument(
+        "--text", action="append", help="送るテキスト。複数指定すると順に使う"
+    )
+    return argparser.parse_args()
+
+
+def run_connection(
+    host: str, port: int, args, texts: List[str], deadline: float, stats: Stats
+) -> None:
+    conn: Optional[http.client.HTTPConnection] = None
+    i = 0
+    while time.monotonic() < deadline:
+        if conn is None:
+            conn = http.client.HTTPConnection(host, port, timeout=300)
+            stats.connects += 1
+        text = texts[i % len(texts)]
+        i += 1
+        start = time.monotonic()
+        try:
+            if args.endpoint == "tts":
+                status, audio, ttfb = tts(conn, args, text, start)
+                stats.ttfbs.append(ttfb)
+            else:
+                status, audio = synthesis(conn, args, text)
+        except (OSError, http.client.HTTPException) as e:
+            count(stats.errors, type(e).__name__)
+            conn.close()
+            conn = None
+            continue
+        if status != 200:
+            count(stats.errors, str(status))
+            continue
+        stats.latencies.append(time.monotonic() - start)
+        stats.audio_seconds += wav_seconds(audio) if audio_is_wav(args) else 0.0
+    if conn is not None:
+        conn.close()
+
+
+def tts(
+    conn: http.client.HTTPConnection, args, text: str, start: float
+) -> Tuple[int, bytes, float]:
+    query = {"text": text, "speaker": args.speaker, "output_format": args.output_format}
+    conn.request("POST", "/tts?" + urlencode(query))
+    # ステータスラインは最初の文の音声と共に送られる
+    response = conn.getresponse()
+    ttfb = time.monotonic() - start
+    return response.status, response.read(), ttfb
+
+
+def synthesis(conn: http.client.HTTPConnection, args, text: str) -> Tuple[int, bytes]:
+    query = {"text": text, "speaker": args.speaker}
+    conn.request("POST", "/audio_query?" + urlencode(query))
+    response = conn.getresponse()
+    audio_query = response.read()
+    if response.status != 200:
+        return response.status, b""
+    conn.request(
+        "POST",
+        "/synthesis?" + urlencode({"speaker": args.speaker}),
+        body=audio_query,
+        headers={"Content-Type": "application/json"},
+    )
+    response = conn.getresponse()
+    return response.status, response.read()
+
+
+def audio_is_wav(args) -> bool:
+    return args.endpoint == "synthesis" or args.output_format == "wav"
+
+
+def wav_seconds(wav: bytes) -> float:
+    """16ビットのWAVの長さ(秒)。ヘッダの長さの欄ではなく、受け取ったバイト数から求める。"""
+    if len(wav) < 44:
+        return 0.0
+    (num_channels, sampling_rate) = struct.unpack_from("<HI", wav, 22)
+    return (len(wav) - 44) / (2 * num_channels * sampling_rate)
+
+
+def count(counts: Dict[str, int], key: str) -> None:
+    counts[key] = counts.get(key, 0) + 1
+
+
+def report(stats: List[Stats], elapsed: float, args) -> None:
+    latencies = sorted(latency for s in stats for latency in s.latencies)
+    ttfbs = sorted(ttfb for s in stats for ttfb in s.ttfbs)
+    errors: Dict[str, int] = {}
+    for s in stats:
+        for key, n in s.errors.items():
+            errors[key] = errors.get(key, 0) + n
+    audio_seconds = sum(s.audio_seconds for s in stats)
+
+    result = {
+        "endpoint": args.endpoint,
+        "connections": args.connections,
+        "seconds": round(elapsed, 1),
+        "requests": len(latencies),
+        "errors": errors,
+        "connects": sum(s.connects for s in stats),
+        "requests_per_second": round(len(latencies) / elapsed, 2),
+        "latency_ms": summarize(latencies),
+    }
+    if ttfbs:
+        result["ttfb_ms"] = summarize(ttfbs)
+    if audio_is_wav(args):
+        # 1秒あたりに合成できた音声の長さ。実時間比(RTF)の逆数
+        result["audio_seconds_per_second"] = round(audio_seconds / elapsed, 2)
+    print(json.dumps(result, ensure_ascii=False, indent=2))
+
+
+def summarize(values: List[float]) -> Dict[str, float]:
+    if not values:
+        return {}
+
+    def percentile(p: float) -> float:
+        return round(values[min(int(len(values) * p), len(values) - 1)] * 1e3, 1)
+
+    return {
+        "p50": percentile(0.5),
+        "p95": percentile(0.95),
+        "p99": percentile(0.99),
+        "max": round(values[-1] * 1e3, 1),
+    }
+
+
+if __name__ == "__main__":
+    main()
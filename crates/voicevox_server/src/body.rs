@@ -0,0 +1,63 @@
+//! レスポンスの本体。
+
+use std::{
+    pin::Pin,
+    task::{Context, Poll},
+};
+
+use bytes::Bytes;
+use http_body::{Frame, SizeHint};
+use tokio::sync::mpsc;
+
+pub(crate) enum Body {
+    /// 全体が決まっているもの。長さを`Content-Length`で伝える。
+    Full(Option<Bytes>),
+    /// 合成できたものから順に送るもの。チャンク転送で送る。
+    ///
+    /// 途中でエラーを受け取った場合は、ステータスコードを送った後であるため、接続を切って応答が
+    /// 不完全であることを伝える。
+    Stream {
+        first: Option<Bytes>,
+        rest: mpsc::Receiver<voicevox_core::Result<Bytes>>,
+    },
+}
+
+impl Body {
+    pub(crate) fn full(data: impl Into<Bytes>) -> Self {
+        Self::Full(Some(data.into()))
+    }
+}
+
+impl http_body::Body for Body {
+    type Data = Bytes;
+    type Error = voicevox_core::Error;
+
+    fn poll_frame(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+    ) -> Poll<Option<Result<Frame<Bytes>, Self::Error>>> {
+        match self.get_mut() {
+            Self::Full(data) => Poll::Ready(data.take().map(|data| Ok(Frame::data(data)))),
+            Self::Stream { first, rest } => {
+                if let Some(first) = first.take() {
+                    return Poll::Ready(Some(Ok(Frame::data(first))));
+                }
+                rest.poll_recv(cx)
+                    .map(|chunk| chunk.map(|chunk| chunk.map(Frame::data)))
+            }
+        }
+    }
+
+    fn is_end_stream(&self) -> bool {
+        matches!(self, Self::Full(None))
+    }
+
+    fn size_hint(&self) -> SizeHint {
+        match self {
+            Self::Full(data) => {
+                SizeHint::with_exact(data.as_ref().map_or(0, |data| data.len() as _))
+            }
+            Self::Stream { .. } => SizeHint::default(),
+        }
+    }
+}
@@ -0,0 +1,107 @@
+//! VOICEVOX ENGINEとのJSONの形の違いを埋める。
+//!
+//! ENGINEのAudioQueryは、全体に関わる値のキーがキャメルケース(`speedScale`など)になっている。
+//! アクセント句とモーラのキーはどちらもスネークケースで同じ形。
+
+use serde_json::Value;
+use voicevox_core::AudioQueryModel;
+
+/// AudioQueryのキーのうち、ENGINEでは名前が異なるもの。
+const RENAMED_KEYS: &[(&str, &str)] = &[
+    ("speed_scale", "speedScale"),
+    ("pitch_scale", "pitchScale"),
+    ("intonation_scale", "intonationScale"),
+    ("volume_scale", "volumeScale"),
+    ("pre_phoneme_length", "prePhonemeLength"),
+    ("post_phoneme_length", "postPhonemeLength"),
+    ("output_sampling_rate", "outputSamplingRate"),
+    ("output_stereo", "outputStereo"),
+];
+
+/// ENGINEと同じ形のAudioQueryにする。
+pub(crate) fn audio_query_to_engine(audio_query: &AudioQueryModel) -> Value {
+    let audio_query = serde_json::to_value(audio_query).expect("should be serializable");
+    rename_keys(audio_query, |key| {
+        RENAMED_KEYS
+            .iter()
+            .find(|(ours, _)| *ours == key)
+            .map(|&(_, engine)| engine)
+    })
+}
+
+/// ENGINEと同じ形のAudioQueryを読む。VOICEVOX COREと同じ形のものもそのまま読める。
+pub(crate) fn audio_query_from_engine(audio_query: Value) -> serde_json::Result<AudioQueryModel> {
+    serde_json::from_value(rename_keys(audio_query, |key| {
+        RENAMED_KEYS
+            .iter()
+            .find(|(_, engine)| *engine == key)
+            .map(|&(ours, _)| ours)
+    }))
+}
+
+/// オブジェクトのキーを、順番を保ったまま`rename`で付け替える。
+fn rename_keys(value: Value, rename: impl Fn(&str) -> Option<&'static str>) -> Value {
+    let Value::Object(object) = value else {
+        return value;
+    };
+    let object = object
+        .into_iter()
+        .map(|(key, value)| match rename(&key) {
+            Some(renamed) => (renamed.to_owned(), value),
+            None => (key, value),
+        })
+        .collect();
+    Value::Object(object)
+}
+
+#[cfg(test)]
+mod tests {
+    use serde_json::json;
+
+    use super::*;
+
+    fn engine_audio_query() -> Value {
+        json!({
+            "accent_phrases": [
+                {
+                    "moras": [
+                        {
+                            "text": "ア",
+                            "consonant": null,
+                            "consonant_length": null,
+                            "vowel": "a",
+                            "vowel_length": 0.125,
+                            "pitch": 5.0
+                        }
+                    ],
+                    "accent": 1,
+                    "pause_mora": null,
+                    "is_interrogative": false
+                }
+            ],
+            "speedScale": 1.0,
+            "pitchScale": 0.0,
+            "intonationScale": 1.0,
+            "volumeScale": 1.0,
+            "prePhonemeLength": 0.125,
+            "postPhonemeLength": 0.125,
+            "outputSamplingRate": 24000,
+            "outputStereo": false,
+            "kana": "ア'"
+        })
+    }
+
+    #[test]
+    fn audio_query_round_trips() {
+        let audio_query = audio_query_from_engine(engine_audio_query()).unwrap();
+        assert_eq!(engine_audio_query(), audio_query_to_engine(&audio_query),);
+    }
+
+    #[test]
+    fn audio_query_from_engine_accepts_snake_case() {
+        let snake_case =
+            serde_json::to_value(audio_query_from_engine(engine_audio_query()).unwrap()).unwrap();
+        let audio_query = audio_query_from_engine(snake_case).unwrap();
+        assert_eq!(24000, *audio_query.output_sampling_rate());
+    }
+}
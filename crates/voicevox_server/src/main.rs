@@ -0,0 +1,329 @@
+//! VOICEVOX ENGINEと互換のエンドポイントを持つ、ローカルのHTTPサーバー。
+//!
+//! 推論セッションの組を`--sessions`の数だけ作り(組ごとに`Synthesizer`を一つ作り、同じ音声モデルを
+//! 読み込む)、推論を伴うリクエストを空いている組に振り分ける。一つの組は一度に一つの推論しか
+//! できないため、並列に推論できるリクエストの数は組の数までとなる。その代わり、推論モデルは組の
+//! 数だけメモリに載る。
+//!
+//! 推論はブロックしてよいスレッドで行い、同時に推論するリクエストの数を`--max-concurrency`で制限
+//! する。接続はキープアライブで使い回し、`/tts`は文ごとに合成できたものから順に送る。
+//!
+//! ```console
+//! $ cargo run --release -p voicevox_server -- --open-jtalk-dict-dir dict
+//! $ curl -X POST 'localhost:50021/audio_query?speaker=0&text=こんにちは' > query.json
+//! $ curl -X POST 'localhost:50021/synthesis?speaker=0' \
+//!     -H 'Content-Type: application/json' -d @query.json > audio.wav
+//! ```
+//!
+//! | エンドポイント | 内容 |
+//! |----------------|------|
+//! | `GET /version`, `GET /core_versions` | VOICEVOX COREのバージョン |
+//! | `GET /speakers` | 読み込まれている話者のメタ情報 |
+//! | `POST /audio_query` | AudioQueryを作る。ENGINEと同じくキャメルケースのキーで返す |
+//! | `POST /accent_phrases` | アクセント句を作る |
+//! | `POST /synthesis` | AudioQueryから音声合成を行い、全体を一度に返す |
+//! | `POST /tts` | テキスト音声合成を行い、文ごとに少しずつ返す(ENGINEには無い) |
+//! | `GET /metrics` | Prometheusのテキスト形式の統計 |
+
+mod body;
+mod compat;
+mod routes;
+
+use std::{
+    future::Future,
+    io,
+    net::SocketAddr,
+    path::PathBuf,
+    pin::pin,
+    sync::{Arc, Mutex},
+    thread,
+    time::{Duration, Instant},
+};
+
+use anyhow::Context as _;
+use clap::{Parser as _, ValueEnum};
+use hyper::{server::conn::http1, service::service_fn};
+use hyper_util::{
+    rt::{TokioIo, TokioTimer},
+    server::graceful::GracefulShutdown,
+};
+use tokio::{
+    net::TcpListener,
+    runtime::{self, Handle},
+    sync::Semaphore,
+};
+use tracing::{debug, info, warn};
+use voicevox_core::{
+    AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer, SynthesizerStats, VoiceModel,
+    VoiceModelMeta,
+};
+
+/// 終了を指示されてから、処理中のリクエストを待つ時間の上限。
+const SHUTDOWN_TIMEOUT: Duration = Duration::from_secs(30);
+
+#[derive(clap::Parser)]
+struct Args {
+    /// 待ち受けるアドレス
+    #[arg(long, default_value = "127.0.0.1:50021")]
+    addr: SocketAddr,
+
+    /// Open JTalkの辞書のディレクトリ
+    #[arg(long)]
+    open_jtalk_dict_dir: PathBuf,
+
+    /// 読み込むVVMファイル。指定しなければ、モデルディレクトリにあるものをすべて読み込む
+    #[arg(long)]
+    vvm: Vec<PathBuf>,
+
+    /// ハードウェアアクセラレーションモード
+    #[arg(value_enum, long, default_value_t = Device::Cpu)]
+    device: Device,
+
+    /// 推論のスレッド数。0のときはVOICEVOX COREの既定の値
+    #[arg(long, default_value_t = 0)]
+    cpu_num_threads: u16,
+
+    /// 接続を処理するワーカースレッドの数。指定しなければ論理コア数
+    #[arg(long)]
+    workers: Option<usize>,
+
+    /// 推論セッションの組の数。組ごとに音声モデルを読み込むため、推論モデルは組の数だけメモリに
+    /// 載る
+    #[arg(long, default_value_t = 1)]
+    sessions: usize,
+
+    /// 同時に推論するリクエストの数の上限。超えた分は順番を待つ。指定しなければ`--sessions`と同じ。
+    /// `--sessions`より大きくしても、超えた分は推論セッションが空くのを待つ
+    #[arg(long)]
+    max_concurrency: Option<usize>,
+
+    /// キープアライブの接続で次のリクエストを待つ時間、およびヘッダを受け取るまでの時間の上限(秒)
+    #[arg(long, default_value_t = 5)]
+    keep_alive_timeout: u64,
+}
+
+#[derive(ValueEnum, Clone, Copy)]
+enum Device {
+    Cpu,
+    Gpu,
+}
+
+/// すべての接続で共有する状態。
+pub(crate) struct App {
+    /// 推論セッションの組ごとの`Synthesizer`。どれも同じ音声モデルを読み込んでいる。
+    synthesizers: Vec<Arc<Synthesizer>>,
+    /// `synthesizers`それぞれで推論しているリクエストの数。
+    busy: Mutex<Vec<usize>>,
+    /// 同時に推論するリクエストの数を制限する。
+    inference: Arc<Semaphore>,
+}
+
+impl App {
+    pub(crate) fn new(synthesizers: Vec<Synthesizer>, max_concurrency: usize) -> Self {
+        assert!(!synthesizers.is_empty());
+        Self {
+            busy: Mutex::new(vec![0; synthesizers.len()]),
+            synthesizers: synthesizers.into_iter().map(Arc::new).collect(),
+            inference: Arc::new(Semaphore::new(max_concurrency.max(1))),
+        }
+    }
+
+    /// 読み込まれている音声モデルのメタ情報。
+    pub(crate) fn metas(&self) -> VoiceModelMeta {
+        self.synthesizers[0].metas()
+    }
+
+    /// すべての`Synthesizer`の計測値を足し合わせたもの。
+    pub(crate) fn stats(&self) -> SynthesizerStats {
+        let mut stats = self.synthesizers[0].stats();
+        for synthesizer in &self.synthesizers[1..] {
+            stats.merge(&synthesizer.stats());
+        }
+        stats
+    }
+
+    /// 推論を伴う処理`f`を、ブロックしてよいスレッドで行う。
+    ///
+    /// `Synthesizer`の非同期関数は推論の間スレッドをブロックするため、接続を処理するワーカー
+    /// スレッドでは呼ばない。`--max-concurrency`を超える分は、ここで順番を待つ。`f`には、推論して
+    /// いるリクエストが最も少ない組の`Synthesizer`を渡す。
+    pub(crate) async fn infer<F, Fut, T>(self: &Arc<Self>, f: F) -> T
+    where
+        F: FnOnce(Arc<Synthesizer>) -> Fut + Send + 'static,
+        Fut: Future<Output = T>,
+        T: Send + 'static,
+    {
+        let permit = self.inference.clone().acquire_owned().await.unwrap();
+        let lease = self.lease();
+        let runtime = Handle::current();
+        tokio::task::spawn_blocking(move || {
+            let _permit = permit;
+            runtime.block_on(f(lease.synthesizer()))
+        })
+        .await
+        .unwrap()
+    }
+
+    /// 推論しているリクエストが最も少ない組を選ぶ。
+    fn lease(self: &Arc<Self>) -> Lease {
+        let mut busy = self.busy.lock().unwrap();
+        let (index, _) = busy
+            .iter()
+            .enumerate()
+            .min_by_key(|&(_, &n)| n)
+            .expect("should not be empty");
+        busy[index] += 1;
+        Lease {
+            app: self.clone(),
+            index,
+        }
+    }
+}
+
+/// 推論セッションの組を使っている間のしるし。手放すと、組で推論しているリクエストの数を減らす。
+struct Lease {
+    app: Arc<App>,
+    index: usize,
+}
+
+impl Lease {
+    fn synthesizer(&self) -> Arc<Synthesizer> {
+        self.app.synthesizers[self.index].clone()
+    }
+}
+
+impl Drop for Lease {
+    fn drop(&mut self) {
+        self.app.busy.lock().unwrap()[self.index] -= 1;
+    }
+}
+
+fn main() -> anyhow::Result<()> {
+    setup_logger();
+
+    let args = Args::parse();
+    let mut runtime = runtime::Builder::new_multi_thread();
+    runtime.enable_all();
+    if let Some(workers) = args.workers {
+        runtime.worker_threads(workers.max(1));
+    }
+    runtime.build()?.block_on(run(args))
+}
+
+async fn run(args: Args) -> anyhow::Result<()> {
+    let start = Instant::now();
+    let sessions = args.sessions.max(1);
+    let max_concurrency = args.max_concurrency.unwrap_or(sessions).max(1);
+    let app = Arc::new(App::new(
+        synthesizers(&args, sessions).await?,
+        max_concurrency,
+    ));
+    let listener = TcpListener::bind(args.addr)
+        .await
+        .with_context(|| format!("could not listen on {}", args.addr))?;
+    info!(
+        "listening on http://{} (started in {:?}, {} worker(s), {sessions} session(s), \
+         {max_concurrency} concurrent inference(s))",
+        args.addr,
+        start.elapsed(),
+        args.workers
+            .unwrap_or_else(|| thread::available_parallelism().map_or(1, |n| n.get())),
+    );
+    serve(listener, app, Duration::from_secs(args.keep_alive_timeout)).await;
+    Ok(())
+}
+
+/// 推論セッションの組を`sessions`個作り、それぞれに音声モデルを読み込む。
+async fn synthesizers(args: &Args, sessions: usize) -> anyhow::Result<Vec<Synthesizer>> {
+    let models = if args.vvm.is_empty() {
+        VoiceModel::get_all_models().await?
+    } else {
+        let mut models = Vec::with_capacity(args.vvm.len());
+        for vvm in &args.vvm {
+            models.push(VoiceModel::from_path(vvm).await?);
+        }
+        models
+    };
+
+    let mut synthesizers = Vec::with_capacity(sessions);
+    for _ in 0..sessions {
+        // Open JTalkは一度に一つの解析しかできないため、組ごとに持つ
+        let open_jtalk = Arc::new(OpenJtalk::new_with_initialize(&args.open_jtalk_dict_dir)?);
+        let synthesizer = Synthesizer::new_with_initialize(
+            open_jtalk,
+            &InitializeOptions {
+                acceleration_mode: match args.device {
+                    Device::Cpu => AccelerationMode::Cpu,
+                    Device::Gpu => AccelerationMode::Gpu,
+                },
+                cpu_num_threads: args.cpu_num_threads,
+                // 共有すると組どうしが推論セッションのロックを待ち合う
+                share_sessions: false,
+                ..Default::default()
+            },
+        )
+        .await?;
+        for model in &models {
+            synthesizer.load_voice_model(model).await?;
+        }
+        synthesizers.push(synthesizer);
+    }
+    info!(
+        "loaded {} model(s) into {sessions} session(s)",
+        models.len()
+    );
+    Ok(synthesizers)
+}
+
+/// Ctrl-Cを受け取るまで接続を受け付ける。受け取った後は新しい接続を受け付けず、処理中の
+/// リクエストが終わるのを待つ。
+async fn serve(listener: TcpListener, app: Arc<App>, keep_alive_timeout: Duration) {
+    let mut builder = http1::Builder::new();
+    builder
+        .timer(TokioTimer::new())
+        .keep_alive(true)
+        .header_read_timeout(keep_alive_timeout);
+    let graceful = GracefulShutdown::new();
+    let mut shutdown = pin!(tokio::signal::ctrl_c());
+
+    loop {
+        let stream = tokio::select! {
+            accepted = listener.accept() => match accepted {
+                Ok((stream, _)) => stream,
+                Err(err) => {
+                    warn!("could not accept a connection: {err}");
+                    continue;
+                }
+            },
+            _ = &mut shutdown => break,
+        };
+        // 音声の断片を溜めずに送る
+        if let Err(err) = stream.set_nodelay(true) {
+            debug!("could not set TCP_NODELAY: {err}");
+        }
+        let app = app.clone();
+        let service = service_fn(move |request| routes::handle(app.clone(), request));
+        let connection = graceful.watch(builder.serve_connection(TokioIo::new(stream), service));
+        tokio::spawn(async move {
+            if let Err(err) = connection.await {
+                debug!("connection closed: {err}");
+            }
+        });
+    }
+
+    info!("shutting down");
+    tokio::select! {
+        _ = graceful.shutdown() => {}
+        _ = tokio::time::sleep(SHUTDOWN_TIMEOUT) => {
+            warn!("gave up waiting for {SHUTDOWN_TIMEOUT:?}");
+        }
+    }
+}
+
+fn setup_logger() {
+    tracing_subscriber::fmt()
+        .with_env_filter(format!("error,{}=info", env!("CARGO_CRATE_NAME")))
+        .with_writer(io::stderr)
+        .with_target(false)
+        .init();
+}
@@ -0,0 +1,594 @@
+//! エンドポイントごとの処理。
+//!
+//! パラメータの名前と意味はVOICEVOX ENGINEに合わせる。エラーはENGINEと同じく`{"detail": ...}`の
+//! 形で返す。
+
+use std::{convert::Infallible, sync::Arc, time::Instant};
+
+use bytes::Bytes;
+use http_body_util::{BodyExt as _, LengthLimitError, Limited};
+use hyper::{
+    body::Incoming,
+    header::{HeaderValue, CONTENT_TYPE},
+    http::request::Parts,
+    Method, Request, StatusCode,
+};
+use serde::Serialize;
+use tokio::sync::mpsc;
+use tracing::{debug, warn};
+use voicevox_core::{
+    AccentPhrasesOptions, AudioQueryOptions, Encoder, OutputFormat, StyleId, SynthesisOptions,
+    TtsOptions, VERSION,
+};
+
+use crate::{body::Body, compat, App};
+
+type Response = hyper::Response<Body>;
+
+/// 受け取るリクエストの本体の大きさの上限。
+const MAX_REQUEST_BODY_SIZE: usize = 16 * 1024 * 1024;
+/// `/tts`で、送り終えていない音声の断片をいくつまで溜めるか。
+const STREAM_QUEUE_LEN: usize = 4;
+/// 文の区切りとする文字。
+const SENTENCE_DELIMITERS: &[char] = &['。', '！', '？', '!', '?', '\n'];
+/// 文の区切りの直後にあれば、前の文に含める閉じ括弧。
+const CLOSING_BRACKETS: &[char] = &['」', '』', '）', ')'];
+
+pub(crate) async fn handle(
+    app: Arc<App>,
+    request: Request<Incoming>,
+) -> Result<Response, Infallible> {
+    let start = Instant::now();
+    let (parts, body) = request.into_parts();
+    let response = route(app, &parts, body)
+        .await
+        .unwrap_or_else(HttpError::into_response);
+    debug!(
+        "{} {} {} in {:?}",
+        parts.method,
+        parts.uri.path(),
+        response.status(),
+        start.elapsed(),
+    );
+    Ok(response)
+}
+
+async fn route<B>(app: Arc<App>, parts: &Parts, body: B) -> Result<Response, HttpError>
+where
+    B: hyper::body::Body<Data = Bytes>,
+    B::Error: Into<Box<dyn std::error::Error + Send + Sync>>,
+{
+    let query = &Query::parse(parts.uri.query());
+    match (&parts.method, parts.uri.path()) {
+        (&Method::GET, "/version") => json(&VERSION),
+        (&Method::GET, "/core_versions") => json(&[VERSION]),
+        (&Method::GET, "/speakers") => json(&app.metas()),
+        (&Method::GET, "/metrics") => Ok(with_content_type(
+            Body::full(app.stats().to_prometheus_text()),
+            "text/plain; version=0.0.4",
+        )),
+        (&Method::POST, "/audio_query") => audio_query(app, query).await,
+        (&Method::POST, "/accent_phrases") => accent_phrases(app, query).await,
+        (&Method::POST, "/synthesis") => synthesis(app, query, body).await,
+        (&Method::POST, "/tts") => tts(app, query).await,
+        (
+            _,
+            "/version" | "/core_versions" | "/speakers" | "/metrics" | "/audio_query"
+            | "/accent_phrases" | "/synthesis" | "/tts",
+        ) => Err(HttpError::new(
+            StatusCode::METHOD_NOT_ALLOWED,
+            "Method Not Allowed",
+        )),
+        _ => Err(HttpError::new(StatusCode::NOT_FOUND, "Not Found")),
+    }
+}
+
+async fn audio_query(app: Arc<App>, query: &Query) -> Result<Response, HttpError> {
+    let text = query.required::<String>("text")?;
+    let style_id = StyleId::new(query.required("speaker")?);
+    let audio_query = app
+        .infer(move |synthesizer| async move {
+            synthesizer
+                .audio_query(&text, style_id, &AudioQueryOptions::default())
+                .await
+        })
+        .await?;
+    json(&compat::audio_query_to_engine(&audio_query))
+}
+
+async fn accent_phrases(app: Arc<App>, query: &Query) -> Result<Response, HttpError> {
+    let text = query.required::<String>("text")?;
+    let style_id = StyleId::new(query.required("speaker")?);
+    let kana = query.optional("is_kana", false)?;
+    let accent_phrases = app
+        .infer(move |synthesizer| async move {
+            synthesizer
+                .create_accent_phrases(&text, style_id, &AccentPhrasesOptions { kana })
+                .await
+        })
+        .await?;
+    json(&accent_phrases)
+}
+
+async fn synthesis<B>(app: Arc<App>, query: &Query, body: B) -> Result<Response, HttpError>
+where
+    B: hyper::body::Body<Data = Bytes>,
+    B::Error: Into<Box<dyn std::error::Error + Send + Sync>>,
+{
+    let style_id = StyleId::new(query.required("speaker")?);
+    let enable_interrogative_upspeak = query.optional("enable_interrogative_upspeak", true)?;
+    let output_format = query.optional("output_format", OutputFormat::Wav)?;
+
+    let body = Limited::new(body, MAX_REQUEST_BODY_SIZE)
+        .collect()
+        .await
+        .map_err(|err| match err.downcast_ref::<LengthLimitError>() {
+            Some(_) => HttpError::new(StatusCode::PAYLOAD_TOO_LARGE, err.to_string()),
+            None => HttpError::new(StatusCode::BAD_REQUEST, err.to_string()),
+        })?
+        .to_bytes();
+    let audio_query = serde_json::from_slice(&body)
+        .and_then(compat::audio_query_from_engine)
+        .map_err(|err| HttpError::unprocessable(format!("invalid AudioQuery: {err}")))?;
+
+    let wav = app
+        .infer(move |synthesizer| async move {
+            let options = SynthesisOptions {
+                enable_interrogative_upspeak,
+                output_format,
+                ..Default::default()
+            };
+            synthesizer
+                .synthesis(&audio_query, style_id, &options)
+                .await
+        })
+        .await?;
+    Ok(with_content_type(
+        Body::full(wav),
+        content_type(output_format),
+    ))
+}
+
+/// テキスト音声合成を行う。ENGINEには無いエンドポイント。
+///
+/// AquesTalk風記法でないテキストは文に分けて一文ずつ合成し、合成できた文から順に送る。最初の文を
+/// 合成できるまではステータスコードを送らないため、最初の文のエラーはエラーとして返せる。接続が
+/// 切られた場合は、残りの文を合成しない。
+async fn tts(app: Arc<App>, query: &Query) -> Result<Response, HttpError> {
+    let text = query.required::<String>("text")?;
+    let style_id = StyleId::new(query.required("speaker")?);
+    let kana = query.optional("is_kana", false)?;
+    let enable_interrogative_upspeak = query.optional("enable_interrogative_upspeak", true)?;
+    let output_format = query.optional("output_format", OutputFormat::Wav)?;
+
+    let mut sentences = if kana { vec![] } else { split_sentences(&text) };
+    if sentences.is_empty() {
+        // 空のテキストに対するエラーはVOICEVOX COREに任せる
+        sentences.push(text);
+    }
+
+    let (tx, mut rx) = mpsc::channel(STREAM_QUEUE_LEN);
+    tokio::spawn(async move {
+        let mut encoder = Encoder::new(output_format);
+        for sentence in sentences {
+            let waveform = app
+                .infer(move |synthesizer| async move {
+                    let options = TtsOptions {
+                        kana,
+                        enable_interrogative_upspeak,
+                        ..Default::default()
+                    };
+                    synthesizer
+                        .tts_waveform(&sentence, style_id, &options)
+                        .await
+                })
+                .await;
+            let chunk = waveform.map(|waveform| {
+                let mut chunk = vec![];
+                encoder.write(&waveform, &mut chunk);
+                Bytes::from(chunk)
+            });
+            if let Err(err) = &chunk {
+                warn!("could not synthesize a sentence: {err}");
+            }
+            let failed = chunk.is_err();
+            if tx.send(chunk).await.is_err() || failed {
+                return;
+            }
+        }
+        let mut rest = vec![];
+        encoder.finish(&mut rest);
+        if !rest.is_empty() {
+            let _ = tx.send(Ok(rest.into())).await;
+        }
+    });
+
+    let first = rx
+        .recv()
+        .await
+        .ok_or_else(|| HttpError::new(StatusCode::INTERNAL_SERVER_ERROR, "synthesis aborted"))??;
+    Ok(with_content_type(
+        Body::Stream {
+            first: Some(first),
+            rest: rx,
+        },
+        content_type(output_format),
+    ))
+}
+
+/// テキストを文に分ける。区切りの文字は前の文に含め、空白だけの文は除く。
+fn split_sentences(text: &str) -> Vec<String> {
+    let mut sentences = vec![];
+    let mut sentence = String::new();
+    let mut chars = text.chars().peekable();
+    while let Some(c) = chars.next() {
+        sentence.push(c);
+        // 「！？」や「。」」のように続く区切りと閉じ括弧は、まとめて前の文に含める
+        let ends = SENTENCE_DELIMITERS.contains(&c) || CLOSING_BRACKETS.contains(&c);
+        let continues = chars.peek().map_or(false, |next| {
+            SENTENCE_DELIMITERS.contains(next) || CLOSING_BRACKETS.contains(next)
+        });
+        if ends && !continues && sentence.contains(SENTENCE_DELIMITERS) {
+            push_sentence(&mut sentences, &sentence);
+            sentence.clear();
+        }
+    }
+    push_sentence(&mut sentences, &sentence);
+    sentences
+}
+
+fn push_sentence(sentences: &mut Vec<String>, sentence: &str) {
+    let sentence = sentence.trim();
+    if !sentence.is_empty() {
+        sentences.push(sentence.to_owned());
+    }
+}
+
+fn content_type(output_format: OutputFormat) -> &'static str {
+    match output_format {
+        OutputFormat::Wav => "audio/wav",
+        OutputFormat::Flac => "audio/flac",
+        OutputFormat::MuLaw => "audio/basic",
+        OutputFormat::ALaw => "audio/x-alaw-basic",
+    }
+}
+
+fn json(value: &impl Serialize) -> Result<Response, HttpError> {
+    let json = serde_json::to_vec(value).expect("should be serializable");
+    Ok(with_content_type(Body::full(json), "application/json"))
+}
+
+fn with_content_type(body: Body, content_type: &'static str) -> Response {
+    let mut response = Response::new(body);
+    response
+        .headers_mut()
+        .insert(CONTENT_TYPE, HeaderValue::from_static(content_type));
+    response
+}
+
+/// クエリ文字列。
+struct Query(Vec<(String, String)>);
+
+impl Query {
+    fn parse(query: Option<&str>) -> Self {
+        let query = query.unwrap_or_default().as_bytes();
+        Self(form_urlencoded::parse(query).into_owned().collect())
+    }
+
+    fn required<T: FromQuery>(&self, name: &str) -> Result<T, HttpError> {
+        self.get(name)?
+            .ok_or_else(|| HttpError::unprocessable(format!("`{name}` is required")))
+    }
+
+    fn optional<T: FromQuery>(&self, name: &str, default: T) -> Result<T, HttpError> {
+        Ok(self.get(name)?.unwrap_or(default))
+    }
+
+    fn get<T: FromQuery>(&self, name: &str) -> Result<Option<T>, HttpError> {
+        let Some((_, value)) = self.0.iter().find(|(key, _)| key == name) else {
+            return Ok(None);
+        };
+        T::from_query(value)
+            .map(Some)
+            .ok_or_else(|| HttpError::unprocessable(format!("invalid `{name}`: {value:?}")))
+    }
+}
+
+trait FromQuery: Sized {
+    fn from_query(value: &str) -> Option<Self>;
+}
+
+impl FromQuery for String {
+    fn from_query(value: &str) -> Option<Self> {
+        Some(value.to_owned())
+    }
+}
+
+impl FromQuery for u32 {
+    fn from_query(value: &str) -> Option<Self> {
+        value.parse().ok()
+    }
+}
+
+impl FromQuery for bool {
+    fn from_query(value: &str) -> Option<Self> {
+        match &*value.to_ascii_lowercase() {
+            "true" | "1" | "yes" | "on" => Some(true),
+            "false" | "0" | "no" | "off" => Some(false),
+            _ => None,
+        }
+    }
+}
+
+impl FromQuery for OutputFormat {
+    fn from_query(value: &str) -> Option<Self> {
+        serde_json::from_value(value.into()).ok()
+    }
+}
+
+/// エラーとして返すレスポンス。
+#[derive(Debug)]
+struct HttpError {
+    status: StatusCode,
+    detail: String,
+}
+
+impl HttpError {
+    fn new(status: StatusCode, detail: impl Into<String>) -> Self {
+        Self {
+            status,
+            detail: detail.into(),
+        }
+    }
+
+    fn unprocessable(detail: impl Into<String>) -> Self {
+        Self::new(StatusCode::UNPROCESSABLE_ENTITY, detail)
+    }
+
+    fn into_response(self) -> Response {
+        let body = serde_json::json!({ "detail": self.detail });
+        let mut response = with_content_type(Body::full(body.to_string()), "application/json");
+        *response.status_mut() = self.status;
+        response
+    }
+}
+
+impl From<voicevox_core::Error> for HttpError {
+    fn from(err: voicevox_core::Error) -> Self {
+        use voicevox_core::Error;
+
+        let status = match err {
+            // ENGINEと同じく、入力が正しくないものは422とする
+            Error::InvalidStyleId { .. }
+            | Error::InvalidModelId { .. }
+            | Error::ParseKana(_)
+            | Error::ExtractFullContextLabel(_) => StatusCode::UNPROCESSABLE_ENTITY,
+            Error::DeadlineExceeded | Error::TimedOut => StatusCode::SERVICE_UNAVAILABLE,
+            _ => {
+                warn!("{err}");
+                StatusCode::INTERNAL_SERVER_ERROR
+            }
+        };
+        Self::new(status, err.to_string())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use http_body_util::Full;
+    use voicevox_core::{AccelerationMode, InitializeOptions, OpenJtalk, Synthesizer, VoiceModel};
+
+    use super::*;
+
+    /// サンプルの音声モデルを読み込んだ推論セッションの組を`sessions`個持つ[`App`]。
+    async fn app(sessions: usize) -> Arc<App> {
+        let model = VoiceModel::from_path(concat!(
+            env!("CARGO_MANIFEST_DIR"),
+            "/../../model/sample.vvm",
+        ))
+        .await
+        .unwrap();
+        let mut synthesizers = vec![];
+        for _ in 0..sessions {
+            let open_jtalk =
+                Arc::new(OpenJtalk::new_with_initialize(test_util::OPEN_JTALK_DIC_DIR).unwrap());
+            let synthesizer = Synthesizer::new_with_initialize(
+                open_jtalk,
+                &InitializeOptions {
+                    acceleration_mode: AccelerationMode::Cpu,
+                    ..Default::default()
+                },
+            )
+            .await
+            .unwrap();
+            synthesizer.load_voice_model(&model).await.unwrap();
+            synthesizers.push(synthesizer);
+        }
+        Arc::new(App::new(synthesizers, sessions))
+    }
+
+    fn with_query(path: &str, pairs: &[(&str, &str)]) -> String {
+        let query = form_urlencoded::Serializer::new(String::new())
+            .extend_pairs(pairs)
+            .finish();
+        format!("{path}?{query}")
+    }
+
+    /// [`route`]にリクエストを渡し、ステータスコード・`Content-Type`・本体を返す。
+    async fn request(
+        app: &Arc<App>,
+        method: Method,
+        uri: &str,
+        body: impl Into<Bytes>,
+    ) -> (StatusCode, String, Bytes) {
+        let (parts, ()) = Request::builder()
+            .method(method)
+            .uri(uri)
+            .body(())
+            .unwrap()
+            .into_parts();
+        let response = route(app.clone(), &parts, Full::new(body.into()))
+            .await
+            .unwrap_or_else(HttpError::into_response);
+        let status = response.status();
+        let content_type = response.headers()[CONTENT_TYPE]
+            .to_str()
+            .unwrap()
+            .to_owned();
+        let body = response.into_body().collect().await.unwrap().to_bytes();
+        (status, content_type, body)
+    }
+
+    #[tokio::test]
+    async fn endpoints_work() {
+        let app = app(2).await;
+
+        let (status, _, body) = request(&app, Method::GET, "/version", "").await;
+        assert_eq!(StatusCode::OK, status);
+        assert_eq!(serde_json::to_vec(&VERSION).unwrap(), body);
+
+        let (status, _, body) = request(&app, Method::GET, "/speakers", "").await;
+        assert_eq!(StatusCode::OK, status);
+        assert!(!serde_json::from_slice::<Vec<serde_json::Value>>(&body)
+            .unwrap()
+            .is_empty());
+
+        let uri = with_query("/audio_query", &[("speaker", "0"), ("text", "こんにちは")]);
+        let (status, content_type, audio_query) = request(&app, Method::POST, &uri, "").await;
+        assert_eq!(StatusCode::OK, status);
+        assert_eq!("application/json", content_type);
+        // 全体に関わる値のキーはENGINEと同じくキャメルケースになる
+        let engine_audio_query = serde_json::from_slice::<serde_json::Value>(&audio_query).unwrap();
+        assert!(engine_audio_query["accent_phrases"].is_array());
+        assert!(engine_audio_query["speedScale"].is_number());
+
+        let (status, content_type, wav) =
+            request(&app, Method::POST, "/synthesis?speaker=0", audio_query).await;
+        assert_eq!(StatusCode::OK, status);
+        assert_eq!("audio/wav", content_type);
+        assert!(wav.starts_with(b"RIFF"));
+
+        // 文ごとに合成したものが、一つのWAVとして続けて送られる
+        let uri = with_query(
+            "/tts",
+            &[("speaker", "0"), ("text", "こんにちは。さようなら。")],
+        );
+        let (status, content_type, wav) = request(&app, Method::POST, &uri, "").await;
+        assert_eq!(StatusCode::OK, status);
+        assert_eq!("audio/wav", content_type);
+        assert!(wav.starts_with(b"RIFF"));
+
+        // `/synthesis`で一回、`/tts`で文ごとに一回ずつ。どの組で合成したものも数える
+        assert_eq!(3, app.stats().stages[&voicevox_core::Stage::Decode].count);
+        let (status, _, metrics) = request(&app, Method::GET, "/metrics", "").await;
+        assert_eq!(StatusCode::OK, status);
+        assert!(std::str::from_utf8(&metrics)
+            .unwrap()
+            .contains("voicevox_stage_duration_seconds_count{stage=\"decode\"} 3\n"));
+    }
+
+    #[tokio::test]
+    async fn errors_are_returned_as_json() {
+        let app = app(1).await;
+        for (method, uri, expected) in [
+            (Method::GET, "/nothing", StatusCode::NOT_FOUND),
+            (Method::GET, "/tts", StatusCode::METHOD_NOT_ALLOWED),
+            (
+                Method::POST,
+                "/tts?text=a",
+                StatusCode::UNPROCESSABLE_ENTITY,
+            ),
+            (
+                Method::POST,
+                "/audio_query?speaker=9999&text=a",
+                StatusCode::UNPROCESSABLE_ENTITY,
+            ),
+            (
+                Method::POST,
+                "/synthesis?speaker=0",
+                StatusCode::UNPROCESSABLE_ENTITY,
+            ),
+        ] {
+            let (status, content_type, body) = request(&app, method, uri, "").await;
+            assert_eq!(expected, status, "{uri}");
+            assert_eq!("application/json", content_type);
+            assert!(
+                serde_json::from_slice::<serde_json::Value>(&body).unwrap()["detail"].is_string()
+            );
+        }
+    }
+
+    #[tokio::test]
+    async fn inference_goes_to_the_least_busy_session() {
+        let app = app(2).await;
+        let first = app.lease();
+        let second = app.lease();
+        assert!(!Arc::ptr_eq(&first.synthesizer(), &second.synthesizer()));
+
+        drop(first);
+        let third = app.lease();
+        assert_eq!(0, third.index);
+        drop((second, third));
+        assert_eq!(vec![0, 0], *app.busy.lock().unwrap());
+    }
+
+    #[test]
+    fn split_sentences_works() {
+        assert_eq!(
+            ["こんにちは。", "元気ですか？"],
+            *split_sentences("こんにちは。元気ですか？"),
+        );
+        assert_eq!(
+            ["えっ！？", "本当", "はい"],
+            *split_sentences("えっ！？本当\n\nはい"),
+        );
+        assert_eq!(
+            ["「はい。」", "と言った。"],
+            *split_sentences("「はい。」と言った。"),
+        );
+        assert_eq!(["（笑）です"], *split_sentences("（笑）です"));
+        assert!(split_sentences(" \n ").is_empty());
+    }
+
+    #[test]
+    fn query_works() {
+        let query = Query::parse(Some(
+            "text=%E3%81%82&speaker=1&is_kana=True&output_format=mu_law",
+        ));
+        assert_eq!("あ", query.required::<String>("text").unwrap());
+        assert_eq!(1, query.required::<u32>("speaker").unwrap());
+        assert!(query.optional("is_kana", false).unwrap());
+        assert!(query
+            .optional("enable_interrogative_upspeak", true)
+            .ok()
+            .unwrap());
+        assert_eq!(
+            OutputFormat::MuLaw,
+            query
+                .optional("output_format", OutputFormat::Wav)
+                .ok()
+                .unwrap(),
+        );
+    }
+
+    #[test]
+    fn query_fails() {
+        let query = Query::parse(Some("speaker=-1&is_kana=maybe"));
+        assert_eq!(
+            StatusCode::UNPROCESSABLE_ENTITY,
+            status(query.required::<u32>("speaker")),
+        );
+        assert_eq!(
+            StatusCode::UNPROCESSABLE_ENTITY,
+            status(query.optional("is_kana", false)),
+        );
+        assert_eq!(
+            StatusCode::UNPROCESSABLE_ENTITY,
+            status(query.required::<String>("text")),
+        );
+    }
+
+    fn status<T>(result: Result<T, HttpError>) -> StatusCode {
+        result.err().unwrap().status
+    }
+}
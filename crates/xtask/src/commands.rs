@@ -1 +1,3 @@
+pub(crate) mod bench_compare;
+pub(crate) mod quantize_vvm;
 pub(crate) mod update_c_header;
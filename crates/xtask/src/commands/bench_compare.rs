@@ -0,0 +1,150 @@
+use std::{
+    collections::BTreeMap,
+    env, io,
+    path::{Path, PathBuf},
+    process::Command,
+};
+
+use eyre::{bail, ContextCompat as _};
+use serde_json::Value;
+
+#[derive(clap::Parser)]
+pub(crate) struct ArgsBenchCompare {
+    /// Baseline file
+    #[clap(long, default_value = DEFAULT_BASELINE)]
+    baseline: PathBuf,
+
+    /// Save the results as the new baseline instead of comparing
+    #[clap(long)]
+    save: bool,
+
+    /// Regression threshold in percent
+    #[clap(long, default_value_t = 10.)]
+    threshold: f64,
+
+    /// Compare the results of the last run without running the benchmarks
+    #[clap(long)]
+    no_run: bool,
+
+    /// Filter passed to criterion
+    filter: Option<String>,
+}
+
+static DEFAULT_BASELINE: &str = concat!(
+    env!("CARGO_MANIFEST_DIR"),
+    "/../../target/bench-baseline.json",
+);
+static WORKSPACE_DIR: &str = concat!(env!("CARGO_MANIFEST_DIR"), "/../..");
+/// criterionの結果の置き場。ほかのベンチマークや以前の実行の結果と混ざらないよう、
+/// `target/criterion`とは分け、実行のたびに空にする。
+static CRITERION_HOME: &str = concat!(env!("CARGO_MANIFEST_DIR"), "/../../target/bench-compare");
+
+pub(crate) fn run(
+    ArgsBenchCompare {
+        baseline,
+        save,
+        threshold,
+        no_run,
+        filter,
+    }: ArgsBenchCompare,
+) -> eyre::Result<()> {
+    if !no_run {
+        run_benches(filter.as_deref())?;
+    }
+
+    let current = collect_results(Path::new(CRITERION_HOME))?;
+    if save {
+        fs_err::write(&baseline, serde_json::to_vec_pretty(&current)?)?;
+        eprintln!("Saved {} results to {}", current.len(), baseline.display());
+        return Ok(());
+    }
+
+    let baseline = serde_json::from_slice::<BTreeMap<String, f64>>(&fs_err::read(&baseline)?)?;
+    let mut regressions = vec![];
+
+    println!("| benchmark | baseline | current | change |");
+    println!("|-----------|----------|---------|--------|");
+    for (id, &current) in &current {
+        let Some(&base) = baseline.get(id) else {
+            println!("| {id} | - | {} | new |", format_nanos(current));
+            continue;
+        };
+        let change = (current / base - 1.) * 100.;
+        println!(
+            "| {id} | {} | {} | {change:+.2}% |",
+            format_nanos(base),
+            format_nanos(current),
+        );
+        if change > threshold {
+            regressions.push(id);
+        }
+    }
+
+    if !regressions.is_empty() {
+        bail!(
+            "{} benchmark(s) regressed by more than {threshold}%: {regressions:?}",
+            regressions.len(),
+        );
+    }
+    Ok(())
+}
+
+fn run_benches(filter: Option<&str>) -> eyre::Result<()> {
+    match fs_err::remove_dir_all(CRITERION_HOME) {
+        Err(err) if err.kind() != io::ErrorKind::NotFound => return Err(err.into()),
+        _ => {}
+    }
+    let status = Command::new(env::var("CARGO").unwrap_or_else(|_| "cargo".to_owned()))
+        .args(["bench", "-p", "voicevox_core", "--bench", "pipeline", "--"])
+        .args(filter)
+        .env("CRITERION_HOME", CRITERION_HOME)
+        .current_dir(WORKSPACE_DIR)
+        .status()?;
+    if !status.success() {
+        bail!("`cargo bench` failed: {status}");
+    }
+    Ok(())
+}
+
+/// `criterion_dir/**/new/`から、ベンチマークのIDと平均(ナノ秒)を集める。
+fn collect_results(criterion_dir: &Path) -> eyre::Result<BTreeMap<String, f64>> {
+    let mut results = BTreeMap::new();
+    let mut dirs = vec![criterion_dir.to_owned()];
+
+    while let Some(dir) = dirs.pop() {
+        for entry in fs_err::read_dir(&dir)? {
+            let path = entry?.path();
+            if !path.is_dir() {
+                continue;
+            }
+            if path.file_name().map_or(true, |name| name != "new") {
+                dirs.push(path);
+                continue;
+            }
+
+            let benchmark = read_json(&path.join("benchmark.json"))?;
+            let estimates = read_json(&path.join("estimates.json"))?;
+            let id = benchmark["full_id"]
+                .as_str()
+                .with_context(|| format!("`full_id` is missing in {}", path.display()))?;
+            let mean = estimates["mean"]["point_estimate"]
+                .as_f64()
+                .with_context(|| format!("`mean` is missing in {}", path.display()))?;
+            results.insert(id.to_owned(), mean);
+        }
+    }
+    Ok(results)
+}
+
+fn read_json(path: &Path) -> eyre::Result<Value> {
+    Ok(serde_json::from_slice(&fs_err::read(path)?)?)
+}
+
+fn format_nanos(nanos: f64) -> String {
+    match nanos {
+        n if n >= 1e9 => format!("{:.3} s", n / 1e9),
+        n if n >= 1e6 => format!("{:.3} ms", n / 1e6),
+        n if n >= 1e3 => format!("{:.3} µs", n / 1e3),
+        n => format!("{n:.3} ns"),
+    }
+}
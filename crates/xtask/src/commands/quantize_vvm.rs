@@ -0,0 +1,187 @@
+use std::{
+    io::{Read as _, Write as _},
+    path::{Path, PathBuf},
+    process::Command,
+};
+
+use eyre::{bail, ensure, eyre, ContextCompat as _};
+use serde_json::{Map, Value};
+use zip::{write::FileOptions, ZipArchive, ZipWriter};
+
+#[derive(clap::Parser)]
+pub(crate) struct ArgsQuantizeVvm {
+    /// Input VVM file
+    input: PathBuf,
+
+    /// Output VVM file
+    #[clap(short, long)]
+    output: PathBuf,
+
+    /// Precision of the variants to add
+    #[clap(long, value_enum)]
+    precision: Precision,
+
+    /// Models to quantize
+    #[clap(long, value_enum, value_delimiter = ',', default_value = "decode")]
+    models: Vec<Model>,
+
+    /// Python interpreter that has `onnxruntime` (for int8) or `onnxconverter-common` (for fp16)
+    #[clap(long, default_value = "python3")]
+    python: PathBuf,
+}
+
+#[derive(clap::ValueEnum, Clone, Copy)]
+enum Precision {
+    Fp16,
+    Int8,
+}
+
+impl Precision {
+    fn as_str(self) -> &'static str {
+        match self {
+            Self::Fp16 => "fp16",
+            Self::Int8 => "int8",
+        }
+    }
+}
+
+#[derive(clap::ValueEnum, Clone, Copy)]
+enum Model {
+    Decode,
+    PredictDuration,
+    PredictIntonation,
+}
+
+impl Model {
+    fn manifest_key(self) -> &'static str {
+        match self {
+            Self::Decode => "decode_filename",
+            Self::PredictDuration => "predict_duration_filename",
+            Self::PredictIntonation => "predict_intonation_filename",
+        }
+    }
+}
+
+pub(crate) fn run(
+    ArgsQuantizeVvm {
+        input,
+        output,
+        precision,
+        models,
+        python,
+    }: ArgsQuantizeVvm,
+) -> eyre::Result<()> {
+    ensure!(input != output, "`--output` must differ from the input");
+
+    let mut archive = ZipArchive::new(fs_err::File::open(&input)?)?;
+    let mut manifest = serde_json::from_slice::<Map<String, Value>>(&read_entry(
+        &mut archive,
+        MANIFEST_FILENAME,
+    )?)?;
+
+    let tempdir = tempfile::tempdir()?;
+    let mut variants = Map::new();
+    let mut quantized = vec![];
+
+    for model in models {
+        let filename = manifest
+            .get(model.manifest_key())
+            .and_then(Value::as_str)
+            .with_context(|| format!("`{}` is missing in the manifest", model.manifest_key()))?
+            .to_owned();
+        let variant_filename = variant_filename(&filename, precision)?;
+
+        let src = tempdir.path().join(&filename);
+        let dst = tempdir.path().join(&variant_filename);
+        fs_err::write(&src, read_entry(&mut archive, &filename)?)?;
+        quantize(&python, precision, &src, &dst)?;
+
+        eprintln!("{filename} -> {variant_filename}");
+        variants.insert(
+            model.manifest_key().to_owned(),
+            variant_filename.clone().into(),
+        );
+        quantized.push((variant_filename, fs_err::read(dst)?));
+    }
+
+    manifest
+        .entry("model_variants")
+        .or_insert_with(|| Map::new().into())
+        .as_object_mut()
+        .with_context(|| "`model_variants` in the manifest must be an object")?
+        .entry(precision.as_str())
+        .or_insert_with(|| Map::new().into())
+        .as_object_mut()
+        .with_context(|| format!("`model_variants.{}` must be an object", precision.as_str()))?
+        .extend(variants);
+
+    let mut writer = ZipWriter::new(fs_err::File::create(&output)?);
+    for i in 0..archive.len() {
+        let entry = archive.by_index_raw(i)?;
+        if entry.name() == MANIFEST_FILENAME || quantized.iter().any(|(n, _)| n == entry.name()) {
+            continue;
+        }
+        writer.raw_copy_file(entry)?;
+    }
+    writer.start_file(MANIFEST_FILENAME, FileOptions::default())?;
+    writer.write_all(&serde_json::to_vec_pretty(&manifest)?)?;
+    for (name, content) in quantized {
+        writer.start_file(name, FileOptions::default())?;
+        writer.write_all(&content)?;
+    }
+    writer.finish()?;
+    return Ok(());
+
+    const MANIFEST_FILENAME: &str = "manifest.json";
+}
+
+fn read_entry(archive: &mut ZipArchive<fs_err::File>, name: &str) -> eyre::Result<Vec<u8>> {
+    let mut entry = archive.by_name(name)?;
+    let mut buf = Vec::with_capacity(entry.size() as _);
+    entry.read_to_end(&mut buf)?;
+    Ok(buf)
+}
+
+/// `decode.onnx` → `decode.int8.onnx`
+fn variant_filename(filename: &str, precision: Precision) -> eyre::Result<String> {
+    let filename = Path::new(filename);
+    let stem = filename
+        .file_stem()
+        .and_then(|s| s.to_str())
+        .ok_or_else(|| eyre!("invalid filename: {}", filename.display()))?;
+    let extension = filename
+        .extension()
+        .and_then(|s| s.to_str())
+        .unwrap_or("onnx");
+    Ok(format!("{stem}.{}.{extension}", precision.as_str()))
+}
+
+fn quantize(python: &Path, precision: Precision, src: &Path, dst: &Path) -> eyre::Result<()> {
+    let status = Command::new(python)
+        .args(["-c", QUANTIZE_PY, precision.as_str()])
+        .args([src, dst])
+        .status()?;
+    if !status.success() {
+        bail!("quantization failed: {status}");
+    }
+    return Ok(());
+
+    // 入出力の型はfp32のままにしておき、voicevox_coreからは区別なく扱えるようにする
+    static QUANTIZE_PY: &str = r#"
+import sys
+
+precision, src, dst = sys.argv[1:]
+if precision == "int8":
+    from onnxruntime.quantization import QuantType, quantize_dynamic
+
+    quantize_dynamic(src, dst, weight_type=QuantType.QInt8)
+elif precision == "fp16":
+    import onnx
+    from onnxconverter_common import float16
+
+    model = float16.convert_float_to_float16(onnx.load(src), keep_io_types=True)
+    onnx.save(model, dst)
+else:
+    raise ValueError(precision)
+"#;
+}
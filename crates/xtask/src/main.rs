@@ -2,12 +2,19 @@ mod commands;
 
 use clap::Parser as _;
 
-use crate::commands::update_c_header::ArgsUpdateCHeader;
+use crate::commands::{
+    bench_compare::ArgsBenchCompare, quantize_vvm::ArgsQuantizeVvm,
+    update_c_header::ArgsUpdateCHeader,
+};
 
 #[derive(clap::Parser)]
 enum Args {
     /// Update voicevox_core.h
     UpdateCHeader(ArgsUpdateCHeader),
+    /// Add quantized variants of the ONNX models to a VVM file
+    QuantizeVvm(ArgsQuantizeVvm),
+    /// Run the voicevox_core benchmarks and compare the results to a stored baseline
+    BenchCompare(ArgsBenchCompare),
 }
 
 fn main() -> eyre::Result<()> {
@@ -15,5 +22,7 @@ fn main() -> eyre::Result<()> {
     color_eyre::install()?;
     match args {
         Args::UpdateCHeader(args) => commands::update_c_header::run(args),
+        Args::QuantizeVvm(args) => commands::quantize_vvm::run(args),
+        Args::BenchCompare(args) => commands::bench_compare::run(args),
     }
 }
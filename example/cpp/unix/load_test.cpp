@@ -0,0 +1,523 @@
+// voicevox_core の C API に負荷をかけ、レイテンシ・実時間比・メモリ使用量・スループットを計測するツール。
+//
+// 使い方は README.md を参照。
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "voicevox_core/voicevox_core.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Mode {
+  // voicevox_synthesizer_tts
+  Tts,
+  // voicevox_synthesizer_create_audio_query のみ
+  AudioQuery,
+  // voicevox_synthesizer_create_audio_query と voicevox_synthesizer_synthesis
+  QueryAndSynthesis,
+  // voicevox_synthesizer_tts_async を1スレッドから呼ぶ
+  TtsAsync,
+};
+
+struct Options {
+  Mode mode = Mode::Tts;
+  std::string corpus_path;
+  std::string open_jtalk_dict_path = "voicevox_core/open_jtalk_dic_utf_8-1.11";
+  std::vector<std::string> vvm_paths;
+  VoicevoxStyleId style_id = 0;
+  unsigned threads = 1;
+  // TtsAsync の場合の、クローズドループで同時に処理させるリクエスト数
+  unsigned in_flight = 16;
+  // 0 の場合はクローズドループ(各スレッドが前のリクエストの完了後すぐに次を送る)
+  double rps = 0;
+  double duration_sec = 60;
+  double report_interval_sec = 10;
+};
+
+struct Sample {
+  double latency_sec;
+  double audio_sec;
+};
+
+struct WorkerResult {
+  std::vector<Sample> samples;
+  uint64_t errors = 0;
+};
+
+void print_usage() {
+  std::cout
+      << "使い方: ./load_test --corpus <ファイル> [オプション]\n"
+         "\n"
+         "  --corpus <path>          1行に1文のテキストファイル\n"
+         "  --mode <mode>            tts | audio_query | query_and_synthesis | tts_async\n"
+         "                           (既定: tts)\n"
+         "  --threads <n>            リクエストを送るスレッド数 (既定: 1)。tts_async では無視される\n"
+         "  --in-flight <n>          tts_async で同時に処理させるリクエスト数 (既定: 16)\n"
+         "  --rps <r>                目標の秒間リクエスト数。省略時はクローズドループ\n"
+         "  --duration <sec>         計測時間 (既定: 60)\n"
+         "  --report-interval <sec>  途中経過を出す間隔 (既定: 10)\n"
+         "  --style-id <id>          スタイルID (既定: 0)\n"
+         "  --vvm <path>             読み込むVVM。複数指定可。省略時は全モデルを読み込む\n"
+         "  --dict <path>            Open JTalkの辞書ディレクトリ\n";
+}
+
+bool parse_args(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--help" || arg == "-h") {
+      return false;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << arg << " の値がありません" << std::endl;
+      return false;
+    }
+    std::string value(argv[++i]);
+    if (arg == "--corpus") {
+      options.corpus_path = value;
+    } else if (arg == "--mode") {
+      if (value == "tts") {
+        options.mode = Mode::Tts;
+      } else if (value == "audio_query") {
+        options.mode = Mode::AudioQuery;
+      } else if (value == "query_and_synthesis") {
+        options.mode = Mode::QueryAndSynthesis;
+      } else if (value == "tts_async") {
+        options.mode = Mode::TtsAsync;
+      } else {
+        std::cerr << "不明なモード: " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--threads") {
+      options.threads = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--in-flight") {
+      options.in_flight = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--rps") {
+      options.rps = std::atof(value.c_str());
+    } else if (arg == "--duration") {
+      options.duration_sec = std::atof(value.c_str());
+    } else if (arg == "--report-interval") {
+      options.report_interval_sec = std::atof(value.c_str());
+      if (!(options.report_interval_sec > 0)) {
+        std::cerr << "--report-interval は正の数でなければなりません: " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--style-id") {
+      options.style_id = static_cast<VoicevoxStyleId>(std::atoi(value.c_str()));
+    } else if (arg == "--vvm") {
+      options.vvm_paths.push_back(value);
+    } else if (arg == "--dict") {
+      options.open_jtalk_dict_path = value;
+    } else {
+      std::cerr << "不明なオプション: " << arg << std::endl;
+      return false;
+    }
+  }
+  if (options.corpus_path.empty()) {
+    std::cerr << "--corpus は必須です" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::vector<std::string> read_corpus(const std::string &path) {
+  std::vector<std::string> corpus;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty()) {
+      corpus.push_back(line);
+    }
+  }
+  return corpus;
+}
+
+// 現在の常駐メモリ(RSS)をKiB単位で返す。
+long current_rss_kib() {
+  std::ifstream statm("/proc/self/statm");
+  long size, resident;
+  if (statm >> size >> resident) {
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+  // /proc が無い環境(macOS)では最大RSSで代用する
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// WAVのヘッダから音声の長さ(秒)を求める。
+double wav_duration_sec(const uint8_t *wav, size_t size) {
+  if (size < 44) {
+    return 0;
+  }
+  uint16_t num_channels;
+  uint32_t sampling_rate, data_size;
+  std::memcpy(&num_channels, wav + 22, sizeof(num_channels));
+  std::memcpy(&sampling_rate, wav + 24, sizeof(sampling_rate));
+  std::memcpy(&data_size, wav + 40, sizeof(data_size));
+  return static_cast<double>(data_size) / (sampling_rate * num_channels * 2);
+}
+
+// 1リクエスト分を実行し、音声の長さ(秒)を返す。audio_query のみの場合は0。
+VoicevoxResultCode run_request(const VoicevoxSynthesizer *synthesizer, const Options &options,
+                               const std::string &text, double &audio_sec) {
+  audio_sec = 0;
+  size_t wav_size = 0;
+  uint8_t *wav = nullptr;
+  VoicevoxResultCode result;
+
+  switch (options.mode) {
+    case Mode::Tts:
+    case Mode::TtsAsync:
+      result = voicevox_synthesizer_tts(synthesizer, text.c_str(), options.style_id,
+                                        voicevox_default_tts_options, &wav_size, &wav);
+      break;
+    case Mode::AudioQuery:
+    case Mode::QueryAndSynthesis: {
+      char *audio_query = nullptr;
+      result = voicevox_synthesizer_create_audio_query(synthesizer, text.c_str(),
+                                                       options.style_id,
+                                                       voicevox_default_audio_query_options,
+                                                       &audio_query);
+      if (result != VOICEVOX_RESULT_OK || options.mode == Mode::AudioQuery) {
+        if (audio_query != nullptr) {
+          voicevox_json_free(audio_query);
+        }
+        return result;
+      }
+      result = voicevox_synthesizer_synthesis(synthesizer, audio_query, options.style_id,
+                                              voicevox_default_synthesis_options, &wav_size,
+                                              &wav);
+      voicevox_json_free(audio_query);
+      break;
+    }
+  }
+  if (result == VOICEVOX_RESULT_OK) {
+    audio_sec = wav_duration_sec(wav, wav_size);
+    voicevox_wav_free(wav);
+  }
+  return result;
+}
+
+// voicevox_synthesizer_tts_async の完了を、コールバックから発行元のスレッドに渡すためのキュー。
+// イベントループを持つサーバーであれば、ここでeventfdやパイプに書き込むことになる。
+struct Completion {
+  Clock::time_point scheduled;
+  VoicevoxResultCode result;
+  double audio_sec;
+};
+
+struct CompletionQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Completion> completions;
+};
+
+struct AsyncRequest {
+  CompletionQueue *queue;
+  Clock::time_point scheduled;
+};
+
+void on_tts_complete(void *user_data, VoicevoxResultCode result_code, uintptr_t wav_length,
+                     uint8_t *wav) {
+  std::unique_ptr<AsyncRequest> request(static_cast<AsyncRequest *>(user_data));
+  Completion completion{request->scheduled, result_code, 0};
+  if (result_code == VOICEVOX_RESULT_OK) {
+    completion.audio_sec = wav_duration_sec(wav, wav_length);
+    voicevox_wav_free(wav);
+  }
+  {
+    std::lock_guard<std::mutex> lock(request->queue->mutex);
+    request->queue->completions.push_back(completion);
+  }
+  request->queue->cv.notify_one();
+}
+
+// 1つのスレッドから voicevox_synthesizer_tts_async でリクエストを送り続ける。
+//
+// クローズドループでは常に options.in_flight 個のリクエストを処理させ、オープンループでは処理の
+// 完了を待たずに予定の時刻にリクエストを送る。
+void run_async(const VoicevoxSynthesizer *synthesizer, const Options &options,
+               const std::vector<std::string> &corpus, Clock::time_point start,
+               Clock::time_point deadline, std::mutex &results_mutex, WorkerResult &result) {
+  CompletionQueue queue;
+  uint64_t n = 0;
+  size_t in_flight = 0;
+
+  auto scheduled_time = [&](uint64_t n) {
+    return start + std::chrono::duration_cast<Clock::duration>(
+                       std::chrono::duration<double>(n / options.rps));
+  };
+  // 受け付けられたかどうかを返す
+  auto submit = [&](Clock::time_point scheduled) {
+    auto request = std::make_unique<AsyncRequest>(AsyncRequest{&queue, scheduled});
+    auto code = voicevox_synthesizer_tts_async(synthesizer, corpus[n++ % corpus.size()].c_str(),
+                                               options.style_id, voicevox_default_tts_options,
+                                               on_tts_complete, request.get());
+    if (code == VOICEVOX_RESULT_OK) {
+      request.release();
+      in_flight++;
+      return true;
+    }
+    std::lock_guard<std::mutex> lock(results_mutex);
+    result.errors++;
+    return false;
+  };
+
+  while (true) {
+    auto now = Clock::now();
+    auto wake = deadline;
+    if (now < deadline) {
+      if (options.rps > 0) {
+        for (auto scheduled = scheduled_time(n); scheduled <= now && scheduled < deadline;
+             scheduled = scheduled_time(n)) {
+          submit(scheduled);
+        }
+        wake = std::min(scheduled_time(n), deadline);
+      } else {
+        // 同期的に失敗したら、この回の補充はやめる
+        while (in_flight < options.in_flight && submit(now)) {
+        }
+        // 処理中のものがなければ、完了を待っても次の補充の機会が来ない
+        if (in_flight == 0) {
+          std::cerr << "リクエストを受け付けられなかったため、中断します" << std::endl;
+          break;
+        }
+      }
+    } else if (in_flight == 0) {
+      break;
+    }
+
+    std::deque<Completion> completions;
+    {
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      auto ready = [&] { return !queue.completions.empty(); };
+      if (now < deadline) {
+        queue.cv.wait_until(lock, wake, ready);
+      } else {
+        queue.cv.wait(lock, ready);
+      }
+      completions.swap(queue.completions);
+    }
+
+    auto finished = Clock::now();
+    std::lock_guard<std::mutex> lock(results_mutex);
+    for (const auto &completion : completions) {
+      in_flight--;
+      if (completion.result == VOICEVOX_RESULT_OK) {
+        double latency_sec = std::chrono::duration<double>(finished - completion.scheduled).count();
+        result.samples.push_back({latency_sec, completion.audio_sec});
+      } else {
+        result.errors++;
+      }
+    }
+  }
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  auto index = static_cast<size_t>(p / 100 * (values.size() - 1) + 0.5);
+  return values[std::min(index, values.size() - 1)];
+}
+
+void report(const std::vector<Sample> &samples, uint64_t errors, double elapsed_sec,
+            long initial_rss_kib) {
+  std::vector<double> latencies, rtfs;
+  double total_audio_sec = 0;
+  for (const auto &sample : samples) {
+    latencies.push_back(sample.latency_sec * 1000);
+    if (sample.audio_sec > 0) {
+      rtfs.push_back(sample.latency_sec / sample.audio_sec);
+      total_audio_sec += sample.audio_sec;
+    }
+  }
+  long rss_kib = current_rss_kib();
+
+  std::cout << std::fixed << std::setprecision(2) << "[" << elapsed_sec << "s] "
+            << "requests=" << samples.size() << " errors=" << errors
+            << " throughput=" << samples.size() / elapsed_sec << "req/s"
+            << " latency_ms(p50/p95/p99)=" << percentile(latencies, 50) << "/"
+            << percentile(latencies, 95) << "/" << percentile(latencies, 99);
+  if (!rtfs.empty()) {
+    std::cout << std::setprecision(4) << " rtf(p50/p95)=" << percentile(rtfs, 50) << "/"
+              << percentile(rtfs, 95) << std::setprecision(2)
+              << " audio_per_sec=" << total_audio_sec / elapsed_sec;
+  }
+  std::cout << " rss_kib=" << rss_kib << " (+" << rss_kib - initial_rss_kib << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parse_args(argc, argv, options)) {
+    print_usage();
+    return 1;
+  }
+
+  auto corpus = read_corpus(options.corpus_path);
+  if (corpus.empty()) {
+    std::cerr << "コーパスが空です: " << options.corpus_path << std::endl;
+    return 1;
+  }
+
+  std::cout << "coreの初期化中..." << std::endl;
+
+  OpenJtalkRc *open_jtalk;
+  auto result = voicevox_open_jtalk_rc_new(options.open_jtalk_dict_path.c_str(), &open_jtalk);
+  if (result != VOICEVOX_RESULT_OK) {
+    std::cerr << voicevox_error_result_to_message(result) << std::endl;
+    return 1;
+  }
+  auto initialize_options = voicevox_default_initialize_options;
+  initialize_options.load_all_models = options.vvm_paths.empty();
+  VoicevoxSynthesizer *synthesizer;
+  result = voicevox_synthesizer_new_with_initialize(open_jtalk, initialize_options, &synthesizer);
+  voicevox_open_jtalk_rc_delete(open_jtalk);
+  if (result != VOICEVOX_RESULT_OK) {
+    std::cerr << voicevox_error_result_to_message(result) << std::endl;
+    return 1;
+  }
+  for (const auto &path : options.vvm_paths) {
+    VoicevoxVoiceModel *model;
+    result = voicevox_voice_model_new_from_path(path.c_str(), &model);
+    if (result == VOICEVOX_RESULT_OK) {
+      result = voicevox_synthesizer_load_voice_model(synthesizer, model);
+      voicevox_voice_model_delete(model);
+    }
+    if (result != VOICEVOX_RESULT_OK) {
+      std::cerr << path << ": " << voicevox_error_result_to_message(result) << std::endl;
+      return 1;
+    }
+  }
+
+  // ウォームアップ
+  {
+    double audio_sec;
+    result = run_request(synthesizer, options, corpus[0], audio_sec);
+    if (result != VOICEVOX_RESULT_OK) {
+      std::cerr << voicevox_error_result_to_message(result) << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "負荷をかけています (";
+  if (options.mode == Mode::TtsAsync) {
+    std::cout << "async";
+    if (options.rps <= 0) {
+      std::cout << ", in-flight=" << options.in_flight;
+    }
+  } else {
+    std::cout << "threads=" << options.threads;
+  }
+  if (options.rps > 0) {
+    std::cout << ", rps=" << options.rps;
+  } else {
+    std::cout << ", closed-loop";
+  }
+  std::cout << ", duration=" << options.duration_sec << "s)..." << std::endl;
+
+  const long initial_rss_kib = current_rss_kib();
+  const auto start = Clock::now();
+  const auto deadline =
+      start + std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>(options.duration_sec));
+  std::atomic<uint64_t> next_request{0};
+  std::mutex results_mutex;
+  std::vector<WorkerResult> results(options.mode == Mode::TtsAsync ? 1 : options.threads);
+
+  std::vector<std::thread> workers;
+  if (options.mode == Mode::TtsAsync) {
+    workers.emplace_back([&] {
+      run_async(synthesizer, options, corpus, start, deadline, results_mutex, results[0]);
+    });
+  }
+  for (unsigned i = 0; i < options.threads && options.mode != Mode::TtsAsync; i++) {
+    workers.emplace_back([&, i] {
+      while (true) {
+        auto n = next_request.fetch_add(1);
+        // オープンループの場合、レイテンシはリクエストを送るべきだった時刻から計る。こうすることで
+        // 処理が詰まったときの待ち時間もレイテンシに含まれる
+        auto scheduled = Clock::now();
+        if (options.rps > 0) {
+          scheduled = start + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(n / options.rps));
+          std::this_thread::sleep_until(scheduled);
+        }
+        if (scheduled >= deadline) {
+          break;
+        }
+
+        double audio_sec;
+        auto result = run_request(synthesizer, options, corpus[n % corpus.size()], audio_sec);
+        double latency_sec = std::chrono::duration<double>(Clock::now() - scheduled).count();
+
+        std::lock_guard<std::mutex> lock(results_mutex);
+        if (result == VOICEVOX_RESULT_OK) {
+          results[i].samples.push_back({latency_sec, audio_sec});
+        } else {
+          results[i].errors++;
+        }
+      }
+    });
+  }
+
+  auto collect = [&](std::vector<Sample> &samples, uint64_t &errors) {
+    std::lock_guard<std::mutex> lock(results_mutex);
+    samples.clear();
+    errors = 0;
+    for (const auto &r : results) {
+      samples.insert(samples.end(), r.samples.begin(), r.samples.end());
+      errors += r.errors;
+    }
+  };
+
+  std::vector<Sample> samples;
+  uint64_t errors;
+  const auto interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.report_interval_sec));
+  for (auto next_report = start + interval; next_report < deadline; next_report += interval) {
+    std::this_thread::sleep_until(next_report);
+    collect(samples, errors);
+    report(samples, errors, std::chrono::duration<double>(Clock::now() - start).count(),
+           initial_rss_kib);
+  }
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  collect(samples, errors);
+
+  std::cout << "結果:" << std::endl;
+  report(samples, errors, std::chrono::duration<double>(Clock::now() - start).count(),
+         initial_rss_kib);
+
+  voicevox_synthesizer_delete(synthesizer);
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// voicevox_core.hpp (C++ラッパー) の呼び出しごとのオーバーヘッドを、C APIを直接呼んだ場合と比べる。
+//
+// 使い方は README.md を参照。
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "voicevox_core/voicevox_core.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const VoicevoxStyleId STYLE_ID = 0;
+const char *TEXT = "こんにちは";
+
+// `f`を`iterations`回呼び、1回あたりの時間をマイクロ秒で返す
+template <class F>
+double measure(unsigned iterations, F &&f) {
+  f();  // ウォームアップ
+  auto start = Clock::now();
+  for (unsigned i = 0; i < iterations; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+void report(const char *name, double raw_us, double wrapper_us) {
+  std::cout << std::left << std::setw(20) << name << std::right << std::fixed
+            << std::setprecision(3) << std::setw(14) << raw_us << std::setw(14) << wrapper_us
+            << std::setw(14) << wrapper_us - raw_us << std::endl;
+}
+
+void check(VoicevoxResultCode result) {
+  if (result != VOICEVOX_RESULT_OK) {
+    std::cerr << voicevox_error_result_to_message(result) << std::endl;
+    std::exit(1);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned iterations = argc > 1 ? std::stoul(argv[1]) : 100;
+
+  voicevox::OpenJtalk open_jtalk("voicevox_core/open_jtalk_dic_utf_8-1.11");
+  auto initialize_options = voicevox_default_initialize_options;
+  initialize_options.load_all_models = true;
+  voicevox::Synthesizer synthesizer(open_jtalk, initialize_options);
+  const VoicevoxSynthesizer *raw = synthesizer.get();
+
+  std::cout << std::left << std::setw(20) << "call" << std::right << std::setw(14) << "raw (us)"
+            << std::setw(14) << "wrapper (us)" << std::setw(14) << "diff (us)" << std::endl;
+
+  // 処理自体がほぼ無いため、呼び出しのオーバーヘッドがそのまま出る
+  report(
+      "is_gpu_mode",
+      measure(iterations * 1000, [&] { voicevox_synthesizer_is_gpu_mode(raw); }),
+      measure(iterations * 1000, [&] { synthesizer.is_gpu_mode(); }));
+
+  report(
+      "get_stats_json", measure(iterations * 10,
+                                [&] {
+                                  char *json;
+                                  check(voicevox_synthesizer_get_stats_json(raw, &json));
+                                  voicevox_json_free(json);
+                                }),
+      measure(iterations * 10, [&] { synthesizer.stats_json(); }));
+
+  report(
+      "create_audio_query", measure(iterations,
+                                    [&] {
+                                      char *json;
+                                      check(voicevox_synthesizer_create_audio_query(
+                                          raw, TEXT, STYLE_ID,
+                                          voicevox_default_audio_query_options, &json));
+                                      voicevox_json_free(json);
+                                    }),
+      measure(iterations, [&] { synthesizer.create_audio_query(TEXT, STYLE_ID); }));
+
+  report(
+      "tts", measure(iterations,
+                     [&] {
+                       uintptr_t length;
+                       uint8_t *wav;
+                       check(voicevox_synthesizer_tts(raw, TEXT, STYLE_ID,
+                                                      voicevox_default_tts_options, &length,
+                                                      &wav));
+                       voicevox_wav_free(wav);
+                     }),
+      measure(iterations, [&] { synthesizer.tts(TEXT, STYLE_ID); }));
+
+  return 0;
+}
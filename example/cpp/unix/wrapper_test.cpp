@@ -0,0 +1,96 @@
+// voicevox_core.hpp (C++ラッパー) のテスト。
+//
+// simple_tts と同じく、voicevox_core ディレクトリに辞書とモデルが置かれていることを前提とする。
+// `ctest --test-dir build` で実行できる。
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "voicevox_core/voicevox_core.hpp"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                      \
+  do {                                                                   \
+    if (!(cond)) {                                                       \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; \
+      ++failures;                                                        \
+    }                                                                    \
+  } while (false)
+
+// `f`が`expected`の結果コードで voicevox::Error を投げるか
+template <class F>
+bool throws_error(VoicevoxResultCode expected, F &&f) {
+  try {
+    f();
+  } catch (const voicevox::Error &e) {
+    return e.code() == expected;
+  }
+  return false;
+}
+
+bool is_wav(const uint8_t *data, std::size_t size) {
+  return size > 44 && std::memcmp(data, "RIFF", 4) == 0;
+}
+
+static_assert(!std::is_copy_constructible_v<voicevox::Synthesizer>);
+static_assert(std::is_nothrow_move_constructible_v<voicevox::Synthesizer>);
+static_assert(!std::is_copy_constructible_v<voicevox::Wav>);
+static_assert(std::is_nothrow_move_constructible_v<voicevox::Wav>);
+
+const VoicevoxStyleId STYLE_ID = 0;
+const char *TEXT = "この音声は、ボイスボックスを使用して、出力されています。";
+
+}  // namespace
+
+int main() {
+  CHECK(throws_error(VOICEVOX_RESULT_OPEN_FILE_ERROR,
+                     [] { voicevox::VoiceModel("not_exist.vvm"); }));
+
+  voicevox::OpenJtalk open_jtalk("voicevox_core/open_jtalk_dic_utf_8-1.11");
+  auto initialize_options = voicevox_default_initialize_options;
+  initialize_options.load_all_models = true;
+  voicevox::Synthesizer synthesizer(open_jtalk, initialize_options);
+
+  // JSONはコピーせずにそのまま渡せる
+  auto audio_query = synthesizer.create_audio_query(TEXT, STYLE_ID);
+  CHECK(audio_query.view().find("accent_phrases") != std::string_view::npos);
+  auto wav = synthesizer.synthesis(audio_query, STYLE_ID);
+  CHECK(is_wav(wav.data(), wav.size()));
+
+  // ムーブ後は元のオブジェクトが解放の責任を持たない
+  auto moved = std::move(wav);
+  CHECK(wav.data() == nullptr);
+  CHECK(is_wav(moved.data(), moved.size()));
+
+  // `std::string_view`はNUL終端の文字列にコピーしてから渡される
+  auto tts_wav = synthesizer.tts(std::string_view(TEXT), STYLE_ID);
+  CHECK(is_wav(tts_wav.data(), tts_wav.size()));
+
+  auto future = synthesizer.tts_async(TEXT, STYLE_ID);
+  auto async_wav = future.get();
+  CHECK(async_wav.size() == tts_wav.size());
+
+  CHECK(throws_error(VOICEVOX_RESULT_INVALID_STYLE_ID_ERROR,
+                     [&] { synthesizer.tts_async(TEXT, 9999).get(); }));
+
+  voicevox::CancellationToken cancellation_token;
+  cancellation_token.cancel();
+  auto tts_options = voicevox_default_tts_options;
+  tts_options.cancellation_token = cancellation_token.get();
+  CHECK(throws_error(VOICEVOX_RESULT_CANCELED_ERROR,
+                     [&] { synthesizer.tts(TEXT, STYLE_ID, tts_options); }));
+
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  std::cout << "ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,82 @@
+"""
+音声データの受け取り方ごとの、スループットとPython側のメモリ使用量のピークを比べる。
+
+- ``wav`` : WAVを ``bytes`` で受け取り、ヘッダを除いてNumPy配列にする従来の方法
+- ``int16`` / ``float32`` : ``output_format`` を指定してPCMを直接NumPy配列で受け取る方法
+"""
+
+import asyncio
+import time
+import tracemalloc
+from argparse import ArgumentParser
+from pathlib import Path
+from typing import Awaitable, Callable, Tuple
+
+import numpy as np
+from voicevox_core import AudioQuery, OpenJtalk, Synthesizer, VoiceModel
+
+# 長文での差が分かるよう、文を繰り返す
+TEXT = "この音声は、ボイスボックスを使用して、出力されています。" * 20
+
+
+async def main() -> None:
+    vvm_path, open_jtalk_dict_dir, style_id, iterations = parse_args()
+
+    synthesizer = await Synthesizer.new_with_initialize(OpenJtalk(open_jtalk_dict_dir))
+    await synthesizer.load_voice_model(await VoiceModel.from_path(vvm_path))
+    audio_query = await synthesizer.audio_query(TEXT, style_id)
+
+    async def wav() -> np.ndarray:
+        wav = await synthesizer.synthesis(audio_query, style_id)
+        return np.frombuffer(wav[44:], dtype=np.int16).astype(np.float32) / 0x7FFF
+
+    async def int16() -> np.ndarray:
+        return await synthesizer.synthesis(audio_query, style_id, output_format="int16")
+
+    async def float32() -> np.ndarray:
+        return await synthesizer.synthesis(
+            audio_query, style_id, output_format="float32"
+        )
+
+    print(f"{'output':<10}{'audio sec/sec':>16}{'peak (KiB)':>14}")
+    for name, f in [("wav", wav), ("int16", int16), ("float32", float32)]:
+        throughput, peak = await measure(f, audio_query, iterations)
+        print(f"{name:<10}{throughput:>16.2f}{peak / 1024:>14.1f}")
+
+
+async def measure(
+    f: Callable[[], Awaitable[np.ndarray]], audio_query: AudioQuery, iterations: int
+) -> Tuple[float, int]:
+    """合成した音声の秒数を処理時間で割ったものと、Python側で確保されたメモリのピークを返す。"""
+    await f()  # ウォームアップ
+
+    audio_secs = 0.0
+    tracemalloc.start()
+    start = time.perf_counter()
+    for _ in range(iterations):
+        samples = await f()
+        audio_secs += len(samples) / audio_query.output_sampling_rate
+        del samples
+    elapsed = time.perf_counter() - start
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    return audio_secs / elapsed, peak
+
+
+def parse_args() -> Tuple[Path, Path, int, int]:
+    argparser = ArgumentParser()
+    argparser.add_argument("vvm", type=Path, help="vvmファイルへのパス")
+    argparser.add_argument(
+        "--dict-dir",
+        default="./open_jtalk_dic_utf_8-1.11",
+        type=Path,
+        help="Open JTalkの辞書ディレクトリ",
+    )
+    argparser.add_argument("--style-id", default=0, type=int, help="スタイルID")
+    argparser.add_argument("--iterations", default=10, type=int, help="繰り返す回数")
+    args = argparser.parse_args()
+    return (args.vvm, args.dict_dir, args.style_id, args.iterations)
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
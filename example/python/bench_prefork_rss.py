@@ -0,0 +1,119 @@
+"""
+プロセスを複数立ち上げてそれぞれで音声モデルを読み込んだときの、プロセスごとのメモリ使用量を測る。
+
+環境変数 ``VV_SHARED_MODEL_DIR`` で復号済みの推論モデルの置き場を指定しない場合と、指定した場合とを
+比べる。メモリ使用量は Linux の ``/proc/self/smaps_rollup`` から読むため、Linux でのみ動く。
+
+RSS はプロセス間で共有されているページも含むため、共有の効果は PSS (共有されているページを共有
+しているプロセスの数で割ったもの) で見る。
+"""
+
+import asyncio
+import multiprocessing
+import os
+import tempfile
+from argparse import ArgumentParser
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+from voicevox_core import OpenJtalk, Synthesizer, VoiceModel
+
+FIELDS = ["Rss", "Pss", "Pss_Anon", "Pss_File"]
+
+
+def main() -> None:
+    vvm_path, open_jtalk_dict_dir, workers = parse_args()
+
+    print(f"{'mode':<10}" + "".join(f"{field + ' (MiB)':>16}" for field in FIELDS))
+    with tempfile.TemporaryDirectory() as shared_model_dir:
+        for mode, dir in [("private", None), ("shared", shared_model_dir)]:
+            usages = run_workers(vvm_path, open_jtalk_dict_dir, workers, dir)
+            average = {
+                field: sum(usage[field] for usage in usages) / len(usages)
+                for field in FIELDS
+            }
+            print(
+                f"{mode:<10}"
+                + "".join(f"{average[field] / 1024:>16.1f}" for field in FIELDS)
+            )
+    print(f"(各列は {workers} プロセスの平均)")
+
+
+def run_workers(
+    vvm_path: Path, open_jtalk_dict_dir: Path, workers: int, shared_model_dir: Optional[str]
+) -> List[Dict[str, int]]:
+    """すべてのプロセスが読み込みを終えた時点での、それぞれのメモリ使用量(KiB)を返す。"""
+    ctx = multiprocessing.get_context("fork")
+    loaded = ctx.Barrier(workers + 1)
+    measured = ctx.Barrier(workers + 1)
+    queue = ctx.Queue()
+    processes = [
+        ctx.Process(
+            target=worker,
+            args=(vvm_path, open_jtalk_dict_dir, shared_model_dir, loaded, measured, queue),
+        )
+        for _ in range(workers)
+    ]
+    for process in processes:
+        process.start()
+    loaded.wait()
+    usages = [queue.get() for _ in processes]
+    measured.wait()
+    for process in processes:
+        process.join()
+    return usages
+
+
+def worker(
+    vvm_path: Path,
+    open_jtalk_dict_dir: Path,
+    shared_model_dir: Optional[str],
+    loaded,
+    measured,
+    queue,
+) -> None:
+    if shared_model_dir is None:
+        os.environ.pop("VV_SHARED_MODEL_DIR", None)
+    else:
+        os.environ["VV_SHARED_MODEL_DIR"] = shared_model_dir
+
+    async def load() -> Synthesizer:
+        synthesizer = await Synthesizer.new_with_initialize(OpenJtalk(open_jtalk_dict_dir))
+        await synthesizer.load_voice_model(await VoiceModel.from_path(vvm_path))
+        await synthesizer.tts("こんにちは", 0)
+        return synthesizer
+
+    synthesizer = asyncio.run(load())
+    # 他のプロセスが読み込みを終えるのを待ってから測る
+    loaded.wait()
+    queue.put(memory_usage())
+    measured.wait()
+    del synthesizer
+
+
+def memory_usage() -> Dict[str, int]:
+    usage = {}
+    with open("/proc/self/smaps_rollup") as f:
+        for line in f:
+            name, _, value = line.partition(":")
+            if name in FIELDS:
+                usage[name] = int(value.split()[0])
+    return usage
+
+
+def parse_args() -> Tuple[Path, Path, int]:
+    argparser = ArgumentParser()
+    argparser.add_argument("vvm", type=Path, help="vvmファイルへのパス")
+    argparser.add_argument(
+        "--dict-dir",
+        default="./open_jtalk_dic_utf_8-1.11",
+        type=Path,
+        help="Open JTalkの辞書ディレクトリ",
+    )
+    argparser.add_argument("--workers", default=8, type=int, help="プロセスの数")
+    args = argparser.parse_args()
+    return (args.vvm, args.dict_dir, args.workers)
+
+
+if __name__ == "__main__":
+    main()